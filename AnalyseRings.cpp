@@ -30,12 +30,14 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "3DCalculations.h"
 #include "Angle.h"
 #include "BasicMathsFunctions.h"
+#include "ConnectivityTable.h"
 #include "CyclicInteger.h"
 #include "Plane.h"
 #include "Sort.h"
 #include "Vector3D.h"
 #include "Vector3DCalculations.h"
 
+#include <algorithm>
 #include <stdexcept>
 #include <iostream> // For testing only
 #include <cmath>
@@ -371,3 +373,124 @@ SixMemberedRingAnalyser::GeometryType SixMemberedRingAnalyser::axial_or_equatori
 
 // ********************************************************************************
 
+namespace
+{
+
+// Depth-first search for paths back to path[0] that only visit atoms with a higher index than path[0].
+void extend_path( const ConnectivityTable & connectivity_table, const size_t maximum_ring_size, std::vector< size_t > & path, std::vector< bool > & on_path, std::vector< std::vector< size_t > > & rings )
+{
+    const size_t current = path.back();
+    for ( size_t k( 0 ); k != connectivity_table.nneighbours( current ); ++k )
+    {
+        size_t neighbour = connectivity_table.neighbour( current, k );
+        if ( neighbour == path[0] )
+        {
+            // Each ring is found in two directions, keep one.
+            if ( ( path.size() > 2 ) && ( path[1] < path.back() ) )
+                rings.push_back( path );
+            continue;
+        }
+        if ( ( neighbour < path[0] ) || on_path[neighbour] || ( path.size() == maximum_ring_size ) )
+            continue;
+        path.push_back( neighbour );
+        on_path[neighbour] = true;
+        extend_path( connectivity_table, maximum_ring_size, path, on_path, rings );
+        on_path[neighbour] = false;
+        path.pop_back();
+    }
+}
+
+} // namespace
+
+// ********************************************************************************
+
+std::vector< std::vector< size_t > > find_rings( const ConnectivityTable & connectivity_table, const size_t maximum_ring_size )
+{
+    std::vector< std::vector< size_t > > result;
+    std::vector< bool > on_path( connectivity_table.size(), false );
+    std::vector< size_t > path;
+    for ( size_t i( 0 ); i != connectivity_table.size(); ++i )
+    {
+        path.push_back( i );
+        on_path[i] = true;
+        extend_path( connectivity_table, maximum_ring_size, path, on_path, result );
+        on_path[i] = false;
+        path.pop_back();
+    }
+    return result;
+}
+
+// ********************************************************************************
+
+// An atom is in a ring if at least one of its bonds is not a bridge.
+// Bridges are found with Tarjan's algorithm: an iterative depth-first search that keeps track of the
+// earliest discovered atom that can be reached from each subtree.
+std::vector< bool > atoms_in_rings( const ConnectivityTable & connectivity_table )
+{
+    const size_t natoms = connectivity_table.size();
+    const size_t not_discovered = natoms;
+    std::vector< bool > result( natoms, false );
+    std::vector< size_t > discovery_time( natoms, not_discovered );
+    std::vector< size_t > lowest_reachable( natoms, not_discovered );
+    // The stack holds the atom, its parent and the index of the next neighbour to visit.
+    std::vector< size_t > stack_atoms;
+    std::vector< size_t > stack_parents;
+    std::vector< size_t > stack_next;
+    size_t time( 0 );
+    for ( size_t root( 0 ); root != natoms; ++root )
+    {
+        if ( discovery_time[root] != not_discovered )
+            continue;
+        discovery_time[root] = time;
+        lowest_reachable[root] = time;
+        ++time;
+        stack_atoms.push_back( root );
+        stack_parents.push_back( not_discovered );
+        stack_next.push_back( 0 );
+        while ( ! stack_atoms.empty() )
+        {
+            size_t current = stack_atoms.back();
+            size_t parent = stack_parents.back();
+            if ( stack_next.back() != connectivity_table.nneighbours( current ) )
+            {
+                size_t neighbour = connectivity_table.neighbour( current, stack_next.back() );
+                ++stack_next.back();
+                if ( neighbour == parent )
+                    continue;
+                if ( discovery_time[neighbour] == not_discovered )
+                {
+                    discovery_time[neighbour] = time;
+                    lowest_reachable[neighbour] = time;
+                    ++time;
+                    stack_atoms.push_back( neighbour );
+                    stack_parents.push_back( current );
+                    stack_next.push_back( 0 );
+                }
+                else
+                {
+                    // A bond that closes a cycle.
+                    lowest_reachable[current] = std::min( lowest_reachable[current], discovery_time[neighbour] );
+                    result[current] = true;
+                    result[neighbour] = true;
+                }
+                continue;
+            }
+            stack_atoms.pop_back();
+            stack_parents.pop_back();
+            stack_next.pop_back();
+            if ( parent == not_discovered )
+                continue;
+            lowest_reachable[parent] = std::min( lowest_reachable[parent], lowest_reachable[current] );
+            // If the subtree of current can reach parent or an earlier atom, the bond parent-current is not a bridge.
+            if ( lowest_reachable[current] <= discovery_time[parent] )
+            {
+                result[parent] = true;
+                result[current] = true;
+            }
+        }
+    }
+    return result;
+}
+
+// ********************************************************************************
+
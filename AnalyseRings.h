@@ -29,6 +29,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ********************************************* */
 
 //class CollectionOfPoints;
+class ConnectivityTable;
 class Vector3D;
 
 #include "Mapping.h"
@@ -137,5 +138,13 @@ private:
 
 };
 
+// All rings (cycles in which no atom occurs twice) with at most maximum_ring_size atoms.
+// Every ring is listed once, starting with its lowest atom index, followed by the lower of its two neighbours in the ring.
+// Because all cycles are found, naphthalene with maximum_ring_size >= 10 also gives the ten-membered ring around the outside.
+std::vector< std::vector< size_t > > find_rings( const ConnectivityTable & connectivity_table, const size_t maximum_ring_size );
+
+// For each atom, whether it is part of a ring of any size. Linear in the number of atoms and bonds.
+std::vector< bool > atoms_in_rings( const ConnectivityTable & connectivity_table );
+
 #endif // ANALYSERINGS_H
 
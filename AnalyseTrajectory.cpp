@@ -33,19 +33,39 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "Element.h"
 #include "ReadCif.h"
 #include "TextFileWriter.h"
+#include "ThreadPool.h"
 #include "Utilities.h"
 
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+namespace
+{
+
+// Everything that is needed from one frame of the trajectory.
+struct DecodedFrame
+{
+    CrystalLattice crystal_lattice_;
+    Vector3D actual_centre_;
+    std::vector< std::vector< Vector3D > > fractional_positions_; // For each atom in the unit cell, its positions in all the unit cells of the supercell.
+};
+
+} // namespace
+
 // ********************************************************************************
 
 AnalyseTrajectory::AnalyseTrajectory( const FileList file_list,
                                       const size_t u,
                                       const size_t v,
                                       const size_t w,
-                                      const SpaceGroup & space_group ) :
+                                      const SpaceGroup & space_group,
+                                      const size_t nthreads ) :
 file_list_(file_list),
 u_(u),
 v_(v),
 w_(w),
+nthreads_(nthreads),
 space_group_(space_group),
 write_lean_(false),
 write_average_(true),
@@ -62,12 +82,49 @@ drift_correction_(USE_FIRST_FRAME)
 void AnalyseTrajectory::analyse()
 {
     file_list_.set_prepend_file_name_with_basedirectory( true );
-    std::string directory;
-    std::string file_name;
-    std::string extension;
     std::vector< Element > elements;
     std::vector< RunningAverageAndESD< Vector3D > > average_positions; // Fractional coordinates.
+    // For each atom, the sum of the outer products of the deviations from the running average (fractional coordinates),
+    // from which the covariance matrix and therefore the ADPs follow without storing the positions.
+    std::vector< SymmetricMatrix3D > co_moments;
+    // Only needed to write the sum of all frames.
     std::vector< std::vector< Vector3D > > fractional_positions_trajectory;
+    // The frames must be added in order: the first frame determines the drift correction, and the running averages
+    // (and therefore the output) should not depend on the number of threads.
+    std::function< void( const DecodedFrame & ) > add_frame = [&]( const DecodedFrame & frame )
+    {
+        average_a_.add_value( frame.crystal_lattice_.a() / u_ );
+        average_b_.add_value( frame.crystal_lattice_.b() / v_ );
+        average_c_.add_value( frame.crystal_lattice_.c() / w_ );
+        average_alpha_.add_value( frame.crystal_lattice_.alpha() );
+        average_beta_.add_value( frame.crystal_lattice_.beta() );
+        average_gamma_.add_value( frame.crystal_lattice_.gamma() );
+        average_volume_.add_value( frame.crystal_lattice_.volume() / ( u_ * v_ * w_ ) );
+        centres_of_mass_.push_back( frame.actual_centre_ );
+        if ( frame.fractional_positions_.size() != natoms_ )
+            throw std::runtime_error( "AnalyseTrajectory::analyse(): The number of atoms in the cif files is not the same, the average cif could not be generated." );
+        for ( size_t i( 0 ); i != natoms_; ++i )
+        {
+            for ( size_t j( 0 ); j != frame.fractional_positions_[i].size(); ++j )
+            {
+                const Vector3D & position = frame.fractional_positions_[i][j];
+                // Welford's update: ( n - 1 ) / n times the outer product of the deviation from the previous average.
+                if ( average_positions[i].nvalues() != 0 )
+                {
+                    const double n = average_positions[i].nvalues() + 1;
+                    Vector3D difference = position - average_positions[i].average();
+                    for ( size_t k( 0 ); k != 3; ++k )
+                    {
+                        for ( size_t l( k ); l != 3; ++l )
+                            co_moments[i].set_value( k, l, co_moments[i].value( k, l ) + ( ( n - 1.0 ) / n ) * difference.value( k ) * difference.value( l ) );
+                    }
+                }
+                average_positions[i].add_value( position );
+                if ( write_sum_ )
+                    fractional_positions_trajectory[i].push_back( position );
+            }
+        }
+    };
     // Read the first cif file and initialise everything.
     {
     CrystalStructure crystal_structure;
@@ -75,75 +132,50 @@ void AnalyseTrajectory::analyse()
     read_cif( file_list_.value( 0 ), crystal_structure );
     if ( write_lean_ )
         crystal_structure.save_cif( append_to_file_name( file_list_.value( 0 ), "_lean" ) );
-    CrystalLattice crystal_lattice = crystal_structure.crystal_lattice();
     crystal_structure.set_space_group( space_group_ );
-    average_a_.add_value( crystal_lattice.a() / u_ );
-    average_b_.add_value( crystal_lattice.b() / v_ );
-    average_c_.add_value( crystal_lattice.c() / w_ );
-    average_alpha_.add_value( crystal_lattice.alpha() );
-    average_beta_.add_value( crystal_lattice.beta() );
-    average_gamma_.add_value( crystal_lattice.gamma() );
-    average_volume_.add_value( crystal_lattice.volume() / ( u_ * v_ * w_ ) );
-    std::vector< std::vector< Vector3D > > fractional_positions_frame;
-    Vector3D actual_centre;
+    DecodedFrame frame;
+    frame.crystal_lattice_ = crystal_structure.crystal_lattice();
     // Returns a std::vector of atomic coordinates for each atom in the asymmetric unit.
     if ( ( drift_correction_ == NONE ) ||
          ( drift_correction_ == USE_FIRST_FRAME ) )
     {
-        crystal_structure.collapse_supercell( u_, v_, w_, 0, drift_correction_vector_, actual_centre, fractional_positions_frame );
-        drift_correction_vector_ = actual_centre;
+        crystal_structure.collapse_supercell( u_, v_, w_, 0, drift_correction_vector_, frame.actual_centre_, frame.fractional_positions_ );
+        drift_correction_vector_ = frame.actual_centre_;
     }
     else
-        crystal_structure.collapse_supercell( u_, v_, w_, drift_correction_, drift_correction_vector_, actual_centre, fractional_positions_frame );
-    centres_of_mass_.push_back( actual_centre );
-    natoms_ = fractional_positions_frame.size();
+        crystal_structure.collapse_supercell( u_, v_, w_, drift_correction_, drift_correction_vector_, frame.actual_centre_, frame.fractional_positions_ );
+    natoms_ = frame.fractional_positions_.size();
     elements.reserve( natoms_ );
-    average_positions.reserve( natoms_ );
     for ( size_t i( 0 ); i != natoms_; ++i )
-    {
         elements.push_back( crystal_structure.atom( i ).element() );
-        RunningAverageAndESD< Vector3D > average_position;
-        std::vector< Vector3D > temp_fractional_positions;
-        for ( size_t j( 0 ); j != fractional_positions_frame[i].size(); ++j )
-        {
-            average_position.add_value( fractional_positions_frame[i][j] );
-            temp_fractional_positions.push_back( fractional_positions_frame[i][j] );
-        }
-        average_positions.push_back( average_position );
-        fractional_positions_trajectory.push_back( temp_fractional_positions );
-    }
+    average_positions = std::vector< RunningAverageAndESD< Vector3D > >( natoms_ );
+    co_moments = std::vector< SymmetricMatrix3D >( natoms_, SymmetricMatrix3D( 0.0 ) );
+    if ( write_sum_ )
+        fractional_positions_trajectory = std::vector< std::vector< Vector3D > >( natoms_ );
+    add_frame( frame );
     }
-    // Read the remaining cif files.
-    for ( size_t i( 1 ); i != file_list_.size(); ++i )
+    // Read the remaining cif files. The cif files are read and the supercells are collapsed in parallel,
+    // a block of frames at a time so that only a few frames are in memory at any one time.
+    ThreadPool thread_pool( nthreads_ );
+    const size_t block_size = 4 * thread_pool.nthreads();
+    std::vector< DecodedFrame > frames( block_size );
+    for ( size_t block_begin( 1 ); block_begin < file_list_.size(); block_begin += block_size )
     {
-        std::cout << "Now reading cif... " + file_list_.value( i ).full_name() << std::endl;
-        CrystalStructure crystal_structure;
-        read_cif( file_list_.value( i ), crystal_structure );
-        if ( write_lean_ )
-            crystal_structure.save_cif( append_to_file_name( file_list_.value( i ), "_lean" ) );
-        CrystalLattice crystal_lattice = crystal_structure.crystal_lattice();
-        crystal_structure.set_space_group( space_group_ );
-        average_a_.add_value( crystal_lattice.a() / u_ );
-        average_b_.add_value( crystal_lattice.b() / v_ );
-        average_c_.add_value( crystal_lattice.c() / w_ );
-        average_alpha_.add_value( crystal_lattice.alpha() );
-        average_beta_.add_value( crystal_lattice.beta() );
-        average_gamma_.add_value( crystal_lattice.gamma() );
-        average_volume_.add_value( crystal_lattice.volume() / ( u_ * v_ * w_ ) );
-        std::vector< std::vector< Vector3D > > fractional_positions_frame;
-        // Returns a std::vector of atomic coordinates for each atom in the asymmetric unit
-        Vector3D actual_centre;
-        crystal_structure.collapse_supercell( u_, v_, w_, drift_correction_, drift_correction_vector_, actual_centre, fractional_positions_frame );
-        centres_of_mass_.push_back( actual_centre );
-        if ( fractional_positions_frame.size() != natoms_ )
-            throw std::runtime_error( "AnalyseTrajectory::analyse(): The number of atoms in the cif files is not the same, the average cif could not be generated." );
-        for ( size_t i( 0 ); i != natoms_; ++i )
+        const size_t nframes = std::min( block_size, file_list_.size() - block_begin );
+        thread_pool.run( nframes, [&]( const size_t k )
         {
-            for ( size_t j( 0 ); j != fractional_positions_frame[i].size(); ++j )
-            {
-                average_positions[i].add_value( fractional_positions_frame[i][j] );
-                fractional_positions_trajectory[i].push_back( fractional_positions_frame[i][j] );
-            }
+            CrystalStructure crystal_structure;
+            read_cif( file_list_.value( block_begin + k ), crystal_structure );
+            if ( write_lean_ )
+                crystal_structure.save_cif( append_to_file_name( file_list_.value( block_begin + k ), "_lean" ) );
+            crystal_structure.set_space_group( space_group_ );
+            frames[k].crystal_lattice_ = crystal_structure.crystal_lattice();
+            crystal_structure.collapse_supercell( u_, v_, w_, drift_correction_, drift_correction_vector_, frames[k].actual_centre_, frames[k].fractional_positions_ );
+        } );
+        for ( size_t k( 0 ); k != nframes; ++k )
+        {
+            std::cout << "Now adding frame... " + file_list_.value( block_begin + k ).full_name() << std::endl;
+            add_frame( frames[k] );
         }
     }
     crystal_lattice_average_ = CrystalLattice( average_a_.average(),
@@ -153,14 +185,28 @@ void AnalyseTrajectory::analyse()
                                                average_beta_.average(),
                                                average_gamma_.average() );
     std::vector< AnisotropicDisplacementParameters > all_ADPs;
+    all_ADPs.reserve( natoms_ );
     // We precalculate all ADPs, even if not necessary.
+    // The conversion from fractional to Cartesian coordinates is linear, so the Cartesian covariance matrix is M C M^T.
+    const Matrix3D M = crystal_lattice_average_.fractional_to_orthogonal_matrix();
     for ( size_t i( 0 ); i != natoms_; ++i )
     {
-        std::vector< Vector3D > cartesian_positions;
-        for ( size_t j( 0 ); j != fractional_positions_trajectory[i].size(); ++j )
-            cartesian_positions.push_back( crystal_lattice_average_.fractional_to_orthogonal_matrix() * fractional_positions_trajectory[i][j] );
-        AnisotropicDisplacementParameters adps( cartesian_positions );
-        all_ADPs.push_back( adps );
+        const double nvalues = average_positions[i].nvalues();
+        SymmetricMatrix3D covariance_matrix( 0.0 );
+        for ( size_t k( 0 ); k != 3; ++k )
+        {
+            for ( size_t l( k ); l != 3; ++l )
+            {
+                double sum( 0.0 );
+                for ( size_t m( 0 ); m != 3; ++m )
+                {
+                    for ( size_t n( 0 ); n != 3; ++n )
+                        sum += M.value( k, m ) * co_moments[i].value( m, n ) * M.value( l, n );
+                }
+                covariance_matrix.set_value( k, l, sum / nvalues );
+            }
+        }
+        all_ADPs.push_back( AnisotropicDisplacementParameters( covariance_matrix ) );
     }
     if ( write_average_ )
         write_average( elements, average_positions, all_ADPs, true );
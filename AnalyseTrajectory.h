@@ -53,6 +53,8 @@ class Element;
   i.e. that no phase transition has taken place. Of course, if the space group is P1 there is no problem.
   You'll get horrible results when applying the space-group symmetry if you have manually repositioned the molecules so that all molecules were comfortably within the unit cell.
   Based on experience, Z' = 2 x 1/2 does not preserve the order of the atoms, so you cannot specify a space group in that case.
+  The positions are not stored: the averages and the ADPs are calculated from running sums, so memory does not grow with the number of frames
+  (unless the sum of all frames is written).
 */
 class AnalyseTrajectory
 {
@@ -62,11 +64,14 @@ public:
     //AnalyseTrajectory();
 
     // Make sure the space group name is set properly: it is written to the cif file.
+    // The cif files are read and the supercells are collapsed by nthreads threads, 0 means the number of cores.
+    // The frames are added in order, so the results do not depend on the number of threads.
     explicit AnalyseTrajectory( const FileList file_list,
                                 const size_t u = 1,
                                 const size_t v = 1,
                                 const size_t w = 1,
-                                const SpaceGroup & space_group = SpaceGroup() );
+                                const SpaceGroup & space_group = SpaceGroup(),
+                                const size_t nthreads = 0 );
 
     enum DriftCorrection { NONE, USE_FIRST_FRAME, USE_VECTOR };
 
@@ -95,6 +100,7 @@ private:
     size_t u_;
     size_t v_;
     size_t w_;
+    size_t nthreads_;
     size_t natoms_;
     SpaceGroup space_group_;
     CrystalLattice crystal_lattice_average_;
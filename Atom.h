@@ -60,12 +60,12 @@ public:
     void set_element( const Element element ) { element_ = element; }
 
     // Is this position in Cartesian coordinates or in fractional coordinates?
-    Vector3D position() const { return position_; }
+    const Vector3D & position() const { return position_; }
 
     // Is this position in Cartesian coordinates or in fractional coordinates?
     void set_position( const Vector3D & position ) { position_ = position; }
     
-    std::string label() const { return label_; }
+    const std::string & label() const { return label_; }
 
     void set_label( const std::string & label ) { label_ = label; }
 
@@ -96,7 +96,7 @@ public:
     // | member of five-membered ring | member of six-membered ring | member of seven-membered ring | cyclic
     // All these properties must be independent of the presence of 3D coordinates, they are topological attributes.
     // They cannot be calculated in this class, they can be calculated in e.g. the CrystalStructure class
-    std::string topological_attributes() const { return topological_attributes_; }
+    const std::string & topological_attributes() const { return topological_attributes_; }
     
     void set_topological_attributes( const std::string & topological_attributes ) { topological_attributes_ = topological_attributes; }
 
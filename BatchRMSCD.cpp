@@ -0,0 +1,285 @@
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include "BatchRMSCD.h"
+#include "CrystalStructure.h"
+#include "FileName.h"
+#include "ReadCif.h"
+#include "TextFileWriter.h"
+#include "ThreadPool.h"
+#include "Utilities.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+
+namespace
+{
+
+// Every file is read once, slot i holds either the structure or the reason it could not be read.
+class StructureCache
+{
+public:
+
+    explicit StructureCache( const std::function< void( const FileName &, CrystalStructure & ) > & crystal_structure_reader ):
+    crystal_structure_reader_(crystal_structure_reader)
+    {}
+
+    // Adds the file if it is not yet in the cache, returns its index.
+    size_t add( const FileName & file_name )
+    {
+        std::map< std::string, size_t >::const_iterator it = indices_.find( file_name.full_name() );
+        if ( it != indices_.end() )
+            return it->second;
+        size_t result = file_names_.size();
+        indices_[ file_name.full_name() ] = result;
+        file_names_.push_back( file_name );
+        return result;
+    }
+
+    size_t size() const { return file_names_.size(); }
+
+    void read_all( ThreadPool & thread_pool )
+    {
+        crystal_structures_ = std::vector< CrystalStructure >( file_names_.size() );
+        error_messages_ = std::vector< std::string >( file_names_.size() );
+        std::cout << "Now reading " << file_names_.size() << " files with " << thread_pool.nthreads() << " threads" << std::endl;
+        thread_pool.run( file_names_.size(), [&]( const size_t i )
+        {
+            try
+            {
+                crystal_structure_reader_( file_names_[i], crystal_structures_[i] );
+            }
+            catch ( std::exception & e )
+            {
+                error_messages_[i] = file_names_[i].full_name() + ": " + e.what();
+            }
+        } );
+    }
+
+    const FileName & file_name( const size_t i ) const { return file_names_[i]; }
+    const CrystalStructure & crystal_structure( const size_t i ) const { return crystal_structures_[i]; }
+    const std::string & error_message( const size_t i ) const { return error_messages_[i]; }
+
+private:
+    std::function< void( const FileName &, CrystalStructure & ) > crystal_structure_reader_;
+    std::map< std::string, size_t > indices_;
+    std::vector< FileName > file_names_;
+    std::vector< CrystalStructure > crystal_structures_;
+    std::vector< std::string > error_messages_;
+};
+
+// ********************************************************************************
+
+// Fields that contain a comma, a double quote or a newline are quoted, double quotes are doubled.
+std::string csv_field( const std::string & input )
+{
+    if ( input.find_first_of( ",\"\n" ) == std::string::npos )
+        return input;
+    std::string result( "\"" );
+    for ( size_t i( 0 ); i != input.length(); ++i )
+    {
+        if ( input[i] == '"' )
+            result += '"';
+        result += input[i];
+    }
+    return result + "\"";
+}
+
+} // namespace
+
+// ********************************************************************************
+
+BatchRMSCD::BatchRMSCD( const FileList & file_list_1, const FileList & file_list_2 ):
+file_list_1_(file_list_1),
+file_list_2_(file_list_2),
+all_vs_all_(false),
+with_matching_(false),
+shift_steps_(1),
+add_inversion_(false),
+include_hydrogens_(false),
+nthreads_(0),
+crystal_structure_reader_(read_cif)
+{
+    if ( file_list_1_.size() != file_list_2_.size() )
+        throw std::runtime_error( "BatchRMSCD::BatchRMSCD(): Error: file lists do not contain the same number of entries." );
+}
+
+// ********************************************************************************
+
+BatchRMSCD::BatchRMSCD( const FileList & file_list ):
+file_list_1_(file_list),
+file_list_2_(file_list),
+all_vs_all_(true),
+with_matching_(false),
+shift_steps_(1),
+add_inversion_(false),
+include_hydrogens_(false),
+nthreads_(0),
+crystal_structure_reader_(read_cif)
+{
+}
+
+// ********************************************************************************
+
+size_t BatchRMSCD::npairs() const
+{
+    if ( all_vs_all_ )
+        return ( file_list_1_.size() * ( file_list_1_.size() - std::min( file_list_1_.size(), static_cast<size_t>( 1 ) ) ) ) / 2;
+    return file_list_1_.size();
+}
+
+// ********************************************************************************
+
+std::vector< RMSCDResult > BatchRMSCD::calculate() const
+{
+    return calculate( static_cast< TextFileWriter * >( 0 ) );
+}
+
+// ********************************************************************************
+
+void BatchRMSCD::calculate( const FileName & output_file_name ) const
+{
+    TextFileWriter text_file_writer( output_file_name );
+    text_file_writer.write_line( "file_1,file_2,RMSCD,seconds,error" );
+    calculate( &text_file_writer );
+}
+
+// ********************************************************************************
+
+std::vector< RMSCDResult > BatchRMSCD::calculate( TextFileWriter * text_file_writer ) const
+{
+    ThreadPool thread_pool( nthreads_ );
+    StructureCache cache( crystal_structure_reader_ );
+    std::vector< size_t > indices_1;
+    std::vector< size_t > indices_2;
+    indices_1.reserve( file_list_1_.size() );
+    for ( size_t i( 0 ); i != file_list_1_.size(); ++i )
+        indices_1.push_back( cache.add( file_list_1_.value( i ) ) );
+    if ( all_vs_all_ )
+        indices_2 = indices_1;
+    else
+    {
+        indices_2.reserve( file_list_2_.size() );
+        for ( size_t i( 0 ); i != file_list_2_.size(); ++i )
+            indices_2.push_back( cache.add( file_list_2_.value( i ) ) );
+    }
+    cache.read_all( thread_pool );
+    std::vector< RMSCDResult > result;
+    // Large enough to keep all threads busy, small enough to give regular progress reports.
+    const size_t block_size = std::max( static_cast<size_t>( 256 ), 64 * thread_pool.nthreads() );
+    const size_t npairs = this->npairs();
+    std::cout << "Now calculating " << npairs << " RMSCDs with " << thread_pool.nthreads() << " threads" << std::endl;
+    std::vector< RMSCDResult > block;
+    block.reserve( std::min( block_size, npairs ) );
+    // The next pair, for all-vs-all i < j.
+    size_t next_i( 0 );
+    size_t next_j( all_vs_all_ ? 1 : 0 );
+    size_t ndone( 0 );
+    double total_seconds( 0.0 );
+    std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+    while ( ndone != npairs )
+    {
+        block.clear();
+        while ( ( block.size() != block_size ) && ( ndone + block.size() != npairs ) )
+        {
+            RMSCDResult pair;
+            pair.i_ = next_i;
+            pair.j_ = next_j;
+            pair.RMSCD_ = 0.0;
+            pair.seconds_ = 0.0;
+            block.push_back( pair );
+            if ( all_vs_all_ )
+            {
+                ++next_j;
+                if ( next_j == file_list_1_.size() )
+                {
+                    ++next_i;
+                    next_j = next_i + 1;
+                }
+            }
+            else
+            {
+                ++next_i;
+                ++next_j;
+            }
+        }
+        thread_pool.run( block.size(), [&]( const size_t k )
+        {
+            RMSCDResult & pair = block[k];
+            const size_t i = indices_1[ pair.i_ ];
+            const size_t j = indices_2[ pair.j_ ];
+            if ( ! cache.error_message( i ).empty() )
+            {
+                pair.error_message_ = cache.error_message( i );
+                return;
+            }
+            if ( ! cache.error_message( j ).empty() )
+            {
+                pair.error_message_ = cache.error_message( j );
+                return;
+            }
+            std::chrono::steady_clock::time_point pair_start_time = std::chrono::steady_clock::now();
+            try
+            {
+                if ( with_matching_ )
+                    pair.RMSCD_ = RMSCD_with_matching( cache.crystal_structure( i ), cache.crystal_structure( j ), shift_steps_, add_inversion_, include_hydrogens_ );
+                else
+                    pair.RMSCD_ = root_mean_square_Cartesian_displacement( cache.crystal_structure( i ), cache.crystal_structure( j ), include_hydrogens_ );
+            }
+            catch ( std::exception & e )
+            {
+                pair.error_message_ = e.what();
+            }
+            pair.seconds_ = std::chrono::duration< double >( std::chrono::steady_clock::now() - pair_start_time ).count();
+        } );
+        for ( size_t k( 0 ); k != block.size(); ++k )
+        {
+            total_seconds += block[k].seconds_;
+            if ( text_file_writer )
+                text_file_writer->write_line( csv_field( cache.file_name( indices_1[ block[k].i_ ] ).full_name() ) + "," +
+                                              csv_field( cache.file_name( indices_2[ block[k].j_ ] ).full_name() ) + "," +
+                                              double2string( block[k].RMSCD_, 5 ) + "," +
+                                              double2string( block[k].seconds_, 6 ) + "," +
+                                              csv_field( block[k].error_message_ ) );
+            else
+                result.push_back( block[k] );
+        }
+        if ( text_file_writer )
+            text_file_writer->flush();
+        ndone += block.size();
+        double elapsed_seconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - start_time ).count();
+        std::cout << ndone << " of " << npairs << " RMSCDs done, " << elapsed_seconds << " s elapsed, " << ( total_seconds / ndone ) << " s per RMSCD" << std::endl;
+    }
+    return result;
+}
+
+// ********************************************************************************
+
@@ -0,0 +1,112 @@
+#ifndef BATCHRMSCD_H
+#define BATCHRMSCD_H
+
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include "FileList.h"
+
+#include <cstddef> // For definition of size_t
+#include <functional>
+#include <string>
+#include <vector>
+
+class CrystalStructure;
+class FileName;
+class TextFileWriter;
+
+struct RMSCDResult
+{
+    size_t i_; // Index of the first structure in the first file list.
+    size_t j_; // Index of the second structure in the second file list, or in the first file list for all-vs-all.
+    double RMSCD_; // In Angstrom, 0.0 if the comparison failed.
+    double seconds_; // Wall-clock time of the comparison.
+    std::string error_message_; // Empty if the comparison succeeded.
+};
+
+/*
+  Calculates the root-mean-square Cartesian displacements for many pairs of crystal structures.
+
+  Either file_list_1[i] is compared to file_list_2[i], or every structure in one file list is compared to every other structure (i < j).
+  Every file is read exactly once into a cache that is shared by all comparisons, files that occur more than once
+  (e.g. in all-vs-all comparisons) are therefore not parsed again. The files are read in parallel.
+
+  The comparisons are divided over nthreads threads, 0 means the number of cores. They are run in blocks, after each block
+  progress is reported and the results of that block are appended to the output file, so memory does not grow with the number of pairs.
+  The results are always written in the order of the pairs and do not depend on the number of threads.
+
+  A file that cannot be read or a pair that cannot be compared (e.g. different numbers of atoms) does not stop the run,
+  the error message is stored with the result instead.
+*/
+class BatchRMSCD
+{
+public:
+
+    // file_list_1[i] is compared to file_list_2[i], the file lists must have the same size.
+    BatchRMSCD( const FileList & file_list_1, const FileList & file_list_2 );
+
+    // All-vs-all.
+    explicit BatchRMSCD( const FileList & file_list );
+
+    size_t npairs() const;
+
+    // Default: false, i.e. root_mean_square_Cartesian_displacement(), which assumes that the atoms are in the same order.
+    // If true, RMSCD_with_matching() is used with the shift_steps and add_inversion settings.
+    void set_with_matching( const bool with_matching ) { with_matching_ = with_matching; }
+    void set_shift_steps( const size_t shift_steps ) { shift_steps_ = shift_steps; }
+    void set_add_inversion( const bool add_inversion ) { add_inversion_ = add_inversion; }
+    void set_include_hydrogens( const bool include_hydrogens ) { include_hydrogens_ = include_hydrogens; }
+    void set_nthreads( const size_t nthreads ) { nthreads_ = nthreads; }
+
+    // Default: read_cif(). Must be thread-safe, it is called for several files at the same time.
+    // An exception is stored as the error message of every pair that contains the file.
+    void set_crystal_structure_reader( const std::function< void( const FileName &, CrystalStructure & ) > & crystal_structure_reader ) { crystal_structure_reader_ = crystal_structure_reader; }
+
+    // Returns all results in the order of the pairs.
+    std::vector< RMSCDResult > calculate() const;
+
+    // Writes a .csv file with columns file_1, file_2, RMSCD, seconds, error, one line per pair in the order of the pairs.
+    // The results are not kept in memory.
+    void calculate( const FileName & output_file_name ) const;
+
+private:
+    FileList file_list_1_;
+    FileList file_list_2_;
+    bool all_vs_all_;
+    bool with_matching_;
+    size_t shift_steps_;
+    bool add_inversion_;
+    bool include_hydrogens_;
+    size_t nthreads_;
+    std::function< void( const FileName &, CrystalStructure & ) > crystal_structure_reader_;
+
+    // When text_file_writer is 0, the results are returned, otherwise they are written to the file.
+    std::vector< RMSCDResult > calculate( TextFileWriter * text_file_writer ) const;
+};
+
+#endif // BATCHRMSCD_H
+
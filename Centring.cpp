@@ -198,6 +198,11 @@ Centring::Centring( std::string centring_name )
         centring_vectors_.push_back( Vector3D( 0.5, 0.5, 0.0 ) );
         centring_type_ = F;
     }
+    else if ( centring_name == "I" )
+    {
+        centring_vectors_.push_back( Vector3D( 0.5, 0.5, 0.5 ) );
+        centring_type_ = I;
+    }
     else
         throw std::runtime_error( "Centring::Centring( std::string ): error: centring name not recognised." );
 }
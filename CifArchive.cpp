@@ -0,0 +1,131 @@
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include "CifArchive.h"
+#include "CrystalStructure.h"
+#include "ReadCif.h"
+#include "Utilities.h"
+
+#include <stdexcept>
+
+// ********************************************************************************
+
+CifArchive::CifArchive( const FileName & file_name ):
+file_name_(file_name),
+memory_mapped_file_(file_name),
+cif_tokeniser_(memory_mapped_file_.data(), memory_mapped_file_.data() + memory_mapped_file_.size()),
+has_index_(false)
+{
+}
+
+// ********************************************************************************
+
+bool CifArchive::next( CrystalStructure & crystal_structure )
+{
+    return read_cif_data_block( cif_tokeniser_, crystal_structure );
+}
+
+// ********************************************************************************
+
+void CifArchive::rewind()
+{
+    cif_tokeniser_ = CifTokeniser( memory_mapped_file_.data(), memory_mapped_file_.data() + memory_mapped_file_.size() );
+}
+
+// ********************************************************************************
+
+void CifArchive::build_index()
+{
+    block_offsets_.clear();
+    block_line_numbers_.clear();
+    CifTokeniser cif_tokeniser( memory_mapped_file_.data(), memory_mapped_file_.data() + memory_mapped_file_.size() );
+    CifToken token;
+    while ( cif_tokeniser.next( token ) )
+    {
+        if ( token.type_ == CifToken::DATA_BLOCK )
+        {
+            block_offsets_.push_back( token.begin_ - memory_mapped_file_.data() );
+            block_line_numbers_.push_back( token.line_number_ );
+        }
+        else if ( block_offsets_.empty() )
+        {
+            block_offsets_.push_back( 0 );
+            block_line_numbers_.push_back( 1 );
+        }
+    }
+    block_offsets_.push_back( memory_mapped_file_.size() );
+    has_index_ = true;
+}
+
+// ********************************************************************************
+
+size_t CifArchive::size() const
+{
+    if ( ! has_index_ )
+        throw std::runtime_error( "CifArchive::size(): Error: build_index() has not been called." );
+    return block_offsets_.size() - 1;
+}
+
+// ********************************************************************************
+
+std::string CifArchive::name( const size_t i ) const
+{
+    check_index( i );
+    CifTokeniser cif_tokeniser( memory_mapped_file_.data() + block_offsets_[i], memory_mapped_file_.data() + block_offsets_[i+1], block_line_numbers_[i] );
+    CifToken token;
+    if ( cif_tokeniser.next( token ) && ( token.type_ == CifToken::DATA_BLOCK ) )
+        return std::string( token.begin_ + 5, token.end_ );
+    return std::string();
+}
+
+// ********************************************************************************
+
+void CifArchive::read( const size_t i, CrystalStructure & crystal_structure ) const
+{
+    check_index( i );
+    CifTokeniser cif_tokeniser( memory_mapped_file_.data() + block_offsets_[i], memory_mapped_file_.data() + block_offsets_[i+1], block_line_numbers_[i] );
+    read_cif_data_block( cif_tokeniser, crystal_structure );
+}
+
+// ********************************************************************************
+
+std::string CifArchive::text( const size_t i ) const
+{
+    check_index( i );
+    return std::string( memory_mapped_file_.data() + block_offsets_[i], memory_mapped_file_.data() + block_offsets_[i+1] );
+}
+
+// ********************************************************************************
+
+void CifArchive::check_index( const size_t i ) const
+{
+    if ( i >= size() )
+        throw std::runtime_error( "CifArchive::check_index(): Error: data block " + size_t2string( i ) + " requested, but file " + file_name_.full_name() + " contains only " + size_t2string( size() ) + " data blocks." );
+}
+
+// ********************************************************************************
+
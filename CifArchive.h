@@ -0,0 +1,101 @@
+#ifndef CIFARCHIVE_H
+#define CIFARCHIVE_H
+
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include "CifTokeniser.h"
+#include "FileName.h"
+#include "MemoryMappedFile.h"
+
+#include <cstddef> // For definition of size_t
+#include <string>
+#include <vector>
+
+class CrystalStructure;
+
+/*
+  A .cif file that contains many data blocks, such as a CSD export or a concatenation of .cif files,
+  read one crystal structure at a time. Each data block is read exactly as read_cif() reads a file.
+
+  The file is memory mapped, so memory use does not grow with the size of the file or the number of structures.
+  next() walks through the data blocks in order. For random access, build_index() makes one pass over the file
+  that only tokenises it and records where each data block starts; size(), name(), read() and text() can then be used.
+  read() is const and independent of next(), so several threads can read different data blocks at the same time.
+
+  If the file does not start with a data_ header, everything before the first data_ header counts as a data block without a name.
+
+  Not copyable.
+*/
+class CifArchive
+{
+public:
+
+    // Throws if the file cannot be opened.
+    explicit CifArchive( const FileName & file_name );
+
+    FileName file_name() const { return file_name_; }
+
+    // Reads the next data block. Returns false, and leaves crystal_structure unchanged, if there are no more data blocks.
+    bool next( CrystalStructure & crystal_structure );
+
+    // The next call to next() returns the first data block again.
+    void rewind();
+
+    void build_index();
+    bool has_index() const { return has_index_; }
+
+    // The following throw if build_index() has not been called.
+
+    // Number of data blocks.
+    size_t size() const;
+
+    // What follows data_, may be empty.
+    std::string name( const size_t i ) const;
+
+    void read( const size_t i, CrystalStructure & crystal_structure ) const;
+
+    // The text of data block i as it is in the file, e.g. to save it as a .cif file of its own.
+    std::string text( const size_t i ) const;
+
+private:
+    FileName file_name_;
+    MemoryMappedFile memory_mapped_file_;
+    CifTokeniser cif_tokeniser_;
+    bool has_index_;
+    std::vector< size_t > block_offsets_; // size() + 1 values, the last one is the size of the file.
+    std::vector< size_t > block_line_numbers_; // For error messages.
+
+    void check_index( const size_t i ) const;
+
+    // Not copyable.
+    CifArchive( const CifArchive & );
+    CifArchive & operator=( const CifArchive & );
+};
+
+#endif // CIFARCHIVE_H
+
@@ -0,0 +1,182 @@
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include "CifTokeniser.h"
+#include "Utilities.h"
+
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+
+bool is_white_space( const char c )
+{
+    return ( c == ' ' ) || ( c == '\t' ) || ( c == '\n' ) || ( c == '\r' );
+}
+
+// ********************************************************************************
+
+// Not case sensitive, rhs must be lower case. Only letters are case folded, so "data?" does not match "data_".
+bool starts_with_reserved_word( const char * begin, const char * end, const char * rhs )
+{
+    const size_t length = std::strlen( rhs );
+    if ( static_cast<size_t>( end - begin ) < length )
+        return false;
+    for ( size_t i( 0 ); i != length; ++i )
+    {
+        if ( begin[i] == rhs[i] )
+            continue;
+        if ( ( ! std::isalpha( static_cast<unsigned char>( rhs[i] ) ) ) || ( begin[i] != std::toupper( static_cast<unsigned char>( rhs[i] ) ) ) )
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+// ********************************************************************************
+
+bool CifToken::equals( const char * rhs ) const
+{
+    const size_t rhs_length = std::strlen( rhs );
+    return ( rhs_length == length() ) && ( std::memcmp( begin_, rhs, rhs_length ) == 0 );
+}
+
+// ********************************************************************************
+
+CifTokeniser::CifTokeniser( const char * begin, const char * end, const size_t line_number ):
+begin_(begin),
+current_(begin),
+end_(end),
+line_number_(line_number),
+push_back_last_token_(false)
+{
+}
+
+// ********************************************************************************
+
+bool CifTokeniser::next( CifToken & token )
+{
+    if ( push_back_last_token_ )
+    {
+        push_back_last_token_ = false;
+        token = last_token_;
+        return true;
+    }
+    // Skip white space and comments.
+    while ( current_ != end_ )
+    {
+        if ( *current_ == '#' )
+        {
+            while ( ( current_ != end_ ) && ( *current_ != '\n' ) )
+                ++current_;
+        }
+        else if ( is_white_space( *current_ ) )
+        {
+            if ( *current_ == '\n' )
+                ++line_number_;
+            ++current_;
+        }
+        else
+            break;
+    }
+    if ( current_ == end_ )
+        return false;
+    token.line_number_ = line_number_;
+    token.is_quoted_ = false;
+    token.type_ = CifToken::VALUE;
+    if ( ( *current_ == ';' ) && at_start_of_line() )
+    {
+        // A text field ends at the first semicolon at the start of a line.
+        ++current_;
+        token.begin_ = current_;
+        token.is_quoted_ = true;
+        while ( true )
+        {
+            if ( current_ == end_ )
+                throw std::runtime_error( "CifTokeniser::next(): Error: text field starting on line " + size_t2string( token.line_number_ ) + " is not terminated." );
+            if ( *current_ == '\n' )
+            {
+                ++line_number_;
+                if ( ( current_+1 != end_ ) && ( *(current_+1) == ';' ) )
+                    break;
+            }
+            ++current_;
+        }
+        token.end_ = current_;
+        if ( ( token.end_ != token.begin_ ) && ( *(token.end_-1) == '\r' ) )
+            --token.end_;
+        current_ += 2;
+    }
+    else if ( ( *current_ == '\'' ) || ( *current_ == '"' ) )
+    {
+        // A quote only closes the value if it is followed by white space, so 'O'Neill' is one value.
+        const char quote = *current_;
+        ++current_;
+        token.begin_ = current_;
+        token.is_quoted_ = true;
+        while ( true )
+        {
+            if ( ( current_ == end_ ) || ( *current_ == '\n' ) || ( *current_ == '\r' ) )
+                throw std::runtime_error( "CifTokeniser::next(): Error: quote on line " + size_t2string( token.line_number_ ) + " is not terminated." );
+            if ( ( *current_ == quote ) && ( ( current_+1 == end_ ) || is_white_space( *(current_+1) ) ) )
+                break;
+            ++current_;
+        }
+        token.end_ = current_;
+        ++current_;
+    }
+    else
+    {
+        token.begin_ = current_;
+        while ( ( current_ != end_ ) && ( ! is_white_space( *current_ ) ) )
+            ++current_;
+        token.end_ = current_;
+        if ( *token.begin_ == '_' )
+            token.type_ = CifToken::TAG;
+        else if ( starts_with_reserved_word( token.begin_, token.end_, "data_" ) )
+            token.type_ = CifToken::DATA_BLOCK;
+        else if ( ( token.length() == 5 ) && starts_with_reserved_word( token.begin_, token.end_, "loop_" ) )
+            token.type_ = CifToken::LOOP;
+        else if ( starts_with_reserved_word( token.begin_, token.end_, "save_" ) )
+            token.type_ = CifToken::SAVE_FRAME;
+    }
+    last_token_ = token;
+    return true;
+}
+
+// ********************************************************************************
+
+void CifTokeniser::push_back_last_token()
+{
+    push_back_last_token_ = true;
+}
+
+// ********************************************************************************
+
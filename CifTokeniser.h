@@ -0,0 +1,86 @@
+#ifndef CIFTOKENISER_H
+#define CIFTOKENISER_H
+
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include <cstddef> // For definition of size_t
+#include <string>
+
+// A token is not a copy, it points into the text that is being tokenised, so it is only valid as long as that text is.
+// The quotes of a quoted value and the semicolons of a text field are not part of the token, a data_ block header is the whole word.
+struct CifToken
+{
+    enum Type { DATA_BLOCK, LOOP, SAVE_FRAME, TAG, VALUE };
+
+    Type type_;
+    const char * begin_;
+    const char * end_;
+    bool is_quoted_; // Quoted values and text fields, "." and "?" in quotes are values, not placeholders.
+    size_t line_number_; // Starts at 1, for error messages.
+
+    size_t length() const { return end_ - begin_; }
+    std::string str() const { return std::string( begin_, end_ ); }
+    bool equals( const char * rhs ) const;
+    // The CIF placeholders "." (inapplicable) and "?" (unknown).
+    bool is_placeholder() const { return ( ! is_quoted_ ) && ( length() == 1 ) && ( ( *begin_ == '.' ) || ( *begin_ == '?' ) ); }
+};
+
+/*
+  Splits CIF text into tokens without copying it: data_ block headers, loop_, save_ frames, tags and values.
+  Values can be unquoted, in single or double quotes (a quote only closes a value when it is followed by white space)
+  or in a text field delimited by semicolons at the start of a line. Comments (# up to the end of the line) are skipped.
+  In contrast to TextFileReader, nothing is line based, so a loop row may span several lines and several rows may share a line.
+
+  Usually used on the contents of a MemoryMappedFile.
+*/
+class CifTokeniser
+{
+public:
+
+    // line_number is that of the first character, for when the text is part of a larger file.
+    CifTokeniser( const char * begin, const char * end, const size_t line_number = 1 );
+
+    // Returns false at the end of the text. Throws if a quoted value or a text field is not terminated.
+    bool next( CifToken & token );
+
+    // The next call to next() returns the last token again.
+    void push_back_last_token();
+
+private:
+    const char * begin_;
+    const char * current_;
+    const char * end_;
+    size_t line_number_;
+    CifToken last_token_;
+    bool push_back_last_token_;
+
+    bool at_start_of_line() const { return ( current_ == begin_ ) || ( *(current_-1) == '\n' ) || ( *(current_-1) == '\r' ); }
+};
+
+#endif // CIFTOKENISER_H
+
@@ -28,14 +28,17 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "ConnectivityTable.h"
 #include "Utilities.h"
 
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
 
 // ********************************************************************************
 
-ConnectivityTable::ConnectivityTable( const size_t natoms ) : dimension_(natoms)
+ConnectivityTable::ConnectivityTable( const size_t natoms ) :
+neighbours_( natoms ),
+bond_types_( natoms ),
+nbonds_(0)
 {
-    data_ = std::vector< size_t >( ( dimension_ * ( dimension_ - 1 ) ) / 2, 0 );
 }
 
 // ********************************************************************************
@@ -44,14 +47,17 @@ size_t ConnectivityTable::value( size_t i, size_t j ) const
 {
     if ( i < j )
         std::swap( i, j );
-    if ( i < dimension_ )
+    if ( i < size() )
     {
         if ( i == j )
             return 1;
-        return data_[ ((i*(i-1))/2) + j ];
+        std::vector< size_t >::const_iterator it = std::lower_bound( neighbours_[i].begin(), neighbours_[i].end(), j );
+        if ( ( it == neighbours_[i].end() ) || ( *it != j ) )
+            return 0;
+        return bond_types_[i][ it - neighbours_[i].begin() ];
     }
     else
-        throw std::runtime_error( "ConnectivityTable::value(): out of bounds ( " + size_t2string(i) + " > " + size_t2string(dimension_) + " )" );
+        throw std::runtime_error( "ConnectivityTable::value(): out of bounds ( " + size_t2string(i) + " > " + size_t2string(size()) + " )" );
 }
 
 // ********************************************************************************
@@ -60,14 +66,40 @@ void ConnectivityTable::set_value( size_t i, size_t j, const size_t value )
 {
     if ( i < j )
         std::swap( i, j );
-    if ( i < dimension_ )
+    if ( i < size() )
     {
         if ( i == j )
             return;
-        data_[ ((i*(i-1))/2) + j ] = value;
+        // Both directions are stored.
+        for ( size_t k( 0 ); k != 2; ++k )
+        {
+            std::vector< size_t >::iterator it = std::lower_bound( neighbours_[i].begin(), neighbours_[i].end(), j );
+            size_t position = it - neighbours_[i].begin();
+            bool present = ( it != neighbours_[i].end() ) && ( *it == j );
+            if ( present )
+            {
+                if ( value == 0 )
+                {
+                    neighbours_[i].erase( it );
+                    bond_types_[i].erase( bond_types_[i].begin() + position );
+                    if ( k == 0 )
+                        --nbonds_;
+                }
+                else
+                    bond_types_[i][position] = value;
+            }
+            else if ( value != 0 )
+            {
+                neighbours_[i].insert( it, j );
+                bond_types_[i].insert( bond_types_[i].begin() + position, value );
+                if ( k == 0 )
+                    ++nbonds_;
+            }
+            std::swap( i, j );
+        }
     }
     else
-        throw std::runtime_error( "ConnectivityTable::set_value(): out of bounds ( " + size_t2string(i) + " > " + size_t2string(dimension_) + " )" );
+        throw std::runtime_error( "ConnectivityTable::set_value(): out of bounds ( " + size_t2string(i) + " > " + size_t2string(size()) + " )" );
 }
 
 // ********************************************************************************
@@ -86,74 +118,32 @@ void ConnectivityTable::show() const
 
 // ********************************************************************************
 
-std::vector< bool > initialise_row( const ConnectivityTable & connectivity_table, const size_t iRow )
-{
-    std::vector< bool > result( connectivity_table.size(), false ); 
-    for ( size_t j( 0 ); j != connectivity_table.size(); ++j )
-        result[j] = ( connectivity_table.value( iRow, j ) > 0 );
-    return result;
-}
-
-// ********************************************************************************
-
-void show( const std::vector< bool > & input )
-{
-    for ( size_t i( 0 ); i != input.size(); ++i )
-    {
-        if ( input[i] )
-            std::cout << "1";
-        else
-            std::cout << "0";        
-    }
-}
-
-// ********************************************************************************
-
 std::vector< std::vector< size_t > > split( const ConnectivityTable & connectivity_table )
 {
     std::vector< std::vector< size_t > > result;
     std::vector< bool > done( connectivity_table.size(), false );
+    // Breadth-first search, the molecule doubles as the queue.
     for ( size_t i( 0 ); i != connectivity_table.size(); ++i )
     {
         if ( done[ i ] )
             continue;
-        std::vector< bool > this_molecule = initialise_row( connectivity_table, i );
+        std::vector< size_t > this_molecule;
+        this_molecule.push_back( i );
         done[ i ] = true;
-        bool change( false );
-        do
+        for ( size_t j( 0 ); j != this_molecule.size(); ++j )
         {
-            change = false;
-            for ( size_t j( 0 ); j != connectivity_table.size(); ++j )
+            size_t current = this_molecule[j];
+            for ( size_t k( 0 ); k != connectivity_table.nneighbours( current ); ++k )
             {
-                if ( done[ j ] )
+                size_t neighbour = connectivity_table.neighbour( current, k );
+                if ( done[ neighbour ] )
                     continue;
-                if ( this_molecule[j] )
-                {
-                    // Add row j to the current molecule
-                    for ( size_t k( 0 ); k != connectivity_table.size(); ++k )
-                    {
-                        if ( done[ k ] )
-                            continue;
-                        if ( ( connectivity_table.value( j, k ) > 0 ) && ( ! this_molecule[k] ) )
-                        {
-                            this_molecule[k] = true;
-                            change = true;
-                        }
-                    }                    
-                    done[ j ] = true;
-                }
-            }
-        }
-        while ( change );
-        std::vector< size_t > this_molecule_2;
-        for ( size_t j( 0 ); j != connectivity_table.size(); ++j )
-        {
-            if ( this_molecule[j] )
-            {
-                this_molecule_2.push_back( j );             
+                this_molecule.push_back( neighbour );
+                done[ neighbour ] = true;
             }
         }
-        result.push_back( this_molecule_2 );
+        std::sort( this_molecule.begin(), this_molecule.end() );
+        result.push_back( this_molecule );
     }
     return result;
 }
@@ -32,9 +32,11 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <vector>
 
 /*
-  A connectivity table in its simplest form: for N atoms a NxN table.
+  A connectivity table for N atoms, stored as a sorted list of bonded neighbours per atom,
+  so the memory is proportional to the number of bonds rather than to N^2.
   
-  Could make the entry the type of bond (single, double), but currently it is just "bonded or not bonded".
+  The value of an entry is the type of bond (e.g. single, double), 0 means "not bonded".
+  Currently it is just "bonded or not bonded".
   
   We will probably have things like Molecule3D, Molecule3D and ChemicalCompound (= Molecule2D objects + stoichiometry + racemic yes / no)
   in the future.
@@ -45,23 +47,33 @@ public:
 
     explicit ConnectivityTable( const size_t natoms = 0 );
 
-    size_t size() const { return dimension_; }
+    size_t size() const { return neighbours_.size(); }
 
     // In keeping with the silly C++ convention: zero-based
     // Returns 1 for i == j
     size_t value( size_t i, size_t j ) const;
 
+    // Setting the value to 0 removes the bond.
     void set_value( size_t i, size_t j, const size_t value );
+
+    size_t nbonds() const { return nbonds_; }
+
+    // The bonded neighbours of atom i, sorted by index.
+    size_t nneighbours( const size_t i ) const { return neighbours_[i].size(); }
+    size_t neighbour( const size_t i, const size_t k ) const { return neighbours_[i][k]; }
+    // The type of the bond between atom i and its k-th neighbour.
+    size_t bond_type( const size_t i, const size_t k ) const { return bond_types_[i][k]; }
     
     void show() const;
 
 private:
-    std::vector< size_t > data_; // Could have used bool, but I assume it will store the bond type one day.
-    size_t dimension_;
+    std::vector< std::vector< size_t > > neighbours_;
+    std::vector< std::vector< size_t > > bond_types_; // Same layout as neighbours_.
+    size_t nbonds_;
 
 };
 
+// Each connected component (molecule), sorted by index; the components are sorted by their first index.
 std::vector< std::vector< size_t > > split( const ConnectivityTable & connectivity_table );
 
 #endif // CONNECTIVITYTABLE_H
-
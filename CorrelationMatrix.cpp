@@ -26,26 +26,258 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ********************************************* */
 
 #include "CorrelationMatrix.h"
+#include "FileName.h"
+#include "MemoryMappedFile.h"
 #include "TextFileWriter.h"
 #include "Utilities.h"
 
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
 
+namespace
+{
+
+const size_t header_size( 32 );
+const char magic_number[9] = "CORRMAT1";
+
+// ********************************************************************************
+
+size_t bytes_per_value( const CorrelationMatrix::Precision precision )
+{
+    switch ( precision )
+    {
+        case CorrelationMatrix::DOUBLE : return 8;
+        case CorrelationMatrix::FLOAT  : return 4;
+        case CorrelationMatrix::HALF   : return 2;
+    }
+    return 8;
+}
+
+// ********************************************************************************
+
+// IEEE 754 half precision, rounded to the nearest value, ties to even.
+unsigned short float_to_half( const float value )
+{
+    unsigned int bits;
+    memcpy( &bits, &value, 4 );
+    unsigned short sign = ( bits >> 16 ) & 0x8000;
+    unsigned int float_exponent = ( bits >> 23 ) & 0xFF;
+    unsigned int mantissa = bits & 0x7FFFFF;
+    if ( float_exponent == 0xFF ) // Infinity or NaN
+        return sign | 0x7C00 | ( ( mantissa != 0 ) ? 0x200 : 0 );
+    int exponent = static_cast< int >( float_exponent ) - 127 + 15;
+    if ( exponent >= 31 ) // Overflow, infinity
+        return sign | 0x7C00;
+    if ( exponent <= 0 ) // Subnormal or zero
+    {
+        if ( exponent < -10 )
+            return sign;
+        mantissa |= 0x800000;
+        unsigned int shift = 14 - exponent;
+        unsigned int result = mantissa >> shift;
+        unsigned int remainder = mantissa & ( ( 1u << shift ) - 1 );
+        unsigned int halfway = 1u << ( shift - 1 );
+        if ( ( remainder > halfway ) || ( ( remainder == halfway ) && ( result & 1 ) ) )
+            ++result;
+        return sign | result;
+    }
+    unsigned int result = ( exponent << 10 ) | ( mantissa >> 13 );
+    unsigned int remainder = mantissa & 0x1FFF;
+    // A carry into the exponent is correct, including an overflow to infinity.
+    if ( ( remainder > 0x1000 ) || ( ( remainder == 0x1000 ) && ( result & 1 ) ) )
+        ++result;
+    return sign | result;
+}
+
+// ********************************************************************************
+
+float half_to_float( const unsigned short value )
+{
+    unsigned int sign = ( value & 0x8000 ) << 16;
+    unsigned int exponent = ( value >> 10 ) & 0x1F;
+    unsigned int mantissa = value & 0x3FF;
+    unsigned int bits;
+    if ( exponent == 0 )
+    {
+        if ( mantissa == 0 )
+            bits = sign;
+        else // Subnormal, normalise
+        {
+            exponent = 127 - 15 + 1;
+            while ( ( mantissa & 0x400 ) == 0 )
+            {
+                mantissa <<= 1;
+                --exponent;
+            }
+            bits = sign | ( exponent << 23 ) | ( ( mantissa & 0x3FF ) << 13 );
+        }
+    }
+    else if ( exponent == 31 )
+        bits = sign | 0x7F800000 | ( mantissa << 13 );
+    else
+        bits = sign | ( ( exponent - 15 + 127 ) << 23 ) | ( mantissa << 13 );
+    float result;
+    memcpy( &result, &bits, 4 );
+    return result;
+}
+
+} // namespace
+
 // ********************************************************************************
 
-CorrelationMatrix::CorrelationMatrix( const size_t dimension ) : dimension_(dimension)
+CorrelationMatrix::CorrelationMatrix( const size_t dimension, const Precision precision ):
+dimension_(dimension),
+precision_(precision),
+value_on_diagonal_(1.0),
+memory_mapped_file_(0),
+data_(0),
+writable_data_(0)
 {
-    data_ptr_ = new double[ ( dimension_ * ( dimension_ - 1 ) ) / 2 ];
-    value_on_diagonal_ = 1.0;
+    memory_.resize( nvalues() * bytes_per_value( precision_ ), 0 );
+    if ( ! memory_.empty() )
+    {
+        writable_data_ = &memory_[0];
+        data_ = writable_data_;
+    }
+}
+
+// ********************************************************************************
+
+CorrelationMatrix::CorrelationMatrix( const size_t dimension, const FileName & file_name, const Precision precision ):
+dimension_(dimension),
+precision_(precision),
+value_on_diagonal_(1.0),
+memory_mapped_file_(0),
+data_(0),
+writable_data_(0)
+{
+    memory_mapped_file_ = new MemoryMappedFile( file_name, header_size + nvalues() * bytes_per_value( precision_ ) );
+    write_header( memory_mapped_file_->writable_data() );
+    writable_data_ = memory_mapped_file_->writable_data() + header_size;
+    data_ = writable_data_;
+}
+
+// ********************************************************************************
+
+CorrelationMatrix::CorrelationMatrix( const FileName & file_name, const bool memory_map, const bool write_back ):
+dimension_(0),
+precision_(DOUBLE),
+value_on_diagonal_(1.0),
+memory_mapped_file_(0),
+data_(0),
+writable_data_(0)
+{
+    char header[header_size];
+    std::vector< char > file_contents;
+    if ( memory_map )
+    {
+        memory_mapped_file_ = new MemoryMappedFile( file_name, write_back ? MemoryMappedFile::READ_WRITE : MemoryMappedFile::READ_ONLY );
+        if ( memory_mapped_file_->size() >= header_size )
+            memcpy( header, memory_mapped_file_->data(), header_size );
+    }
+    else
+    {
+        std::ifstream input_file( file_name.full_name().c_str(), std::ios::in | std::ios::binary );
+        if ( ! input_file )
+            throw std::runtime_error( "CorrelationMatrix::CorrelationMatrix(): Error: could not open file " + file_name.full_name() );
+        input_file.read( header, header_size );
+        if ( input_file.gcount() != static_cast< std::streamsize >( header_size ) )
+            throw std::runtime_error( "CorrelationMatrix::CorrelationMatrix(): Error: file too short " + file_name.full_name() );
+    }
+    unsigned long long dimension;
+    int precision;
+    if ( ( memory_map && ( memory_mapped_file_->size() < header_size ) ) || ( memcmp( header, magic_number, 8 ) != 0 ) )
+    {
+        delete memory_mapped_file_;
+        throw std::runtime_error( "CorrelationMatrix::CorrelationMatrix(): Error: not a binary correlation matrix " + file_name.full_name() );
+    }
+    memcpy( &dimension, header + 8, 8 );
+    memcpy( &precision, header + 16, 4 );
+    memcpy( &value_on_diagonal_, header + 24, 8 );
+    dimension_ = dimension;
+    if ( ( precision < DOUBLE ) || ( precision > HALF ) )
+    {
+        delete memory_mapped_file_;
+        throw std::runtime_error( "CorrelationMatrix::CorrelationMatrix(): Error: unknown precision in " + file_name.full_name() );
+    }
+    precision_ = static_cast< Precision >( precision );
+    size_t nbytes = nvalues() * bytes_per_value( precision_ );
+    if ( memory_map )
+    {
+        if ( memory_mapped_file_->size() != header_size + nbytes )
+        {
+            delete memory_mapped_file_;
+            throw std::runtime_error( "CorrelationMatrix::CorrelationMatrix(): Error: file size does not match dimension " + file_name.full_name() );
+        }
+        data_ = memory_mapped_file_->data() + header_size;
+        if ( write_back )
+            writable_data_ = memory_mapped_file_->writable_data() + header_size;
+    }
+    else
+    {
+        memory_.resize( nbytes );
+        std::ifstream input_file( file_name.full_name().c_str(), std::ios::in | std::ios::binary );
+        input_file.seekg( header_size );
+        if ( nbytes != 0 )
+        {
+            input_file.read( &memory_[0], nbytes );
+            if ( input_file.gcount() != static_cast< std::streamsize >( nbytes ) )
+                throw std::runtime_error( "CorrelationMatrix::CorrelationMatrix(): Error: file size does not match dimension " + file_name.full_name() );
+            writable_data_ = &memory_[0];
+            data_ = writable_data_;
+        }
+    }
+}
+
+// ********************************************************************************
+
+CorrelationMatrix::CorrelationMatrix( const CorrelationMatrix & rhs ):
+dimension_(rhs.dimension_),
+precision_(rhs.precision_),
+value_on_diagonal_(rhs.value_on_diagonal_),
+memory_mapped_file_(0),
+data_(0),
+writable_data_(0)
+{
+    memory_.assign( rhs.data_, rhs.data_ + nvalues() * bytes_per_value( precision_ ) );
+    if ( ! memory_.empty() )
+    {
+        writable_data_ = &memory_[0];
+        data_ = writable_data_;
+    }
+}
+
+// ********************************************************************************
+
+CorrelationMatrix & CorrelationMatrix::operator=( const CorrelationMatrix & rhs )
+{
+    if ( this == &rhs )
+        return *this;
+    CorrelationMatrix copy( rhs );
+    std::swap( dimension_, copy.dimension_ );
+    std::swap( precision_, copy.precision_ );
+    std::swap( value_on_diagonal_, copy.value_on_diagonal_ );
+    memory_.swap( copy.memory_ ); // Swapping does not move the elements, so data_ remains valid.
+    std::swap( memory_mapped_file_, copy.memory_mapped_file_ );
+    std::swap( data_, copy.data_ );
+    std::swap( writable_data_, copy.writable_data_ );
+    return *this;
 }
 
 // ********************************************************************************
 
 CorrelationMatrix::~CorrelationMatrix()
 {
-    delete[] data_ptr_;
+    delete memory_mapped_file_;
+}
+
+// ********************************************************************************
+
+bool CorrelationMatrix::is_read_only() const
+{
+    return ( memory_mapped_file_ != 0 ) && ( memory_mapped_file_->mode() == MemoryMappedFile::READ_ONLY );
 }
 
 // ********************************************************************************
@@ -58,7 +290,7 @@ double CorrelationMatrix::value( size_t i, size_t j ) const
     {
         if ( i == j )
             return value_on_diagonal_;
-        return data_ptr_[ ((i*(i-1))/2) + j ];
+        return stored_value( ((i*(i-1))/2) + j );
     }
     else
         throw std::runtime_error( "CorrelationMatrix::element(): out of bounds ( " + size_t2string(i) + " > " + size_t2string(dimension_) + " )" );
@@ -74,7 +306,7 @@ void CorrelationMatrix::set_value( size_t i, size_t j, const double value )
     {
         if ( i == j )
             return;
-        data_ptr_[ ((i*(i-1))/2) + j ] = value;
+        set_stored_value( ((i*(i-1))/2) + j, value );
     }
     else
         throw std::runtime_error( "CorrelationMatrix::set_element(): out of bounds ( " + size_t2string(i) + " > " + size_t2string(dimension_) + " )" );
@@ -82,14 +314,26 @@ void CorrelationMatrix::set_value( size_t i, size_t j, const double value )
 
 // ********************************************************************************
 
+void CorrelationMatrix::set_value_on_diagonal( const double value )
+{
+    if ( is_read_only() )
+        throw std::runtime_error( "CorrelationMatrix::set_value_on_diagonal(): Error: matrix is read only." );
+    value_on_diagonal_ = value;
+    if ( memory_mapped_file_ != 0 )
+        write_header( memory_mapped_file_->writable_data() );
+}
+
+// ********************************************************************************
+
 // Diagonal is not included
 double CorrelationMatrix::largest_value() const
 {
     double result( 0.0 );
-    for ( size_t i( 0 ); i != (( dimension_ * ( dimension_ - 1 ) ) / 2); ++i )
+    for ( size_t i( 0 ); i != nvalues(); ++i )
     {
-        if ( data_ptr_[i] > result )
-            result = data_ptr_[i];
+        double value = stored_value( i );
+        if ( value > result )
+            result = value;
     }
     return result;
 }
@@ -100,10 +344,11 @@ double CorrelationMatrix::largest_value() const
 double CorrelationMatrix::smallest_value() const
 {
     double result( 1.0 );
-    for ( size_t i( 0 ); i != (( dimension_ * ( dimension_ - 1 ) ) / 2); ++i )
+    for ( size_t i( 0 ); i != nvalues(); ++i )
     {
-        if ( data_ptr_[i] < result )
-            result = data_ptr_[i];
+        double value = stored_value( i );
+        if ( value < result )
+            result = value;
     }
     return result;
 }
@@ -125,86 +370,160 @@ void CorrelationMatrix::save( const FileName & file_name ) const
 
 // ********************************************************************************
 
+void CorrelationMatrix::save_lower_triangle( const FileName & file_name ) const
+{
+    TextFileWriter text_file_writer( file_name );
+    size_t index( 0 );
+    for ( size_t i( 1 ); i < size(); ++i )
+    {
+        for ( size_t j( 0 ); j != i; ++j )
+        {
+            text_file_writer.write( double2string( stored_value( index ) ) + "  " );
+            ++index;
+        }
+        text_file_writer.write_line();
+    }
+}
+
+// ********************************************************************************
+
+void CorrelationMatrix::save_binary( const FileName & file_name ) const
+{
+    std::ofstream output_file( file_name.full_name().c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+    if ( ! output_file )
+        throw std::runtime_error( "CorrelationMatrix::save_binary(): Error: could not open file " + file_name.full_name() );
+    char header[header_size];
+    write_header( header );
+    output_file.write( header, header_size );
+    size_t nbytes = nvalues() * bytes_per_value( precision_ );
+    if ( nbytes != 0 )
+        output_file.write( data_, nbytes );
+    if ( ! output_file )
+        throw std::runtime_error( "CorrelationMatrix::save_binary(): Error: could not write file " + file_name.full_name() );
+}
+
+// ********************************************************************************
+
 // Divides the entries into clusters, all entries more similar than threshold are put into a cluster.
 // If this leads to inconsistencies, e.g. because A = B, B = C, but A != C, then A = C.
 std::vector< std::vector< size_t > > CorrelationMatrix::clusters( const double threshold ) const
+{
+    return calculate_clusters( threshold, threshold, false );
+}
+
+// ********************************************************************************
+
+std::vector< std::vector< size_t > > CorrelationMatrix::clusters( const double grey_area_threshold, const double threshold ) const
+{
+    return calculate_clusters( grey_area_threshold, threshold, true );
+}
+
+// ********************************************************************************
+
+// Entry i starts a new cluster unless it is more similar than threshold to the first entry of an earlier cluster,
+// it is then added to the earliest such cluster.
+// Because the first entries of the clusters all have a lower index, the values can be read one row at a time
+// in the order in which they are stored.
+// @@ We may still have inconsistencies here.
+std::vector< std::vector< size_t > > CorrelationMatrix::calculate_clusters( const double grey_area_threshold, const double threshold, const bool print_warnings ) const
 {
     std::vector< std::vector< size_t > > result;
-    std::vector< bool > done( size(), false );
+    std::vector< size_t > cluster_indices( size(), size() ); // For the first entry of each cluster, the index of its cluster, otherwise size()
+    for ( size_t i( 0 ); i != size(); ++i )
     {
-        for ( size_t i( 0 ); i != size(); ++i )
+        size_t row_start = ( i * ( i - 1 ) ) / 2;
+        size_t cluster_index( result.size() );
+        for ( size_t j( 0 ); j != i; ++j )
         {
-            if ( done[i] )
+            if ( cluster_indices[j] == size() )
                 continue;
-            std::vector< size_t > one_cluster;
-            one_cluster.push_back( i );
-            done[i] = true;
-            for ( size_t j( i+1 ); j < size(); ++j )
+            double value = stored_value( row_start + j );
+            if ( value > threshold )
             {
-                if ( done[j] )
-                    continue;
-                if ( value( i, j ) > threshold  )
-                {
-                    one_cluster.push_back( j );
-                    done[j] = true;
-//                    // The following is to ensure that if A = B and B = C, then A = C.
-//                    // This may not necessarily follow from the correlation value,
-//                    // because it is possible that A and C are the beginning and the end
-//                    // of a temperature series.
-//                    for ( size_t k( j+1 ); k < size(); ++k )
-//                    {
-//                        if ( done[k] )
-//                            continue;
-//                        if ( ( value( j, k ) > threshold ) && ( ! ( value( i, k ) > threshold) )  )
-//                        {
-//                            one_cluster.push_back( k );
-//                            done[k] = true;
-//                        }
-//                    }
-                }
+                cluster_index = cluster_indices[j];
+                break;
             }
-            result.push_back( one_cluster );
+            if ( print_warnings && ( value > grey_area_threshold ) )
+                std::cout << "Warning: similarity " << j << ", " << i << " is " << value << std::endl;
         }
+        if ( cluster_index == result.size() )
+        {
+            cluster_indices[i] = cluster_index;
+            result.push_back( std::vector< size_t >( 1, i ) );
+        }
+        else
+            result[cluster_index].push_back( i );
     }
-    // @@ We may still have inconsistencies here.
-    // @@ Depending on how we handle the inconsistencies, the lists of indices may not be ordered when we get here.
     return result;
 }
 
 // ********************************************************************************
 
-std::vector< std::vector< size_t > > CorrelationMatrix::clusters( const double grey_area_threshold, const double threshold ) const
+double CorrelationMatrix::stored_value( const size_t index ) const
 {
-    std::vector< std::vector< size_t > > result;
-    std::vector< bool > done( size(), false );
+    switch ( precision_ )
     {
-        for ( size_t i( 0 ); i != size(); ++i )
+        case DOUBLE :
         {
-            if ( done[i] )
-                continue;
-            std::vector< size_t > one_cluster;
-            one_cluster.push_back( i );
-            done[i] = true;
-            for ( size_t j( i+1 ); j < size(); ++j )
-            {
-                if ( done[j] )
-                    continue;
-                if ( value( i, j ) > threshold  )
-                {
-                    one_cluster.push_back( j );
-                    done[j] = true;
-                }
-                else if ( value( i, j ) > grey_area_threshold  )
-                {
-                    std::cout << "Warning: similarity " << i << ", " << j << " is " << value( i, j ) << std::endl;
-                }
-            }
-            result.push_back( one_cluster );
+            double result;
+            memcpy( &result, data_ + 8 * index, 8 );
+            return result;
+        }
+        case FLOAT :
+        {
+            float result;
+            memcpy( &result, data_ + 4 * index, 4 );
+            return result;
+        }
+        case HALF :
+        {
+            unsigned short result;
+            memcpy( &result, data_ + 2 * index, 2 );
+            return half_to_float( result );
         }
     }
-    // @@ We may still have inconsistencies here.
-    // @@ Depending on how we handle the inconsistencies, the lists of indices may not be ordered when we get here.
-    return result;
+    return 0.0;
+}
+
+// ********************************************************************************
+
+void CorrelationMatrix::set_stored_value( const size_t index, const double value )
+{
+    if ( is_read_only() )
+        throw std::runtime_error( "CorrelationMatrix::set_value(): Error: matrix is read only." );
+    switch ( precision_ )
+    {
+        case DOUBLE :
+        {
+            memcpy( writable_data_ + 8 * index, &value, 8 );
+            break;
+        }
+        case FLOAT :
+        {
+            float float_value = static_cast< float >( value );
+            memcpy( writable_data_ + 4 * index, &float_value, 4 );
+            break;
+        }
+        case HALF :
+        {
+            unsigned short half_value = float_to_half( static_cast< float >( value ) );
+            memcpy( writable_data_ + 2 * index, &half_value, 2 );
+            break;
+        }
+    }
+}
+
+// ********************************************************************************
+
+void CorrelationMatrix::write_header( char * header ) const
+{
+    memset( header, 0, header_size );
+    memcpy( header, magic_number, 8 );
+    unsigned long long dimension = dimension_;
+    int precision = precision_;
+    memcpy( header + 8, &dimension, 8 );
+    memcpy( header + 16, &precision, 4 );
+    memcpy( header + 24, &value_on_diagonal_, 8 );
 }
 
 // ********************************************************************************
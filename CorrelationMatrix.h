@@ -29,6 +29,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ********************************************* */
 
 class FileName;
+class MemoryMappedFile;
 
 #include <cstddef> // For definition of size_t
 #include <string>
@@ -41,25 +42,60 @@ class FileName;
   Access is boundary-checked, even for the diagonal.
   
   The value that is used for the diagonal can be set (but it must be the same for all entries on the diagonal).
+
+  Only the N(N-1)/2 values below the diagonal are stored, row by row: (1,0), (2,0), (2,1), (3,0), ...
+  They can be stored as double (8 bytes), float (4 bytes) or IEEE 754 half precision (2 bytes, about three significant digits,
+  which is enough for clustering). For N = 100,000 that is 40 GB, 20 GB and 10 GB, respectively.
+
+  A matrix that does not fit into memory can be file backed: the values are then stored in a memory-mapped file
+  in the binary format of save_binary(), and only the parts that are accessed are in memory.
+  clusters() reads the values in the order in which they are stored, so it streams through a file-backed matrix.
+
+  The binary format is a 32-byte header followed by the values in native byte order:
+  the 8 characters "CORRMAT1", the dimension (8-byte unsigned integer), the precision (4-byte integer, 0 = double, 1 = float, 2 = half),
+  4 bytes padding and the value on the diagonal (8-byte double).
 */
 class CorrelationMatrix
 {
 public:
 
-    explicit CorrelationMatrix( const size_t dimension );
-    
+    enum Precision { DOUBLE, FLOAT, HALF };
+
+    explicit CorrelationMatrix( const size_t dimension, const Precision precision = DOUBLE );
+
+    // File backed: creates the file file_name, any existing file is overwritten. The values are initialised to 0.0.
+    // The file remains when the CorrelationMatrix is destroyed and can be reloaded with the constructor below.
+    CorrelationMatrix( const size_t dimension, const FileName & file_name, const Precision precision );
+
+    // Reads a file written by save_binary() or by a file-backed CorrelationMatrix.
+    // If memory_map is true, the matrix is file backed. It is then read only, and set_value() and set_value_on_diagonal() throw,
+    // unless write_back is true, in which case changes are written to the file. write_back is ignored if memory_map is false.
+    explicit CorrelationMatrix( const FileName & file_name, const bool memory_map = false, const bool write_back = false );
+
+    // The copy is always held in memory, even if the original is file backed.
+    CorrelationMatrix( const CorrelationMatrix & rhs );
+    CorrelationMatrix & operator=( const CorrelationMatrix & rhs );
+
     ~CorrelationMatrix();
 
     size_t size() const { return dimension_; }
 
+    Precision precision() const { return precision_; }
+
+    bool is_file_backed() const { return memory_mapped_file_ != 0; }
+
+    // Only a memory-mapped matrix without write-back is read only.
+    bool is_read_only() const;
+
     // In keeping with the silly C++ convention: zero-based.
     double value( size_t i, size_t j ) const;
 
+    // With reduced precision, value() returns the nearest number that can be stored.
     void set_value( size_t i, size_t j, const double value );
 
     double value_on_diagonal() const { return value_on_diagonal_; }
     
-    void set_value_on_diagonal( const double value ) { value_on_diagonal_ = value; }
+    void set_value_on_diagonal( const double value );
 
     // Diagonal is not included.
     double largest_value() const;
@@ -67,11 +103,15 @@ public:
     // Diagonal is not included.
     double smallest_value() const;
 
+    // Text file with the full matrix.
     void save( const FileName & file_name ) const;
     
-    // @@@not yet implemented>
+    // Text file with the values below the diagonal, one line per row, starting with row 1.
     void save_lower_triangle( const FileName & file_name ) const;
 
+    // Binary file, see above. Can be read back with CorrelationMatrix( file_name ) without any conversions.
+    void save_binary( const FileName & file_name ) const;
+
     // Divides the entries into clusters, all entries more similar than threshold are put into a cluster.
     // If this leads to inconsistencies, e.g. because A = B, B = C, but A != C, then A = C.
     std::vector< std::vector< size_t > > clusters( const double threshold ) const;
@@ -80,9 +120,19 @@ public:
     std::vector< std::vector< size_t > > clusters( const double grey_area_threshold, const double threshold ) const;
 
 private:
-    double* data_ptr_;
     size_t dimension_;
+    Precision precision_;
     double value_on_diagonal_;
+    std::vector< char > memory_; // Empty if file backed
+    MemoryMappedFile * memory_mapped_file_; // 0 if not file backed
+    const char * data_; // Points into memory_ or into the memory-mapped file
+    char * writable_data_; // As data_, 0 if read only
+
+    size_t nvalues() const { return ( dimension_ < 2 ) ? 0 : ( dimension_ * ( dimension_ - 1 ) ) / 2; }
+    double stored_value( const size_t index ) const;
+    void set_stored_value( const size_t index, const double value );
+    void write_header( char * header ) const;
+    std::vector< std::vector< size_t > > calculate_clusters( const double grey_area_threshold, const double threshold, const bool print_warnings ) const;
 };
 
 #endif // CORRELATIONMATRIX_H
@@ -31,9 +31,66 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "Sort.h"
 #include "Utilities.h"
 
+#include <cmath>
 #include <iostream>
 #include <stdexcept>
 
+namespace
+{
+
+// Replaces the basis vectors by shorter lattice vectors until no basis vector can be shortened any more
+// by adding or subtracting (combinations of) the other two. In three dimensions this gives a Minkowski-reduced basis.
+// coefficients[i] are the components of basis vector i with respect to the original basis.
+void reduce_basis( Vector3D basis[3], int coefficients[3][3] )
+{
+    bool changed( true );
+    while ( changed )
+    {
+        changed = false;
+        for ( size_t i( 0 ); i != 3; ++i )
+        {
+            for ( size_t j( 0 ); j != 3; ++j )
+            {
+                if ( j == i )
+                    continue;
+                int m = round_to_int( ( basis[i] * basis[j] ) / basis[j].norm2() );
+                if ( m == 0 )
+                    continue;
+                Vector3D candidate = basis[i] - m * basis[j];
+                // The tolerance guards against endless swapping when the projection is exactly one half.
+                if ( candidate.norm2() < basis[i].norm2() * ( 1.0 - 1.0E-10 ) )
+                {
+                    basis[i] = candidate;
+                    for ( size_t k( 0 ); k != 3; ++k )
+                        coefficients[i][k] -= m * coefficients[j][k];
+                    changed = true;
+                }
+            }
+        }
+        for ( size_t i( 0 ); i != 3; ++i )
+        {
+            size_t j = ( i + 1 ) % 3;
+            size_t k = ( i + 2 ) % 3;
+            for ( int sj( -1 ); sj != 3; sj += 2 )
+            {
+                for ( int sk( -1 ); sk != 3; sk += 2 )
+                {
+                    Vector3D candidate = basis[i] + sj * basis[j] + sk * basis[k];
+                    if ( candidate.norm2() < basis[i].norm2() * ( 1.0 - 1.0E-10 ) )
+                    {
+                        basis[i] = candidate;
+                        for ( size_t l( 0 ); l != 3; ++l )
+                            coefficients[i][l] += sj * coefficients[j][l] + sk * coefficients[k][l];
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
 // ********************************************************************************
 
 CrystalLattice::CrystalLattice()
@@ -90,6 +147,7 @@ alpha_(alpha), beta_(beta), gamma_(gamma)
     constraints_ = ::constraints( lattice_system_ );
     b_is_constrained_ = ( ( constraints_ & 1 ) == 1 );
     c_is_constrained_ = ( ( constraints_ & 2 ) == 2 );
+    initialise_reduced_basis();
 }
 
 // ********************************************************************************
@@ -255,6 +313,47 @@ Vector3D CrystalLattice::fractional_to_orthogonal( const Vector3D & input ) cons
 
 // ********************************************************************************
 
+// Both matrices are upper triangular because a is along x and b is in the xy plane.
+void CrystalLattice::orthogonal_to_fractional( const std::vector< Vector3D > & input, std::vector< Vector3D > & output ) const
+{
+    const double m00 = orthogonal_to_fractional_matrix_.value( 0, 0 );
+    const double m01 = orthogonal_to_fractional_matrix_.value( 0, 1 );
+    const double m02 = orthogonal_to_fractional_matrix_.value( 0, 2 );
+    const double m11 = orthogonal_to_fractional_matrix_.value( 1, 1 );
+    const double m12 = orthogonal_to_fractional_matrix_.value( 1, 2 );
+    const double m22 = orthogonal_to_fractional_matrix_.value( 2, 2 );
+    output.resize( input.size() );
+    for ( size_t i( 0 ); i != input.size(); ++i )
+    {
+        const double x = input[i].x();
+        const double y = input[i].y();
+        const double z = input[i].z();
+        output[i] = Vector3D( m00 * x + m01 * y + m02 * z, m11 * y + m12 * z, m22 * z );
+    }
+}
+
+// ********************************************************************************
+
+void CrystalLattice::fractional_to_orthogonal( const std::vector< Vector3D > & input, std::vector< Vector3D > & output ) const
+{
+    const double m00 = fractional_to_orthogonal_matrix_.value( 0, 0 );
+    const double m01 = fractional_to_orthogonal_matrix_.value( 0, 1 );
+    const double m02 = fractional_to_orthogonal_matrix_.value( 0, 2 );
+    const double m11 = fractional_to_orthogonal_matrix_.value( 1, 1 );
+    const double m12 = fractional_to_orthogonal_matrix_.value( 1, 2 );
+    const double m22 = fractional_to_orthogonal_matrix_.value( 2, 2 );
+    output.resize( input.size() );
+    for ( size_t i( 0 ); i != input.size(); ++i )
+    {
+        const double x = input[i].x();
+        const double y = input[i].y();
+        const double z = input[i].z();
+        output[i] = Vector3D( m00 * x + m01 * y + m02 * z, m11 * y + m12 * z, m22 * z );
+    }
+}
+
+// ********************************************************************************
+
 void CrystalLattice::rescale_volume( const double target_volume, size_t Z )
 {
     size_t current_Z(1);
@@ -290,36 +389,7 @@ double CrystalLattice::shortest_distance( const Vector3D & lhs, const Vector3D &
 // Finds shortest distance, in Angstrom^2, between two positions given in fractional coordinates.
 double CrystalLattice::shortest_distance2( const Vector3D & lhs, const Vector3D & rhs ) const
 {
-    Vector3D difference_vector = adjust_for_translations( rhs - lhs ); // In fractional coordinates
-    // Now we must find the shortest distance.
-    double shortest_distance2 = fractional_to_orthogonal( difference_vector ).norm2();
-    // "shortest_distance" may now be something like 0.95, which clearly should have been 0.05. Likewise,
-    // with very acute unit-cell angles, it may be necessary to add or subtract +/- 1 (fractional coordinates).
-    Vector3D original_difference_vector( difference_vector );
-    bool shortest_distance_changed( false );
-    do
-    {
-        shortest_distance_changed = false;
-        for ( int i( -1 ); i != 2; ++i )
-        {
-            for ( int j( -1 ); j != 2; ++j )
-            {
-                for ( int k( -1 ); k != 2; ++k )
-                {
-                    Vector3D new_difference_vector = original_difference_vector + Vector3D( i, j, k );
-                    double distance2 = fractional_to_orthogonal( new_difference_vector ).norm2();
-                    if ( distance2 < shortest_distance2 )
-                    {
-                        difference_vector = new_difference_vector;
-                        shortest_distance2 = distance2;
-                        shortest_distance_changed = true;
-                    }
-                }
-            }
-        }
-    }
-    while ( shortest_distance_changed );
-    return shortest_distance2;
+    return minimum_image_distance2( rhs - lhs, 0 );
 }
 
 // ********************************************************************************
@@ -328,37 +398,27 @@ double CrystalLattice::shortest_distance2( const Vector3D & lhs, const Vector3D
 // Returns the shortest distance and the shortest difference vector (in fractional coordinates).
 void CrystalLattice::shortest_distance( const Vector3D & lhs, const Vector3D & rhs, double & output_distance, Vector3D & output_difference_vector ) const
 {
-    Vector3D difference_vector = adjust_for_translations( rhs - lhs ); // In fractional coordinates
-    // Now we must find the shortest distance.
-    double shortest_distance = fractional_to_orthogonal( difference_vector ).norm2();
-    // "shortest_distance" may now be something like 0.95, which clearly should have been 0.05. Likewise,
-    // with very acute unit-cell angles, it may be necessary to add or subtract +/- 1 (fractional coordinates).
-    Vector3D original_difference_vector( difference_vector );
-    bool shortest_distance_changed( false );
-    do
-    {
-        shortest_distance_changed = false;
-        for ( int i( -1 ); i != 2; ++i )
-        {
-            for ( int j( -1 ); j != 2; ++j )
-            {
-                for ( int k( -1 ); k != 2; ++k )
-                {
-                    Vector3D new_difference_vector = original_difference_vector + Vector3D( i, j, k );
-                    double distance = fractional_to_orthogonal( new_difference_vector ).norm2();
-                    if ( distance < shortest_distance )
-                    {
-                        difference_vector = new_difference_vector;
-                        shortest_distance = distance;
-                        shortest_distance_changed = true;
-                    }
-                }
-            }
-        }
-    }
-    while ( shortest_distance_changed );
-    output_distance = sqrt( shortest_distance );
-    output_difference_vector = difference_vector;
+    output_distance = sqrt( minimum_image_distance2( rhs - lhs, &output_difference_vector ) );
+}
+
+// ********************************************************************************
+
+void CrystalLattice::shortest_distances2( const Vector3D & lhs, const std::vector< Vector3D > & rhs, std::vector< double > & distances2 ) const
+{
+    distances2.resize( rhs.size() );
+    for ( size_t i( 0 ); i != rhs.size(); ++i )
+        distances2[i] = minimum_image_distance2( rhs[i] - lhs, 0 );
+}
+
+// ********************************************************************************
+
+void CrystalLattice::shortest_distances2( const std::vector< Vector3D > & lhs, const std::vector< Vector3D > & rhs, std::vector< double > & distances2 ) const
+{
+    if ( lhs.size() != rhs.size() )
+        throw std::runtime_error( "CrystalLattice::shortest_distances2(): Error: lhs and rhs must have the same size." );
+    distances2.resize( rhs.size() );
+    for ( size_t i( 0 ); i != rhs.size(); ++i )
+        distances2[i] = minimum_image_distance2( rhs[i] - lhs[i], 0 );
 }
 
 // ********************************************************************************
@@ -525,6 +585,96 @@ void CrystalLattice::transform( const Matrix3D & m )
 
 // ********************************************************************************
 
+void CrystalLattice::initialise_reduced_basis()
+{
+    Vector3D basis[3] = { a_vector_, b_vector_, c_vector_ };
+    int coefficients[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+    reduce_basis( basis, coefficients );
+    // The columns are the reduced basis vectors in terms of the original basis vectors.
+    reduced_to_fractional_matrix_ = Matrix3D( coefficients[0][0], coefficients[1][0], coefficients[2][0],
+                                              coefficients[0][1], coefficients[1][1], coefficients[2][1],
+                                              coefficients[0][2], coefficients[1][2], coefficients[2][2] );
+    fractional_to_reduced_matrix_ = reduced_to_fractional_matrix_;
+    fractional_to_reduced_matrix_.invert();
+    // The matrix is unimodular, so its inverse has integer elements.
+    for ( size_t i( 0 ); i != 3; ++i )
+    {
+        for ( size_t j( 0 ); j != 3; ++j )
+            fractional_to_reduced_matrix_.set_value( i, j, round_to_int( fractional_to_reduced_matrix_.value( i, j ) ) );
+    }
+    // Cholesky decomposition of the metric matrix: only the lengths and angles of the reduced basis matter for distances.
+    reduced_U_[0] = sqrt( basis[0].norm2() );
+    reduced_U_[1] = ( basis[0] * basis[1] ) / reduced_U_[0];
+    reduced_U_[2] = ( basis[0] * basis[2] ) / reduced_U_[0];
+    reduced_U_[3] = sqrt( basis[1].norm2() - square( reduced_U_[1] ) );
+    reduced_U_[4] = ( basis[1] * basis[2] - reduced_U_[1] * reduced_U_[2] ) / reduced_U_[3];
+    reduced_U_[5] = sqrt( basis[2].norm2() - square( reduced_U_[2] ) - square( reduced_U_[4] ) );
+}
+
+// ********************************************************************************
+
+// The search is a Fincke-Pohst enumeration over the reduced basis: because U is upper triangular, the contribution
+// of the third coordinate to the distance^2 is known before the first two have been chosen, and only translations
+// that can still beat the current shortest distance are visited. This is exact for any unit cell,
+// and because the reduced basis is nearly orthogonal, only a handful of translations is visited.
+// The image with all fractional coordinates in [0,1> is tried first, so for ties it is the one returned.
+double CrystalLattice::minimum_image_distance2( const Vector3D & difference_vector, Vector3D * shortest_difference_vector ) const
+{
+    const Vector3D wrapped_difference_vector = adjust_for_translations( difference_vector );
+    const Vector3D y = fractional_to_reduced_matrix_ * wrapped_difference_vector;
+    const double u00 = reduced_U_[0];
+    const double u01 = reduced_U_[1];
+    const double u02 = reduced_U_[2];
+    const double u11 = reduced_U_[3];
+    const double u12 = reduced_U_[4];
+    const double u22 = reduced_U_[5];
+    // Start with the image in [0,1>.
+    double t0 = u00 * y.x() + u01 * y.y() + u02 * y.z();
+    double t1 = u11 * y.y() + u12 * y.z();
+    double t2 = u22 * y.z();
+    double result = t0 * t0 + t1 * t1 + t2 * t2;
+    int best_n0( 0 );
+    int best_n1( 0 );
+    int best_n2( 0 );
+    const double radius = sqrt( result );
+    const int n2_begin = static_cast<int>( ceil( -radius / u22 - y.z() ) );
+    const int n2_end = static_cast<int>( floor( radius / u22 - y.z() ) );
+    for ( int n2( n2_begin ); n2 <= n2_end; ++n2 )
+    {
+        const double z2 = y.z() + n2;
+        const double partial2 = square( u22 * z2 );
+        if ( partial2 >= result )
+            continue;
+        // u11 * ( y1 + n1 ) + u12 * z2 must be within +/- half_width * u11.
+        const double centre1 = y.y() + ( u12 * z2 ) / u11;
+        const double half_width1 = sqrt( result - partial2 ) / u11;
+        const int n1_begin = static_cast<int>( ceil( -half_width1 - centre1 ) );
+        const int n1_end = static_cast<int>( floor( half_width1 - centre1 ) );
+        for ( int n1( n1_begin ); n1 <= n1_end; ++n1 )
+        {
+            const double z1 = y.y() + n1;
+            const double partial1 = partial2 + square( u11 * z1 + u12 * z2 );
+            if ( partial1 >= result )
+                continue;
+            // The best translation along the first reduced basis vector follows directly.
+            const int n0 = -round_to_int( y.x() + ( u01 * z1 + u02 * z2 ) / u00 );
+            const double distance2 = partial1 + square( u00 * ( y.x() + n0 ) + u01 * z1 + u02 * z2 );
+            if ( distance2 < result )
+            {
+                result = distance2;
+                best_n0 = n0;
+                best_n1 = n1;
+                best_n2 = n2;
+            }
+        }
+    }
+    if ( shortest_difference_vector )
+        *shortest_difference_vector = wrapped_difference_vector + reduced_to_fractional_matrix_ * Vector3D( best_n0, best_n1, best_n2 );
+    return result;
+}
+
+// ********************************************************************************
+
 void CrystalLattice::print() const
 {
     std::cout << "a = " << a() << ", " <<
@@ -34,6 +34,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "Vector3D.h"
 
 #include <string>
+#include <vector>
 
 // a along x, b in xy plane, right-handed coordinate frame.
 // We also abuse this class for any functionality related to parallelepipeds.
@@ -97,6 +98,10 @@ public:
     Vector3D orthogonal_to_fractional( const Vector3D & input ) const;
     Vector3D fractional_to_orthogonal( const Vector3D & input ) const;
 
+    // Batch versions, output is resized to the size of input.
+    void orthogonal_to_fractional( const std::vector< Vector3D > & input, std::vector< Vector3D > & output ) const;
+    void fractional_to_orthogonal( const std::vector< Vector3D > & input, std::vector< Vector3D > & output ) const;
+
     // This is the matrix N as used by Grosse-Kunstleve to convert U_cif to U_star.
     SymmetricMatrix3D N() const { return N_; }
     SymmetricMatrix3D N_inverse() const { return N_inverse_; }
@@ -121,6 +126,11 @@ public:
     // Returns the shortest distance (in Angstrom) and the shortest difference vector (defined as rhs - lhs, in fractional coordinates).
     void shortest_distance( const Vector3D & lhs, const Vector3D & rhs, double & distance, Vector3D & difference_vector ) const;
 
+    // Batch versions: shortest distance^2 between lhs and each of rhs, and between lhs[i] and rhs[i], respectively.
+    // distances2 is resized to the size of rhs.
+    void shortest_distances2( const Vector3D & lhs, const std::vector< Vector3D > & rhs, std::vector< double > & distances2 ) const;
+    void shortest_distances2( const std::vector< Vector3D > & lhs, const std::vector< Vector3D > & rhs, std::vector< double > & distances2 ) const;
+
     // The lattice system is initialised by deducing it from the unit-cell parameters.
     LatticeSystem lattice_system() const { return lattice_system_; }
     void set_lattice_system( const LatticeSystem lattice_system );
@@ -188,9 +198,23 @@ private:
     bool c_is_constrained_; // It can then only be constrained to a.
     char constraints_; // From lattice_system_ if set by user, otherwise from the unit-cell parameters.
 
+    // For the minimum-image search: a reduced basis of the same lattice, which has short and nearly orthogonal basis vectors
+    // even if a, b and c are very skewed. The fractional coordinates with respect to the reduced basis are
+    // y = fractional_to_reduced_matrix_ * x, the Cartesian coordinates are U * y with U the upper-triangular
+    // Cholesky factor of the metric matrix of the reduced basis, stored as U00, U01, U02, U11, U12, U22.
+    Matrix3D fractional_to_reduced_matrix_;
+    Matrix3D reduced_to_fractional_matrix_;
+    double reduced_U_[6];
+
 // Deduces the lattice system based on the unit-cell parameters.
     void deduce_lattice_system();
 
+    void initialise_reduced_basis();
+
+    // Returns the shortest distance^2 over all lattice translations of difference_vector (in fractional coordinates).
+    // If shortest_difference_vector is not 0, the corresponding difference vector is returned.
+    double minimum_image_distance2( const Vector3D & difference_vector, Vector3D * shortest_difference_vector ) const;
+
 };
 
 std::string LatticeSystem2string( const CrystalLattice::LatticeSystem lattice_system );
@@ -27,11 +27,13 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "CrystalStructure.h"
 #include "3DCalculations.h"
+#include "AnalyseRings.h"
 #include "BasicMathsFunctions.h"
 #include "ChemicalFormula.h"
 #include "ConnectivityTable.h"
 #include "FileName.h"
 #include "Mapping.h"
+#include "NeighbourSearch.h"
 #include "PhysicalConstants.h"
 #include "PointGroup.h"
 #include "RunningAverageAndESD.h"
@@ -39,18 +41,256 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "TextFileWriter.h"
 #include "Utilities.h"
 
+#include <algorithm>
+#include <functional>
 #include <iostream>
+#include <limits>
 #include <stdexcept>
 
+namespace
+{
+
+// The image of atom i under symmetry operator k has index i * nsymmetry_operators + k.
+std::vector< Vector3D > symmetry_images( const CrystalStructure & crystal_structure )
+{
+    std::vector< Vector3D > result;
+    result.reserve( crystal_structure.natoms() * crystal_structure.space_group().nsymmetry_operators() );
+    const std::vector< Vector3D > & positions = crystal_structure.atom_positions();
+    for ( size_t i( 0 ); i != crystal_structure.natoms(); ++i )
+    {
+        const Vector3D & position = positions[i];
+        for ( size_t k( 0 ); k != crystal_structure.space_group().nsymmetry_operators(); ++k )
+            result.push_back( crystal_structure.space_group().symmetry_operator( k ) * position );
+    }
+    return result;
+}
+
+// ********************************************************************************
+
+// All atoms j > i closer than the cutoff to atom i, taking all space-group symmetry operators into account.
+// For each atom j only the closest image is returned.
+std::vector< NeighbourPair > symmetry_neighbours( const CrystalStructure & crystal_structure, const NeighbourSearch & neighbour_search, const size_t i )
+{
+    const size_t nsymmetry_operators = crystal_structure.space_group().nsymmetry_operators();
+    std::vector< NeighbourPair > images = neighbour_search.neighbours( crystal_structure.atom( i ).position() );
+    std::vector< NeighbourPair > result;
+    // The images are sorted by index, so all images of the same atom are adjacent.
+    for ( size_t k( 0 ); k != images.size(); ++k )
+    {
+        size_t j = images[k].j_ / nsymmetry_operators;
+        if ( j <= i )
+            continue;
+        images[k].i_ = i;
+        images[k].j_ = j;
+        if ( ( ! result.empty() ) && ( result.back().j_ == j ) )
+        {
+            if ( images[k].distance2_ < result.back().distance2_ )
+                result.back() = images[k];
+        }
+        else
+            result.push_back( images[k] );
+    }
+    return result;
+}
+
+// ********************************************************************************
+
+// All pairs of bonded atoms i < j, sorted by i and then by j.
+// The difference vectors are the shortest ones, with or without the space-group symmetry operators.
+std::vector< NeighbourPair > bonded_pairs( const CrystalStructure & crystal_structure, const bool include_symmetry_operators )
+{
+    std::vector< NeighbourPair > result;
+    const std::vector< Element > & elements = crystal_structure.atom_elements();
+    double maximum_Van_der_Waals_radius( 0.0 );
+    for ( size_t i( 0 ); i != crystal_structure.natoms(); ++i )
+        maximum_Van_der_Waals_radius = std::max( maximum_Van_der_Waals_radius, elements[i].Van_der_Waals_radius() );
+    // are_bonded() uses half the sum of the two Van der Waals radii.
+    if ( maximum_Van_der_Waals_radius <= 0.0 )
+        return result;
+    std::vector< NeighbourPair > candidates;
+    if ( include_symmetry_operators )
+    {
+        NeighbourSearch neighbour_search( crystal_structure.crystal_lattice(), symmetry_images( crystal_structure ), maximum_Van_der_Waals_radius );
+        for ( size_t i( 0 ); i != crystal_structure.natoms(); ++i )
+        {
+            std::vector< NeighbourPair > neighbours = symmetry_neighbours( crystal_structure, neighbour_search, i );
+            candidates.insert( candidates.end(), neighbours.begin(), neighbours.end() );
+        }
+    }
+    else
+        candidates = NeighbourSearch( crystal_structure.crystal_lattice(), crystal_structure.atom_positions(), maximum_Van_der_Waals_radius ).pairs();
+    for ( size_t k( 0 ); k != candidates.size(); ++k )
+    {
+        if ( are_bonded( elements[ candidates[k].i_ ], elements[ candidates[k].j_ ], candidates[k].distance2_ ) )
+            result.push_back( candidates[k] );
+    }
+    return result;
+}
+
+// ********************************************************************************
+
+// When trial transformations are compared, an atom that has no counterpart within this distance (in Angstrom) contributes the same penalty,
+// however far away it is. This makes the comparison insensitive to a few atoms that do not match at all, e.g. because of disorder.
+const double matching_cutoff( 2.0 );
+
+// ********************************************************************************
+
+// Finds the symmetry operator and shift that best superimpose the non-H atoms of moving, transformed as symmetry_operator * ( position + shift ),
+// onto the atoms of target. The best transformation is the one for which the sum over the non-H atoms of moving of the squared distance
+// to the nearest atom of the same element in target, capped at matching_cutoff^2, is lowest.
+// The target atoms are indexed in a periodic grid, so each trial transformation costs O(N) instead of O(N^2).
+// The trial transformations are tried in order of increasing distance between the transformed centre of mass of moving and the centre of mass of target,
+// so the best transformation is usually found first and the others are abandoned as soon as their partial sum exceeds the best sum.
+void best_superposition( const CrystalStructure & moving,
+                         const CrystalStructure & target,
+                         const SpaceGroup & space_group,
+                         const std::vector< Vector3D > & shifts,
+                         const CrystalLattice & average_lattice,
+                         size_t & best_symmetry_operator,
+                         size_t & best_shift )
+{
+    best_symmetry_operator = 0;
+    best_shift = 0;
+    std::vector< Vector3D > target_positions;
+    std::vector< Element > target_elements;
+    for ( size_t i( 0 ); i != target.natoms(); ++i )
+    {
+        if ( target.atom_elements()[i].is_H_or_D() )
+            continue;
+        target_positions.push_back( target.atom_positions()[i] );
+        target_elements.push_back( target.atom_elements()[i] );
+    }
+    const std::vector< Vector3D > & moving_positions = moving.atom_positions();
+    const std::vector< Element > & moving_elements = moving.atom_elements();
+    std::vector< size_t > moving_atoms;
+    for ( size_t i( 0 ); i != moving.natoms(); ++i )
+    {
+        if ( ! moving_elements[i].is_H_or_D() )
+            moving_atoms.push_back( i );
+    }
+    if ( moving_atoms.empty() || target_positions.empty() )
+        return;
+    NeighbourSearch neighbour_search( average_lattice, target_positions, matching_cutoff );
+    const double penalty = square( matching_cutoff );
+    // Coarse pass: sort the trial transformations by how well they superimpose the centres of mass.
+    const Vector3D com_moving = moving.centre_of_mass( false );
+    const Vector3D com_target = target.centre_of_mass( false );
+    std::vector< std::pair< double, size_t > > trial_transformations;
+    trial_transformations.reserve( space_group.nsymmetry_operators() * shifts.size() );
+    for ( size_t k( 0 ); k != space_group.nsymmetry_operators(); ++k )
+    {
+        for ( size_t m( 0 ); m != shifts.size(); ++m )
+            trial_transformations.push_back( std::make_pair( average_lattice.shortest_distance2( com_target, space_group.symmetry_operator( k ) * ( com_moving + shifts[m] ) ), k * shifts.size() + m ) );
+    }
+    std::stable_sort( trial_transformations.begin(), trial_transformations.end() );
+    double best_sum = std::numeric_limits< double >::max();
+    for ( size_t t( 0 ); t != trial_transformations.size(); ++t )
+    {
+        const size_t k = trial_transformations[t].second / shifts.size();
+        const size_t m = trial_transformations[t].second % shifts.size();
+        const SymmetryOperator symmetry_operator = space_group.symmetry_operator( k );
+        double sum( 0.0 );
+        for ( size_t i( 0 ); i != moving_atoms.size(); ++i )
+        {
+            std::vector< NeighbourPair > neighbours = neighbour_search.neighbours( symmetry_operator * ( moving_positions[ moving_atoms[i] ] + shifts[m] ) );
+            double distance2( penalty );
+            for ( size_t j( 0 ); j != neighbours.size(); ++j )
+            {
+                if ( target_elements[ neighbours[j].j_ ] == moving_elements[ moving_atoms[i] ] )
+                    distance2 = std::min( distance2, neighbours[j].distance2_ );
+            }
+            sum += distance2;
+            if ( sum >= best_sum )
+                break;
+        }
+        if ( sum < best_sum )
+        {
+            best_sum = sum;
+            best_symmetry_operator = k;
+            best_shift = m;
+        }
+    }
+}
+
+// ********************************************************************************
+
+// For each atom of moving, the atom of target that it corresponds to, such that the sum of the squared distances
+// (after transforming moving as symmetry_operator * ( position + shift )) is minimal.
+// Atoms are only matched to atoms of the same element. The assignment is optimal, not greedy, so each atom of target is used exactly once.
+// Pairs further apart than matching_cutoff all have the same cost.
+std::vector< size_t > match_atoms( const CrystalStructure & moving,
+                                   const CrystalStructure & target,
+                                   const SymmetryOperator & symmetry_operator,
+                                   const Vector3D & shift,
+                                   const CrystalLattice & average_lattice )
+{
+    if ( moving.natoms() != target.natoms() )
+        throw std::runtime_error( "match_atoms(): numbers of atoms are not the same." );
+    std::vector< Vector3D > moving_positions;
+    moving_positions.reserve( moving.natoms() );
+    for ( size_t i( 0 ); i != moving.natoms(); ++i )
+        moving_positions.push_back( symmetry_operator * ( moving.atom( i ).position() + shift ) );
+    NeighbourSearch neighbour_search( average_lattice, target.atom_positions(), matching_cutoff );
+    // The atoms are grouped by element, each group is a separate assignment problem.
+    std::vector< size_t > moving_group_indices( moving.natoms() ); // Index of each atom within its group.
+    std::vector< size_t > target_group_indices( target.natoms() );
+    std::vector< std::vector< size_t > > moving_groups;
+    std::vector< std::vector< size_t > > target_groups;
+    std::vector< Element > group_elements;
+    for ( size_t i( 0 ); i != moving.natoms(); ++i )
+    {
+        const size_t g = std::find( group_elements.begin(), group_elements.end(), moving.atom( i ).element() ) - group_elements.begin();
+        if ( g == group_elements.size() )
+        {
+            group_elements.push_back( moving.atom( i ).element() );
+            moving_groups.push_back( std::vector< size_t >() );
+            target_groups.push_back( std::vector< size_t >() );
+        }
+        moving_group_indices[i] = moving_groups[g].size();
+        moving_groups[g].push_back( i );
+    }
+    for ( size_t i( 0 ); i != target.natoms(); ++i )
+    {
+        const size_t g = std::find( group_elements.begin(), group_elements.end(), target.atom( i ).element() ) - group_elements.begin();
+        if ( ( g == group_elements.size() ) || ( target_groups[g].size() == moving_groups[g].size() ) )
+            throw std::runtime_error( "match_atoms(): elements are not the same." );
+        target_group_indices[i] = target_groups[g].size();
+        target_groups[g].push_back( i );
+    }
+    std::vector< size_t > result( moving.natoms() );
+    const double penalty = 4.0 * square( matching_cutoff );
+    for ( size_t g( 0 ); g != group_elements.size(); ++g )
+    {
+        if ( target_groups[g].size() != moving_groups[g].size() )
+            throw std::runtime_error( "match_atoms(): elements are not the same." );
+        std::vector< std::vector< double > > costs( moving_groups[g].size(), std::vector< double >( moving_groups[g].size(), penalty ) );
+        for ( size_t i( 0 ); i != moving_groups[g].size(); ++i )
+        {
+            std::vector< NeighbourPair > neighbours = neighbour_search.neighbours( moving_positions[ moving_groups[g][i] ] );
+            for ( size_t j( 0 ); j != neighbours.size(); ++j )
+            {
+                if ( target.atom( neighbours[j].j_ ).element() == group_elements[g] )
+                    costs[i][ target_group_indices[ neighbours[j].j_ ] ] = neighbours[j].distance2_;
+            }
+        }
+        Mapping mapping = minimum_cost_mapping( costs );
+        for ( size_t i( 0 ); i != moving_groups[g].size(); ++i )
+            result[ moving_groups[g][i] ] = target_groups[g][ mapping[i] ];
+    }
+    return result;
+}
+
+} // namespace
+
 // ********************************************************************************
 
-CrystalStructure::CrystalStructure(): space_group_symmetry_has_been_applied_(false)
+CrystalStructure::CrystalStructure(): space_group_symmetry_has_been_applied_(false), use_label_index_(false)
 {
 }
 
 // ********************************************************************************
 
-Atom CrystalStructure::atom( const size_t i ) const
+const Atom & CrystalStructure::atom( const size_t i ) const
 {
     if ( i >= atoms_.size() )
         throw std::runtime_error( "CrystalStructure::atom( size_t ): i >= atoms_.size()" );
@@ -69,22 +309,46 @@ ChemicalFormula CrystalStructure::chemical_formula() const
 
 // ********************************************************************************
 
+void CrystalStructure::reserve_natoms( const size_t value )
+{
+    atoms_.reserve( value );
+    positions_.reserve( value );
+    elements_.reserve( value );
+    occupancies_.reserve( value );
+    suppressed_.reserve( value );
+}
+
+// ********************************************************************************
+
 void CrystalStructure::add_atom( const Atom & atom )
 {
     atoms_.push_back( atom );
+    positions_.push_back( atom.position() );
+    elements_.push_back( atom.element() );
+    occupancies_.push_back( atom.occupancy() );
     suppressed_.push_back( false );
-    basic_checks();
+    if ( use_label_index_ )
+        add_to_label_index( atoms_.size() - 1 );
 }
 
 // ********************************************************************************
 
 void CrystalStructure::add_atoms( const std::vector< Atom > & atoms )
 {
-    atoms_.reserve( atoms_.size() + atoms.size() );
+    reserve_natoms( atoms_.size() + atoms.size() );
     atoms_.insert( atoms_.end(), atoms.begin(), atoms.end() );
     for ( size_t i( 0 ); i != atoms.size(); ++i )
+    {
+        positions_.push_back( atoms[i].position() );
+        elements_.push_back( atoms[i].element() );
+        occupancies_.push_back( atoms[i].occupancy() );
         suppressed_.push_back( false );
-    basic_checks();
+    }
+    if ( use_label_index_ )
+    {
+        for ( size_t i( atoms_.size() - atoms.size() ); i != atoms_.size(); ++i )
+            add_to_label_index( i );
+    }
 }
 
 // ********************************************************************************
@@ -98,6 +362,8 @@ void CrystalStructure::remove_H_and_D()
             new_atoms.push_back( atom( i ) );
     }
     atoms_ = new_atoms;
+    rebuild_columns();
+    rebuild_label_index();
 }
 
 // ********************************************************************************
@@ -117,21 +383,66 @@ void CrystalStructure::set_global_Uiso( const double Uiso )
 
 void CrystalStructure::set_atom( const size_t i, const Atom & atom )
 {
+    if ( ( ! use_label_index_ ) || ( atoms_[i].label() == atom.label() ) )
+    {
+        atoms_[i] = atom;
+        update_columns( i );
+        return;
+    }
+    const std::string old_label = atoms_[i].label();
     atoms_[i] = atom;
-    basic_checks();
+    update_columns( i );
+    std::unordered_map< std::string, size_t >::iterator it = label_index_.find( old_label );
+    if ( it->second == i )
+    {
+        // Atom i was the first with this label, the next one with the same label (if any) takes its place.
+        label_index_.erase( it );
+        for ( size_t j( i+1 ); j != atoms_.size(); ++j )
+        {
+            if ( atoms_[j].label() == old_label )
+            {
+                label_index_[ old_label ] = j;
+                break;
+            }
+        }
+    }
+    add_to_label_index( i );
 }
 
 // ********************************************************************************
 
 void CrystalStructure::basic_checks() const
 {
-
+    std::vector< Vector3D > positions;
+    positions.reserve( natoms() );
+    for ( size_t i( 0 ); i != natoms(); ++i )
+        positions.push_back( atoms_[i].position() );
+    std::vector< NeighbourPair > overlapping_atoms = NeighbourSearch( crystal_lattice_, positions, 0.5 ).pairs();
+    for ( size_t k( 0 ); k != overlapping_atoms.size(); ++k )
+        std::cout << "CrystalStructure::basic_checks(): warning: atoms " << atoms_[ overlapping_atoms[k].i_ ].label() << " and " << atoms_[ overlapping_atoms[k].j_ ].label() << " are only " << sqrt( overlapping_atoms[k].distance2_ ) << " A apart." << std::endl;
+    std::vector< std::string > labels;
+    labels.reserve( natoms() );
+    for ( size_t i( 0 ); i != natoms(); ++i )
+        labels.push_back( atoms_[i].label() );
+    std::sort( labels.begin(), labels.end() );
+    for ( size_t i( 1 ); i < labels.size(); ++i )
+    {
+        if ( ( labels[i] == labels[i-1] ) && ( ( i == 1 ) || ( labels[i] != labels[i-2] ) ) )
+            std::cout << "CrystalStructure::basic_checks(): warning: atom label " << labels[i] << " is not unique." << std::endl;
+    }
 }
 
 // ********************************************************************************
 
 size_t CrystalStructure::find_label( const std::string & label ) const
 {
+    if ( use_label_index_ )
+    {
+        std::unordered_map< std::string, size_t >::const_iterator it = label_index_.find( label );
+        if ( it == label_index_.end() )
+            return natoms();
+        return it->second;
+    }
     for ( size_t i( 0 ); i != atoms_.size(); ++i )
     {
         if ( atoms_[i].label() == label )
@@ -144,11 +455,9 @@ size_t CrystalStructure::find_label( const std::string & label ) const
 
 size_t CrystalStructure::atom( const std::string & atom_label ) const
 {
-    for ( size_t i( 0 ); i != atoms_.size(); ++i )
-    {
-        if ( atoms_[ i ].label() == atom_label )
-            return i;
-    }
+    size_t i = find_label( atom_label );
+    if ( i != natoms() )
+        return i;
     throw std::runtime_error( "CrystalStructure::atom( const std::string & label ): label >" + atom_label + "< not found." );
 }
 
@@ -158,6 +467,71 @@ void CrystalStructure::make_atom_labels_unique()
 {
     for ( size_t i( 0 ); i != atoms_.size(); ++i )
         atoms_[ i ].set_label( atoms_[ i ].element().symbol() + size_t2string( i ) );
+    rebuild_label_index();
+}
+
+// ********************************************************************************
+
+void CrystalStructure::set_use_label_index( const bool use_label_index )
+{
+    use_label_index_ = use_label_index;
+    rebuild_label_index();
+}
+
+// ********************************************************************************
+
+void CrystalStructure::add_to_label_index( const size_t i )
+{
+    std::pair< std::unordered_map< std::string, size_t >::iterator, bool > result = label_index_.insert( std::make_pair( atoms_[i].label(), i ) );
+    if ( ( ! result.second ) && ( i < result.first->second ) )
+        result.first->second = i;
+}
+
+// ********************************************************************************
+
+void CrystalStructure::rebuild_label_index()
+{
+    label_index_.clear();
+    if ( ! use_label_index_ )
+        return;
+    label_index_.reserve( atoms_.size() );
+    for ( size_t i( 0 ); i != atoms_.size(); ++i )
+        label_index_.insert( std::make_pair( atoms_[i].label(), i ) );
+}
+
+// ********************************************************************************
+
+void CrystalStructure::update_columns( const size_t i )
+{
+    positions_[i] = atoms_[i].position();
+    elements_[i] = atoms_[i].element();
+    occupancies_[i] = atoms_[i].occupancy();
+}
+
+// ********************************************************************************
+
+void CrystalStructure::rebuild_columns()
+{
+    positions_.clear();
+    elements_.clear();
+    occupancies_.clear();
+    positions_.reserve( atoms_.size() );
+    elements_.reserve( atoms_.size() );
+    occupancies_.reserve( atoms_.size() );
+    for ( size_t i( 0 ); i != atoms_.size(); ++i )
+    {
+        positions_.push_back( atoms_[i].position() );
+        elements_.push_back( atoms_[i].element() );
+        occupancies_.push_back( atoms_[i].occupancy() );
+    }
+}
+
+// ********************************************************************************
+
+void CrystalStructure::set_atom_position( const size_t i, const Vector3D & position )
+{
+    atoms_[i].set_position( position );
+    positions_[i] = position;
 }
 
 // ********************************************************************************
@@ -174,21 +548,12 @@ std::set< Element > CrystalStructure::elements() const
 
 void CrystalStructure::list_all_bonds( std::vector< std::string > & labels_1, std::vector< std::string > & labels_2, std::vector< double > & bonds ) const
 {
-    
-    for ( size_t i( 0 ); i != connectivity_table_.size(); ++i )
+    std::vector< NeighbourPair > bonded_atoms = bonded_pairs( *this, false );
+    for ( size_t k( 0 ); k != bonded_atoms.size(); ++k )
     {
-        for ( size_t j( i + 1 ); j != connectivity_table_.size(); ++j )
-        {
-            if ( connectivity_table_.value( i, j ) != 0 )
-            {
-                labels_1.push_back( atom( i ).label() );
-                labels_2.push_back( atom( j ).label() );
-                double distance;
-                Vector3D difference_vector; // @@ This is a bit wasteful...
-                crystal_lattice_.shortest_distance( atom( i ).position(), atom( j ).position(), distance, difference_vector );
-                bonds.push_back( distance );
-            }
-        }
+        labels_1.push_back( atoms_[ bonded_atoms[k].i_ ].label() );
+        labels_2.push_back( atoms_[ bonded_atoms[k].j_ ].label() );
+        bonds.push_back( sqrt( bonded_atoms[k].distance2_ ) );
     }
 }
 
@@ -196,7 +561,31 @@ void CrystalStructure::list_all_bonds( std::vector< std::string > & labels_1, st
 
 void CrystalStructure::list_all_angles( std::vector< std::string > & labels_1, std::vector< std::string > & labels_2, std::vector< std::string > & labels_3, std::vector< double > & angles ) const
 {
-    
+    std::vector< NeighbourPair > bonded_atoms = bonded_pairs( *this, false );
+    // For each atom, its bonded neighbours with the difference vectors (in Cartesian coordinates) pointing away from it.
+    std::vector< std::vector< size_t > > neighbours( natoms() );
+    std::vector< std::vector< Vector3D > > bond_vectors( natoms() );
+    for ( size_t k( 0 ); k != bonded_atoms.size(); ++k )
+    {
+        Vector3D bond_vector = crystal_lattice_.fractional_to_orthogonal( bonded_atoms[k].difference_vector_ );
+        neighbours[ bonded_atoms[k].i_ ].push_back( bonded_atoms[k].j_ );
+        bond_vectors[ bonded_atoms[k].i_ ].push_back( bond_vector );
+        neighbours[ bonded_atoms[k].j_ ].push_back( bonded_atoms[k].i_ );
+        bond_vectors[ bonded_atoms[k].j_ ].push_back( -bond_vector );
+    }
+    for ( size_t i( 0 ); i != natoms(); ++i )
+    {
+        for ( size_t j( 0 ); j != neighbours[i].size(); ++j )
+        {
+            for ( size_t k( j + 1 ); k != neighbours[i].size(); ++k )
+            {
+                labels_1.push_back( atoms_[ neighbours[i][j] ].label() );
+                labels_2.push_back( atoms_[i].label() );
+                labels_3.push_back( atoms_[ neighbours[i][k] ].label() );
+                angles.push_back( angle( bond_vectors[i][j], bond_vectors[i][k] ).value_in_degrees() );
+            }
+        }
+    }
 }
 
 // ********************************************************************************
@@ -206,59 +595,129 @@ void CrystalStructure::reduce_to_asymmetric_unit( const double tolerance )
 {
     std::vector< Atom > new_atoms;
     std::vector< bool > is_duplicate( natoms(), false );
+    NeighbourSearch neighbour_search( crystal_lattice_, symmetry_images( *this ), tolerance );
     for ( size_t i( 0 ); i != natoms(); ++i )
     {
         if ( is_duplicate[i] )
             continue;
-        for ( size_t j( i+1 ); j != natoms(); ++j )
+        std::vector< NeighbourPair > neighbours = symmetry_neighbours( *this, neighbour_search, i );
+        for ( size_t k( 0 ); k != neighbours.size(); ++k )
         {
+            size_t j = neighbours[k].j_;
             if ( is_duplicate[j] )
                 continue;
             if ( atom(i).element() != atom(j).element() )
                 continue;
-            if ( shortest_distance2( atom(i).position(), atom(j).position() ) < square( tolerance ) )
-            {
-                if ( ! nearly_equal( atom(i).occupancy(), atom(j).occupancy() ) )
-                    std::cout << "CrystalStructure::reduce_to_asymmetric_unit(): warning: duplicate atoms have different occupancies." << std::endl;
-                is_duplicate[j] = true;
-            }
+            if ( ! nearly_equal( atom(i).occupancy(), atom(j).occupancy() ) )
+                std::cout << "CrystalStructure::reduce_to_asymmetric_unit(): warning: duplicate atoms have different occupancies." << std::endl;
+            is_duplicate[j] = true;
         }
         new_atoms.push_back( atom(i) );
     }
     atoms_ = new_atoms;
+    rebuild_columns();
+    rebuild_label_index();
     space_group_symmetry_has_been_applied_ = false;
 }
 
 // ********************************************************************************
 
+std::vector< std::vector< size_t > > CrystalStructure::distinct_symmetry_images() const
+{
+    const size_t nsymmetry_operators = space_group_.nsymmetry_operators();
+    std::vector< std::vector< size_t > > result( natoms() );
+    std::vector< Vector3D > images( nsymmetry_operators );
+    std::vector< double > distances2;
+    for ( size_t i( 0 ); i != natoms(); ++i )
+    {
+        const Vector3D & position = atom( i ).position();
+        for ( size_t j( 0 ); j != nsymmetry_operators; ++j )
+            images[j] = space_group_.symmetry_operator( j ) * position;
+        // The operators that map the atom onto itself form its site symmetry.
+        crystal_lattice_.shortest_distances2( position, images, distances2 );
+        size_t site_symmetry_order( 0 );
+        for ( size_t j( 0 ); j != nsymmetry_operators; ++j )
+        {
+            if ( distances2[j] < 0.01 )
+                ++site_symmetry_order;
+        }
+        result[i].reserve( nsymmetry_operators / std::max( site_symmetry_order, static_cast<size_t>( 1 ) ) );
+        result[i].push_back( 0 );
+        for ( size_t j( 1 ); j != nsymmetry_operators; ++j )
+        {
+            if ( distances2[j] < 0.01 )
+                continue;
+            // On a special position, an image can also coincide with an image other than the original atom.
+            bool is_new( true );
+            if ( site_symmetry_order != 1 )
+            {
+                for ( size_t k( 1 ); k != result[i].size(); ++k )
+                {
+                    if ( crystal_lattice_.shortest_distance2( images[ result[i][k] ], images[j] ) < 0.01 )
+                    {
+                        is_new = false;
+                        break;
+                    }
+                }
+            }
+            if ( is_new )
+                result[i].push_back( j );
+        }
+    }
+    return result;
+}
+
+// ********************************************************************************
+
 void CrystalStructure::apply_space_group_symmetry( const bool relable_atoms )
 {
     if ( space_group_symmetry_has_been_applied_ )
+    {
         std::cout << "CrystalStructure::apply_space_group_symmetry(): WARNING: space group has already been applied." << std::endl;
-    std::vector< Atom > atoms;
-    for ( size_t j( 1 ); j != space_group_.nsymmetry_operators(); ++j )
+        return;
+    }
+    const size_t nsymmetry_operators = space_group_.nsymmetry_operators();
+    const size_t noriginal_atoms = natoms();
+    std::vector< std::vector< size_t > > images = distinct_symmetry_images();
+    // is_image[ i * nsymmetry_operators + j ] is true if symmetry operator j generates a distinct image of atom i.
+    std::vector< bool > is_image( noriginal_atoms * nsymmetry_operators, false );
+    size_t nnew_atoms( 0 );
+    for ( size_t i( 0 ); i != noriginal_atoms; ++i )
+    {
+        for ( size_t k( 1 ); k < images[i].size(); ++k )
+            is_image[ i * nsymmetry_operators + images[i][k] ] = true;
+        nnew_atoms += images[i].size() - 1;
+    }
+    std::vector< std::string > label_suffixes( nsymmetry_operators );
+    if ( relable_atoms )
     {
-        for ( size_t i( 0 ); i != natoms(); ++i )
+        for ( size_t j( 1 ); j != nsymmetry_operators; ++j )
+            label_suffixes[j] = "_" + size_t2string( j );
+    }
+    reserve_natoms( noriginal_atoms + nnew_atoms );
+    // Same order as before: all atoms for the first symmetry operator, then all atoms for the second symmetry operator, etc.
+    for ( size_t j( 1 ); j != nsymmetry_operators; ++j )
+    {
+        for ( size_t i( 0 ); i != noriginal_atoms; ++i )
         {
-            Vector3D original_position = atom( i ).position();
-            Vector3D new_position = space_group_.symmetry_operator( j ) * original_position;
-            double distance = crystal_lattice_.shortest_distance( original_position, new_position );
-            // Is it a special position?
-            if ( distance > 0.1 )
+            if ( ! is_image[ i * nsymmetry_operators + j ] )
+                continue;
+            add_atom( atom( i ) );
+            Atom & new_atom = atoms_.back();
+            set_atom_position( natoms() - 1, space_group_.symmetry_operator( j ) * new_atom.position() );
+            if ( new_atom.ADPs_type() == Atom::ANISOTROPIC )
             {
-                Atom new_atom = atom( i );
-                new_atom.set_position( new_position );
-                if ( new_atom.ADPs_type() == Atom::ANISOTROPIC )
-                {
-                    new_atom.set_anisotropic_displacement_parameters( rotate_adps( new_atom.anisotropic_displacement_parameters(), space_group_.symmetry_operator( j ).rotation(), crystal_lattice_ ) );
-                }
-                if ( relable_atoms )
-                    new_atom.set_label( atom( i ).label() + "_" + size_t2string( j ) );
-                atoms.push_back( new_atom );
+                new_atom.set_anisotropic_displacement_parameters( rotate_adps( new_atom.anisotropic_displacement_parameters(), space_group_.symmetry_operator( j ).rotation(), crystal_lattice_ ) );
+            }
+            if ( relable_atoms )
+            {
+                new_atom.set_label( new_atom.label() + label_suffixes[j] );
+                // add_atom() indexed the label of the original atom, which was already there.
+                if ( use_label_index_ )
+                    add_to_label_index( natoms() - 1 );
             }
         }
     }
-    add_atoms( atoms );
     space_group_symmetry_has_been_applied_ = true;
 }
 
@@ -268,48 +727,36 @@ void CrystalStructure::move_atoms_to_form_molecules( const bool include_symmetry
 {
     std::vector< bool > has_been_connected( natoms(), false );
     connectivity_table_ = ConnectivityTable( natoms() );
-    for ( size_t i( 0 ); i != natoms(); ++i )
-    {
-        Atom iAtom = atom( i );
-        for ( size_t j( i+1 ); j != natoms(); ++j )
+    // Moving atoms over lattice translations or symmetry operators does not change which atoms are bonded,
+    // so the bonds can be found once, before anything is moved.
+    std::vector< NeighbourPair > bonded_atoms = bonded_pairs( *this, include_symmetry_operators );
+    for ( size_t k( 0 ); k != bonded_atoms.size(); ++k )
+    {
+        size_t i = bonded_atoms[k].i_;
+        size_t j = bonded_atoms[k].j_;
+        // Add this one to the connectivity table.
+        connectivity_table_.set_value( i, j, 1 );
+        // Move atom j so that it really bonds to atom i
+        // The difference vector must be recalculated if either atom has been moved by a symmetry operator;
+        // it does not change when atoms have been moved by lattice translations.
+        Vector3D difference_vector = bonded_atoms[k].difference_vector_;
+        if ( include_symmetry_operators )
         {
-            Atom jAtom = atom( j );
-            double distance2;
-            if ( include_symmetry_operators )
-                distance2 = shortest_distance2( iAtom.position(), jAtom.position() );
+            double distance;
+            shortest_distance( atoms_[i].position(), atoms_[j].position(), distance, difference_vector );
+        }
+        if ( ! nearly_equal( atoms_[j].position(), atoms_[i].position() + difference_vector ) )
+        {
+            // If we are here, we have to move atom j to connect it to atom i
+            if ( ! has_been_connected[j] )
+                set_atom_position( j, atoms_[i].position() + difference_vector );
+            else if ( ! has_been_connected[i] )
+                set_atom_position( i, atoms_[j].position() - difference_vector );
             else
-                distance2 = crystal_lattice_.shortest_distance2( iAtom.position(), jAtom.position() );
-            if ( are_bonded( iAtom.element(), jAtom.element(), distance2 ) )
-            {
-                // Add this one to the connectivity table.
-                connectivity_table_.set_value( i, j, 1 );
-                // Move atom j so that it really bonds to atom i
-                double distance;
-                Vector3D difference_vector;
-                if ( include_symmetry_operators )
-                    shortest_distance( iAtom.position(), jAtom.position(), distance, difference_vector );
-                else
-                    crystal_lattice_.shortest_distance( iAtom.position(), jAtom.position(), distance, difference_vector );
-                if ( ! nearly_equal( jAtom.position(), iAtom.position() + difference_vector ) )
-                {
-                    // If we are here, we have to move atom j to connect it to atom i
-                    if ( ! has_been_connected[j] )
-                    {
-                        jAtom.set_position( iAtom.position() + difference_vector );
-                        set_atom( j, jAtom );
-                    }
-                    else if ( ! has_been_connected[i] )
-                    {
-                        iAtom.set_position( jAtom.position() - difference_vector );
-                        set_atom( i, iAtom );
-                    }
-                    else
-                        throw std::runtime_error( "CrystalStructure::move_atoms_to_form_molecules(): atoms i and j have both been moved but are not bonded." );
-                }
-                has_been_connected[i] = true;
-                has_been_connected[j] = true;
-            }
+                throw std::runtime_error( "CrystalStructure::move_atoms_to_form_molecules(): atoms i and j have both been moved but are not bonded." );
         }
+        has_been_connected[i] = true;
+        has_been_connected[j] = true;
     }
 }
 
@@ -514,6 +961,7 @@ void CrystalStructure::supercell( const size_t u, const size_t v, const size_t w
     CrystalStructure result;
     result.set_space_group( SpaceGroup() );
     result.set_name( name() );
+    result.set_use_label_index( use_label_index_ );
     CrystalLattice new_crystal_lattice( crystal_lattice_.a() * u, crystal_lattice_.b() * v, crystal_lattice_.c() * w, crystal_lattice_.alpha(), crystal_lattice_.beta(), crystal_lattice_.gamma() );
     result.set_crystal_lattice( new_crystal_lattice );
     result.reserve_natoms( natoms() * u * v * w );
@@ -611,7 +1059,7 @@ void CrystalStructure::transform( const SymmetryOperator & symmetry_operator, co
 void CrystalStructure::position_all_atoms_within_unit_cell()
 {
     for ( size_t i( 0 ); i != atoms_.size(); ++i )
-        atoms_[ i ].set_position( adjust_for_translations( atoms_[ i ].position() ) );
+        set_atom_position( i, adjust_for_translations( atoms_[ i ].position() ) );
 }
 
 // ********************************************************************************
@@ -691,60 +1139,53 @@ void CrystalStructure::pack_crystal( const double probe_radius )
     if ( ! space_group_symmetry_has_been_applied() )
         apply_space_group_symmetry();
     position_all_atoms_within_unit_cell();
-    double margin_a = maximum_radius / crystal_lattice_.a();
-    std::vector< Atom > new_atoms;
-    for ( size_t i( 0 ); i != natoms(); ++i )
-    {
-        if ( atom( i ).position().x() < margin_a )
-        {
-            Atom new_atom( atom( i ) );
-            new_atom.set_position( new_atom.position() + Vector3D( 1.0, 0.0, 0.0 ) );
-            new_atoms.push_back( new_atom );
-        }
-        if ( atom( i ).position().x() > ( 1.0 - margin_a ) )
+    // The margins are measured perpendicular to the faces of the unit cell, a* is the reciprocal of the distance between the bc faces.
+    const double margins[3] = { maximum_radius * crystal_lattice_.a_star(), maximum_radius * crystal_lattice_.b_star(), maximum_radius * crystal_lattice_.c_star() };
+    // For each atom, the translations along a, b and c that bring an image within the margins. Counted first so that
+    // all images can be added in one go; the images along two or three axes (near edges and corners) are included.
+    const size_t noriginal_atoms = natoms();
+    std::vector< signed char > translations( 6 * noriginal_atoms, 0 );
+    size_t nnew_atoms( 0 );
+    for ( size_t i( 0 ); i != noriginal_atoms; ++i )
+    {
+        size_t nimages( 1 );
+        for ( size_t k( 0 ); k != 3; ++k )
         {
-            Atom new_atom( atom( i ) );
-            new_atom.set_position( new_atom.position() - Vector3D( 1.0, 0.0, 0.0 ) );
-            new_atoms.push_back( new_atom );
+            const double x = atom( i ).position().value( k );
+            if ( x < margins[k] )
+                translations[ 6 * i + 2 * k ] = 1;
+            if ( x > ( 1.0 - margins[k] ) )
+                translations[ 6 * i + 2 * k + 1 ] = -1;
+            nimages *= 1 + ( translations[ 6 * i + 2 * k ] != 0 ) + ( translations[ 6 * i + 2 * k + 1 ] != 0 );
         }
+        nnew_atoms += nimages - 1;
     }
-    add_atoms( new_atoms );
-    new_atoms.clear();
-    double margin_b = maximum_radius / crystal_lattice_.b();
-    for ( size_t i( 0 ); i != natoms(); ++i )
+    reserve_natoms( noriginal_atoms + nnew_atoms );
+    for ( size_t i( 0 ); i != noriginal_atoms; ++i )
     {
-        if ( atom( i ).position().y() < margin_b )
-        {
-            Atom new_atom( atom( i ) );
-            new_atom.set_position( new_atom.position() + Vector3D( 0.0, 1.0, 0.0 ) );
-            new_atoms.push_back( new_atom );
-        }
-        if ( atom( i ).position().y() > ( 1.0 - margin_b ) )
+        for ( size_t u( 0 ); u != 3; ++u )
         {
-            Atom new_atom( atom( i ) );
-            new_atom.set_position( new_atom.position() - Vector3D( 0.0, 1.0, 0.0 ) );
-            new_atoms.push_back( new_atom );
-        }
-    }
-    add_atoms( new_atoms );
-    new_atoms.clear();
-    double margin_c = maximum_radius / crystal_lattice_.c();
-    for ( size_t i( 0 ); i != natoms(); ++i )
-    {
-        if ( atom( i ).position().z() < margin_c )
-        {
-            Atom new_atom( atom( i ) );
-            new_atom.set_position( new_atom.position() + Vector3D( 0.0, 0.0, 1.0 ) );
-            new_atoms.push_back( new_atom );
-        }
-        if ( atom( i ).position().z() > ( 1.0 - margin_c ) )
-        {
-            Atom new_atom( atom( i ) );
-            new_atom.set_position( new_atom.position() - Vector3D( 0.0, 0.0, 1.0 ) );
-            new_atoms.push_back( new_atom );
+            if ( ( u != 0 ) && ( translations[ 6 * i + u - 1 ] == 0 ) )
+                continue;
+            for ( size_t v( 0 ); v != 3; ++v )
+            {
+                if ( ( v != 0 ) && ( translations[ 6 * i + 2 + v - 1 ] == 0 ) )
+                    continue;
+                for ( size_t w( 0 ); w != 3; ++w )
+                {
+                    if ( ( w != 0 ) && ( translations[ 6 * i + 4 + w - 1 ] == 0 ) )
+                        continue;
+                    if ( ( u == 0 ) && ( v == 0 ) && ( w == 0 ) )
+                        continue;
+                    Vector3D translation( ( u == 0 ) ? 0 : translations[ 6 * i + u - 1 ],
+                                          ( v == 0 ) ? 0 : translations[ 6 * i + 2 + v - 1 ],
+                                          ( w == 0 ) ? 0 : translations[ 6 * i + 4 + w - 1 ] );
+                    add_atom( atom( i ) );
+                    set_atom_position( natoms() - 1, atoms_.back().position() + translation );
+                }
+            }
         }
     }
-    add_atoms( new_atoms );
 }
 
 // ********************************************************************************
@@ -891,21 +1332,32 @@ size_t CrystalStructure::nearest_atom( const size_t iAtom ) const
 {
     if ( iAtom >= atoms_.size() )
         throw std::runtime_error( "CrystalStructure::nearest_atom(): iAtom > natoms." );
-    double overall_shortest_distance2( 9999.0 * 9999.0 );
-    size_t best_match;
-    Vector3D lhs = atoms_[iAtom].position();
-    for ( size_t i( 0 ); i != atoms_.size(); ++i )
-    {
-        if ( i == iAtom )
-            continue;
-        double distance2 = shortest_distance2( lhs, atoms_[i].position() );
-        if ( distance2 < overall_shortest_distance2 )
+    if ( atoms_.size() < 2 )
+        throw std::runtime_error( "CrystalStructure::nearest_atom(): there is only one atom." );
+    const size_t nsymmetry_operators = space_group_.nsymmetry_operators();
+    std::vector< Vector3D > images = symmetry_images( *this );
+    // Start with a typical bond length and double the search radius until an atom has been found.
+    double cutoff( 2.0 );
+    while ( true )
+    {
+        std::vector< NeighbourPair > neighbours = NeighbourSearch( crystal_lattice_, images, cutoff ).neighbours( atoms_[iAtom].position() );
+        double overall_shortest_distance2( 0.0 );
+        size_t best_match( atoms_.size() );
+        for ( size_t k( 0 ); k != neighbours.size(); ++k )
         {
-            best_match = i;
-            overall_shortest_distance2 = distance2;
+            size_t i = neighbours[k].j_ / nsymmetry_operators;
+            if ( i == iAtom )
+                continue;
+            if ( ( best_match == atoms_.size() ) || ( neighbours[k].distance2_ < overall_shortest_distance2 ) )
+            {
+                best_match = i;
+                overall_shortest_distance2 = neighbours[k].distance2_;
+            }
         }
+        if ( best_match != atoms_.size() )
+            return best_match;
+        cutoff *= 2.0;
     }
-    return best_match;
 }
 
 // ********************************************************************************
@@ -940,7 +1392,7 @@ void CrystalStructure::collapse_supercell( const size_t u, const size_t v, const
         position.set_x( u * position.x() );
         position.set_y( v * position.y() );
         position.set_z( w * position.z() );
-        atoms_[ i ].set_position( position );
+        set_atom_position( i, position );
     }
     position_all_atoms_within_unit_cell();
     CrystalLattice crystal_lattice( crystal_lattice_.a() / u,
@@ -966,7 +1418,7 @@ void CrystalStructure::collapse_supercell( const size_t u, const size_t v, const
                 shortest_distance = shortest_position.length();
             }
         }
-        atoms_[ i ].set_position( shortest_position );
+        set_atom_position( i, shortest_position );
     }
 }
 
@@ -995,7 +1447,7 @@ void CrystalStructure::collapse_supercell( const size_t u, const size_t v, const
         position.set_x( u * position.x() );
         position.set_y( v * position.y() );
         position.set_z( w * position.z() );
-        atoms_[ i ].set_position( position );
+        set_atom_position( i, position );
     }
     position_all_atoms_within_unit_cell();
     CrystalLattice crystal_lattice( crystal_lattice_.a() / u,
@@ -1039,6 +1491,8 @@ void CrystalStructure::collapse_supercell( const size_t u, const size_t v, const
         new_atoms.push_back( Atom( atoms_[ i ].element(), average_position.average(), atoms_[ i ].label() ) );
     }
     atoms_ = new_atoms;
+    rebuild_columns();
+    rebuild_label_index();
 }
 
 // ********************************************************************************
@@ -1066,7 +1520,7 @@ void CrystalStructure::collapse_supercell( const size_t u, const size_t v, const
         position.set_x( u * position.x() );
         position.set_y( v * position.y() );
         position.set_z( w * position.z() );
-        atoms_[ i ].set_position( position );
+        set_atom_position( i, position );
     }
     CrystalLattice crystal_lattice( crystal_lattice_.a() / u,
                                     crystal_lattice_.b() / v,
@@ -1100,6 +1554,8 @@ void CrystalStructure::collapse_supercell( const size_t u, const size_t v, const
         new_atoms.push_back( Atom( atoms_[ i ].element(), average_position.average(), atoms_[ i ].label() ) );
     }
     atoms_ = new_atoms;
+    rebuild_columns();
+    rebuild_label_index();
 }
 
 // ********************************************************************************
@@ -1127,7 +1583,7 @@ void CrystalStructure::collapse_supercell( const size_t u,
         for ( size_t i( 0 ); i != atoms_.size(); ++i )
         {
             Vector3D position = atoms_[ i ].position() - actual_centre + target_centre;
-            atoms_[ i ].set_position( position );
+            set_atom_position( i, position );
         }
     }
     for ( size_t i( 0 ); i != atoms_.size(); ++i )
@@ -1136,7 +1592,7 @@ void CrystalStructure::collapse_supercell( const size_t u,
         position.set_x( u * position.x() );
         position.set_y( v * position.y() );
         position.set_z( w * position.z() );
-        atoms_[ i ].set_position( position );
+        set_atom_position( i, position );
     }
     CrystalLattice crystal_lattice( crystal_lattice_.a() / u,
                                     crystal_lattice_.b() / v,
@@ -1298,14 +1754,22 @@ void CrystalStructure::save_cif( const FileName & file_name ) const
             label = atoms_[i].element().symbol() + size_t2string( i + 1, len, '0' );
         else
             label = atoms_[i].label();
-        text_file_writer.write( label + " " +
-                                     atoms_[i].element().symbol() + " " +
-                                     double2string_pad_plus( atoms_[ i ].position().x(), 5, ' ' ) + " " +
-                                     double2string_pad_plus( atoms_[ i ].position().y(), 5, ' ' ) + " " +
-                                     double2string_pad_plus( atoms_[ i ].position().z(), 5, ' ' ) + " " +
-                                     double2string_2( atoms_[ i ].occupancy(), 4 ) );
+        text_file_writer.write( label );
+        text_file_writer.write( ' ' );
+        text_file_writer.write( atoms_[i].element().symbol() );
+        for ( size_t j( 0 ); j != 3; ++j )
+        {
+            // Same as double2string_pad_plus( value, 5, ' ' ).
+            text_file_writer.write( ( atoms_[ i ].position().value( j ) >= 0.0 ) ? "  " : " " );
+            text_file_writer.write( atoms_[ i ].position().value( j ), 5 );
+        }
+        text_file_writer.write( ' ' );
+        text_file_writer.write( atoms_[ i ].occupancy(), 4 );
         if ( at_least_one_atom_has_isotropic_ADPs )
-            text_file_writer.write( " " + double2string( atoms_[i].Uiso() ) );
+        {
+            text_file_writer.write( ' ' );
+            text_file_writer.write( atoms_[i].Uiso() );
+        }
         if ( at_least_one_atom_has_anisotropic_ADPs )
         {
             if ( atoms_[i].ADPs_type() == Atom::ANISOTROPIC )
@@ -1337,13 +1801,14 @@ void CrystalStructure::save_cif( const FileName & file_name ) const
                 else
                     label = atoms_[i].label();
                 SymmetricMatrix3D Ucif = atoms_[i].anisotropic_displacement_parameters().U_cif( crystal_lattice_ );
-                text_file_writer.write_line( label + " " +
-                                             double2string( Ucif.value( 0, 0 ) ) + " " +
-                                             double2string( Ucif.value( 1, 1 ) ) + " " +
-                                             double2string( Ucif.value( 2, 2 ) ) + " " +
-                                             double2string( Ucif.value( 0, 1 ) ) + " " +
-                                             double2string( Ucif.value( 0, 2 ) ) + " " +
-                                             double2string( Ucif.value( 1, 2 ) ) );
+                text_file_writer.write( label );
+                const size_t indices[6][2] = { { 0, 0 }, { 1, 1 }, { 2, 2 }, { 0, 1 }, { 0, 2 }, { 1, 2 } };
+                for ( size_t j( 0 ); j != 6; ++j )
+                {
+                    text_file_writer.write( ' ' );
+                    text_file_writer.write( Ucif.value( indices[j][0], indices[j][1] ) );
+                }
+                text_file_writer.write_line();
             }
         }
     }
@@ -1358,16 +1823,56 @@ void CrystalStructure::save_cif( const FileName & file_name ) const
 // All these properties must be independent of the presence of 3D coordinates, they are topological attributes.
 void CrystalStructure::calculate_topological_attributes()
 {
+    // The bonds do not depend on whether the atoms have already been moved to form molecules.
+    if ( connectivity_table_.size() != natoms() )
+    {
+        connectivity_table_ = ConnectivityTable( natoms() );
+        std::vector< NeighbourPair > bonded_atoms = bonded_pairs( *this, false );
+        for ( size_t k( 0 ); k != bonded_atoms.size(); ++k )
+            connectivity_table_.set_value( bonded_atoms[k].i_, bonded_atoms[k].j_, 1 );
+    }
+    std::vector< std::vector< size_t > > rings = find_rings( connectivity_table_, 7 );
+    // ring_sizes[i][n] is true if atom i is a member of an n-membered ring.
+    std::vector< std::vector< bool > > ring_sizes( natoms(), std::vector< bool >( 8, false ) );
+    for ( size_t i( 0 ); i != rings.size(); ++i )
+    {
+        for ( size_t j( 0 ); j != rings[i].size(); ++j )
+            ring_sizes[ rings[i][j] ][ rings[i].size() ] = true;
+    }
+    std::vector< bool > is_cyclic = atoms_in_rings( connectivity_table_ );
     for ( size_t i( 0 ); i != natoms(); ++i )
     {
-        Atom new_atom( atoms_[i] );
         std::string topological_attributes;
-        topological_attributes = new_atom.element().symbol();
+        topological_attributes = atoms_[i].element().symbol();
         topological_attributes = pad( topological_attributes, 2 );
-
-
-        new_atom.set_topological_attributes( topological_attributes );
-        this->set_atom( i, new_atom );
+        // Bonded atoms, heaviest first.
+        std::vector< size_t > atomic_numbers;
+        size_t nhydrogen_atoms( 0 );
+        for ( size_t k( 0 ); k != connectivity_table_.nneighbours( i ); ++k )
+        {
+            Element element = atoms_[ connectivity_table_.neighbour( i, k ) ].element();
+            if ( element.is_H_or_D() )
+            {
+                ++nhydrogen_atoms;
+                atomic_numbers.push_back( 1 );
+            }
+            else
+                atomic_numbers.push_back( element.atomic_number() );
+        }
+        std::sort( atomic_numbers.begin(), atomic_numbers.end(), std::greater< size_t >() );
+        topological_attributes += size_t2string( connectivity_table_.nneighbours( i ) );
+        topological_attributes += size_t2string( nhydrogen_atoms );
+        for ( size_t k( 0 ); k != 4; ++k )
+        {
+            if ( k < atomic_numbers.size() )
+                topological_attributes += pad( Element( atomic_numbers[k] ).symbol(), 2 );
+            else
+                topological_attributes += pad( "0", 2 );
+        }
+        for ( size_t n( 3 ); n != 8; ++n )
+            topological_attributes += ring_sizes[i][n] ? "1" : "0";
+        topological_attributes += is_cyclic[i] ? "1" : "0";
+        atoms_[i].set_topological_attributes( topological_attributes );
     }
 }
 
@@ -1450,12 +1955,6 @@ double RMSCD_with_matching( const CrystalStructure & lhs, const CrystalStructure
     // First find all floating axes; these are a problem if there is more than one residue in the asymmetric unit,
     // but we cannot detect that at the moment.
 
-    std::vector< Vector3D > best_matches; // Fractional coordinates, from rhs.
-    best_matches.reserve( natoms );
-    std::vector< size_t > matching_indices; // Indices from rhs.
-    matching_indices.reserve( natoms );
-    // Find closest match
-    std::vector< bool > done( natoms, false );
     // In principle, the two structures could have different space groups,
     // but for the moment they must have the same space group.
     if ( ! same_symmetry_operators( lhs.space_group(), rhs.space_group() ) )
@@ -1480,51 +1979,103 @@ double RMSCD_with_matching( const CrystalStructure & lhs, const CrystalStructure
             }
         }
     }
+    // Each atom may use its own symmetry operator and shift, so all images of all rhs atoms are indexed in a periodic grid.
+    // The image of atom j under symmetry operator k and shift m has index ( j * nsymmetry_operators + k ) * nshifts + m.
+    const size_t nimages_per_atom = space_group.nsymmetry_operators() * shifts.size();
+    std::vector< Vector3D > images;
+    images.reserve( natoms * nimages_per_atom );
+    for ( size_t j( 0 ); j != natoms; ++j )
+    {
+        for ( size_t k( 0 ); k != space_group.nsymmetry_operators(); ++k )
+        {
+            for ( size_t m( 0 ); m != shifts.size(); ++m )
+                images.push_back( space_group.symmetry_operator( k ) * ( rhs.atom( j ).position() + shifts[m] ) );
+        }
+    }
+    NeighbourSearch neighbour_search( average_lattice, images, matching_cutoff );
+    // The closest image of each rhs atom near each lhs atom, only for atoms of the same element.
+    std::vector< std::vector< NeighbourPair > > closest_images( natoms );
     for ( size_t i( 0 ); i != natoms; ++i )
     {
-        double smallest_distance( 10000.0 );
-        Vector3D best_match;
-  //      size_t best_symmetry_operator;
-  //      size_t best_shift;
-        size_t matching_index = natoms + 1;
-        // Loop over atoms.
-        for ( size_t j( 0 ); j != natoms; ++j )
+        std::vector< NeighbourPair > neighbours = neighbour_search.neighbours( lhs.atom( i ).position() );
+        for ( size_t n( 0 ); n != neighbours.size(); ++n )
         {
-            // Check if element the same.
-            if ( lhs.atom( i ).element() != rhs.atom( j ).element() )
+            neighbours[n].j_ /= nimages_per_atom;
+            if ( lhs.atom( i ).element() != rhs.atom( neighbours[n].j_ ).element() )
                 continue;
-            // Loop over symmetry operators.
-            for ( size_t k( 0 ); k != space_group.nsymmetry_operators(); ++k )
+            if ( ( ! closest_images[i].empty() ) && ( closest_images[i].back().j_ == neighbours[n].j_ ) )
             {
-                // Loop over shifts.
-                for ( size_t m( 0 ); m != shifts.size(); ++m )
-                {
-                    // Fractional coordinates.
-                    Vector3D current_position = space_group.symmetry_operator( k ) * ( rhs.atom( j ).position() + shifts[m] );
-                    // Adjust for translations and convert to Cartesian coordinates.
-                    double shortest_distance;
-                    Vector3D difference_vector; // Fractional coordinates.
-                    average_lattice.shortest_distance( lhs.atom( i ).position(), current_position, shortest_distance, difference_vector );
-                    if ( shortest_distance < smallest_distance )
-                    {
-                        smallest_distance = shortest_distance;
-                        matching_index = j;
-                        best_match = lhs.atom( i ).position() + difference_vector;
-                //        best_symmetry_operator = k;
-               //         best_shift = m;
-                    }
-                }
+                if ( neighbours[n].distance2_ < closest_images[i].back().distance2_ )
+                    closest_images[i].back() = neighbours[n];
+            }
+            else
+                closest_images[i].push_back( neighbours[n] );
+        }
+    }
+    // Optimal assignment, per element.
+    std::vector< size_t > matching_indices( natoms, natoms ); // Indices from rhs.
+    std::vector< Element > elements;
+    for ( size_t i( 0 ); i != natoms; ++i )
+    {
+        if ( std::find( elements.begin(), elements.end(), lhs.atom( i ).element() ) == elements.end() )
+            elements.push_back( lhs.atom( i ).element() );
+    }
+    for ( size_t e( 0 ); e != elements.size(); ++e )
+    {
+        std::vector< size_t > lhs_atoms;
+        std::vector< size_t > rhs_atoms;
+        std::vector< size_t > rhs_group_indices( natoms, natoms );
+        for ( size_t i( 0 ); i != natoms; ++i )
+        {
+            if ( lhs.atom( i ).element() == elements[e] )
+                lhs_atoms.push_back( i );
+            if ( rhs.atom( i ).element() == elements[e] )
+            {
+                rhs_group_indices[i] = rhs_atoms.size();
+                rhs_atoms.push_back( i );
             }
         }
-        std::cout << lhs.atom( i ).element().symbol() << " smallest distance = " << smallest_distance << std::endl;
-        if ( done[ matching_index ] && ( ! lhs.atom( i ).element().is_H_or_D() ) )
+        if ( lhs_atoms.size() != rhs_atoms.size() )
+            throw std::runtime_error( "RMSCD_with_matching(): elements are not the same." );
+        std::vector< std::vector< double > > costs( lhs_atoms.size(), std::vector< double >( rhs_atoms.size(), 4.0 * square( matching_cutoff ) ) );
+        for ( size_t i( 0 ); i != lhs_atoms.size(); ++i )
         {
-            std::cout << size_t2string( i ) << std::endl;
-            throw std::runtime_error( "RMSCD_with_matching(): an atom has two matches." );
+            for ( size_t n( 0 ); n != closest_images[ lhs_atoms[i] ].size(); ++n )
+                costs[i][ rhs_group_indices[ closest_images[ lhs_atoms[i] ][n].j_ ] ] = closest_images[ lhs_atoms[i] ][n].distance2_;
+        }
+        Mapping mapping = minimum_cost_mapping( costs );
+        for ( size_t i( 0 ); i != lhs_atoms.size(); ++i )
+            matching_indices[ lhs_atoms[i] ] = rhs_atoms[ mapping[i] ];
+    }
+    // The matching image of each rhs atom, in fractional coordinates.
+    std::vector< Vector3D > best_matches;
+    best_matches.reserve( natoms );
+    for ( size_t i( 0 ); i != natoms; ++i )
+    {
+        const std::vector< NeighbourPair > & neighbours = closest_images[i];
+        size_t n( 0 );
+        while ( ( n != neighbours.size() ) && ( neighbours[n].j_ != matching_indices[i] ) )
+            ++n;
+        if ( n != neighbours.size() )
+        {
+            best_matches.push_back( lhs.atom( i ).position() + neighbours[n].difference_vector_ );
+            continue;
+        }
+        // The two atoms are further apart than the cutoff, search all images.
+        double smallest_distance( std::numeric_limits< double >::max() );
+        Vector3D best_match;
+        for ( size_t k( 0 ); k != nimages_per_atom; ++k )
+        {
+            double distance;
+            Vector3D difference_vector;
+            average_lattice.shortest_distance( lhs.atom( i ).position(), images[ matching_indices[i] * nimages_per_atom + k ], distance, difference_vector );
+            if ( distance < smallest_distance )
+            {
+                smallest_distance = distance;
+                best_match = lhs.atom( i ).position() + difference_vector;
+            }
         }
-        done[ matching_index ] = true;
         best_matches.push_back( best_match );
-        matching_indices.push_back( matching_index );
     }
     // Save cif for this match.
     CrystalStructure reordered_crystal_structure;
@@ -1555,8 +2106,6 @@ SymmetryOperator find_match( const CrystalStructure & lhs, const CrystalStructur
         std::cout << "find_match(): WARNING: unit cells differ." << std::endl;
     if ( natoms == 0 )
         return SymmetryOperator();
-    // Find closest match
-    std::vector< bool > done( natoms, false );
     // In principle, the two structures could have different space groups,
     // but for the moment they must have the same space group.
     if ( ! same_symmetry_operators( lhs.space_group(), rhs.space_group() ) )
@@ -1602,102 +2151,14 @@ SymmetryOperator find_match( const CrystalStructure & lhs, const CrystalStructur
             }
         }
     }
-    std::vector< size_t > symmetry_operators_frequencies( space_group.nsymmetry_operators(), 0 );
-    std::vector< size_t > shifts_frequencies( shifts.size(), 0 );
-    std::vector< size_t > inversion_frequencies( 2, 0 );
-    for ( size_t i( 0 ); i != natoms; ++i )
-    {
-        if ( lhs.atom( i ).element().is_H_or_D() )
-            continue;
-        double smallest_distance( 10000.0 );
-        Vector3D best_match;
-        size_t best_symmetry_operator( 0 ); // Stupid initialisation to silence compiler warnings
-        size_t best_shift( 0 ); // Stupid initialisation to silence compiler warnings
-        size_t matching_index = natoms + 1;
-        // Loop over atoms.
-        for ( size_t j( 0 ); j != natoms; ++j )
-        {
-            // Check if element the same.
-            if ( lhs.atom( i ).element() != rhs.atom( j ).element() )
-                continue;
-            // Loop over symmetry operators.
-            for ( size_t k( 0 ); k != space_group.nsymmetry_operators(); ++k )
-            {
-                // Loop over shifts.
-                for ( size_t m( 0 ); m != shifts.size(); ++m )
-                {
-                    // Fractional coordinates.
-                    Vector3D current_position = space_group.symmetry_operator( k ) * ( rhs.atom( j ).position() + shifts[m] );
-                    // Adjust for translations and convert to Cartesian coordinates.
-                    double shortest_distance;
-                    Vector3D difference_vector; // Fractional coordinates.
-                    average_lattice.shortest_distance( lhs.atom( i ).position(), current_position, shortest_distance, difference_vector );
-                    if ( shortest_distance < smallest_distance )
-                    {
-                        smallest_distance = shortest_distance;
-                        matching_index = j;
-                        best_match = lhs.atom( i ).position() + difference_vector;
-                        best_symmetry_operator = k;
-                        best_shift = m;
-                    }
-                }
-            }
-        }
-        std::cout << lhs.atom( i ).element().symbol() << " smallest distance = " << smallest_distance << std::endl;
-        if ( done[ matching_index ] && ( ! lhs.atom( i ).element().is_H_or_D() ) )
-        {
-            std::cout << "find_match(): an atom has two matches." << std::endl;
-          //  throw std::runtime_error( "find_match(): an atom has two matches." );
-        }
-        done[ matching_index ] = true;
-        std::cout << "Symmetry operator = " << best_symmetry_operator << std::endl;
-        std::cout << "Shift = " << best_shift << std::endl;
-        ++symmetry_operators_frequencies[best_symmetry_operator];
-        ++shifts_frequencies[best_shift];
-    }
-    // Check if there is one and only one symmetry operator that has the greatest frequency
-    size_t most_common_space_group_index = symmetry_operators_frequencies.size();
-    size_t most_common_space_group_frequency = 0;
-    for ( size_t i( 0 ); i != symmetry_operators_frequencies.size(); ++i )
-    {
-        if ( symmetry_operators_frequencies[i] > most_common_space_group_frequency )
-        {
-            most_common_space_group_frequency = symmetry_operators_frequencies[i];
-            most_common_space_group_index = i;
-        }
-    }
-    // Check if any other symmetry operators are ever found
-    for ( size_t i( 0 ); i != symmetry_operators_frequencies.size(); ++i )
-    {
-        if ( i == most_common_space_group_index )
-            continue;
-        if ( symmetry_operators_frequencies[i] != 0 )
-            std::cout << "symmetry_operators_frequencies[" << i << "] = " << symmetry_operators_frequencies[i] << " " << space_group.symmetry_operator( i ).to_string() << std::endl;
-    }
-    // Check if there is one and only one shift that has the greatest frequency.
-    size_t most_common_shift_index = shifts_frequencies.size();
-    size_t most_common_shift_frequency = 0;
-    for ( size_t i( 0 ); i != shifts_frequencies.size(); ++i )
-    {
-        if ( shifts_frequencies[i] > most_common_shift_frequency )
-        {
-            most_common_shift_frequency = shifts_frequencies[i];
-            most_common_shift_index = i;
-        }
-    }
-    // Check if any other shifts are ever found
-    for ( size_t i( 0 ); i != shifts_frequencies.size(); ++i )
-    {
-        if ( i == most_common_shift_index )
-            continue;
-        if ( shifts_frequencies[i] != 0 )
-            std::cout << "shifts_frequencies[" << i << "] = " << shifts_frequencies[i] << " " << shifts[i].to_string() << std::endl;
-    }
-    std::cout << "The most common symmetry operator, with " << most_common_space_group_frequency << " occurrences, is:" << std::endl;
-    std::cout << space_group.symmetry_operator( most_common_space_group_index ).to_string() << std::endl;
-    std::cout << "The most common shift, with " << most_common_shift_frequency << " occurrences, is:" << std::endl;
-    shifts[ most_common_shift_index ].show();
-    SymmetryOperator result( space_group.symmetry_operator( most_common_space_group_index ).rotation(), space_group.symmetry_operator( most_common_space_group_index ).rotation() * shifts[ most_common_shift_index ] + space_group.symmetry_operator( most_common_space_group_index ).translation() );
+    size_t best_symmetry_operator;
+    size_t best_shift;
+    best_superposition( rhs, lhs, space_group, shifts, average_lattice, best_symmetry_operator, best_shift );
+    std::cout << "The best symmetry operator is:" << std::endl;
+    std::cout << space_group.symmetry_operator( best_symmetry_operator ).to_string() << std::endl;
+    std::cout << "The best shift is:" << std::endl;
+    shifts[ best_shift ].show();
+    SymmetryOperator result( space_group.symmetry_operator( best_symmetry_operator ).rotation(), space_group.symmetry_operator( best_symmetry_operator ).rotation() * shifts[ best_shift ] + space_group.symmetry_operator( best_symmetry_operator ).translation() );
     // Apply found transformation to rhs
     Vector3D integer_shifts_2 = lhs.centre_of_mass( false ) - ( result * rhs.centre_of_mass( false ) ); // Fractional coordinates. lhs is the target.
     integer_shifts.clear();
@@ -1706,7 +2167,7 @@ SymmetryOperator find_match( const CrystalStructure & lhs, const CrystalStructur
     integer_shifts.push_back( round_to_int( integer_shifts_2.z() ) );
     std::cout << "Integer shifts are " << integer_shifts[0] << " " << integer_shifts[1] << " " << integer_shifts[2] << std::endl;
     std::cout << "Rotation = " << std::endl;
-    space_group.symmetry_operator( most_common_space_group_index ).rotation().show();
+    space_group.symmetry_operator( best_symmetry_operator ).rotation().show();
     // @@ Can still be off by integer multiples!
     std::cout << "Translation = " << std::endl;
     result.translation().show();
@@ -1895,7 +2356,6 @@ void CrystalStructure::match( const CrystalStructure & rhs, const size_t shift_s
 
 // ********************************************************************************
 
-// Hydrogen / Deuterium is ignored
 void map( const CrystalStructure & to_be_changed, const CrystalStructure & target, const size_t shift_steps, Mapping & mapping, SymmetryOperator & symmetry_operator, std::vector< Vector3D > & translations, const bool allow_inversion, const bool correct_floating_axes )
 {
     bool debug_output( false );
@@ -1914,10 +2374,7 @@ void map( const CrystalStructure & to_be_changed, const CrystalStructure & targe
         throw std::runtime_error( "map( CrystalStructure, CrystalStructure ): chemical formulae are not the same." );
     if ( natoms == 0 )
         return;
-    std::vector< size_t > mapping_temp;
     translations.clear();
-    // Find closest match
-    std::vector< bool > done( natoms, false );
     // First find all floating axes; @@ these are a problem if there is more than one residue in the asymmetric unit,
     // but we cannot detect that at the moment.
     // @@ There is also a bug here for floating axes along a diagonal as found in cubic space groups.
@@ -1945,6 +2402,7 @@ void map( const CrystalStructure & to_be_changed, const CrystalStructure & targe
     // Add all combinations of shifts of 1/shift_steps along a, b and c.
     // If the space group contains centring vectors, do not add shifts that duplicate the centring vectors
     // I checked that this should not upset any floating origin corrections
+    // The zero shift is always kept, even though the centring vectors include the zero vector.
     std::vector< Vector3D > shifts;
     if ( ( shift_steps == 0 ) || ( shift_steps == 1 ) )
         shifts.push_back( floating_axes_correction );
@@ -1960,116 +2418,29 @@ void map( const CrystalStructure & to_be_changed, const CrystalStructure & targe
                 for ( size_t i3( 0 ); i3 != shift_steps; ++i3 )
                 {
                     Vector3D shift( static_cast<double>(i1)/static_cast<double>(shift_steps), static_cast<double>(i2)/static_cast<double>(shift_steps), static_cast<double>(i3)/static_cast<double>(shift_steps) );
-                    if ( ! centring.contains( shift ) )
+                    if ( shift.nearly_zero() || ( ! centring.contains( shift ) ) )
                         shifts.push_back( floating_axes_correction + shift );
                 }
             }
         }
     }
-    std::vector< size_t > symmetry_operators_frequencies( space_group.nsymmetry_operators(), 0 );
-    std::vector< size_t > shifts_frequencies( shifts.size(), 0 );
-    for ( size_t i( 0 ); i != natoms; ++i )
-    {
-        if ( to_be_changed.atom( i ).element().is_H_or_D() )
-            continue;
-        double smallest_distance( 10000.0 );
-        Vector3D best_match;
-        size_t best_symmetry_operator( 0 ); // Stupid initialisation to silence compiler warnings
-        size_t best_shift( 0 ); // Stupid initialisation to silence compiler warnings
-        size_t matching_index = natoms + 1;
-        // Loop over atoms.
-        for ( size_t j( 0 ); j != natoms; ++j )
-        {
-            // Check if element the same.
-            if ( to_be_changed.atom( i ).element() != target.atom( j ).element() )
-                continue;
-            // Loop over symmetry operators.
-            for ( size_t k( 0 ); k != space_group.nsymmetry_operators(); ++k )
-            {
-                // Loop over shifts.
-                for ( size_t m( 0 ); m != shifts.size(); ++m )
-                {
-                    // Fractional coordinates.
-                    Vector3D current_position = space_group.symmetry_operator( k ) * ( to_be_changed.atom( i ).position() + shifts[m] );
-                    // Adjust for translations and convert to Cartesian coordinates.
-                    double shortest_distance;
-                    Vector3D difference_vector; // Fractional coordinates.
-                    average_lattice.shortest_distance( target.atom( j ).position(), current_position, shortest_distance, difference_vector );
-                    if ( shortest_distance < smallest_distance )
-                    {
-                        smallest_distance = shortest_distance;
-                        matching_index = j;
-                        best_symmetry_operator = k;
-                        best_shift = m;
-                    }
-                }
-            }
-        }
-        if ( debug_output )
-            std::cout << to_be_changed.atom( i ).element().symbol() << " smallest distance = " << smallest_distance << std::endl;
-        if ( matching_index == natoms + 1 ) // This is impossible at the moment because we check via the chemical formula that the same elements are found in both structures
-            throw std::runtime_error( "map( CrystalStructure, CrystalStructure ): an atom could not be matched." );
-        if ( done[ matching_index ] )
-        {
-            std::cout << "map( CrystalStructure, CrystalStructure ): an atom has two matches." << std::endl;
-          //  throw std::runtime_error( "map( CrystalStructure, CrystalStructure ): an atom has two matches." );
-        }
-        done[ matching_index ] = true;
-        ++symmetry_operators_frequencies[best_symmetry_operator];
-        ++shifts_frequencies[best_shift];
-        mapping_temp.push_back( matching_index );
-    }
-    // Check if there is one and only one symmetry operator that has the greatest frequency
-    size_t most_common_symmetry_operator_index = symmetry_operators_frequencies.size();
-    size_t most_common_symmetry_operator_frequency = 0;
-    for ( size_t i( 0 ); i != symmetry_operators_frequencies.size(); ++i )
-    {
-        if ( symmetry_operators_frequencies[i] > most_common_symmetry_operator_frequency )
-        {
-            most_common_symmetry_operator_frequency = symmetry_operators_frequencies[i];
-            most_common_symmetry_operator_index = i;
-        }
-    }
-    symmetry_operator = space_group.symmetry_operator( most_common_symmetry_operator_index );
-    // Check if any other symmetry operators are ever found.
-    for ( size_t i( 0 ); i != symmetry_operators_frequencies.size(); ++i )
-    {
-        if ( i == most_common_symmetry_operator_index )
-            continue;
-        if ( symmetry_operators_frequencies[i] != 0 )
-            std::cout << "symmetry_operators_frequencies[" << i << "] = " << symmetry_operators_frequencies[i] << " " << space_group.symmetry_operator( i ).to_string() << std::endl;
-    }
-    // Check if there is one and only one shift that has the greatest frequency.
-    size_t most_common_shift_index = shifts_frequencies.size();
-    size_t most_common_shift_frequency = 0;
-    for ( size_t i( 0 ); i != shifts_frequencies.size(); ++i )
-    {
-        if ( shifts_frequencies[i] > most_common_shift_frequency )
-        {
-            most_common_shift_frequency = shifts_frequencies[i];
-            most_common_shift_index = i;
-        }
-    }
-    // Check if any other shifts are ever found.
-    for ( size_t i( 0 ); i != shifts_frequencies.size(); ++i )
-    {
-        if ( i == most_common_shift_index )
-            continue;
-        if ( shifts_frequencies[i] != 0 )
-            std::cout << "shifts_frequencies[" << i << "] = " << shifts_frequencies[i] << " " << shifts[i].to_string() << std::endl;
-    }
+    size_t best_symmetry_operator;
+    size_t best_shift;
+    best_superposition( to_be_changed, target, space_group, shifts, average_lattice, best_symmetry_operator, best_shift );
+    symmetry_operator = space_group.symmetry_operator( best_symmetry_operator );
     if ( debug_output )
     {
-        std::cout << "The most common symmetry operator, with " << most_common_symmetry_operator_frequency << " occurrences, is:" << std::endl;
+        std::cout << "The best symmetry operator is:" << std::endl;
         std::cout << symmetry_operator.to_string() << std::endl;
-        std::cout << "The most common shift, with " << most_common_shift_frequency << " occurrences, is:" << std::endl;
-        shifts[ most_common_shift_index ].show();
+        std::cout << "The best shift is:" << std::endl;
+        shifts[ best_shift ].show();
     }
-    mapping = Mapping( mapping_temp );
+    // All atoms, including hydrogen atoms, are matched.
+    mapping = Mapping( match_atoms( to_be_changed, target, symmetry_operator, shifts[ best_shift ], average_lattice ) );
     for ( size_t i( 0 ); i != natoms; ++i )
     {
         // Fractional coordinates.
-        Vector3D current_position = symmetry_operator * ( to_be_changed.atom( i ).position() + shifts[most_common_shift_index] );
+        Vector3D current_position = symmetry_operator * ( to_be_changed.atom( i ).position() + shifts[ best_shift ] );
         // Adjust for translations and convert to Cartesian coordinates.
         double shortest_distance;
         Vector3D difference_vector; // Fractional coordinates.
@@ -2077,7 +2448,7 @@ void map( const CrystalStructure & to_be_changed, const CrystalStructure & targe
         // difference_vector is now the shortest distance (vector) with all integer translations factored out.
         // We also know the actual difference vector. The difference between the two is the integer translations.
         Vector3D integer_translations = target.atom( mapping[ i ] ).position() - difference_vector - current_position;
-        translations.push_back( shifts[most_common_shift_index] + inverse( symmetry_operator.rotation() ) * integer_translations );
+        translations.push_back( shifts[ best_shift ] + inverse( symmetry_operator.rotation() ) * integer_translations );
     }
     mapping.invert();
 }
@@ -2097,6 +2468,8 @@ void CrystalStructure::apply_map( const Mapping & mapping, const SymmetryOperato
         new_atoms.push_back( new_atom );
     }
     atoms_ = new_atoms;
+    rebuild_columns();
+    rebuild_label_index();
 }
 
 // ********************************************************************************
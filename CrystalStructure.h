@@ -39,6 +39,8 @@ class Mapping;
 #include "SpaceGroup.h"
 
 #include <set>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 struct SpecialPositionsReport
@@ -73,21 +75,34 @@ public:
 
     size_t natoms() const { return atoms_.size(); }
 
-    Atom atom( const size_t i ) const;
+    // Returns a reference, so no strings or ADPs are copied. The reference is invalidated when atoms are added or removed.
+    const Atom & atom( const size_t i ) const;
 
-    // Returns natoms() when label not found.
+    // Returns natoms() when label not found. If there are duplicate labels, the first atom is returned.
     size_t find_label( const std::string & label ) const;
 
     // Label must be an exact match, i.e. "C11" does not match "C1" and "C1_0" does not match "C1".
     // Zero-based, throws if no match found.
     size_t atom( const std::string & atom_label ) const;
 
-    // This is an expensive method...
-    std::vector< Atom > atoms() const { return atoms_; }
+    const std::vector< Atom > & atoms() const { return atoms_; }
+
+    // The positions (fractional coordinates), elements and occupancies of all atoms as packed arrays, in the same order as atoms(),
+    // for loops that need nothing else. They are kept up to date by all member functions that change atoms.
+    // The references are invalidated when atoms are added or removed.
+    const std::vector< Vector3D > & atom_positions() const { return positions_; }
+    const std::vector< Element > & atom_elements() const { return elements_; }
+    const std::vector< double > & atom_occupancies() const { return occupancies_; }
+
+    // Default: false. When true, a hash index from label to atom makes find_label() and atom( label ) constant time instead of a linear search,
+    // at the cost of one string per atom. The index is kept up to date by all member functions that add, remove or relabel atoms.
+    // read_cif() switches it on, because merging the ADPs requires one look-up per atom.
+    void set_use_label_index( const bool use_label_index );
+    bool use_label_index() const { return use_label_index_; }
     
     ChemicalFormula chemical_formula() const;
 
-    void reserve_natoms( const size_t value ) { atoms_.reserve( value ); suppressed_.reserve( value ); }
+    void reserve_natoms( const size_t value );
     void add_atom( const Atom & atom );
     void add_atoms( const std::vector< Atom > & atoms );
 
@@ -97,7 +112,7 @@ public:
     void set_global_Uiso( const double Uiso );
 
     // Replaces an existing atom, enables making changes to atoms in the crystal
-    // The alternative would have been to make atom(size_t) return a reference.
+    // The alternative would have been to make atom(size_t) return a non-const reference.
     // To keep all other attributes of the atom use something like:
     // Atom new_atom = crystal_structure.atom( i );
     // new_atom.set_X( X_new ); // Change property X to X_new
@@ -109,8 +124,9 @@ public:
     bool suppressed( const size_t i ) const { return suppressed_[i]; }
     void set_suppressed( const size_t i, const bool value ) { suppressed_[i] = value; }
 
-    // Checks if there are overlapping atoms
+    // Checks if there are overlapping atoms (closer than 0.5 A)
     // Checks if any atom labels are duplicate
+    // Only prints warnings. Not called automatically, because adding atoms one by one would become quadratic.
     void basic_checks() const;
 
     void make_atom_labels_unique();
@@ -142,15 +158,20 @@ public:
 
     bool space_group_symmetry_has_been_applied() const { return space_group_symmetry_has_been_applied_; }
 
-    // For each atom, adds all symmetry-related atoms.
-    // If the symmetry-related atom is less than 0.1 A away from the original atom (taking
-    // periodicity into account), it is assumed to be on a special position and the symmetry-related
-    // copy is discarded.
+    // For each atom, the indices of the symmetry operators that generate its distinct images, starting with 0 (the identity).
+    // Two images are considered the same if they are less than 0.1 A apart (taking periodicity into account),
+    // so for an atom on a special position the number of images is the number of symmetry operators
+    // divided by the order of its site symmetry.
+    std::vector< std::vector< size_t > > distinct_symmetry_images() const;
+
+    // For each atom, adds all its distinct symmetry-related images as given by distinct_symmetry_images().
+    // Images that coincide with the original atom or with each other are added only once.
+    // The atoms generated by symmetry operator j are labelled label + "_j".
+    // Ignored, with a warning, when space-group symmetry has already been applied.
     // @@ How is this different from convert_to_P1()? (Space group is not reset...)
     // @@ How is this different from supercell( 1, 1, 1 ) ?
     // @@ If a molecule on a special position is present and it has been expanded and saved to cif by Mercury,
     // this method gives the wrong answer because.
-    // @@ Should this be made such that it can only be applied once? (I.e. is ignored when called again after first call.)
     void apply_space_group_symmetry( const bool relabel_atoms = true );
 
     // Moves atoms, currently only using integer translations, but symmetry operators
@@ -305,11 +326,28 @@ private:
     SpaceGroup space_group_;
     CrystalLattice crystal_lattice_;
     std::vector< Atom > atoms_;
+    // Columns with the positions, elements and occupancies of atoms_.
+    std::vector< Vector3D > positions_;
+    std::vector< Element > elements_;
+    std::vector< double > occupancies_;
     std::vector< MoleculeInCrystal > molecules_;
     std::vector< bool > suppressed_;
     std::string name_;
     bool space_group_symmetry_has_been_applied_;
     ConnectivityTable connectivity_table_;
+    bool use_label_index_;
+    std::unordered_map< std::string, size_t > label_index_; // Label -> index of the first atom with that label, empty if use_label_index_ is false.
+
+    // Atom i has been added or relabelled.
+    void add_to_label_index( const size_t i );
+    // Must be called after atoms_ has been replaced, does nothing if use_label_index_ is false.
+    void rebuild_label_index();
+    // Atom i has been added or changed.
+    void update_columns( const size_t i );
+    // Must be called after atoms_ has been replaced.
+    void rebuild_columns();
+    // Also updates the columns.
+    void set_atom_position( const size_t i, const Vector3D & position );
 };
 
 // Atoms on special positions contribute fractionally if space group has not been applied.
@@ -320,9 +358,13 @@ private:
 double root_mean_square_Cartesian_displacement( const CrystalStructure & lhs, const CrystalStructure & rhs, const bool include_hydrogens );
 
 // This really should not be used any more, use find_match() followed by root_mean_square_Cartesian_displacement();
+// Each atom of rhs may be moved by its own symmetry operator and shift, the atoms are matched by optimal assignment.
 double RMSCD_with_matching( const CrystalStructure & lhs, const CrystalStructure & rhs, const size_t shift_steps, const bool add_inversion, const bool include_hydrogens );
 
 // Hydrogen / Deuterium is ignored
+// The symmetry operator and shift are those that minimise the sum over the non-H atoms of rhs of the squared distance to the nearest atom of the same element of lhs.
+// Each squared distance is capped at ( 2.0 A )^2, so an atom without a counterpart within 2.0 A adds the same fixed penalty however far away it is,
+// and a few atoms that do not match at all (e.g. because of disorder) do not dominate the score. The atoms of lhs are indexed in a periodic grid.
 // What is returned is not necessarily a symmetry operator, it is a combination of a rotation matrix and a translation vector that may or may not correspond to a symmetry operator.
 // Note that symmetry operators are canonicalised and the translational part must always be [0,1>. integer_shifts carries the remainder and is a vector of dimension three in fractional coordinates.
 // To go from rhs to lhs, so rhs is changed and lhs is the target
@@ -331,7 +373,8 @@ double RMSCD_with_matching( const CrystalStructure & lhs, const CrystalStructure
 // @@ currently the result is returned in two variables, perhaps better to simply return the matching crystal structure.
 SymmetryOperator find_match( const CrystalStructure & lhs, const CrystalStructure & rhs, const size_t shift_steps, std::vector< int > & integer_shifts, const bool add_inversion, const bool correct_floating_axes );
 
-// Hydrogen and deuterium are ignored
+// Hydrogen and deuterium are ignored when the symmetry operator and shift are determined, but they are included in the mapping.
+// The mapping is the optimal assignment (same elements only) that minimises the sum of the squared distances.
 // Maybe this should be a class
 void map( const CrystalStructure & to_be_changed, const CrystalStructure & target, const size_t shift_steps, Mapping & mapping, SymmetryOperator & symmetry_operator, std::vector< Vector3D > & translations, const bool allow_inversion, const bool correct_floating_axes );
 
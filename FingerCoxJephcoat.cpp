@@ -30,6 +30,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "Angle.h"
 #include "BasicMathsFunctions.h"
 #include "MathsFunctions.h"
+#include "PeakProfileTable.h"
 
 #include <iostream> // for debugging
 #include <stdexcept>
@@ -97,12 +98,9 @@ std::vector< double > FingerCoxJephcoat::asymmetric_peak( const Angle two_theta,
     if ( two_theta > Angle::angle_90_degrees() )
         throw std::runtime_error( "FingerCoxJephcoat::asymmetric_peak(): two_theta > 90.0." );
     std::vector< double > result( two_phi_values.size(), 0.0 );
-    Angle two_phi_min;
+    Angle two_phi_min = this->two_phi_min( two_theta );
     Angle two_phi_infl;
-    double cosine_argument = two_theta.cosine() * sqrt( square( A_ + B_ ) + 1.0 );
-    if ( cosine_argument < 1.0 )
-        two_phi_min = arccosine( cosine_argument );
-    cosine_argument = two_theta.cosine() * sqrt( square( A_ - B_ ) + 1.0 );
+    double cosine_argument = two_theta.cosine() * sqrt( square( A_ - B_ ) + 1.0 );
     if ( cosine_argument < 1.0 )
         two_phi_infl = arccosine( cosine_argument );
     for ( size_t i( 0 ); i != two_phi_values.size(); ++i )
@@ -137,6 +135,68 @@ std::vector< double > FingerCoxJephcoat::asymmetric_peak( const Angle two_theta,
 
 // ********************************************************************************
 
+std::vector< double > FingerCoxJephcoat::asymmetric_peak( const Angle two_theta, const std::vector< Angle > & two_phi_values, const PeakProfileTable & peak_profile_table ) const
+{
+    if ( two_theta > Angle::angle_90_degrees() )
+        throw std::runtime_error( "FingerCoxJephcoat::asymmetric_peak(): two_theta > 90.0." );
+    if ( ! nearly_equal( peak_profile_table.eta(), eta_ ) )
+        throw std::runtime_error( "FingerCoxJephcoat::asymmetric_peak(): eta of peak profile table is different." );
+    Angle two_phi_min = this->two_phi_min( two_theta );
+    Angle two_phi_infl;
+    double cosine_argument = two_theta.cosine() * sqrt( square( A_ - B_ ) + 1.0 );
+    if ( cosine_argument < 1.0 )
+        two_phi_infl = arccosine( cosine_argument );
+    // The positions and weights of the quadrature points do not depend on 2phi.
+    std::vector< double > delta_n_values( N_ ); // In degrees
+    std::vector< double > terms( N_ );
+    double denominator( 0.0 );
+    for ( size_t j( 0 ); j != N_; ++j )
+    {
+        Angle delta_n = ( two_theta + two_phi_min ) / 2.0 + ( two_theta - two_phi_min ) * x_i_[j] / 2.0;
+        double C = sqrt( ( square( delta_n.cosine() ) / square( two_theta.cosine() ) ) - 1.0 );
+        double term;
+        if ( delta_n < two_phi_infl )
+            term = ( ( A_ + B_ ) / C ) - 1.0;
+        else
+        {
+            if ( A_ < B_ )
+                term = 2.0 * A_ / C;
+            else
+                term = 2.0 * B_ / C;
+        }
+        term *= w_i_[j];
+        term /= delta_n.cosine();
+        delta_n_values[j] = delta_n.value_in_degrees();
+        terms[j] = term;
+        denominator += term;
+    }
+    std::vector< double > result( two_phi_values.size(), 0.0 );
+    for ( size_t i( 0 ); i != two_phi_values.size(); ++i )
+    {
+        if ( two_phi_values[i] > Angle::angle_90_degrees() )
+            throw std::runtime_error( "FingerCoxJephcoat::asymmetric_peak(): two_phi_values[i] > 90.0." );
+        double two_phi = two_phi_values[i].value_in_degrees();
+        double numerator = 0.0;
+        for ( size_t j( 0 ); j != N_; ++j )
+            numerator += terms[j] * peak_profile_table.value( two_phi - delta_n_values[j] );
+        result[i] = numerator / denominator;
+    }
+    return result;
+}
+
+// ********************************************************************************
+
+Angle FingerCoxJephcoat::two_phi_min( const Angle two_theta ) const
+{
+    Angle result;
+    double cosine_argument = two_theta.cosine() * sqrt( square( A_ + B_ ) + 1.0 );
+    if ( cosine_argument < 1.0 )
+        result = arccosine( cosine_argument );
+    return result;
+}
+
+// ********************************************************************************
+
 std::vector< double > FingerCoxJephcoat::asymmetric_peak_H_is_S( const Angle two_theta, const std::vector< Angle > & two_phi_values, const double FWHM ) const
 {
     if ( two_theta > Angle::angle_90_degrees() )
@@ -29,6 +29,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ********************************************* */
 
 class Angle;
+class PeakProfileTable;
 
 #include <cstddef> // For definition of size_t
 #include <vector>
@@ -72,6 +73,18 @@ public:
     // two_theta is the peak position.
     std::vector< double > asymmetric_peak( const Angle two_theta, const std::vector< Angle > & two_phi_values, const double FWHM ) const;
 
+    // Same, but the pseudo-Voigt is taken from the table, which must have been made with the same eta.
+    // The quadrature points and their weights are calculated once per peak instead of once per 2phi value,
+    // so no transcendental functions are evaluated per 2phi value.
+    // The peak is zero outside [ two_phi_min( two_theta ) - peak_profile_table.half_width(), two_theta + peak_profile_table.half_width() ],
+    // so two_phi_values should be restricted to that window.
+    std::vector< double > asymmetric_peak( const Angle two_theta, const std::vector< Angle > & two_phi_values, const PeakProfileTable & peak_profile_table ) const;
+
+    // The lower limit of the axial-divergence contribution to the peak at two_theta, the peak then still has to be convoluted with the pseudo-Voigt.
+    Angle two_phi_min( const Angle two_theta ) const;
+
+    double eta() const { return eta_; }
+
     // Sets B = A.
     std::vector< double > asymmetric_peak_H_is_S( const Angle two_theta, const std::vector< Angle > & two_phi_values, const double FWHM ) const;
 
@@ -36,12 +36,14 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "AnalyseTrajectory.h"
 #include "Angle.h"
 #include "AnisotropicDisplacementParameters.h"
+#include "BatchRMSCD.h"
 //#include "BFDH.h"
 #include "BondDetector.h"
 #include "Centring.h"
 #include "ChebyshevBackground.h"
 #include "CheckFoundItem.h"
 #include "ChemicalFormula.h"
+#include "CifArchive.h"
 #include "CollectionOfPoints.h"
 #include "Complex.h"
 #include "Constraints.h"
@@ -76,7 +78,10 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "OrientationalOrderParameters.h"
 #include "Plane.h"
 #include "PowderPattern.h"
+#include "PowderPatternArchive.h"
 #include "PowderPatternCalculator.h"
+#include "PowderPatternCalculatorCache.h"
+#include "PreparedPowderPattern.h"
 #include "RandomNumberGenerator.h"
 #include "ReadCell.h"
 #include "ReadCif.h"
@@ -113,11 +118,14 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "VoidsFinder.h"
 #include "WriteCASTEPFile.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
 #define MACRO_ONE_FILELISTNAME_AS_ARGUMENT \
@@ -1617,6 +1625,7 @@ int main( int argc, char** argv )
         Angle two_theta_step( 0.01, Angle::DEGREES );
         double FWHM( 0.1 );
         PowderPattern powder_pattern_sum( two_theta_start, two_theta_end, two_theta_step );
+        PowderPatternCalculatorCache cache;
         for ( size_t i( 0 ); i != file_list.size(); ++i )
         {
             CrystalStructure crystal_structure;
@@ -1628,6 +1637,7 @@ int main( int argc, char** argv )
             powder_pattern_calculator.set_two_theta_end( two_theta_end );
             powder_pattern_calculator.set_two_theta_step( two_theta_step );
             powder_pattern_calculator.set_FWHM( FWHM );
+            powder_pattern_calculator.set_cache( cache );
             PowderPattern powder_pattern;
             powder_pattern_calculator.calculate( powder_pattern );
             powder_pattern_sum += powder_pattern;
@@ -1889,8 +1899,27 @@ int main( int argc, char** argv )
         MACRO_ONE_CIFFILENAME_AS_ARGUMENT
         crystal_structure.apply_space_group_symmetry();
         double probe_radius = 1.75;
-        double volume = find_voids( crystal_structure, probe_radius );
+        VoidsReport voids_report = find_voids_on_grid( crystal_structure, probe_radius );
+        double volume = voids_report.total_void_volume_;
         std::cout << double2string( volume ) + " " + double2string( volume / crystal_structure.space_group().nsymmetry_operators() ) << std::endl;
+        size_t npockets( 0 );
+        for ( size_t i( 0 ); i != voids_report.void_volumes_.size(); ++i )
+        {
+            if ( voids_report.void_dimensionalities_[i] == 0 )
+                ++npockets;
+        }
+        std::cout << "Number of voids = " << size_t2string( voids_report.void_volumes_.size() ) << ", of which " << size_t2string( npockets ) << " isolated pockets" << std::endl;
+        for ( size_t i( 0 ); i != voids_report.void_volumes_.size(); ++i )
+        {
+            std::string description( "isolated pocket" );
+            if ( voids_report.void_dimensionalities_[i] == 1 )
+                description = "channel";
+            else if ( voids_report.void_dimensionalities_[i] == 2 )
+                description = "layer";
+            else if ( voids_report.void_dimensionalities_[i] == 3 )
+                description = "three-dimensional network";
+            std::cout << double2string( voids_report.void_volumes_[i] ) << " " << description << std::endl;
+        }
     MACRO_END_GAME
 
     try // Find voids for a list of files.
@@ -2381,7 +2410,6 @@ int main( int argc, char** argv )
         CrystalStructure target_crystal_structure;
         std::cout << "Now reading cif... " + input_file_name_1.full_name() << std::endl;
         read_cif( input_file_name_1, target_crystal_structure );
-        target_crystal_structure.apply_space_group_symmetry();
 
         FileName input_file_name_2( argv[ 2 ] );
         CrystalStructure crystal_structure;
@@ -2437,7 +2465,6 @@ int main( int argc, char** argv )
                     new_atom.set_position( current_position );
                     new_crystal_structure.set_atom( i, new_atom );
                 }
-                new_crystal_structure.apply_space_group_symmetry();
                 PowderPatternCalculator powder_pattern_calculator( new_crystal_structure );
                 powder_pattern_calculator.set_two_theta_start( two_theta_start );
                 powder_pattern_calculator.set_two_theta_end( two_theta_end );
@@ -4046,6 +4073,30 @@ int main( int argc, char** argv )
         powder_pattern.save_xye( replace_extension( input_file_name, "xye" ), true );
     MACRO_END_GAME
 
+    try // Convert powder patterns in a file list (.xye, .xrdml, .raw, .mdi, .txt, .cif) to one binary .ppa archive.
+    {
+        MACRO_ONE_FILELISTNAME_OR_LIST_OF_FILES_AS_ARGUMENT
+        PowderPatternArchiveWriter powder_pattern_archive_writer( FileName( "PowderPatterns.ppa" ), PowderPatternArchive::FLOAT );
+        for ( size_t i( 0 ); i != file_list.size(); ++i )
+        {
+            PowderPattern powder_pattern;
+            powder_pattern.read( file_list.value( i ) );
+            powder_pattern_archive_writer.add( powder_pattern );
+        }
+        powder_pattern_archive_writer.close();
+        std::cout << powder_pattern_archive_writer.size() << " powder patterns written to PowderPatterns.ppa" << std::endl;
+    MACRO_END_GAME
+
+    try // Convert all powder patterns in a binary .ppa archive to .xye.
+    {
+        if ( argc != 2 )
+            throw std::runtime_error( "Please give the name of a .ppa file." );
+        FileName input_file_name( argv[ 1 ] );
+        PowderPatternArchive powder_pattern_archive( input_file_name );
+        for ( size_t i( 0 ); i != powder_pattern_archive.size(); ++i )
+            powder_pattern_archive.powder_pattern( i ).save_xye( FileName( input_file_name.directory(), input_file_name.name() + "_" + size_t2string( i, 6, '0' ), "xye" ), true );
+    MACRO_END_GAME
+
     try // Repair XRPD pattern extracted from a .png.
     {
         MACRO_ONE_XYEFILENAME_AS_ARGUMENT
@@ -4223,8 +4274,9 @@ int main( int argc, char** argv )
     {
         MACRO_ONE_CIFFILENAME_AS_ARGUMENT
         crystal_structure.apply_space_group_symmetry();
-        double total_void_volume = void_volume( crystal_structure );
-        std::cout << "Total void volume = " << double2string( total_void_volume ) << std::endl;
+        VolumeEstimate volume_estimate = integrate_void_volume( crystal_structure );
+        double total_void_volume = volume_estimate.volume_;
+        std::cout << "Total void volume = " << double2string( total_void_volume ) << " +/- " << double2string( volume_estimate.standard_error_ ) << " (" << size_t2string( volume_estimate.npoints_ ) << " points)" << std::endl;
         std::cout << "Unit-cell volume = " <<  double2string( crystal_structure.crystal_lattice().volume() ) << std::endl;
         std::cout << "Molecular volume = " << double2string( ( crystal_structure.crystal_lattice().volume() - total_void_volume ) / crystal_structure.space_group().nsymmetry_operators() ) << std::endl;
         std::cout << "Packing coefficient = " << double2string( ( crystal_structure.crystal_lattice().volume() - total_void_volume ) / crystal_structure.crystal_lattice().volume() ) << std::endl;
@@ -4656,6 +4708,9 @@ int main( int argc, char** argv )
             throw std::runtime_error( std::string( "No files in file list " ) + file_list_file_name.full_name() );
         double highest_correlation( 0.0 );
         size_t highest_correlation_index( 0 );
+        // The target is prepared once, which includes its weighted cross-correlation with itself.
+        PreparedPowderPattern prepared_target_powder_pattern( target_powder_pattern, Angle( 1.5, Angle::DEGREES ) );
+        PowderPatternCalculatorCache cache;
         for ( size_t i( 0 ); i != file_list.size(); ++i )
         {
             CrystalStructure crystal_structure;
@@ -4668,11 +4723,12 @@ int main( int argc, char** argv )
             powder_pattern_calculator.set_two_theta_end( two_theta_end );
             powder_pattern_calculator.set_two_theta_step( two_theta_step );
             powder_pattern_calculator.set_FWHM( FWHM );
+            powder_pattern_calculator.set_cache( cache );
             PowderPattern powder_pattern;
             powder_pattern_calculator.calculate_reflection_list(); // F^2 is set to 1.0 by default.
             ReflectionList reflection_list = powder_pattern_calculator.reflection_list();
             powder_pattern_calculator.calculate( reflection_list, powder_pattern );
-            double correlation = normalised_weighted_cross_correlation( target_powder_pattern, powder_pattern, Angle( 1.5, Angle::DEGREES ) );
+            double correlation = normalised_weighted_cross_correlation( prepared_target_powder_pattern, PreparedPowderPattern( powder_pattern, Angle( 1.5, Angle::DEGREES ) ) );
 //            if ( correlation > 0.95 )
 //                text_file_writer.write_line( double2string( correlation ) + " " + size_t2string( i+1 ) );
 //            if ( correlation > highest_correlation )
@@ -4724,7 +4780,6 @@ int main( int argc, char** argv )
         CrystalStructure target_crystal_structure;
         std::cout << "Now reading cif... " + target_file_name.full_name() << std::endl;
         read_cif( target_file_name, target_crystal_structure );
-        target_crystal_structure.apply_space_group_symmetry();
         Angle two_theta_start( 3.0, Angle::DEGREES );
         Angle two_theta_end(  35.0, Angle::DEGREES );
         Angle two_theta_step( 0.01, Angle::DEGREES );
@@ -4754,6 +4809,9 @@ int main( int argc, char** argv )
 //        water_labels.push_back( "O0_2" );
 //        water_labels.push_back( "H0_2" );
 //        water_labels.push_back( "H1_2" );
+        // The target is prepared once, which includes its weighted cross-correlation with itself.
+        PreparedPowderPattern prepared_target_powder_pattern( target_powder_pattern, Angle( 3.0, Angle::DEGREES ) );
+        PowderPatternCalculatorCache cache;
         for ( size_t i( 0 ); i != file_list.size(); ++i )
         {
             CrystalStructure crystal_structure;
@@ -4771,16 +4829,16 @@ int main( int argc, char** argv )
                     crystal_structure.set_atom( iAtom, new_atom );
                 }
             }
-            crystal_structure.apply_space_group_symmetry();
 //            std::cout << "Now calculating powder pattern... " + size_t2string( i, 4, '0' ) << std::endl;
             PowderPatternCalculator powder_pattern_calculator( crystal_structure );
             powder_pattern_calculator.set_two_theta_start( two_theta_start );
             powder_pattern_calculator.set_two_theta_end( two_theta_end );
             powder_pattern_calculator.set_two_theta_step( two_theta_step );
             powder_pattern_calculator.set_FWHM( FWHM );
+            powder_pattern_calculator.set_cache( cache );
             PowderPattern powder_pattern;
             powder_pattern_calculator.calculate( powder_pattern );
-            double correlation = normalised_weighted_cross_correlation( target_powder_pattern, powder_pattern, Angle( 3.0, Angle::DEGREES ) );
+            double correlation = normalised_weighted_cross_correlation( prepared_target_powder_pattern, PreparedPowderPattern( powder_pattern, Angle( 3.0, Angle::DEGREES ) ) );
 //            if ( correlation > 0.95 )
 //                text_file_writer.write_line( double2string( correlation ) + " " + size_t2string( i+1 ) );
             if ( correlation > highest_correlation )
@@ -5577,6 +5635,19 @@ int main( int argc, char** argv )
         MACRO_ONE_FILELISTNAME_OR_LIST_OF_FILES_AS_ARGUMENT
         CorrelationMatrix similarity_matrix = calculate_correlation_matrix( file_list );
         similarity_matrix.save( FileName( "SimilarityMatrix.txt" ) );
+        similarity_matrix.save_binary( FileName( "SimilarityMatrix.bin" ) );
+    MACRO_END_GAME
+
+    try // Calculate similarity matrix for all crystal structures in one .cif file.
+    {
+        if ( argc != 2 )
+            throw std::runtime_error( "Please give the name of a .cif file." );
+        FileName input_file_name( argv[ 1 ] );
+        CifArchive cif_archive( input_file_name );
+        cif_archive.build_index();
+        CorrelationMatrix similarity_matrix = calculate_correlation_matrix( cif_archive );
+        similarity_matrix.save( FileName( "SimilarityMatrix.txt" ) );
+        similarity_matrix.save_binary( FileName( "SimilarityMatrix.bin" ) );
     MACRO_END_GAME
 
     try // Calculate similarity matrix based on unit cells.
@@ -5584,6 +5655,7 @@ int main( int argc, char** argv )
         MACRO_ONE_FILELISTNAME_OR_LIST_OF_FILES_AS_ARGUMENT
         CorrelationMatrix similarity_matrix = calculate_correlation_matrix_1( file_list );
         similarity_matrix.save( FileName( "SimilarityMatrix_1.txt" ) );
+        similarity_matrix.save_binary( FileName( "SimilarityMatrix_1.bin" ) );
     MACRO_END_GAME
 
     try // Average two unit cells and normalise X-H bonds.
@@ -6021,23 +6093,8 @@ int main( int argc, char** argv )
             throw std::runtime_error( std::string( "Error: No files in file list " ) + file_list_file_name_2.full_name() );
         if ( file_list_1.size() != file_list_2.size() )
             throw std::runtime_error( "Error: FileList.txt files do not contain the same number of entries." );
-        TextFileWriter text_file_writer( FileName( file_list_file_name_1.directory(), "RMSCDs", "txt" ) );
-        text_file_writer.write_line( file_list_file_name_1.full_name() );
-        text_file_writer.write_line( file_list_file_name_2.full_name() );
-        for ( size_t fi( 0 ); fi != file_list_1.size(); ++fi )
-        {
-            FileName file_name_1( file_list_1.value( fi ) );
-            CrystalStructure crystal_structure_1;
-            std::cout << "Now reading cif... " + file_name_1.full_name() << std::endl;
-            read_cif( file_name_1, crystal_structure_1 );
-            FileName file_name_2( file_list_2.value( fi ) );
-            CrystalStructure crystal_structure_2;
-            std::cout << "Now reading cif... " + file_name_2.full_name() << std::endl;
-            read_cif( file_name_2, crystal_structure_2 );
-//            double result = RMSCD_with_matching( crystal_structure_1, crystal_structure_2, false );
-            double result = root_mean_square_Cartesian_displacement( crystal_structure_1, crystal_structure_2, false );
-            text_file_writer.write_line( file_list_1.value( fi ).name() + " " + file_list_2.value( fi ).name() + " " + double2string( result ) );
-        }
+        BatchRMSCD batch_RMSCD( file_list_1, file_list_2 );
+        batch_RMSCD.calculate( FileName( file_list_file_name_1.directory(), "RMSCDs", "csv" ) );
     MACRO_END_GAME
 
     try // Reorder atoms by molecule.
@@ -6242,22 +6299,11 @@ int main( int argc, char** argv )
     {
         MACRO_ONE_FILELISTNAME_AS_ARGUMENT
         std::string minimisation_ID( "_mi_TMFF" );
-        TextFileWriter text_file_writer( FileName( file_list_file_name.directory(), "RMSCDs" + minimisation_ID, "txt" ) );
+        std::vector< FileName > minimised_file_names;
         for ( size_t i( 0 ); i != file_list.size(); ++i )
-        {
-            FileName input_file_name( file_list.value( i ) );
-            CrystalStructure crystal_structure_1;
-            read_cif( input_file_name, crystal_structure_1 );
-            CrystalStructure crystal_structure_2;
-            FileName file_name_2( append_to_file_name( input_file_name, minimisation_ID ) );
-            read_cif( file_name_2, crystal_structure_2 );
-            double result = root_mean_square_Cartesian_displacement( crystal_structure_1, crystal_structure_2, false );
-            std::cout << "Structure 1 = " << input_file_name.full_name() << std::endl;
-            std::cout << "Structure 2 = " << file_name_2.full_name() << std::endl;
-            std::cout << result << " A" << std::endl;
-            text_file_writer.write_line( input_file_name.file_name() + " " + double2string( result, 5 ) );
-            std::cout << std::endl;
-        }
+            minimised_file_names.push_back( append_to_file_name( file_list.value( i ), minimisation_ID ) );
+        BatchRMSCD batch_RMSCD( file_list, FileList( minimised_file_names ) );
+        batch_RMSCD.calculate( FileName( file_list_file_name.directory(), "RMSCDs" + minimisation_ID, "csv" ) );
     MACRO_END_GAME
 
     try // RMSCDs of a list of structures and their energy-minimised counterparts. Without matching.
@@ -6265,68 +6311,29 @@ int main( int argc, char** argv )
         MACRO_ONE_FILELISTNAME_AS_ARGUMENT
         {
         std::string minimisation_ID( "_mi_ucfr" );
-        TextFileWriter text_file_writer( FileName( file_list_file_name.directory(), "RMSCDs" + minimisation_ID, "txt" ) );
+        std::vector< FileName > minimised_file_names;
         for ( size_t i( 0 ); i != file_list.size(); ++i )
-        {
-            FileName input_file_name( file_list.value( i ) );
-            CrystalStructure crystal_structure_1;
-            read_cif( input_file_name, crystal_structure_1 );
-//            crystal_structure_1.space_group().show();
-            CrystalStructure crystal_structure_2;
-            FileName file_name_2( append_to_file_name( input_file_name, minimisation_ID ) );
-            read_cif( file_name_2, crystal_structure_2 );
-//            crystal_structure_2.space_group().show();
-            double result = root_mean_square_Cartesian_displacement( crystal_structure_1, crystal_structure_2, false );
-            std::cout << "Structure 1 = " << input_file_name.full_name() << std::endl;
-            std::cout << "Structure 2 = " << file_name_2.full_name() << std::endl;
-            std::cout << result << " A" << std::endl;
-            text_file_writer.write_line( input_file_name.file_name() + " " + double2string( result, 5 ) );
-            std::cout << std::endl;
-        }
+            minimised_file_names.push_back( append_to_file_name( file_list.value( i ), minimisation_ID ) );
+        BatchRMSCD batch_RMSCD( file_list, FileList( minimised_file_names ) );
+        batch_RMSCD.calculate( FileName( file_list_file_name.directory(), "RMSCDs" + minimisation_ID, "csv" ) );
         }
 
         {
         std::string minimisation_ID( "_PBE0_mi_ucfr" );
-        TextFileWriter text_file_writer( FileName( file_list_file_name.directory(), "RMSCDs" + minimisation_ID, "txt" ) );
+        std::vector< FileName > minimised_file_names;
         for ( size_t i( 0 ); i != file_list.size(); ++i )
-        {
-            FileName input_file_name( file_list.value( i ) );
-            CrystalStructure crystal_structure_1;
-            read_cif( input_file_name, crystal_structure_1 );
-//            crystal_structure_1.space_group().show();
-            CrystalStructure crystal_structure_2;
-            FileName file_name_2( append_to_file_name( input_file_name, minimisation_ID ) );
-            read_cif( file_name_2, crystal_structure_2 );
-//            crystal_structure_2.space_group().show();
-            double result = root_mean_square_Cartesian_displacement( crystal_structure_1, crystal_structure_2, false );
-            std::cout << "Structure 1 = " << input_file_name.full_name() << std::endl;
-            std::cout << "Structure 2 = " << file_name_2.full_name() << std::endl;
-            std::cout << result << " A" << std::endl;
-            text_file_writer.write_line( input_file_name.file_name() + " " + double2string( result, 5 ) );
-            std::cout << std::endl;
-        }
+            minimised_file_names.push_back( append_to_file_name( file_list.value( i ), minimisation_ID ) );
+        BatchRMSCD batch_RMSCD( file_list, FileList( minimised_file_names ) );
+        batch_RMSCD.calculate( FileName( file_list_file_name.directory(), "RMSCDs" + minimisation_ID, "csv" ) );
         }
 
         {
         std::string minimisation_ID( "_PBE0_MBD_mi_ucfr" );
-        TextFileWriter text_file_writer( FileName( file_list_file_name.directory(), "RMSCDs" + minimisation_ID, "txt" ) );
+        std::vector< FileName > minimised_file_names;
         for ( size_t i( 0 ); i != file_list.size(); ++i )
-        {
-            FileName input_file_name( file_list.value( i ) );
-            CrystalStructure crystal_structure_1;
-            read_cif( input_file_name, crystal_structure_1 );
-//            crystal_structure_1.space_group().show();
-            CrystalStructure crystal_structure_2;
-            FileName file_name_2( append_to_file_name( input_file_name, minimisation_ID ) );
-            read_cif( file_name_2, crystal_structure_2 );
-//            crystal_structure_2.space_group().show();
-            double result = root_mean_square_Cartesian_displacement( crystal_structure_1, crystal_structure_2, false );
-            std::cout << "Structure 1 = " << input_file_name.full_name() << std::endl;
-            std::cout << "Structure 2 = " << file_name_2.full_name() << std::endl;
-            std::cout << result << " A" << std::endl;
-            text_file_writer.write_line( input_file_name.file_name() + " " + double2string( result, 5 ) );
-            std::cout << std::endl;
-        }
+            minimised_file_names.push_back( append_to_file_name( file_list.value( i ), minimisation_ID ) );
+        BatchRMSCD batch_RMSCD( file_list, FileList( minimised_file_names ) );
+        batch_RMSCD.calculate( FileName( file_list_file_name.directory(), "RMSCDs" + minimisation_ID, "csv" ) );
         }
     MACRO_END_GAME
 
@@ -6374,34 +6381,19 @@ int main( int argc, char** argv )
     try // Split cif with multiple crystal structures.
     {
         FileName file_name( "GF.cif" );
-        TextFileReader text_file_reader_1( file_name );
-        text_file_reader_1.set_skip_empty_lines( true );
-        std::string line;
-        bool more_left = text_file_reader_1.get_next_line( line );
-        text_file_reader_1.push_back_last_line();
-        while ( more_left && text_file_reader_1.get_next_line( line ) )
+        // Only data_ headers that are tokens count, so "data_" inside a text field or a quoted value does not split the file.
+        CifArchive cif_archive( file_name );
+        cif_archive.build_index();
+        for ( size_t i( 0 ); i != cif_archive.size(); ++i )
         {
-            size_t iPos = to_lower( line ).find( "data_" );
-            if ( iPos == std::string::npos )
-            {
-                std::cout << line << std::endl;
-                throw std::runtime_error( "First line does not contain data_ keyword." );
-            }
-            std::string identifier = strip( line.substr( iPos + 5 ) );
+            std::string identifier = cif_archive.name( i );
             FileName output_file_name;
             if ( identifier.empty() )
                 output_file_name = generate_unique_file_name( file_name );
             else
                 output_file_name = FileName( file_name.directory(), identifier, "cif" );
             TextFileWriter text_file_writer( output_file_name );
-            text_file_writer.write_line( line ); // The line containing "data_"
-            more_left = text_file_reader_1.get_next_line( line );
-            while ( more_left && ( to_lower( line ).find( "data_" ) == std::string::npos ) )
-            {
-                text_file_writer.write_line( line );
-                more_left = text_file_reader_1.get_next_line( line );
-            }
-            text_file_reader_1.push_back_last_line();
+            text_file_writer.write( cif_archive.text( i ) );
         }
     MACRO_END_GAME
 
@@ -6994,6 +6986,41 @@ int main( int argc, char** argv )
         reflection_list.save( replace_extension( input_file_name, "txt" ) );
     MACRO_END_GAME
 
+    try // Benchmark PowderPatternCalculator: speed-up as a function of the number of threads.
+    {
+        MACRO_ONE_CIFFILENAME_AS_ARGUMENT
+        PowderPatternCalculator powder_pattern_calculator( crystal_structure );
+        powder_pattern_calculator.set_two_theta_end( Angle::from_degrees( 60.0 ) );
+        size_t max_nthreads = std::thread::hardware_concurrency();
+        if ( max_nthreads == 0 )
+            max_nthreads = 1;
+        const size_t nrepeats( 5 );
+        double time_1_thread( 0.0 );
+        PowderPattern powder_pattern_1_thread;
+        size_t nthreads( 1 );
+        for ( ;; )
+        {
+            powder_pattern_calculator.set_nthreads( nthreads );
+            PowderPattern powder_pattern;
+            std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+            for ( size_t i( 0 ); i != nrepeats; ++i )
+                powder_pattern_calculator.calculate( powder_pattern );
+            double seconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - start_time ).count() / nrepeats;
+            if ( nthreads == 1 )
+            {
+                time_1_thread = seconds;
+                powder_pattern_1_thread = powder_pattern;
+            }
+            double largest_difference( 0.0 );
+            for ( size_t i( 0 ); i != powder_pattern.size(); ++i )
+                largest_difference = std::max( largest_difference, std::abs( powder_pattern.intensity( i ) - powder_pattern_1_thread.intensity( i ) ) );
+            std::cout << nthreads << " threads: " << seconds << " s, speed-up = " << time_1_thread / seconds << ", largest difference with 1 thread = " << largest_difference << std::endl;
+            if ( nthreads == max_nthreads )
+                break;
+            nthreads = std::min( 2 * nthreads, max_nthreads );
+        }
+    MACRO_END_GAME
+
     try // Analyse volumes in .cif file before and after minimisation.
     {
         MACRO_ONE_FILELISTNAME_AS_ARGUMENT
@@ -7833,7 +7860,6 @@ int main( int argc, char** argv )
                 CrystalStructure crystal_structure;
                 std::cout << "Now reading cif... " + file_list.value( iCandidateStructure ).full_name() << std::endl;
                 read_cif( file_list.value( iCandidateStructure ), crystal_structure );
-                crystal_structure.apply_space_group_symmetry();
                 PowderPatternCalculator powder_pattern_calculator( crystal_structure );
                 powder_pattern_calculator.set_two_theta_start( two_theta_start );
                 powder_pattern_calculator.set_two_theta_end( two_theta_end );
@@ -7954,7 +7980,6 @@ int main( int argc, char** argv )
                         CrystalStructure crystal_structure_2;
                         std::cout << "Now reading cif... " + file_list.value( j ).full_name() << std::endl;
                         read_cif( file_list.value( j ), crystal_structure_2 );
-                        crystal_structure_2.apply_space_group_symmetry();
                         PowderPatternCalculator powder_pattern_calculator_2( crystal_structure_2 );
                         powder_pattern_calculator_2.set_two_theta_start( two_theta_start );
                         powder_pattern_calculator_2.set_two_theta_end( two_theta_end );
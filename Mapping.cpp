@@ -28,6 +28,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "Mapping.h"
 #include "Utilities.h"
 
+#include <limits>
 #include <stdexcept>
 
 // ********************************************************************************
@@ -98,3 +99,77 @@ void Mapping::check_consistency() const
 
 // ********************************************************************************
 
+Mapping minimum_cost_mapping( const std::vector< std::vector< double > > & costs )
+{
+    const size_t n = costs.size();
+    for ( size_t i( 0 ); i != n; ++i )
+    {
+        if ( costs[i].size() != n )
+            throw std::runtime_error( "minimum_cost_mapping(): error: matrix of costs must be square." );
+    }
+    // Rows and columns are numbered from 1, column 0 is a dummy column to which the row that is being added is assigned.
+    // u and v are the dual variables (potentials) of the rows and the columns, row_of_column[j] is the row assigned to column j.
+    const double infinity = std::numeric_limits< double >::max();
+    std::vector< double > u( n + 1, 0.0 );
+    std::vector< double > v( n + 1, 0.0 );
+    std::vector< size_t > row_of_column( n + 1, 0 );
+    std::vector< size_t > previous_column( n + 1, 0 );
+    for ( size_t i( 1 ); i != n + 1; ++i )
+    {
+        // Find the shortest augmenting path from row i.
+        row_of_column[0] = i;
+        size_t j0( 0 );
+        std::vector< double > minimum_slack( n + 1, infinity );
+        std::vector< bool > used( n + 1, false );
+        do
+        {
+            used[j0] = true;
+            const size_t i0 = row_of_column[j0];
+            double delta( infinity );
+            size_t j1( 0 );
+            for ( size_t j( 1 ); j != n + 1; ++j )
+            {
+                if ( used[j] )
+                    continue;
+                const double slack = costs[i0-1][j-1] - u[i0] - v[j];
+                if ( slack < minimum_slack[j] )
+                {
+                    minimum_slack[j] = slack;
+                    previous_column[j] = j0;
+                }
+                if ( minimum_slack[j] < delta )
+                {
+                    delta = minimum_slack[j];
+                    j1 = j;
+                }
+            }
+            for ( size_t j( 0 ); j != n + 1; ++j )
+            {
+                if ( used[j] )
+                {
+                    u[ row_of_column[j] ] += delta;
+                    v[j] -= delta;
+                }
+                else
+                    minimum_slack[j] -= delta;
+            }
+            j0 = j1;
+        }
+        while ( row_of_column[j0] != 0 );
+        // Flip the assignments along the augmenting path.
+        do
+        {
+            const size_t j1 = previous_column[j0];
+            row_of_column[j0] = row_of_column[j1];
+            j0 = j1;
+        }
+        while ( j0 != 0 );
+    }
+    std::vector< size_t > result( n );
+    for ( size_t j( 1 ); j != n + 1; ++j )
+        result[ row_of_column[j] - 1 ] = j - 1;
+    return Mapping( result );
+}
+
+// ********************************************************************************
+
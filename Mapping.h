@@ -65,5 +65,9 @@ private:
     void check_consistency() const;
 };
 
+// Solves the assignment problem: returns the one-to-one mapping i -> j that minimises the sum of costs[i][j].
+// costs must be square. Uses the Hungarian algorithm, which is O(n^3).
+Mapping minimum_cost_mapping( const std::vector< std::vector< double > > & costs );
+
 #endif // MAPPING_H
 
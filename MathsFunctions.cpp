@@ -322,6 +322,27 @@ double add_doubles( const std::vector< double > & values )
 
 // ********************************************************************************
 
+double dot_product( const double * lhs, const double * rhs, const size_t n )
+{
+    double sum_0( 0.0 );
+    double sum_1( 0.0 );
+    double sum_2( 0.0 );
+    double sum_3( 0.0 );
+    size_t i( 0 );
+    for ( ; i + 4 <= n; i += 4 )
+    {
+        sum_0 += lhs[i  ] * rhs[i  ];
+        sum_1 += lhs[i+1] * rhs[i+1];
+        sum_2 += lhs[i+2] * rhs[i+2];
+        sum_3 += lhs[i+3] * rhs[i+3];
+    }
+    for ( ; i != n; ++i )
+        sum_0 += lhs[i] * rhs[i];
+    return ( sum_0 + sum_1 ) + ( sum_2 + sum_3 );
+}
+
+// ********************************************************************************
+
 // @@ Not sophisticated enough, but a start.
 // Should use a better algorithm (adding pairwise, for example)
 double add_absolute_doubles( const std::vector< double > & values )
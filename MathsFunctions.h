@@ -166,6 +166,10 @@ double add_absolute_doubles( const std::vector< double > & values );
 // Adds a list of doubles trying to avoid adding very small to very large numbers.
 double add_squared_doubles( const std::vector< double > & values );
 
+// sum_i lhs[i] * rhs[i], with four independent partial sums so that the compiler can pipeline or vectorise the loop.
+// The order of summation is therefore different from a simple loop.
+double dot_product( const double * lhs, const double * rhs, const size_t n );
+
 double calculate_average( const std::vector< double > & values );
 double calculate_minimum( const std::vector< double > & values );
 double calculate_maximum( const std::vector< double > & values );
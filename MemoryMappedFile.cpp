@@ -0,0 +1,176 @@
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include "MemoryMappedFile.h"
+#include "FileName.h"
+
+#include <stdexcept>
+
+#if defined( __unix__ ) || defined( __APPLE__ )
+    #define MEMORYMAPPEDFILE_MMAP
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#else
+    #include <fstream>
+#endif
+
+// ********************************************************************************
+
+MemoryMappedFile::MemoryMappedFile( const FileName & file_name, const Mode mode ):
+mode_(mode),
+size_(0),
+data_(0),
+file_descriptor_(-1)
+{
+    open( file_name, false, 0 );
+}
+
+// ********************************************************************************
+
+MemoryMappedFile::MemoryMappedFile( const FileName & file_name, const size_t size ):
+mode_(READ_WRITE),
+size_(size),
+data_(0),
+file_descriptor_(-1)
+{
+    open( file_name, true, size );
+}
+
+// ********************************************************************************
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+#ifdef MEMORYMAPPEDFILE_MMAP
+    if ( data_ != 0 )
+        munmap( data_, size_ );
+    if ( file_descriptor_ != -1 )
+        close( file_descriptor_ );
+#else
+    try
+    {
+        flush();
+    }
+    catch ( std::exception & e ) {}
+#endif
+}
+
+// ********************************************************************************
+
+char * MemoryMappedFile::writable_data()
+{
+    if ( mode_ != READ_WRITE )
+        throw std::runtime_error( "MemoryMappedFile::writable_data(): Error: file is read-only." );
+    return data_;
+}
+
+// ********************************************************************************
+
+void MemoryMappedFile::flush()
+{
+    if ( mode_ != READ_WRITE )
+        return;
+#ifdef MEMORYMAPPEDFILE_MMAP
+    if ( ( data_ != 0 ) && ( msync( data_, size_, MS_SYNC ) != 0 ) )
+        throw std::runtime_error( "MemoryMappedFile::flush(): Error: could not write file." );
+#else
+    std::ofstream output_file( file_name_.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+    if ( ! output_file )
+        throw std::runtime_error( "MemoryMappedFile::flush(): Error: could not write file " + file_name_ );
+    output_file.write( data_, size_ );
+#endif
+}
+
+// ********************************************************************************
+
+void MemoryMappedFile::open( const FileName & file_name, const bool create, const size_t size )
+{
+    file_name_ = file_name.full_name();
+#ifdef MEMORYMAPPEDFILE_MMAP
+    int flags = ( mode_ == READ_WRITE ) ? O_RDWR : O_RDONLY;
+    if ( create )
+        flags |= O_CREAT | O_TRUNC;
+    file_descriptor_ = ::open( file_name_.c_str(), flags, 0644 );
+    if ( file_descriptor_ == -1 )
+        throw std::runtime_error( "MemoryMappedFile::open(): Error: could not open file " + file_name_ );
+    if ( create )
+    {
+        if ( ftruncate( file_descriptor_, size ) != 0 )
+        {
+            close( file_descriptor_ );
+            file_descriptor_ = -1;
+            throw std::runtime_error( "MemoryMappedFile::open(): Error: could not resize file " + file_name_ );
+        }
+    }
+    else
+    {
+        struct stat file_status;
+        if ( fstat( file_descriptor_, &file_status ) != 0 )
+        {
+            close( file_descriptor_ );
+            file_descriptor_ = -1;
+            throw std::runtime_error( "MemoryMappedFile::open(): Error: could not determine size of file " + file_name_ );
+        }
+        size_ = file_status.st_size;
+    }
+    // mmap() does not accept a length of 0.
+    if ( size_ == 0 )
+        return;
+    int protection = ( mode_ == READ_WRITE ) ? ( PROT_READ | PROT_WRITE ) : PROT_READ;
+    void * address = mmap( 0, size_, protection, MAP_SHARED, file_descriptor_, 0 );
+    if ( address == MAP_FAILED )
+    {
+        close( file_descriptor_ );
+        file_descriptor_ = -1;
+        throw std::runtime_error( "MemoryMappedFile::open(): Error: could not map file " + file_name_ );
+    }
+    data_ = static_cast< char * >( address );
+#else
+    if ( create )
+        buffer_.assign( size, 0 );
+    else
+    {
+        std::ifstream input_file( file_name_.c_str(), std::ios::in | std::ios::binary );
+        if ( ! input_file )
+            throw std::runtime_error( "MemoryMappedFile::open(): Error: could not open file " + file_name_ );
+        input_file.seekg( 0, std::ios::end );
+        size_ = input_file.tellg();
+        input_file.seekg( 0, std::ios::beg );
+        buffer_.resize( size_ );
+        if ( size_ != 0 )
+            input_file.read( &buffer_[0], size_ );
+    }
+    if ( size_ != 0 )
+        data_ = &buffer_[0];
+    if ( create )
+        flush(); // Creates the file
+#endif
+}
+
+// ********************************************************************************
+
@@ -0,0 +1,88 @@
+#ifndef MEMORYMAPPEDFILE_H
+#define MEMORYMAPPEDFILE_H
+
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+class FileName;
+
+#include <cstddef> // For definition of size_t
+#include <string>
+#include <vector>
+
+/*
+  A file that is mapped into memory, so that it can be accessed as one array of bytes without reading it first.
+  Only the pages that are actually accessed are read, by the operating system, so the file can be larger than the available memory.
+  Changes to a read-write mapping are written to the file by the operating system.
+
+  On systems without mmap() (anything other than Unix, Linux or macOS) the file is read into memory instead,
+  and a read-write file is written back in the destructor. This is correct, but the file must then fit into memory.
+
+  Not copyable.
+*/
+class MemoryMappedFile
+{
+public:
+
+    enum Mode { READ_ONLY, READ_WRITE };
+
+    // Maps an existing file. Throws if the file cannot be opened.
+    explicit MemoryMappedFile( const FileName & file_name, const Mode mode = READ_ONLY );
+
+    // Creates a new file of size bytes, all zero, and maps it READ_WRITE. An existing file is overwritten.
+    MemoryMappedFile( const FileName & file_name, const size_t size );
+
+    ~MemoryMappedFile();
+
+    size_t size() const { return size_; }
+    Mode mode() const { return mode_; }
+
+    const char * data() const { return data_; }
+
+    // Throws if the mode is READ_ONLY.
+    char * writable_data();
+
+    // Writes changes to the file now rather than when the operating system sees fit.
+    void flush();
+
+private:
+    Mode mode_;
+    size_t size_;
+    char * data_; // 0 if size_ == 0
+    int file_descriptor_;
+    std::vector< char > buffer_; // Only used without mmap()
+    std::string file_name_;
+
+    void open( const FileName & file_name, const bool create, const size_t size );
+
+    // Not copyable.
+    MemoryMappedFile( const MemoryMappedFile & );
+    MemoryMappedFile & operator=( const MemoryMappedFile & );
+};
+
+#endif // MEMORYMAPPEDFILE_H
+
@@ -60,7 +60,7 @@ public:
     // This should probably be a member function of CrystalStructure: molecule_is_on_special_position( const size_t i );
   //  bool is_on_special_position( const CrystalStructure & crystal_structure ) const;
 
-    Atom atom( const size_t i ) const { return atoms_[i]; }
+    const Atom & atom( const size_t i ) const { return atoms_[i]; }
     
     void set_atom( const size_t i, const Atom & new_atom ) { atoms_[i] = new_atom; }
     
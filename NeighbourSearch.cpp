@@ -0,0 +1,211 @@
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include "NeighbourSearch.h"
+#include "3DCalculations.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace
+{
+
+// Shortest image first.
+bool by_j_and_distance( const NeighbourPair & lhs, const NeighbourPair & rhs )
+{
+    if ( lhs.j_ != rhs.j_ )
+        return lhs.j_ < rhs.j_;
+    return lhs.distance2_ < rhs.distance2_;
+}
+
+// ********************************************************************************
+
+bool same_j( const NeighbourPair & lhs, const NeighbourPair & rhs )
+{
+    return lhs.j_ == rhs.j_;
+}
+
+// ********************************************************************************
+
+// Rounds towards minus infinity.
+int floor_division( const int numerator, const int denominator )
+{
+    int result = numerator / denominator;
+    if ( ( numerator % denominator != 0 ) && ( numerator < 0 ) )
+        --result;
+    return result;
+}
+
+// ********************************************************************************
+
+double wrap( const double x )
+{
+    double result = x - floor( x );
+    // For very small negative numbers, x - floor( x ) can evaluate to exactly 1.0.
+    if ( result >= 1.0 )
+        result = 0.0;
+    return result;
+}
+
+} // namespace
+
+// ********************************************************************************
+
+NeighbourSearch::NeighbourSearch( const CrystalLattice & crystal_lattice, const std::vector< Vector3D > & positions, const double cutoff ):
+fractional_to_orthogonal_matrix_( crystal_lattice.fractional_to_orthogonal_matrix() ),
+cutoff_(cutoff),
+cutoff2_(cutoff*cutoff)
+{
+    if ( cutoff_ <= 0.0 )
+        throw std::runtime_error( "NeighbourSearch::NeighbourSearch(): Error: cutoff must be positive." );
+    positions_.reserve( positions.size() );
+    for ( size_t i( 0 ); i != positions.size(); ++i )
+        positions_.push_back( Vector3D( wrap( positions[i].x() ), wrap( positions[i].y() ), wrap( positions[i].z() ) ) );
+    // The perpendicular width of the unit cell along a is 1/a*.
+    // Two points that are less than the cutoff apart differ by less than a* * cutoff in their fractional x coordinate.
+    // The small margin guards against rounding errors.
+    double fractional_cutoffs[3];
+    fractional_cutoffs[0] = crystal_lattice.a_star() * cutoff_ * ( 1.0 + 1.0E-9 );
+    fractional_cutoffs[1] = crystal_lattice.b_star() * cutoff_ * ( 1.0 + 1.0E-9 );
+    fractional_cutoffs[2] = crystal_lattice.c_star() * cutoff_ * ( 1.0 + 1.0E-9 );
+    for ( size_t i( 0 ); i != 3; ++i )
+        ncells_[i] = std::max( 1, static_cast<int>( std::min( 1.0 / fractional_cutoffs[i], 1024.0 ) ) );
+    // Empty cells only cost time, so there should not be more cells than points.
+    const size_t maximum_ncells = std::max( static_cast<size_t>( 1 ), positions_.size() );
+    while ( static_cast<size_t>( ncells_[0] ) * ncells_[1] * ncells_[2] > maximum_ncells )
+    {
+        size_t largest( 0 );
+        if ( ncells_[1] > ncells_[largest] )
+            largest = 1;
+        if ( ncells_[2] > ncells_[largest] )
+            largest = 2;
+        ncells_[largest] = ( ncells_[largest] + 1 ) / 2;
+    }
+    for ( size_t i( 0 ); i != 3; ++i )
+        search_range_[i] = static_cast<int>( ceil( fractional_cutoffs[i] * ncells_[i] ) );
+    // Counting sort of the points by cell.
+    const size_t ncells = static_cast<size_t>( ncells_[0] ) * ncells_[1] * ncells_[2];
+    std::vector< size_t > cell_indices( positions_.size() );
+    cell_start_ = std::vector< size_t >( ncells + 1, 0 );
+    for ( size_t i( 0 ); i != positions_.size(); ++i )
+    {
+        int u;
+        int v;
+        int w;
+        cell( positions_[i], u, v, w );
+        cell_indices[i] = ( static_cast<size_t>( u ) * ncells_[1] + v ) * ncells_[2] + w;
+        ++cell_start_[ cell_indices[i] + 1 ];
+    }
+    for ( size_t i( 0 ); i != ncells; ++i )
+        cell_start_[i+1] += cell_start_[i];
+    cell_points_ = std::vector< size_t >( positions_.size() );
+    std::vector< size_t > next( cell_start_.begin(), cell_start_.end() - 1 );
+    for ( size_t i( 0 ); i != positions_.size(); ++i )
+        cell_points_[ next[ cell_indices[i] ]++ ] = i;
+}
+
+// ********************************************************************************
+
+std::vector< NeighbourPair > NeighbourSearch::pairs() const
+{
+    std::vector< NeighbourPair > result;
+    for ( size_t i( 0 ); i != positions_.size(); ++i )
+        add_neighbours( positions_[i], i, i + 1, result );
+    return result;
+}
+
+// ********************************************************************************
+
+std::vector< NeighbourPair > NeighbourSearch::neighbours( const Vector3D & point ) const
+{
+    std::vector< NeighbourPair > result;
+    // Difference vectors are displacements, so wrapping the point does not change them.
+    Vector3D wrapped_point( wrap( point.x() ), wrap( point.y() ), wrap( point.z() ) );
+    add_neighbours( wrapped_point, size(), 0, result );
+    return result;
+}
+
+// ********************************************************************************
+
+void NeighbourSearch::cell( const Vector3D & position, int & u, int & v, int & w ) const
+{
+    u = std::min( static_cast<int>( position.x() * ncells_[0] ), ncells_[0] - 1 );
+    v = std::min( static_cast<int>( position.y() * ncells_[1] ), ncells_[1] - 1 );
+    w = std::min( static_cast<int>( position.z() * ncells_[2] ), ncells_[2] - 1 );
+}
+
+// ********************************************************************************
+
+void NeighbourSearch::add_neighbours( const Vector3D & position, const size_t i, const size_t first_j, std::vector< NeighbourPair > & result ) const
+{
+    const size_t old_size = result.size();
+    int u;
+    int v;
+    int w;
+    cell( position, u, v, w );
+    for ( int du( -search_range_[0] ); du <= search_range_[0]; ++du )
+    {
+        const int tu = floor_division( u + du, ncells_[0] );
+        const int cu = u + du - tu * ncells_[0];
+        for ( int dv( -search_range_[1] ); dv <= search_range_[1]; ++dv )
+        {
+            const int tv = floor_division( v + dv, ncells_[1] );
+            const int cv = v + dv - tv * ncells_[1];
+            for ( int dw( -search_range_[2] ); dw <= search_range_[2]; ++dw )
+            {
+                const int tw = floor_division( w + dw, ncells_[2] );
+                const int cw = w + dw - tw * ncells_[2];
+                // When the search range is larger than the number of cells, the same cell is visited more than once, but with a different lattice translation.
+                const Vector3D translation( tu, tv, tw );
+                const size_t c = ( static_cast<size_t>( cu ) * ncells_[1] + cv ) * ncells_[2] + cw;
+                for ( size_t k( cell_start_[c] ); k != cell_start_[c+1]; ++k )
+                {
+                    const size_t j = cell_points_[k];
+                    if ( j < first_j )
+                        continue;
+                    Vector3D difference_vector = positions_[j] + translation - position;
+                    double distance2 = ( fractional_to_orthogonal_matrix_ * difference_vector ).norm2();
+                    if ( distance2 < cutoff2_ )
+                    {
+                        NeighbourPair neighbour_pair;
+                        neighbour_pair.i_ = i;
+                        neighbour_pair.j_ = j;
+                        neighbour_pair.difference_vector_ = difference_vector;
+                        neighbour_pair.distance2_ = distance2;
+                        result.push_back( neighbour_pair );
+                    }
+                }
+            }
+        }
+    }
+    std::sort( result.begin() + old_size, result.end(), by_j_and_distance );
+    result.erase( std::unique( result.begin() + old_size, result.end(), same_j ), result.end() );
+}
+
+// ********************************************************************************
+
@@ -0,0 +1,96 @@
+#ifndef NEIGHBOURSEARCH_H
+#define NEIGHBOURSEARCH_H
+
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include "CrystalLattice.h"
+#include "Matrix3D.h"
+#include "Vector3D.h"
+
+#include <cstddef> // For definition of size_t
+#include <vector>
+
+struct NeighbourPair
+{
+    size_t i_;
+    size_t j_;
+    Vector3D difference_vector_; // Position of the image of j minus position of i, in fractional coordinates.
+    double distance2_; // In Angstrom^2.
+};
+
+/*
+  Finds all pairs of points in a crystal lattice that are closer than a cutoff distance, taking periodicity into account,
+  in near-linear time.
+
+  The points are wrapped into the unit cell and sorted into cells in fractional space. The number of cells
+  along each axis is chosen such that the perpendicular width of a cell (the distance between its two faces,
+  which for a skewed unit cell is smaller than the length of the cell edge) is at least the cutoff,
+  so only the neighbouring cells need to be searched. When the cutoff is larger than the unit cell,
+  the range of cells (and therefore of lattice translations) that is searched is extended accordingly.
+  The number of cells is never larger than the number of points.
+
+  For every pair only the shortest image is returned, so the results are the same as those from
+  CrystalLattice::shortest_distance2() for all pairs that are closer than the cutoff.
+*/
+class NeighbourSearch
+{
+public:
+
+    // positions are fractional coordinates, they do not need to be inside the unit cell.
+    // cutoff is in Angstrom.
+    NeighbourSearch( const CrystalLattice & crystal_lattice, const std::vector< Vector3D > & positions, const double cutoff );
+
+    size_t size() const { return positions_.size(); }
+    double cutoff() const { return cutoff_; }
+
+    // All pairs i < j that are closer than the cutoff, sorted by i and then by j.
+    std::vector< NeighbourPair > pairs() const;
+
+    // All points that are closer than the cutoff to point (in fractional coordinates), sorted by j.
+    // i_ is set to size().
+    std::vector< NeighbourPair > neighbours( const Vector3D & point ) const;
+
+private:
+    Matrix3D fractional_to_orthogonal_matrix_;
+    double cutoff_;
+    double cutoff2_;
+    std::vector< Vector3D > positions_; // Wrapped into [0,1>
+    int ncells_[3];
+    int search_range_[3];
+    std::vector< size_t > cell_start_; // ncells + 1 entries.
+    std::vector< size_t > cell_points_; // Indices of the points, sorted by cell.
+
+    void cell( const Vector3D & position, int & u, int & v, int & w ) const;
+
+    // Adds all points j >= first_j that are closer than the cutoff to position (wrapped into [0,1>),
+    // for each point only the shortest image. The result is sorted by j.
+    void add_neighbours( const Vector3D & position, const size_t i, const size_t first_j, std::vector< NeighbourPair > & result ) const;
+};
+
+#endif // NEIGHBOURSEARCH_H
+
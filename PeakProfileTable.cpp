@@ -0,0 +1,77 @@
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include "PeakProfileTable.h"
+#include "MathsFunctions.h"
+
+#include <stdexcept>
+
+// ********************************************************************************
+
+PeakProfileTable::PeakProfileTable():
+FWHM_(0.0),
+two_theta_step_(0.0),
+oversampling_(1),
+eta_(0.9),
+half_width_(0.0),
+inverse_spacing_(0.0)
+{
+}
+
+// ********************************************************************************
+
+PeakProfileTable::PeakProfileTable( const double FWHM, const double two_theta_step, const size_t oversampling, const double eta ):
+FWHM_(FWHM),
+two_theta_step_(two_theta_step),
+oversampling_(oversampling),
+eta_(eta)
+{
+    if ( FWHM_ <= 0.0 )
+        throw std::runtime_error( "PeakProfileTable::PeakProfileTable(): Error: FWHM must be positive." );
+    if ( two_theta_step_ <= 0.0 )
+        throw std::runtime_error( "PeakProfileTable::PeakProfileTable(): Error: 2theta step must be positive." );
+    if ( oversampling_ == 0 )
+        throw std::runtime_error( "PeakProfileTable::PeakProfileTable(): Error: oversampling must be at least 1." );
+    double spacing = two_theta_step_ / oversampling_;
+    inverse_spacing_ = 1.0 / spacing;
+    // Find number of points out to the right that need to be calculated to reach 0.1% of intensity at 0.0.
+    double I100 = pseudo_Voigt( 0.0, FWHM_, eta_ );
+    values_.push_back( I100 );
+    size_t i( 0 );
+    double value;
+    do
+    {
+        ++i;
+        value = pseudo_Voigt( i * spacing, FWHM_, eta_ );
+        values_.push_back( value );
+    }
+    while ( (I100/1000.0) < value );
+    half_width_ = i * spacing;
+}
+
+// ********************************************************************************
+
@@ -0,0 +1,249 @@
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include "PhaseSumKernel.h"
+
+#include <cmath>
+#include <stdexcept>
+
+#if ! defined( FOURIER_NO_SIMD ) && defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+    #define PHASESUMKERNEL_SIMD
+    #include <immintrin.h>
+#endif
+
+namespace
+{
+
+// The coefficients of the approximation in sincos( Angle, double &, double & ).
+// With x = 2 pi t, B x + C x |x| becomes 8 t - 16 t |t|.
+const double P = 0.225;
+
+// ********************************************************************************
+
+// t is the phase in cycles, i.e. the angle divided by 2 pi.
+inline void sincos_cycles( double t, double & sine, double & cosine )
+{
+    t -= floor( t + 0.5 ); // t is now in [-0.5, 0.5>
+    double y = 8.0 * t - 16.0 * t * fabs( t );
+    sine = P * ( y * fabs( y ) - y ) + y;
+    t += 0.25; // cos(x) = sin(x + pi/2)
+    if ( t > 0.5 )
+        t -= 1.0;
+    y = 8.0 * t - 16.0 * t * fabs( t );
+    cosine = P * ( y * fabs( y ) - y ) + y;
+}
+
+// ********************************************************************************
+
+void phase_sum_scalar( const int h, const int k, const int l,
+                       const double * x, const double * y, const double * z, const double * w, const size_t begin, const size_t n,
+                       double & cosine_sum, double & sine_sum )
+{
+    for ( size_t j( begin ); j < n; ++j )
+    {
+        double sine;
+        double cosine;
+        sincos_cycles( h*x[j] + k*y[j] + l*z[j], sine, cosine );
+        cosine_sum += w[j] * cosine;
+        sine_sum += w[j] * sine;
+    }
+}
+
+#ifdef PHASESUMKERNEL_SIMD
+
+// ********************************************************************************
+
+__attribute__(( target( "avx2,fma" ) ))
+inline __m256d sine_cycles_avx2( const __m256d t )
+{
+    const __m256d sign_mask = _mm256_set1_pd( -0.0 );
+    __m256d y = _mm256_sub_pd( _mm256_mul_pd( _mm256_set1_pd( 8.0 ), t ), _mm256_mul_pd( _mm256_mul_pd( _mm256_set1_pd( 16.0 ), t ), _mm256_andnot_pd( sign_mask, t ) ) );
+    __m256d y_abs_y = _mm256_mul_pd( y, _mm256_andnot_pd( sign_mask, y ) );
+    return _mm256_fmadd_pd( _mm256_set1_pd( P ), _mm256_sub_pd( y_abs_y, y ), y );
+}
+
+// ********************************************************************************
+
+__attribute__(( target( "avx2,fma" ) ))
+void phase_sum_avx2( const int h, const int k, const int l,
+                     const double * x, const double * y, const double * z, const double * w, const size_t n,
+                     double & cosine_sum, double & sine_sum )
+{
+    const __m256d vh = _mm256_set1_pd( h );
+    const __m256d vk = _mm256_set1_pd( k );
+    const __m256d vl = _mm256_set1_pd( l );
+    const __m256d quarter = _mm256_set1_pd( 0.25 );
+    const __m256d half = _mm256_set1_pd( 0.5 );
+    const __m256d one = _mm256_set1_pd( 1.0 );
+    __m256d cosine_sums = _mm256_setzero_pd();
+    __m256d sine_sums = _mm256_setzero_pd();
+    size_t j( 0 );
+    for ( ; j + 4 <= n; j += 4 )
+    {
+        __m256d t = _mm256_add_pd( _mm256_add_pd( _mm256_mul_pd( vh, _mm256_loadu_pd( x + j ) ), _mm256_mul_pd( vk, _mm256_loadu_pd( y + j ) ) ), _mm256_mul_pd( vl, _mm256_loadu_pd( z + j ) ) );
+        t = _mm256_sub_pd( t, _mm256_round_pd( t, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC ) );
+        __m256d sine = sine_cycles_avx2( t );
+        t = _mm256_add_pd( t, quarter );
+        t = _mm256_sub_pd( t, _mm256_and_pd( _mm256_cmp_pd( t, half, _CMP_GT_OQ ), one ) );
+        __m256d cosine = sine_cycles_avx2( t );
+        __m256d weights = _mm256_loadu_pd( w + j );
+        cosine_sums = _mm256_fmadd_pd( weights, cosine, cosine_sums );
+        sine_sums = _mm256_fmadd_pd( weights, sine, sine_sums );
+    }
+    double values[4];
+    _mm256_storeu_pd( values, cosine_sums );
+    cosine_sum += ( values[0] + values[1] ) + ( values[2] + values[3] );
+    _mm256_storeu_pd( values, sine_sums );
+    sine_sum += ( values[0] + values[1] ) + ( values[2] + values[3] );
+    phase_sum_scalar( h, k, l, x, y, z, w, j, n, cosine_sum, sine_sum );
+}
+
+// ********************************************************************************
+
+__attribute__(( target( "avx512f" ) ))
+inline __m512d sine_cycles_avx512( const __m512d t )
+{
+    __m512d y = _mm512_sub_pd( _mm512_mul_pd( _mm512_set1_pd( 8.0 ), t ), _mm512_mul_pd( _mm512_mul_pd( _mm512_set1_pd( 16.0 ), t ), _mm512_abs_pd( t ) ) );
+    __m512d y_abs_y = _mm512_mul_pd( y, _mm512_abs_pd( y ) );
+    return _mm512_fmadd_pd( _mm512_set1_pd( P ), _mm512_sub_pd( y_abs_y, y ), y );
+}
+
+// ********************************************************************************
+
+// Same order of additions as _mm512_reduce_add_pd(), but with zero-masked extracts: in the GCC headers the unmasked
+// extract (also used by _mm512_castpd512_pd256()) starts from _mm256_undefined_pd(), which triggers -Wuninitialized.
+__attribute__(( target( "avx512f" ) ))
+inline double reduce_add_avx512( const __m512d v )
+{
+    __m256d sum4 = _mm256_add_pd( _mm512_maskz_extractf64x4_pd( 0xF, v, 1 ), _mm512_maskz_extractf64x4_pd( 0xF, v, 0 ) );
+    __m128d sum2 = _mm_add_pd( _mm256_extractf128_pd( sum4, 1 ), _mm256_castpd256_pd128( sum4 ) );
+    double values[2];
+    _mm_storeu_pd( values, sum2 );
+    return values[0] + values[1];
+}
+
+// ********************************************************************************
+
+__attribute__(( target( "avx512f" ) ))
+void phase_sum_avx512( const int h, const int k, const int l,
+                       const double * x, const double * y, const double * z, const double * w, const size_t n,
+                       double & cosine_sum, double & sine_sum )
+{
+    const __m512d vh = _mm512_set1_pd( h );
+    const __m512d vk = _mm512_set1_pd( k );
+    const __m512d vl = _mm512_set1_pd( l );
+    const __m512d quarter = _mm512_set1_pd( 0.25 );
+    const __m512d half = _mm512_set1_pd( 0.5 );
+    const __m512d one = _mm512_set1_pd( 1.0 );
+    __m512d cosine_sums = _mm512_setzero_pd();
+    __m512d sine_sums = _mm512_setzero_pd();
+    size_t j( 0 );
+    for ( ; j + 8 <= n; j += 8 )
+    {
+        __m512d t = _mm512_add_pd( _mm512_add_pd( _mm512_mul_pd( vh, _mm512_loadu_pd( x + j ) ), _mm512_mul_pd( vk, _mm512_loadu_pd( y + j ) ) ), _mm512_mul_pd( vl, _mm512_loadu_pd( z + j ) ) );
+        t = _mm512_sub_pd( t, _mm512_maskz_roundscale_pd( 0xFF, t, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC ) );
+        __m512d sine = sine_cycles_avx512( t );
+        t = _mm512_add_pd( t, quarter );
+        t = _mm512_mask_sub_pd( t, _mm512_cmp_pd_mask( t, half, _CMP_GT_OQ ), t, one );
+        __m512d cosine = sine_cycles_avx512( t );
+        __m512d weights = _mm512_loadu_pd( w + j );
+        cosine_sums = _mm512_fmadd_pd( weights, cosine, cosine_sums );
+        sine_sums = _mm512_fmadd_pd( weights, sine, sine_sums );
+    }
+    cosine_sum += reduce_add_avx512( cosine_sums );
+    sine_sum += reduce_add_avx512( sine_sums );
+    phase_sum_scalar( h, k, l, x, y, z, w, j, n, cosine_sum, sine_sum );
+}
+
+#endif // PHASESUMKERNEL_SIMD
+
+} // namespace
+
+// ********************************************************************************
+
+PhaseSumKernel::PhaseSumKernel(): instruction_set_(SCALAR)
+{
+    if ( is_supported( AVX512 ) )
+        instruction_set_ = AVX512;
+    else if ( is_supported( AVX2 ) )
+        instruction_set_ = AVX2;
+}
+
+// ********************************************************************************
+
+PhaseSumKernel::PhaseSumKernel( const InstructionSet instruction_set ): instruction_set_(instruction_set)
+{
+    if ( ! is_supported( instruction_set_ ) )
+        throw std::runtime_error( "PhaseSumKernel::PhaseSumKernel(): Error: instruction set " + instruction_set_to_string( instruction_set_ ) + " is not supported." );
+}
+
+// ********************************************************************************
+
+bool PhaseSumKernel::is_supported( const InstructionSet instruction_set )
+{
+    switch ( instruction_set )
+    {
+        case SCALAR : return true;
+#ifdef PHASESUMKERNEL_SIMD
+        case AVX2   : return __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "fma" );
+        case AVX512 : return __builtin_cpu_supports( "avx512f" );
+#endif
+        default : return false;
+    }
+}
+
+// ********************************************************************************
+
+void PhaseSumKernel::phase_sum( const int h, const int k, const int l,
+                                const double * x, const double * y, const double * z, const double * w, const size_t n,
+                                double & cosine_sum, double & sine_sum ) const
+{
+    switch ( instruction_set_ )
+    {
+#ifdef PHASESUMKERNEL_SIMD
+        case AVX2   : phase_sum_avx2( h, k, l, x, y, z, w, n, cosine_sum, sine_sum ); break;
+        case AVX512 : phase_sum_avx512( h, k, l, x, y, z, w, n, cosine_sum, sine_sum ); break;
+#endif
+        default : phase_sum_scalar( h, k, l, x, y, z, w, 0, n, cosine_sum, sine_sum );
+    }
+}
+
+// ********************************************************************************
+
+std::string instruction_set_to_string( const PhaseSumKernel::InstructionSet instruction_set )
+{
+    switch ( instruction_set )
+    {
+        case PhaseSumKernel::SCALAR : return "scalar";
+        case PhaseSumKernel::AVX2   : return "AVX2";
+        case PhaseSumKernel::AVX512 : return "AVX-512";
+    }
+    return "";
+}
+
+// ********************************************************************************
+
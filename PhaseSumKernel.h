@@ -0,0 +1,75 @@
+#ifndef PHASESUMKERNEL_H
+#define PHASESUMKERNEL_H
+
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include <cstddef> // For definition of size_t
+#include <string>
+
+/*
+  Calculates the phase sums in a structure factor:
+
+      sum_j w_j cos( 2 pi ( h x_j + k y_j + l z_j ) ) and sum_j w_j sin( 2 pi ( h x_j + k y_j + l z_j ) )
+
+  over contiguous arrays of fractional coordinates and weights.
+
+  The sine and cosine are the same fast approximation as sincos( Angle, double &, double & ), which has an error of about 0.001,
+  the vectorised versions agree with the scalar version to within rounding errors.
+  The AVX2 version does four atoms per instruction, the AVX-512 version eight.
+  The default constructor picks the fastest instruction set that the processor supports, this is decided at runtime.
+  Compiling with -DFOURIER_NO_SIMD removes the vectorised versions altogether, which is necessary for compilers
+  other than gcc or processors other than x86.
+*/
+class PhaseSumKernel
+{
+public:
+
+    enum InstructionSet { SCALAR, AVX2, AVX512 };
+
+    PhaseSumKernel();
+
+    // Throws if the instruction set is not supported.
+    explicit PhaseSumKernel( const InstructionSet instruction_set );
+
+    InstructionSet instruction_set() const { return instruction_set_; }
+
+    static bool is_supported( const InstructionSet instruction_set );
+
+    // The sums are added to cosine_sum and sine_sum, which are not reset.
+    void phase_sum( const int h, const int k, const int l,
+                    const double * x, const double * y, const double * z, const double * w, const size_t n,
+                    double & cosine_sum, double & sine_sum ) const;
+
+private:
+    InstructionSet instruction_set_;
+};
+
+std::string instruction_set_to_string( const PhaseSumKernel::InstructionSet instruction_set );
+
+#endif // PHASESUMKERNEL_H
+
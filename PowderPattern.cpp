@@ -28,6 +28,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "PowderPattern.h"
 #include "FileName.h"
 #include "MathsFunctions.h"
+#include "PowderPatternArchive.h"
 #include "RandomNumberGenerator.h"
 #include "RunningAverageAndESD.h"
 #include "StringFunctions.h"
@@ -769,7 +770,56 @@ void PowderPattern::save_xye( const FileName & file_name, const bool include_wav
     if ( include_wave_length )
         text_file_writer.write_line( double2string( wavelength_.wavelength_1() ) );
     for ( size_t i( 0 ); i != size(); ++i )
-        text_file_writer.write_line( double2string( two_theta_values_[i].value_in_degrees(), 5 ) + "  " + double2string( intensities_[i] ) + "  " + double2string( estimated_standard_deviations_[i] ) );
+    {
+        text_file_writer.write( two_theta_values_[i].value_in_degrees(), 5 );
+        text_file_writer.write( "  " );
+        text_file_writer.write( intensities_[i] );
+        text_file_writer.write( "  " );
+        text_file_writer.write( estimated_standard_deviations_[i] );
+        text_file_writer.write_line();
+    }
+}
+
+// ********************************************************************************
+
+void PowderPattern::read_binary( const FileName & file_name, const size_t i )
+{
+    PowderPatternArchive powder_pattern_archive( file_name );
+    powder_pattern_archive.read( i, *this );
+}
+
+// ********************************************************************************
+
+void PowderPattern::save_binary( const FileName & file_name, const bool single_precision ) const
+{
+    PowderPatternArchiveWriter powder_pattern_archive_writer( file_name, single_precision ? PowderPatternArchive::FLOAT : PowderPatternArchive::DOUBLE );
+    powder_pattern_archive_writer.add( *this );
+    powder_pattern_archive_writer.close();
+}
+
+// ********************************************************************************
+
+void PowderPattern::read( const FileName & file_name )
+{
+    std::string extension = to_lower( file_name.extension() );
+    if ( extension == "xye" )
+        read_xye( file_name );
+    else if ( extension == "xrdml" )
+        read_xrdml( file_name );
+    else if ( extension == "raw" )
+        read_raw( file_name );
+    else if ( extension == "mdi" )
+        read_mdi( file_name );
+    else if ( extension == "txt" )
+        read_txt( file_name );
+    else if ( extension == "cif" )
+        read_cif( file_name );
+    else if ( extension == "ppa" )
+        read_binary( file_name );
+    else if ( extension == "xml" )
+        read_brml( file_name );
+    else
+        throw std::runtime_error( "PowderPattern::read(): Error: unknown file format " + file_name.full_name() );
 }
 
 // ********************************************************************************
@@ -1007,20 +1057,25 @@ double weighted_cross_correlation( const PowderPattern & lhs, const PowderPatter
     int m = round_to_int( l / lhs.average_two_theta_step() );
     if ( m == 0 )
         m = 1;
+    int n = lhs.size();
+    std::vector< double > lhs_intensities( n );
+    std::vector< double > rhs_intensities( n );
+    for ( int i( 0 ); i != n; ++i )
+    {
+        lhs_intensities[i] = lhs.intensity( i );
+        rhs_intensities[i] = rhs.intensity( i );
+    }
+    // sum_i sum_j w(j) lhs(i) rhs(i+j) is rearranged as sum_j w(j) sum_i lhs(i) rhs(i+j),
+    // the inner sum is then a dot product over a contiguous range without any branches.
     double result( 0.0 );
-    for ( int i( 0 ); i != lhs.size(); ++i )
+    for ( int j( -m + 1 ); j != m; ++j )
     {
-        for ( int j( -m + 1 ); j != m; ++j )
-        {
-            if ( ( ( i + j ) >= 0 ) && ( ( i + j ) < lhs.size() ) )
-            {
-                double w = 1.0 - absolute( j ) / static_cast<double>( m );
-                if ( (true) )
-                    result += w * lhs.intensity( i ) * rhs.intensity( i + j );
-                else
-                    result += w * ( lhs.intensity( i ) / lhs.estimated_standard_deviation( i ) ) * ( rhs.intensity( i + j ) / rhs.estimated_standard_deviation( i + j ) );
-            }
-        }
+        if ( absolute( j ) >= lhs.size() )
+            continue;
+        int begin = ( j < 0 ) ? -j : 0;
+        int end = ( j > 0 ) ? n - j : n;
+        double w = 1.0 - absolute( j ) / static_cast<double>( m );
+        result += w * dot_product( &lhs_intensities[begin], &rhs_intensities[begin + j], end - begin );
     }
     return result;
 }
@@ -108,6 +108,15 @@ public:
     void read_cif( const FileName & file_name );
     void save_xye( const FileName & file_name, const bool include_wave_length ) const;
 
+    // Pattern i of a binary PowderPatternArchive (.ppa), which is memory mapped, so only this pattern is read.
+    void read_binary( const FileName & file_name, const size_t i = 0 );
+
+    // A PowderPatternArchive with just this pattern. Use PowderPatternArchiveWriter for many patterns.
+    void save_binary( const FileName & file_name, const bool single_precision = false ) const;
+
+    // Chooses the reader from the extension: .xye, .xrdml, .raw, .mdi, .txt, .cif, .ppa or .xml (the RawData0.xml of a .brml file).
+    void read( const FileName & file_name );
+
     // Writes to std::cout the code that is necessary to generate the PowderPattern object.
     // Useful for writing test-suite code that does not rely on external files.
     void generate_code( const bool include_estimated_standard_deviation ) const;
@@ -0,0 +1,370 @@
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include "PowderPatternArchive.h"
+#include "FileName.h"
+#include "PowderPattern.h"
+#include "Utilities.h"
+#include "Wavelength.h"
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace
+{
+
+const size_t header_size( 32 );
+const size_t record_header_size( 64 );
+const char magic_number[9] = "PXRDARC1";
+const unsigned int explicit_two_theta_flag( 1 );
+const double two_theta_tolerance( 1.0E-6 ); // In degrees.
+
+// ********************************************************************************
+
+size_t bytes_per_value( const PowderPatternArchive::Precision precision )
+{
+    return ( precision == PowderPatternArchive::FLOAT ) ? 4 : 8;
+}
+
+// ********************************************************************************
+
+size_t round_up_to_8( const size_t value )
+{
+    return ( value + 7 ) & ~static_cast< size_t >( 7 );
+}
+
+// ********************************************************************************
+
+struct RecordHeader
+{
+    size_t npoints_;
+    unsigned int flags_;
+    Wavelength wavelength_;
+    double two_theta_start_; // In degrees.
+    double two_theta_step_; // In degrees.
+};
+
+// ********************************************************************************
+
+void write_record_header( const RecordHeader & record_header, char * output )
+{
+    memset( output, 0, record_header_size );
+    unsigned long long npoints = record_header.npoints_;
+    int radiation_source = record_header.wavelength_.radiation_source();
+    int is_monochromated = record_header.wavelength_.is_monochromated() ? 1 : 0;
+    int use_average = record_header.wavelength_.use_average() ? 1 : 0;
+    double wavelength = ( record_header.wavelength_.radiation_source() == Wavelength::SYNCHROTRON ) ? record_header.wavelength_.wavelength() : 0.0;
+    memcpy( output, &npoints, 8 );
+    memcpy( output + 8, &record_header.flags_, 4 );
+    memcpy( output + 12, &radiation_source, 4 );
+    memcpy( output + 16, &is_monochromated, 4 );
+    memcpy( output + 20, &use_average, 4 );
+    memcpy( output + 24, &wavelength, 8 );
+    memcpy( output + 32, &record_header.two_theta_start_, 8 );
+    memcpy( output + 40, &record_header.two_theta_step_, 8 );
+}
+
+// ********************************************************************************
+
+RecordHeader read_record_header( const char * input )
+{
+    RecordHeader result;
+    unsigned long long npoints;
+    int radiation_source;
+    int is_monochromated;
+    int use_average;
+    double wavelength;
+    memcpy( &npoints, input, 8 );
+    memcpy( &result.flags_, input + 8, 4 );
+    memcpy( &radiation_source, input + 12, 4 );
+    memcpy( &is_monochromated, input + 16, 4 );
+    memcpy( &use_average, input + 20, 4 );
+    memcpy( &wavelength, input + 24, 8 );
+    memcpy( &result.two_theta_start_, input + 32, 8 );
+    memcpy( &result.two_theta_step_, input + 40, 8 );
+    result.npoints_ = npoints;
+    if ( ( radiation_source < Wavelength::SYNCHROTRON ) || ( radiation_source > Wavelength::Mo ) )
+        throw std::runtime_error( "PowderPatternArchive: Error: unknown radiation source." );
+    if ( radiation_source == Wavelength::SYNCHROTRON )
+        result.wavelength_ = Wavelength::synchrotron_radiation( wavelength );
+    else
+        result.wavelength_ = Wavelength( static_cast< Wavelength::RadiationSource >( radiation_source ), is_monochromated != 0, use_average != 0 );
+    return result;
+}
+
+// ********************************************************************************
+
+// Number of bytes of a pattern including its header and the padding to a multiple of 8.
+size_t record_size( const RecordHeader & record_header, const PowderPatternArchive::Precision precision )
+{
+    size_t result = record_header_size + 2 * record_header.npoints_ * bytes_per_value( precision );
+    if ( record_header.flags_ & explicit_two_theta_flag )
+        result = round_up_to_8( result ) + record_header.npoints_ * 8;
+    return round_up_to_8( result );
+}
+
+} // namespace
+
+// ********************************************************************************
+
+PowderPatternArchive::PowderPatternArchive( const FileName & file_name ):
+memory_mapped_file_( file_name ),
+file_name_( file_name.full_name() ),
+precision_(DOUBLE)
+{
+    const char * data = memory_mapped_file_.data();
+    if ( ( memory_mapped_file_.size() < header_size ) || ( memcmp( data, magic_number, 8 ) != 0 ) )
+        throw std::runtime_error( "PowderPatternArchive::PowderPatternArchive(): Error: not a powder-pattern archive " + file_name_ );
+    unsigned long long npatterns;
+    unsigned long long index_offset;
+    int precision;
+    memcpy( &npatterns, data + 8, 8 );
+    memcpy( &index_offset, data + 16, 8 );
+    memcpy( &precision, data + 24, 4 );
+    if ( ( precision < DOUBLE ) || ( precision > FLOAT ) )
+        throw std::runtime_error( "PowderPatternArchive::PowderPatternArchive(): Error: unknown precision in " + file_name_ );
+    precision_ = static_cast< Precision >( precision );
+    if ( ( index_offset < header_size ) || ( index_offset > memory_mapped_file_.size() ) || ( ( memory_mapped_file_.size() - index_offset ) / 8 < npatterns ) )
+        throw std::runtime_error( "PowderPatternArchive::PowderPatternArchive(): Error: file is truncated " + file_name_ );
+    offsets_.reserve( npatterns );
+    for ( size_t i( 0 ); i != npatterns; ++i )
+    {
+        unsigned long long offset;
+        memcpy( &offset, data + index_offset + 8 * i, 8 );
+        if ( ( offset < header_size ) || ( offset + record_header_size > index_offset ) )
+            throw std::runtime_error( "PowderPatternArchive::PowderPatternArchive(): Error: index is corrupt in " + file_name_ );
+        offsets_.push_back( offset );
+    }
+}
+
+// ********************************************************************************
+
+const char * PowderPatternArchive::record( const size_t i ) const
+{
+    if ( i >= size() )
+        throw std::runtime_error( "PowderPatternArchive::record(): Error: index out of bounds." );
+    return memory_mapped_file_.data() + offsets_[i];
+}
+
+// ********************************************************************************
+
+size_t PowderPatternArchive::npoints( const size_t i ) const
+{
+    unsigned long long result;
+    memcpy( &result, record( i ), 8 );
+    return result;
+}
+
+// ********************************************************************************
+
+void PowderPatternArchive::read( const size_t i, PowderPattern & powder_pattern ) const
+{
+    const char * input = record( i );
+    RecordHeader record_header = read_record_header( input );
+    if ( offsets_[i] + record_size( record_header, precision_ ) > memory_mapped_file_.size() )
+        throw std::runtime_error( "PowderPatternArchive::read(): Error: pattern " + size_t2string( i ) + " is truncated in " + file_name_ );
+    const size_t npoints = record_header.npoints_;
+    const char * intensities = input + record_header_size;
+    const char * estimated_standard_deviations = intensities + npoints * bytes_per_value( precision_ );
+    const char * two_theta_values = input + round_up_to_8( record_header_size + 2 * npoints * bytes_per_value( precision_ ) );
+    const bool explicit_two_theta = ( record_header.flags_ & explicit_two_theta_flag ) != 0;
+    powder_pattern = PowderPattern();
+    powder_pattern.set_wavelength( record_header.wavelength_ );
+    powder_pattern.reserve( npoints );
+    for ( size_t j( 0 ); j != npoints; ++j )
+    {
+        double two_theta;
+        if ( explicit_two_theta )
+            memcpy( &two_theta, two_theta_values + 8 * j, 8 );
+        else
+            two_theta = record_header.two_theta_start_ + j * record_header.two_theta_step_;
+        double intensity;
+        double estimated_standard_deviation;
+        if ( precision_ == FLOAT )
+        {
+            float value;
+            memcpy( &value, intensities + 4 * j, 4 );
+            intensity = value;
+            memcpy( &value, estimated_standard_deviations + 4 * j, 4 );
+            estimated_standard_deviation = value;
+        }
+        else
+        {
+            memcpy( &intensity, intensities + 8 * j, 8 );
+            memcpy( &estimated_standard_deviation, estimated_standard_deviations + 8 * j, 8 );
+        }
+        powder_pattern.push_back( Angle::from_degrees( two_theta ), intensity, estimated_standard_deviation );
+    }
+}
+
+// ********************************************************************************
+
+PowderPattern PowderPatternArchive::powder_pattern( const size_t i ) const
+{
+    PowderPattern result;
+    read( i, result );
+    return result;
+}
+
+// ********************************************************************************
+
+PowderPatternArchiveWriter::PowderPatternArchiveWriter( const FileName & file_name, const PowderPatternArchive::Precision precision ):
+output_file_( file_name.full_name().c_str(), std::ios::out | std::ios::binary | std::ios::trunc ),
+file_name_( file_name.full_name() ),
+precision_(precision),
+current_offset_(header_size),
+is_open_(true)
+{
+    if ( ! output_file_ )
+        throw std::runtime_error( "PowderPatternArchiveWriter::PowderPatternArchiveWriter(): Error: could not open file " + file_name_ );
+    // Placeholder, the header is written by close().
+    char header[header_size];
+    memset( header, 0, header_size );
+    output_file_.write( header, header_size );
+}
+
+// ********************************************************************************
+
+PowderPatternArchiveWriter::~PowderPatternArchiveWriter()
+{
+    if ( ! is_open_ )
+        return;
+    try
+    {
+        close();
+    }
+    catch ( std::exception & e )
+    {
+        std::cout << "PowderPatternArchiveWriter::~PowderPatternArchiveWriter(): Error: " << e.what() << std::endl;
+    }
+}
+
+// ********************************************************************************
+
+void PowderPatternArchiveWriter::write( const void * data, const size_t nbytes )
+{
+    if ( nbytes == 0 )
+        return;
+    output_file_.write( static_cast< const char * >( data ), nbytes );
+    if ( ! output_file_ )
+        throw std::runtime_error( "PowderPatternArchiveWriter::write(): Error: could not write file " + file_name_ );
+    current_offset_ += nbytes;
+}
+
+// ********************************************************************************
+
+size_t PowderPatternArchiveWriter::add( const PowderPattern & powder_pattern )
+{
+    if ( ! is_open_ )
+        throw std::runtime_error( "PowderPatternArchiveWriter::add(): Error: archive has already been closed." );
+    RecordHeader record_header;
+    record_header.npoints_ = powder_pattern.size();
+    record_header.flags_ = 0;
+    record_header.wavelength_ = powder_pattern.wavelength();
+    record_header.two_theta_start_ = 0.0;
+    record_header.two_theta_step_ = 0.0;
+    if ( ! powder_pattern.empty() )
+        record_header.two_theta_start_ = powder_pattern.two_theta_start().value_in_degrees();
+    if ( powder_pattern.size() > 1 )
+        record_header.two_theta_step_ = powder_pattern.average_two_theta_step().value_in_degrees();
+    for ( size_t i( 0 ); i != powder_pattern.size(); ++i )
+    {
+        if ( std::abs( powder_pattern.two_theta( i ).value_in_degrees() - ( record_header.two_theta_start_ + i * record_header.two_theta_step_ ) ) > two_theta_tolerance )
+        {
+            record_header.flags_ |= explicit_two_theta_flag;
+            break;
+        }
+    }
+    const size_t offset = current_offset_;
+    char header[record_header_size];
+    write_record_header( record_header, header );
+    write( header, record_header_size );
+    if ( precision_ == PowderPatternArchive::FLOAT )
+    {
+        std::vector< float > values( powder_pattern.size() );
+        for ( size_t i( 0 ); i != powder_pattern.size(); ++i )
+            values[i] = powder_pattern.intensity( i );
+        write( values.data(), 4 * values.size() );
+        for ( size_t i( 0 ); i != powder_pattern.size(); ++i )
+            values[i] = powder_pattern.estimated_standard_deviation( i );
+        write( values.data(), 4 * values.size() );
+    }
+    else
+    {
+        std::vector< double > values( powder_pattern.size() );
+        for ( size_t i( 0 ); i != powder_pattern.size(); ++i )
+            values[i] = powder_pattern.intensity( i );
+        write( values.data(), 8 * values.size() );
+        for ( size_t i( 0 ); i != powder_pattern.size(); ++i )
+            values[i] = powder_pattern.estimated_standard_deviation( i );
+        write( values.data(), 8 * values.size() );
+    }
+    const char padding[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    write( padding, round_up_to_8( current_offset_ ) - current_offset_ );
+    if ( record_header.flags_ & explicit_two_theta_flag )
+    {
+        std::vector< double > values( powder_pattern.size() );
+        for ( size_t i( 0 ); i != powder_pattern.size(); ++i )
+            values[i] = powder_pattern.two_theta( i ).value_in_degrees();
+        write( values.data(), 8 * values.size() );
+    }
+    offsets_.push_back( offset );
+    return offsets_.size() - 1;
+}
+
+// ********************************************************************************
+
+void PowderPatternArchiveWriter::close()
+{
+    if ( ! is_open_ )
+        return;
+    is_open_ = false;
+    unsigned long long index_offset = current_offset_;
+    for ( size_t i( 0 ); i != offsets_.size(); ++i )
+    {
+        unsigned long long offset = offsets_[i];
+        write( &offset, 8 );
+    }
+    char header[header_size];
+    memset( header, 0, header_size );
+    unsigned long long npatterns = offsets_.size();
+    int precision = precision_;
+    memcpy( header, magic_number, 8 );
+    memcpy( header + 8, &npatterns, 8 );
+    memcpy( header + 16, &index_offset, 8 );
+    memcpy( header + 24, &precision, 4 );
+    output_file_.seekp( 0 );
+    output_file_.write( header, header_size );
+    output_file_.close();
+    if ( ! output_file_ )
+        throw std::runtime_error( "PowderPatternArchiveWriter::close(): Error: could not write file " + file_name_ );
+}
+
+// ********************************************************************************
+
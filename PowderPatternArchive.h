@@ -0,0 +1,133 @@
+#ifndef POWDERPATTERNARCHIVE_H
+#define POWDERPATTERNARCHIVE_H
+
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+class FileName;
+class PowderPattern;
+
+#include "MemoryMappedFile.h"
+
+#include <cstddef> // For definition of size_t
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*
+  A binary file with many powder patterns, e.g. a library of simulated patterns, which is memory mapped
+  so that opening it is instantaneous and only the patterns that are actually read are loaded.
+
+  The format is a 32-byte header, the patterns, and an index with the offset of each pattern, all in native byte order.
+  The header: the 8 characters "PXRDARC1", the number of patterns (8-byte unsigned integer), the offset of the index
+  (8-byte unsigned integer), the precision (4-byte integer, 0 = double, 1 = float) and 4 bytes padding.
+  Each pattern starts at a multiple of 8 bytes with a 64-byte header: the number of points (8-byte unsigned integer),
+  flags (4-byte integer, 1 = explicit 2theta column), the radiation source, is_monochromated and use_average (4-byte integers),
+  the wavelength (8-byte double, only for synchrotron radiation), 2theta start and 2theta step in degrees (8-byte doubles)
+  and 16 bytes padding. The header is followed by the intensities and the ESDs in the precision of the file.
+  Patterns with a uniform 2theta step (to within 1.0E-6 degrees) only store start and step, otherwise a column with
+  the 2theta values in degrees (8-byte doubles) follows the ESDs.
+  The index is the offset of each pattern (8-byte unsigned integers).
+
+  Reading is const and can be done from several threads at the same time. Not copyable.
+*/
+class PowderPatternArchive
+{
+public:
+
+    enum Precision { DOUBLE, FLOAT };
+
+    // Throws if the file is not a powder-pattern archive.
+    explicit PowderPatternArchive( const FileName & file_name );
+
+    size_t size() const { return offsets_.size(); }
+
+    Precision precision() const { return precision_; }
+
+    // Number of 2theta values of pattern i.
+    size_t npoints( const size_t i ) const;
+
+    void read( const size_t i, PowderPattern & powder_pattern ) const;
+
+    PowderPattern powder_pattern( const size_t i ) const;
+
+    std::string file_name() const { return file_name_; }
+
+private:
+    MemoryMappedFile memory_mapped_file_;
+    std::string file_name_;
+    Precision precision_;
+    std::vector< size_t > offsets_;
+
+    const char * record( const size_t i ) const;
+
+    // Not copyable.
+    PowderPatternArchive( const PowderPatternArchive & );
+    PowderPatternArchive & operator=( const PowderPatternArchive & );
+};
+
+/*
+  Writes a PowderPatternArchive one pattern at a time, so the patterns need not all be in memory.
+  The index and the header are written by close() or, if close() has not been called, by the destructor.
+  With FLOAT precision, intensities and ESDs have about seven significant digits, which is plenty for calculated patterns.
+
+  Not copyable.
+*/
+class PowderPatternArchiveWriter
+{
+public:
+
+    // Any existing file is overwritten.
+    PowderPatternArchiveWriter( const FileName & file_name, const PowderPatternArchive::Precision precision = PowderPatternArchive::DOUBLE );
+
+    ~PowderPatternArchiveWriter();
+
+    // Returns the index of the pattern in the archive.
+    size_t add( const PowderPattern & powder_pattern );
+
+    size_t size() const { return offsets_.size(); }
+
+    // Writes the index and the header. No patterns can be added afterwards.
+    void close();
+
+private:
+    std::ofstream output_file_;
+    std::string file_name_;
+    PowderPatternArchive::Precision precision_;
+    std::vector< size_t > offsets_;
+    size_t current_offset_;
+    bool is_open_;
+
+    void write( const void * data, const size_t nbytes );
+
+    // Not copyable.
+    PowderPatternArchiveWriter( const PowderPatternArchiveWriter & );
+    PowderPatternArchiveWriter & operator=( const PowderPatternArchiveWriter & );
+};
+
+#endif // POWDERPATTERNARCHIVE_H
+
@@ -31,9 +31,14 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "CrystallographicCalculations.h"
 #include "CrystalStructure.h"
 #include "MathsFunctions.h"
+#include "PeakProfileTable.h"
 #include "PointGroup.h"
 #include "PowderPattern.h"
+#include "PowderPatternCalculatorCache.h"
 #include "ReflectionList.h"
+#include "StructureFactorCalculator.h"
+#include "SystematicAbsences.h"
+#include "ThreadPool.h"
 
 #include <cmath>
 #include <stdexcept>
@@ -48,38 +53,77 @@ namespace
 {
 // ********************************************************************************
 
-// Precalculating the peak shape is a speed optimisation.
-// Technically, it is an approximation, because the peak centre
-// is not exactly at one of the i*2theta_step points, so there is a slight shift of
-// on average 1/4 of a 2theta_step.
-// This approximation should be fine if 2theta_step is small, such as 0.01 or 0.02.
-std::vector< double > peak_shape( const Angle two_theta_step, const double FWHM )
+// The rotation matrices of a point group converted to integers, nine per symmetry operator, row by row.
+std::vector< int > integer_rotations( const PointGroup & point_group )
 {
-    // Find number of points out to the right that need to be calculated to reach 0.1% of intensity at 0.0.
-    std::vector<double> values;
-    values.reserve( 137 ); // 44 for 1% of intensity, but the value also depends on eta.
-    double I100 = pseudo_Voigt( 0.0, FWHM );
-    values.push_back( I100 );
-    size_t i( 0 );
-    double value;
-    do
+    std::vector< int > result;
+    result.reserve( 9 * point_group.nsymmetry_operators() );
+    for ( size_t i( 0 ); i != point_group.nsymmetry_operators(); ++i )
     {
-        ++i;
-        value = pseudo_Voigt( i * two_theta_step.value_in_degrees(), FWHM );
-        values.push_back( value );
+        Matrix3D rotation = point_group.symmetry_operator( i );
+        for ( size_t j( 0 ); j != 3; ++j )
+        {
+            for ( size_t k( 0 ); k != 3; ++k )
+                result.push_back( round_to_int( rotation.value( j, k ) ) );
+        }
     }
-    while ( (I100/1000.0) < value );
-    // The number of points is now 2*i + 1 (the 1 is 0.0).
-    std::vector<double> result;
-    result.reserve( 2*i+1 );
-    for ( size_t j(0); j < i; ++j )
-        result.push_back( values[i-j] );
-    result.push_back( values[0] );
-    for ( size_t j(0); j < i; ++j )
-        result.push_back( values[j+1] );
     return result;
 }
 
+// ********************************************************************************
+
+bool contains_rotation( const std::vector< int > & rotations, const int rotation[9] )
+{
+    for ( size_t i( 0 ); i != rotations.size(); i += 9 )
+    {
+        size_t j( 0 );
+        while ( ( j != 9 ) && ( rotations[i+j] == rotation[j] ) )
+            ++j;
+        if ( j == 9 )
+            return true;
+    }
+    return false;
+}
+
+// ********************************************************************************
+
+// Returns 0 if (hkl) is not the representative of its set of equivalent reflections, i.e. if (hkl) R comes first according to
+// operator<( MillerIndices, MillerIndices ) for one of the rotations R. Otherwise returns the number of equivalent reflections,
+// which is the number of rotations divided by the number of rotations that map (hkl) onto itself, so no set needs to be built.
+// The rotations must form a group.
+size_t multiplicity_if_representative( const int h, const int k, const int l, const std::vector< int > & rotations )
+{
+    size_t nstabilisers( 0 );
+    for ( size_t i( 0 ); i != rotations.size(); i += 9 )
+    {
+        const int * R = &rotations[i];
+        // H R, with H a row vector.
+        int h2 = h * R[0] + k * R[3] + l * R[6];
+        if ( h2 != h )
+        {
+            if ( h2 > h )
+                return 0;
+            continue;
+        }
+        int k2 = h * R[1] + k * R[4] + l * R[7];
+        if ( k2 != k )
+        {
+            if ( k2 > k )
+                return 0;
+            continue;
+        }
+        int l2 = h * R[2] + k * R[5] + l * R[8];
+        if ( l2 != l )
+        {
+            if ( l2 > l )
+                return 0;
+            continue;
+        }
+        ++nstabilisers;
+    }
+    return ( rotations.size() / 9 ) / nstabilisers;
+}
+
 } // namespace
 
 // ********************************************************************************
@@ -95,12 +139,11 @@ preferred_orientation_direction_( 0, 0, 0 ),
 r_(1.0),
 include_finger_cox_jephcoat_(false),
 finger_cox_jephcoat_( 0.0001, 0.0001 ),
-crystal_structure_(crystal_structure)
+crystal_structure_(crystal_structure),
+nthreads_(1),
+peak_profile_oversampling_(16),
+cache_(0)
 {
-    if ( ! crystal_structure.space_group_symmetry_has_been_applied() )
-        std::cout << "PowderPatternCalculator::PowderPatternCalculator( CrystalStructure ): Warning: space-group symmetry has not been applied for input crystal structure."<< std::endl;
-//    if ( ! crystal_structure.space_group_symmetry_has_been_applied() )
-//        throw std::runtime_error( "PowderPatternCalculator::PowderPatternCalculator( CrystalStructure ): Error: space-group symmetry has not been applied for input crystal structure." );
     Laue_class_ = crystal_structure_.space_group().Laue_class();
 }
 
@@ -111,9 +154,15 @@ void PowderPatternCalculator::set_two_theta_step( const Angle two_theta_step )
     two_theta_step_ = two_theta_step;
     if ( two_theta_step_ < Angle::from_degrees( TOLERANCE ) )
          throw std::runtime_error( "PowderPatternCalculator::set_two_theta_step(): Error: value must be positive." );
-    // There is an approximation in the calculation of the powder pattern that expects the 2theta step to be small.
-    if ( two_theta_step_ > Angle::from_degrees( 0.05 ) )
-        std::cout << "PowderPatternCalculator::set_two_theta_step(): Warning: because of an internal approximation, 2theta step is expected to be small." << std::endl;
+}
+
+// ********************************************************************************
+
+void PowderPatternCalculator::set_peak_profile_oversampling( const size_t peak_profile_oversampling )
+{
+    if ( peak_profile_oversampling == 0 )
+         throw std::runtime_error( "PowderPatternCalculator::set_peak_profile_oversampling(): Error: value must be at least 1." );
+    peak_profile_oversampling_ = peak_profile_oversampling;
 }
 
 // ********************************************************************************
@@ -173,6 +222,8 @@ void PowderPatternCalculator::calculate( PowderPattern & powder_pattern )
 
 void PowderPatternCalculator::calculate_reflection_list( const bool exact )
 {
+    if ( ( cache_ != 0 ) && cache_->find_reflection_list( crystal_structure_.crystal_lattice(), crystal_structure_.space_group(), wavelength_.wavelength_1(), two_theta_start_, two_theta_end_, exact, reflection_list_ ) )
+        return;
     // Get a list of all reflections.
     // As in Mercury, we ignore two_theta_start_ here.
     // We add a little extra at the end to avoid cut-off effects.
@@ -188,35 +239,42 @@ void PowderPatternCalculator::calculate_reflection_list( const bool exact )
     double h_max =           fabs( h_max_x );
     double k_max = std::max( fabs( k_max_x ),           fabs( k_max_y ) );
     double l_max = std::max( fabs( l_max_x ), std::max( fabs( l_max_y ), fabs( l_max_z ) ) );
-    // @@ This can be made more efficient because -h, -k, -l is never needed if programmed properly.
     int h_upper = round_to_int( h_max ) + 1;
     int h_lower = -h_upper;
     int k_upper = round_to_int( k_max ) + 1;
     int k_lower = -k_upper;
     int l_upper = round_to_int( l_max ) + 1;
     int l_lower = -l_upper;
-    // We can precalculate how many reflections there will be to dimension the vector properly.
-    // This can be improved (current numbers are wrong).
-    size_t cube_size = (2*h_upper+1) * (2*k_upper+1) * (l_upper+1);
-    size_t sphere_size = static_cast<size_t>( cube_size/2.0 );
-    reflection_list_.reserve( sphere_size );
-    for ( int h(h_lower); h <= h_upper; ++h )
+    // Only one representative of each set of equivalent reflections is kept: the one that comes first according to operator<( MillerIndices, MillerIndices ),
+    // which is the one with the largest h, then the largest k, then the largest l.
+    // The Laue class always contains the inversion, so the representative has h >= 0. If the Laue class contains
+    // (h,k,l) -> (h,-k,l) the representative has k >= 0, and if it contains (h,k,l) -> (h,k,-l) the representative has l >= 0.
+    // For triclinic, monoclinic and orthorhombic space groups, this is exactly the asymmetric unit,
+    // for higher symmetries the remaining equivalent reflections are rejected by multiplicity_if_representative().
+    std::vector< int > Laue_class_rotations = integer_rotations( Laue_class_ );
+    const int mirror_k[9] = { 1, 0, 0, 0, -1, 0, 0, 0, 1 };
+    const int mirror_l[9] = { 1, 0, 0, 0, 1, 0, 0, 0, -1 };
+    int h_start = Laue_class_.has_inversion() ? 0 : h_lower;
+    int k_start = contains_rotation( Laue_class_rotations, mirror_k ) ? 0 : k_lower;
+    int l_start = contains_rotation( Laue_class_rotations, mirror_l ) ? 0 : l_lower;
+    SystematicAbsences systematic_absences( crystal_structure_.space_group() );
+    CrystalLattice crystal_lattice = crystal_structure_.crystal_lattice();
+    std::vector< MillerIndices > miller_indices;
+    std::vector< double > d_spacings;
+    std::vector< size_t > multiplicities;
+    for ( int h( h_start ); h <= h_upper; ++h )
     {
-        for ( int k(k_lower); k <= k_upper; ++k )
+        for ( int k( k_start ); k <= k_upper; ++k )
         {
-            for ( int l(l_lower); l <= l_upper; ++l )
+            for ( int l( l_start ); l <= l_upper; ++l )
             {
-                MillerIndices current_reflection( h, k, l );
-                if ( current_reflection.is_000() )
+                if ( ( h == 0 ) && ( k == 0 ) && ( l == 0 ) )
                     continue;
-                if ( is_systematic_absence( current_reflection ) )
+                size_t multiplicity = multiplicity_if_representative( h, k, l, Laue_class_rotations );
+                if ( multiplicity == 0 )
                     continue;
-                // Get a list of all equivalent reflections.
-                std::set< MillerIndices > equivalent_reflections = calculate_equivalent_reflections( current_reflection );
-                // Only keep the first one.
-                if ( ! ( current_reflection == *equivalent_reflections.begin() ) )
-                    continue;
-                Vector3D H = reciprocal_lattice_point( current_reflection, crystal_structure_.crystal_lattice() );
+                MillerIndices current_reflection( h, k, l );
+                Vector3D H = reciprocal_lattice_point( current_reflection, crystal_lattice );
                 double d = 1.0 / ( H.length() );
                 // Some of the reflections that are generated lead to asin( x ) with x > 1.0, which is an ERROR.
                 if ( wavelength_.wavelength_1() > 2.0 * d )
@@ -224,96 +282,39 @@ void PowderPatternCalculator::calculate_reflection_list( const bool exact )
                 Angle two_theta = 2.0 * arcsine( wavelength_.wavelength_1() / ( 2.0 * d ) );
                 if ( exact )
                 {
-                    if ( ( two_theta >= two_theta_start_ ) && ( two_theta <= two_theta_end_ ) )
-                        reflection_list_.push_back( current_reflection, 1.0, d, equivalent_reflections.size() );
-                }
-                else
-                {
-                    if ( two_theta < ( two_theta_end_ + Angle::from_degrees( 0.1 ) ) )
-                        reflection_list_.push_back( current_reflection, 1.0, d, equivalent_reflections.size() );
+                    if ( ( two_theta < two_theta_start_ ) || ( two_theta_end_ < two_theta ) )
+                        continue;
                 }
+                else if ( ! ( two_theta < ( two_theta_end_ + Angle::from_degrees( 0.1 ) ) ) )
+                    continue;
+                if ( systematic_absences.is_systematic_absence( current_reflection ) )
+                    continue;
+                miller_indices.push_back( current_reflection );
+                d_spacings.push_back( d );
+                multiplicities.push_back( multiplicity );
             }
         }
     }
+    // F^2 is set to 1.0.
+    reflection_list_ = ReflectionList( miller_indices, std::vector< double >( miller_indices.size(), 1.0 ), d_spacings, multiplicities );
+    if ( cache_ != 0 )
+        cache_->add_reflection_list( crystal_structure_.crystal_lattice(), crystal_structure_.space_group(), wavelength_.wavelength_1(), two_theta_start_, two_theta_end_, exact, reflection_list_ );
 }
 
 // ********************************************************************************
 
 void PowderPatternCalculator::calculate_structure_factors()
 {
-    if ( ! crystal_structure_.space_group_symmetry_has_been_applied() )
-        throw std::runtime_error( "PowderPatternCalculator::calculate_structure_factors(): Error: space-group symmetry has not been applied for input crystal structure." );
-    // For each reflection, calculate an intensity.
-    for ( size_t i( 0 ); i != reflection_list_.size(); ++i )
+    // The atoms are copied into a table sorted by element and Debije-Waller factor once,
+    // so that the loop over the reflections does not have to copy Atom objects.
+    // If space-group symmetry has not been applied, the atoms are the asymmetric unit and the symmetry operators are applied analytically.
+    StructureFactorCalculator structure_factor_calculator( crystal_structure_, ! crystal_structure_.space_group_symmetry_has_been_applied() );
+    if ( nthreads_ == 1 )
+        structure_factor_calculator.calculate_F_squared( reflection_list_ );
+    else
     {
-        MillerIndices miller_indices( reflection_list_.miller_indices( i ) );
-        int h = miller_indices.h();
-        int k = miller_indices.k();
-        int l = miller_indices.l();
-        double d = reflection_list_.d_spacing( i );
-        double sine_theta_over_lambda = 1.0 / ( 2.0 * d );
-        double cosine_term( 0.0 );
-        double sine_term( 0.0 );
-        // This can be sped up by sorting the list into lists of atoms of the same element.
-        double f0_H  = Element(  1 ).scattering_factor( sine_theta_over_lambda );
-        double f0_C  = Element(  6 ).scattering_factor( sine_theta_over_lambda );
-        double f0_N  = Element(  7 ).scattering_factor( sine_theta_over_lambda );
-        double f0_O  = Element(  8 ).scattering_factor( sine_theta_over_lambda );
-        double f0_Cl = Element( 17 ).scattering_factor( sine_theta_over_lambda );
-        double f0_I  = Element( 53 ).scattering_factor( sine_theta_over_lambda );
-        for ( size_t j( 0 ); j != crystal_structure_.natoms(); ++j )
-        {
-            // Get the scattering factor from 2theta, the wavelength and the element of the atom.
-            double f0;
-            switch ( crystal_structure_.atom(j).element().atomic_number() )
-            {
-                case  1 : f0 = f0_H; break;
-                case  6 : f0 = f0_C; break;
-                case  7 : f0 = f0_N; break;
-                case  8 : f0 = f0_O; break;
-                case 17 : f0 = f0_Cl; break;
-                case 53 : f0 = f0_I; break;
-                default : f0 = crystal_structure_.atom(j).element().scattering_factor( sine_theta_over_lambda );
-            }
-            f0 *= crystal_structure_.atom(j).occupancy();
-            // The Debije-Waller factor.
-            double T( 1.0 );
-            if ( crystal_structure_.atom(j).ADPs_type() == Atom::ANISOTROPIC )
-            {
-                AnisotropicDisplacementParameters ADPs = crystal_structure_.atom(j).anisotropic_displacement_parameters();
-                T = exp( -2.0 * square( CONSTANT_PI ) * ( miller_indices * ADPs.U_star( crystal_structure_.crystal_lattice() ) * miller_indices ) );
-            }
-            else if ( crystal_structure_.atom(j).ADPs_type() == Atom::ISOTROPIC )
-            {
-                T = exp( -8.0 * square( CONSTANT_PI ) * crystal_structure_.atom(j).Uiso() * square( sine_theta_over_lambda ) );
-            }
-            else
-            {
-                // This is what Mercury does according to the manual.
-                if ( crystal_structure_.atom(j).element().atomic_number() == 1 )
-                    T = exp( -8.0 * square( CONSTANT_PI ) * 0.06 * square( sine_theta_over_lambda ) );
-                else
-                    T = exp( -8.0 * square( CONSTANT_PI ) * 0.05 * square( sine_theta_over_lambda ) );
-            }
-            double x = crystal_structure_.atom(j).position().x();
-            double y = crystal_structure_.atom(j).position().y();
-            double z = crystal_structure_.atom(j).position().z();
-            Angle argument = Angle::from_radians( 2.0 * CONSTANT_PI * ( h*x + k*y + l*z ) );
-            double sine;
-            double cosine;
-            bool use_sincos = true;
-            if ( use_sincos )
-                sincos( argument, sine, cosine );
-            else
-            {
-                sine   = argument.sine();
-                cosine = argument.cosine();
-            }
-            sine_term += T * f0 * sine;
-            cosine_term += T * f0 * cosine;
-        }
-        double F_squared = square( cosine_term ) + square( sine_term );
-        reflection_list_.set_F_squared( i, F_squared );
+        ThreadPool thread_pool( nthreads_ );
+        structure_factor_calculator.calculate_F_squared( reflection_list_, thread_pool );
     }
 }
 
@@ -322,76 +323,37 @@ void PowderPatternCalculator::calculate_structure_factors()
 void PowderPatternCalculator::calculate( const ReflectionList & reflection_list, PowderPattern & powder_pattern )
 {
     powder_pattern = PowderPattern( two_theta_start_, two_theta_end_, two_theta_step_ );
-    // Calculate one peak with area 1.0.
-    std::vector< double > peak_points = peak_shape( two_theta_step_, FWHM_ );
+    // Tabulate one peak with area 1.0.
+    PeakProfileTable peak_profile_table;
+    if ( ( cache_ == 0 ) || ( ! cache_->find_peak_profile_table( two_theta_step_, FWHM_, peak_profile_oversampling_, peak_profile_table ) ) )
+    {
+        peak_profile_table = PeakProfileTable( FWHM_, two_theta_step_.value_in_degrees(), peak_profile_oversampling_, finger_cox_jephcoat_.eta() );
+        if ( cache_ != 0 )
+            cache_->add_peak_profile_table( peak_profile_table );
+    }
     Vector3D PO_vector;
     if ( include_preferred_orientation_ )
         PO_vector = reciprocal_lattice_point( preferred_orientation_direction_, crystal_structure_.crystal_lattice() );
-    // For each reflection, convolute it with a peak shape.
-    for ( size_t i( 0 ); i != reflection_list.size(); ++i )
+    ThreadPool thread_pool( nthreads_ );
+    // With more than one thread, more blocks than threads, because peaks at low angles are more expensive if Finger-Cox-Jephcoat is included.
+    size_t nblocks = ( thread_pool.nthreads() == 1 ) ? 1 : 4 * thread_pool.nthreads();
+    std::vector< std::vector< double > > block_intensities( nblocks );
+    thread_pool.run( nblocks, [&]( const size_t iBlock )
     {
-        double multiplicity( 0.0 );
-        if ( include_preferred_orientation_ )
-        {
-            std::set< MillerIndices > equivalent_reflections = calculate_equivalent_reflections( reflection_list.miller_indices( i ) );
-            for ( std::set< MillerIndices >::const_iterator it( equivalent_reflections.begin() ); it != equivalent_reflections.end(); ++it )
-            {
-                Vector3D H = reciprocal_lattice_point( *it, crystal_structure_.crystal_lattice() );
-                Angle alpha = angle( PO_vector, H );
-                multiplicity += std::pow( square(r_) * square( alpha.cosine() ) + square( alpha.sine() ) / r_, -3.0/2.0 );
-            }
-        }
-        else
-            multiplicity = reflection_list.multiplicity( i );
-        double peak_intensity = reflection_list.F_squared( i ) * multiplicity;
-        Angle theta = arcsine( wavelength_.wavelength_1() / ( 2.0 * reflection_list.d_spacing( i ) ) );
-        Angle two_theta = 2.0 * theta;
-        if ( include_zero_point_error_ )
-        {
-            two_theta += zero_point_error_;
-            theta = two_theta / 2.0;
-        }
-        // Multiply by the LP factor.
-        double LP_factor = ( 1.0 + square( two_theta.cosine() ) ) / ( 2.0 * two_theta.sine() * theta.sine() );
-        peak_intensity *= LP_factor;
-        if ( include_finger_cox_jephcoat_ && ( two_theta < Angle::angle_45_degrees() ) )
-        {
-            // Peak asymmetry just goes on and on, we essentially have to start at 2theta = 0.0.
-            Angle current_2theta = two_theta_start_;
-            Angle maximum_2theta_value_for_FCJ = two_theta + static_cast<double>(((static_cast<int>(peak_points.size())-1)/2)) * two_theta_step_;
-            std::vector< Angle > two_phi_values;
-            size_t j( 0 );
-            do
-            {
-                current_2theta = two_theta_start_ + j * two_theta_step_;
-                if ( j < powder_pattern.size() )
-                    two_phi_values.push_back( current_2theta );
-                ++j;
-            }
-            while ( current_2theta < maximum_2theta_value_for_FCJ );
-            std::vector< double > peak_points_2 = finger_cox_jephcoat_.asymmetric_peak( two_theta, two_phi_values, FWHM_ );
-            for ( size_t index( 0 ); index != peak_points_2.size(); ++index )
-            {
-                double intensity = powder_pattern.intensity( index );
-                intensity += peak_intensity * peak_points_2[index];
-                powder_pattern.set_intensity( index, intensity );
-            }
-        }
-        else
-        {
-            int peak_centre_index = round_to_int( ( two_theta - two_theta_start_ ) / two_theta_step_ );
-            int peak_start_index = peak_centre_index - ( ( static_cast<int>( peak_points.size() ) - 1 ) / 2 );
-            for ( size_t j ( 0 ); j != peak_points.size(); ++j )
-            {
-                // Calculate new index.
-                int index = peak_start_index + j;
-                if ( ( index < 0 ) || ( index >= powder_pattern.size() ) )
-                    continue;
-                double intensity = powder_pattern.intensity( index );
-                intensity += peak_intensity * pseudo_Voigt( ( powder_pattern.two_theta( index ) - two_theta ).value_in_degrees(), FWHM_ );
-                powder_pattern.set_intensity( index, intensity );
-            }
-        }
+        // Each block gets a contiguous range of reflections and its own intensities, so no locking is needed.
+        block_intensities[iBlock].resize( powder_pattern.size(), 0.0 );
+        size_t begin = ( iBlock * reflection_list.size() ) / nblocks;
+        size_t end = ( ( iBlock + 1 ) * reflection_list.size() ) / nblocks;
+        for ( size_t i( begin ); i != end; ++i )
+            add_peak( reflection_list, i, peak_profile_table, PO_vector, powder_pattern, block_intensities[iBlock] );
+    } );
+    // Sum the blocks in a fixed order, so that the result does not depend on which thread finished first.
+    for ( size_t i( 0 ); i != powder_pattern.size(); ++i )
+    {
+        double intensity( 0.0 );
+        for ( size_t j( 0 ); j != nblocks; ++j )
+            intensity += block_intensities[j][i];
+        powder_pattern.set_intensity( i, intensity );
     }
     powder_pattern.normalise_highest_peak();
     powder_pattern.recalculate_estimated_standard_deviations();
@@ -400,18 +362,67 @@ void PowderPatternCalculator::calculate( const ReflectionList & reflection_list,
 
 // ********************************************************************************
 
-bool PowderPatternCalculator::is_systematic_absence( const MillerIndices H ) const
+void PowderPatternCalculator::add_peak( const ReflectionList & reflection_list,
+                                        const size_t i,
+                                        const PeakProfileTable & peak_profile_table,
+                                        const Vector3D & PO_vector,
+                                        const PowderPattern & powder_pattern,
+                                        std::vector< double > & intensities ) const
 {
-    // Note that we skip the first symmetry operator, which is guaranteed to be the identity.
-    for ( size_t i( 1 ); i != crystal_structure_.space_group().nsymmetry_operators(); ++i )
+    double multiplicity( 0.0 );
+    if ( include_preferred_orientation_ )
     {
-        if ( H * crystal_structure_.space_group().symmetry_operator(i).rotation() == H )
+        std::set< MillerIndices > equivalent_reflections = calculate_equivalent_reflections( reflection_list.miller_indices( i ) );
+        for ( std::set< MillerIndices >::const_iterator it( equivalent_reflections.begin() ); it != equivalent_reflections.end(); ++it )
         {
-            if ( ! nearly_integer( H * crystal_structure_.space_group().symmetry_operator(i).translation(), 0.05 ) )
-                return true;
+            Vector3D H = reciprocal_lattice_point( *it, crystal_structure_.crystal_lattice() );
+            Angle alpha = angle( PO_vector, H );
+            multiplicity += std::pow( square(r_) * square( alpha.cosine() ) + square( alpha.sine() ) / r_, -3.0/2.0 );
         }
     }
-    return false;
+    else
+        multiplicity = reflection_list.multiplicity( i );
+    double peak_intensity = reflection_list.F_squared( i ) * multiplicity;
+    Angle theta = arcsine( wavelength_.wavelength_1() / ( 2.0 * reflection_list.d_spacing( i ) ) );
+    Angle two_theta = 2.0 * theta;
+    if ( include_zero_point_error_ )
+    {
+        two_theta += zero_point_error_;
+        theta = two_theta / 2.0;
+    }
+    // Multiply by the LP factor.
+    double LP_factor = ( 1.0 + square( two_theta.cosine() ) ) / ( 2.0 * two_theta.sine() * theta.sine() );
+    peak_intensity *= LP_factor;
+    // The peak is only calculated at the points of the powder pattern where it is non-zero.
+    Angle peak_start = two_theta - Angle::from_degrees( peak_profile_table.half_width() );
+    Angle peak_end = two_theta + Angle::from_degrees( peak_profile_table.half_width() );
+    bool include_finger_cox_jephcoat = include_finger_cox_jephcoat_ && ( two_theta < Angle::angle_45_degrees() );
+    // The axial divergence only adds intensity at the low-angle side.
+    if ( include_finger_cox_jephcoat )
+        peak_start = finger_cox_jephcoat_.two_phi_min( two_theta ) - Angle::from_degrees( peak_profile_table.half_width() );
+    int start_index = static_cast<int>( ceil( ( peak_start - two_theta_start_ ) / two_theta_step_ ) );
+    int end_index = static_cast<int>( floor( ( peak_end - two_theta_start_ ) / two_theta_step_ ) ) + 1;
+    if ( start_index < 0 )
+        start_index = 0;
+    if ( end_index > static_cast<int>( powder_pattern.size() ) )
+        end_index = powder_pattern.size();
+    if ( end_index <= start_index )
+        return;
+    if ( include_finger_cox_jephcoat )
+    {
+        std::vector< Angle > two_phi_values;
+        two_phi_values.reserve( end_index - start_index );
+        for ( int index( start_index ); index != end_index; ++index )
+            two_phi_values.push_back( powder_pattern.two_theta( index ) );
+        std::vector< double > peak_points = finger_cox_jephcoat_.asymmetric_peak( two_theta, two_phi_values, peak_profile_table );
+        for ( size_t j( 0 ); j != peak_points.size(); ++j )
+            intensities[start_index + j] += peak_intensity * peak_points[j];
+    }
+    else
+    {
+        for ( int index( start_index ); index != end_index; ++index )
+            intensities[index] += peak_intensity * peak_profile_table.value( ( powder_pattern.two_theta( index ) - two_theta ).value_in_degrees() );
+    }
 }
 
 // ********************************************************************************
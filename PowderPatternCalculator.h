@@ -36,9 +36,13 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "Wavelength.h"
 
 class CrystalStructure;
+class PeakProfileTable;
 class PowderPattern;
+class PowderPatternCalculatorCache;
+class Vector3D;
 
 #include <set>
+#include <vector>
 
 // The mixing parameter for the pseudo-Voigt (eta) cannot be set because originally the peak shape was intended to be flexible.
 // But pseudo-Voigt works so well and it is required for Finger-Cox-Jephcoat to work, so we
@@ -89,6 +93,26 @@ public:
     bool include_finger_cox_jephcoat() const { return include_finger_cox_jephcoat_; }
     FingerCoxJephcoat finger_cox_jephcoat() const { return finger_cox_jephcoat_; }
 
+    // The number of threads used for the structure factors and for the peaks, 0 means the number of cores. The default is 1.
+    // The reflections are divided into blocks, each block adds its peaks to its own copy of the intensities
+    // and the copies are summed in the order of the blocks. The division only depends on the number of threads,
+    // so the result is reproducible to the last bit for a given number of threads, and with one thread it is the same as before.
+    // Different numbers of threads give differences of the order of the rounding errors.
+    size_t nthreads() const { return nthreads_; }
+    void set_nthreads( const size_t nthreads ) { nthreads_ = nthreads; }
+
+    // Reflection lists and peak shapes are looked up in and added to the cache, so that they can be reused
+    // when many crystal structures with the same unit cell and space group are calculated, only F^2 is then recalculated.
+    // The cache is held by reference and must outlive the PowderPatternCalculator.
+    void set_cache( PowderPatternCalculatorCache & cache ) { cache_ = &cache; }
+
+    void unset_cache() { cache_ = 0; }
+
+    // The peak profile is tabulated on a grid that is this many times finer than the 2theta step and linearly interpolated,
+    // so that each peak is centred at its exact 2theta value. The default is 16.
+    size_t peak_profile_oversampling() const { return peak_profile_oversampling_; }
+    void set_peak_profile_oversampling( const size_t peak_profile_oversampling );
+
 // Same for eta and/or peak shape
 
     void calculate( PowderPattern & powder_pattern );
@@ -100,6 +124,9 @@ public:
     // This can be switched off by setting exact to true.
     void calculate_reflection_list( const bool exact = false );
 
+    // If space-group symmetry has been applied to the crystal structure, F(hkl) is summed over all atoms.
+    // If not, the atoms are taken to be the asymmetric unit and the symmetry operators are applied analytically,
+    // which is faster because it is not necessary to expand the crystal structure.
     void calculate_structure_factors();
 
     // Sets all structure factors to 1, to get an artificial powder pattern to compare lattices.
@@ -128,9 +155,20 @@ private:
     const CrystalStructure & crystal_structure_; // Creating a copy would be too expensive given that we have tens of thousands of atoms.
     // But what if the crystal structure goes out of scope and the destructor is called? We need a smart pointer here.
     PointGroup Laue_class_;
-    
-    bool is_systematic_absence( const MillerIndices miller_indices ) const;
+    size_t nthreads_;
+    size_t peak_profile_oversampling_;
+    PowderPatternCalculatorCache * cache_; // 0 if there is no cache
+
     std::set< MillerIndices > calculate_equivalent_reflections( const MillerIndices miller_indices ) const;
+
+    // Adds the peak of reflection i to intensities, which has one value per point of powder_pattern.
+    // Only reads data members, so it can be called from several threads at once.
+    void add_peak( const ReflectionList & reflection_list,
+                   const size_t i,
+                   const PeakProfileTable & peak_profile_table,
+                   const Vector3D & PO_vector,
+                   const PowderPattern & powder_pattern,
+                   std::vector< double > & intensities ) const;
 };
 
 #endif // POWDERPATTERNCALCULATOR_H
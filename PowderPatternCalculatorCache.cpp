@@ -0,0 +1,157 @@
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include "PowderPatternCalculatorCache.h"
+#include "CrystallographicCalculations.h"
+#include "MillerIndices.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+// ********************************************************************************
+
+PowderPatternCalculatorCache::PowderPatternCalculatorCache( const size_t maximum_nreflection_lists, const double length_tolerance_percentage, const Angle angle_tolerance ):
+maximum_nreflection_lists_(maximum_nreflection_lists),
+length_tolerance_percentage_(length_tolerance_percentage),
+angle_tolerance_(angle_tolerance),
+nhits_(0),
+nmisses_(0)
+{
+    if ( maximum_nreflection_lists_ == 0 )
+        throw std::runtime_error( "PowderPatternCalculatorCache::PowderPatternCalculatorCache(): Error: maximum number of reflection lists must be at least 1." );
+}
+
+// ********************************************************************************
+
+bool PowderPatternCalculatorCache::find_reflection_list( const CrystalLattice & crystal_lattice,
+                                                         const SpaceGroup & space_group,
+                                                         const double wavelength,
+                                                         const Angle two_theta_start,
+                                                         const Angle two_theta_end,
+                                                         const bool exact,
+                                                         ReflectionList & reflection_list )
+{
+    // Search from the back, the most recently used one is the most likely to match.
+    for ( size_t i( reflection_lists_.size() ); i != 0; --i )
+    {
+        const ReflectionListEntry & entry = reflection_lists_[i-1];
+        if ( ( entry.exact_ != exact ) ||
+             ( entry.wavelength_ != wavelength ) ||
+             ( entry.two_theta_start_ != two_theta_start ) ||
+             ( entry.two_theta_end_ != two_theta_end ) )
+            continue;
+        if ( ! nearly_equal( entry.crystal_lattice_, crystal_lattice, length_tolerance_percentage_, angle_tolerance_ ) )
+            continue;
+        if ( ! same_symmetry_operators( entry.space_group_, space_group ) )
+            continue;
+        ++nhits_;
+        // Move it to the back.
+        std::rotate( reflection_lists_.begin() + ( i - 1 ), reflection_lists_.begin() + i, reflection_lists_.end() );
+        const ReflectionList & cached_reflection_list = reflection_lists_.back().reflection_list_;
+        std::vector< MillerIndices > miller_indices;
+        std::vector< double > d_spacings;
+        std::vector< size_t > multiplicities;
+        miller_indices.reserve( cached_reflection_list.size() );
+        d_spacings.reserve( cached_reflection_list.size() );
+        multiplicities.reserve( cached_reflection_list.size() );
+        for ( size_t j( 0 ); j != cached_reflection_list.size(); ++j )
+        {
+            miller_indices.push_back( cached_reflection_list.miller_indices( j ) );
+            // Recalculate d for the new unit cell, this also re-sorts the list.
+            d_spacings.push_back( 1.0 / reciprocal_lattice_point( miller_indices.back(), crystal_lattice ).length() );
+            multiplicities.push_back( cached_reflection_list.multiplicity( j ) );
+        }
+        reflection_list = ReflectionList( miller_indices, std::vector< double >( miller_indices.size(), 1.0 ), d_spacings, multiplicities );
+        return true;
+    }
+    ++nmisses_;
+    return false;
+}
+
+// ********************************************************************************
+
+void PowderPatternCalculatorCache::add_reflection_list( const CrystalLattice & crystal_lattice,
+                                                        const SpaceGroup & space_group,
+                                                        const double wavelength,
+                                                        const Angle two_theta_start,
+                                                        const Angle two_theta_end,
+                                                        const bool exact,
+                                                        const ReflectionList & reflection_list )
+{
+    if ( reflection_lists_.size() == maximum_nreflection_lists_ )
+        reflection_lists_.erase( reflection_lists_.begin() );
+    ReflectionListEntry entry;
+    entry.crystal_lattice_ = crystal_lattice;
+    entry.space_group_ = space_group;
+    entry.wavelength_ = wavelength;
+    entry.two_theta_start_ = two_theta_start;
+    entry.two_theta_end_ = two_theta_end;
+    entry.exact_ = exact;
+    entry.reflection_list_ = reflection_list;
+    reflection_lists_.push_back( entry );
+}
+
+// ********************************************************************************
+
+bool PowderPatternCalculatorCache::find_peak_profile_table( const Angle two_theta_step, const double FWHM, const size_t oversampling, PeakProfileTable & peak_profile_table )
+{
+    for ( size_t i( 0 ); i != peak_profile_tables_.size(); ++i )
+    {
+        if ( ( peak_profile_tables_[i].two_theta_step() == two_theta_step.value_in_degrees() ) &&
+             ( peak_profile_tables_[i].FWHM() == FWHM ) &&
+             ( peak_profile_tables_[i].oversampling() == oversampling ) )
+        {
+            ++nhits_;
+            peak_profile_table = peak_profile_tables_[i];
+            return true;
+        }
+    }
+    ++nmisses_;
+    return false;
+}
+
+// ********************************************************************************
+
+void PowderPatternCalculatorCache::add_peak_profile_table( const PeakProfileTable & peak_profile_table )
+{
+    if ( peak_profile_tables_.size() == maximum_nreflection_lists_ )
+        peak_profile_tables_.erase( peak_profile_tables_.begin() );
+    peak_profile_tables_.push_back( peak_profile_table );
+}
+
+// ********************************************************************************
+
+void PowderPatternCalculatorCache::clear()
+{
+    reflection_lists_.clear();
+    peak_profile_tables_.clear();
+    nhits_ = 0;
+    nmisses_ = 0;
+}
+
+// ********************************************************************************
+
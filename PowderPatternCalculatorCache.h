@@ -0,0 +1,121 @@
+#ifndef POWDERPATTERNCALCULATORCACHE_H
+#define POWDERPATTERNCALCULATORCACHE_H
+
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include "Angle.h"
+#include "CrystalLattice.h"
+#include "PeakProfileTable.h"
+#include "ReflectionList.h"
+#include "SpaceGroup.h"
+
+#include <vector>
+
+/*
+  Stores reflection lists and peak profile tables so that they can be reused by a PowderPatternCalculator
+  for the next crystal structure, e.g. for the frames of an MD trajectory or for a list of polymorphs
+  that share the same unit cell and space group. Only F^2 then needs to be recalculated.
+
+  A reflection list is reused if the space group has the same symmetry operators (in any order), the wavelength,
+  the 2theta range and the value of "exact" are the same and the unit cell is the same to within a tolerance.
+  The d-spacings are recalculated for the unit cell of the new crystal structure, so the only approximation is that
+  reflections that are within the tolerance of the 2theta limits may be included or left out differently.
+  F^2 is set to 1.0, as by PowderPatternCalculator::calculate_reflection_list().
+
+  A peak profile table is reused if the 2theta step, the FWHM and the oversampling are the same.
+
+  The least recently used reflection list is removed if more than maximum_nreflection_lists are stored,
+  the oldest peak profile table if more than that number of tables are stored.
+
+  Not thread-safe.
+*/
+class PowderPatternCalculatorCache
+{
+public:
+
+    // Length tolerance is relative (in %), angle tolerance is absolute, as in nearly_equal( CrystalLattice, CrystalLattice ).
+    explicit PowderPatternCalculatorCache( const size_t maximum_nreflection_lists = 16,
+                                           const double length_tolerance_percentage = 0.01,
+                                           const Angle angle_tolerance = Angle::from_degrees( 0.01 ) );
+
+    // Returns false if not found, reflection_list is then unchanged.
+    bool find_reflection_list( const CrystalLattice & crystal_lattice,
+                               const SpaceGroup & space_group,
+                               const double wavelength,
+                               const Angle two_theta_start,
+                               const Angle two_theta_end,
+                               const bool exact,
+                               ReflectionList & reflection_list );
+
+    void add_reflection_list( const CrystalLattice & crystal_lattice,
+                              const SpaceGroup & space_group,
+                              const double wavelength,
+                              const Angle two_theta_start,
+                              const Angle two_theta_end,
+                              const bool exact,
+                              const ReflectionList & reflection_list );
+
+    // Returns false if not found, peak_profile_table is then unchanged.
+    bool find_peak_profile_table( const Angle two_theta_step, const double FWHM, const size_t oversampling, PeakProfileTable & peak_profile_table );
+
+    // The 2theta step, FWHM and oversampling are taken from the table.
+    void add_peak_profile_table( const PeakProfileTable & peak_profile_table );
+
+    size_t nreflection_lists() const { return reflection_lists_.size(); }
+
+    // Counts both reflection lists and peak profile tables.
+    size_t nhits() const { return nhits_; }
+    size_t nmisses() const { return nmisses_; }
+
+    void clear();
+
+private:
+
+    struct ReflectionListEntry
+    {
+        CrystalLattice crystal_lattice_;
+        SpaceGroup space_group_;
+        double wavelength_;
+        Angle two_theta_start_;
+        Angle two_theta_end_;
+        bool exact_;
+        ReflectionList reflection_list_;
+    };
+
+    size_t maximum_nreflection_lists_;
+    double length_tolerance_percentage_;
+    Angle angle_tolerance_;
+    // The most recently used one is at the back.
+    std::vector< ReflectionListEntry > reflection_lists_;
+    std::vector< PeakProfileTable > peak_profile_tables_;
+    size_t nhits_;
+    size_t nmisses_;
+};
+
+#endif // POWDERPATTERNCALCULATORCACHE_H
+
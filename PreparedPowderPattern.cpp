@@ -0,0 +1,172 @@
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include "PreparedPowderPattern.h"
+#include "BasicMathsFunctions.h"
+#include "MathsFunctions.h"
+#include "PowderPattern.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace
+{
+
+// ********************************************************************************
+
+// In-place radix-2 discrete Fourier transform, X(f) = sum_n x(n) exp( -2 pi i f n / N ). N must be a power of 2.
+void fast_Fourier_transform( std::vector< double > & real, std::vector< double > & imaginary )
+{
+    size_t n = real.size();
+    // Bit-reversal permutation.
+    for ( size_t i( 1 ), j( 0 ); i < n; ++i )
+    {
+        size_t bit = n >> 1;
+        for ( ; j & bit; bit >>= 1 )
+            j ^= bit;
+        j ^= bit;
+        if ( i < j )
+        {
+            std::swap( real[i], real[j] );
+            std::swap( imaginary[i], imaginary[j] );
+        }
+    }
+    for ( size_t length( 2 ); length <= n; length <<= 1 )
+    {
+        size_t half_length = length / 2;
+        // The twiddle factors are calculated directly rather than by recursion, to keep the rounding errors small.
+        std::vector< double > cosines( half_length );
+        std::vector< double > sines( half_length );
+        for ( size_t k( 0 ); k != half_length; ++k )
+        {
+            cosines[k] = cos( 2.0 * CONSTANT_PI * k / length );
+            sines[k] = -sin( 2.0 * CONSTANT_PI * k / length );
+        }
+        for ( size_t i( 0 ); i < n; i += length )
+        {
+            for ( size_t k( 0 ); k != half_length; ++k )
+            {
+                size_t p = i + k;
+                size_t q = p + half_length;
+                double t_real = real[q] * cosines[k] - imaginary[q] * sines[k];
+                double t_imaginary = real[q] * sines[k] + imaginary[q] * cosines[k];
+                real[q] = real[p] - t_real;
+                imaginary[q] = imaginary[p] - t_imaginary;
+                real[p] += t_real;
+                imaginary[p] += t_imaginary;
+            }
+        }
+    }
+}
+
+// ********************************************************************************
+
+void check_compatible( const PreparedPowderPattern & lhs, const PreparedPowderPattern & rhs )
+{
+    if ( ( lhs.size() != rhs.size() ) ||
+         ( ( lhs.size() != 0 ) && ( ! nearly_equal( lhs.two_theta_start(), rhs.two_theta_start() ) || ! nearly_equal( lhs.two_theta_end(), rhs.two_theta_end() ) ) ) )
+        throw std::runtime_error( "weighted_cross_correlation( PreparedPowderPattern, PreparedPowderPattern ): Error: ranges not same." );
+    if ( lhs.m() != rhs.m() )
+        throw std::runtime_error( "weighted_cross_correlation( PreparedPowderPattern, PreparedPowderPattern ): Error: prepared with different l." );
+}
+
+} // namespace
+
+// ********************************************************************************
+
+PreparedPowderPattern::PreparedPowderPattern():
+npoints_(0),
+m_(1),
+self_term_(0.0)
+{
+}
+
+// ********************************************************************************
+
+PreparedPowderPattern::PreparedPowderPattern( const PowderPattern & powder_pattern, const Angle l ):
+npoints_(powder_pattern.size()),
+m_(1),
+self_term_(0.0)
+{
+    if ( l < Angle() )
+        throw std::runtime_error( "PreparedPowderPattern::PreparedPowderPattern(): Error: l must be non-negative." );
+    if ( npoints_ == 0 )
+        return;
+    two_theta_start_ = powder_pattern.two_theta_start();
+    two_theta_end_ = powder_pattern.two_theta_end();
+    int m = round_to_int( l / powder_pattern.average_two_theta_step() );
+    if ( m > 1 )
+        m_ = m;
+    // Zero padding: shifts of up to m-1 points must not wrap around, and the triangle must not overlap with itself.
+    size_t n( 1 );
+    while ( ( n < npoints_ + m_ - 1 ) || ( n < 2 * m_ - 1 ) )
+        n <<= 1;
+    std::vector< double > real( n, 0.0 );
+    std::vector< double > imaginary( n, 0.0 );
+    for ( size_t i( 0 ); i != npoints_; ++i )
+        real[i] = powder_pattern.intensity( i );
+    fast_Fourier_transform( real, imaginary );
+    // The triangle w(j) = 1 - |j|/m is the autocorrelation of a block of m ones divided by m,
+    // its Fourier transform is ( sin( pi f m / n ) / sin( pi f / n ) )^2 / m.
+    // By Parseval, sum_j w(j) sum_i A(i) B(i+j) = (1/n) sum_f W(f) Re( conj( A(f) ) B(f) ).
+    // The input is real, so f and n-f contribute the same and only f = 0 ... n/2 are stored.
+    values_.reserve( n + 2 );
+    for ( size_t f( 0 ); f <= n / 2; ++f )
+    {
+        double sqrt_W;
+        if ( f == 0 )
+            sqrt_W = sqrt( static_cast<double>( m_ ) );
+        else
+            sqrt_W = fabs( sin( CONSTANT_PI * f * m_ / n ) / sin( CONSTANT_PI * f / n ) ) / sqrt( static_cast<double>( m_ ) );
+        double multiplicity = ( ( f == 0 ) || ( f == n / 2 ) ) ? 1.0 : 2.0;
+        double factor = sqrt_W * sqrt( multiplicity / n );
+        values_.push_back( factor * real[f] );
+        values_.push_back( factor * imaginary[f] );
+    }
+    self_term_ = dot_product( &values_[0], &values_[0], values_.size() );
+}
+
+// ********************************************************************************
+
+double weighted_cross_correlation( const PreparedPowderPattern & lhs, const PreparedPowderPattern & rhs )
+{
+    check_compatible( lhs, rhs );
+    if ( lhs.size() == 0 )
+        return 0.0;
+    return dot_product( &lhs.values()[0], &rhs.values()[0], lhs.values().size() );
+}
+
+// ********************************************************************************
+
+double normalised_weighted_cross_correlation( const PreparedPowderPattern & lhs, const PreparedPowderPattern & rhs )
+{
+    return weighted_cross_correlation( lhs, rhs ) / sqrt( lhs.self_term() * rhs.self_term() );
+}
+
+// ********************************************************************************
+
@@ -0,0 +1,94 @@
+#ifndef PREPAREDPOWDERPATTERN_H
+#define PREPAREDPOWDERPATTERN_H
+
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+class PowderPattern;
+
+#include "Angle.h"
+
+#include <cstddef> // For definition of size_t
+#include <vector>
+
+/*
+  A powder pattern prepared for many weighted cross correlations with the same triangle width l,
+  e.g. to compare one pattern against a database or to fill a correlation matrix.
+
+  The weighted cross correlation
+
+      sum_i sum_j w(j) A(i) B(i+j), with w(j) = 1 - |j|/m for |j| < m and m = l / (2theta step)
+
+  is a correlation with a triangle, and the Fourier transform of the triangle (the Fejer kernel) is never negative.
+  The constructor zero-pads the intensities (so that there is no wrap-around), Fourier transforms them and multiplies them
+  by the square root of the Fejer kernel. The weighted cross correlation of two prepared patterns is then a dot product
+  of about 2N terms instead of a double loop over N(2m-1) terms. The self term weighted_cross_correlation( A, A )
+  is calculated once, in the constructor.
+
+  Agrees with weighted_cross_correlation( PowderPattern, PowderPattern, Angle ) to within rounding errors.
+  Assumes uniform 2theta step size.
+*/
+class PreparedPowderPattern
+{
+public:
+
+    // Default constructor: no points.
+    PreparedPowderPattern();
+
+    explicit PreparedPowderPattern( const PowderPattern & powder_pattern, const Angle l = Angle( 3.0, Angle::DEGREES ) );
+
+    size_t size() const { return npoints_; }
+    Angle two_theta_start() const { return two_theta_start_; }
+    Angle two_theta_end() const { return two_theta_end_; }
+
+    // The half width of the triangle in points.
+    size_t m() const { return m_; }
+
+    // weighted_cross_correlation( A, A ).
+    double self_term() const { return self_term_; }
+
+    // The Fourier coefficients multiplied by the square root of the Fejer kernel, real and imaginary parts interleaved.
+    const std::vector< double > & values() const { return values_; }
+
+private:
+    size_t npoints_;
+    Angle two_theta_start_;
+    Angle two_theta_end_;
+    size_t m_;
+    double self_term_;
+    std::vector< double > values_;
+};
+
+// Same as weighted_cross_correlation( PowderPattern, PowderPattern, Angle ).
+// Throws if the two patterns do not have the same range or have been prepared with a different l.
+double weighted_cross_correlation( const PreparedPowderPattern & lhs, const PreparedPowderPattern & rhs );
+
+// Same as normalised_weighted_cross_correlation( PowderPattern, PowderPattern, Angle ), but only one dot product.
+double normalised_weighted_cross_correlation( const PreparedPowderPattern & lhs, const PreparedPowderPattern & rhs );
+
+#endif // PREPAREDPOWDERPATTERN_H
+
@@ -27,8 +27,10 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "ReadCif.h"
 #include "CheckFoundItem.h"
+#include "CifTokeniser.h"
 #include "CrystalStructure.h"
 #include "FileName.h"
+#include "MemoryMappedFile.h"
 #include "StringFunctions.h"
 #include "TextFileReader.h"
 #include "TextFileWriter.h"
@@ -40,9 +42,17 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace {
     
-bool contains_valid_value( const std::string & input )
+bool contains_valid_value( const CifToken & input )
 {
-    return ( input != ".") && ( input != "?");
+    return ! input.is_placeholder();
+}
+
+// ********************************************************************************
+
+// Reads the number in place, without copying the token.
+double string2double( const CifToken & input )
+{
+    return ::string2double( input.begin_, input.end_ );
 }
 
 class AtomLineInterpreter
@@ -92,7 +102,7 @@ public:
             all_items_found_ = false;
     }
     
-    void interpret( const std::vector< std::string > & words, CrystalStructure & crystal_structure ) const
+    void interpret( const std::vector< CifToken > & words, CrystalStructure & crystal_structure ) const
     {
         if ( ! all_items_found_ )
             return;
@@ -103,10 +113,10 @@ public:
         double z = string2double( words[z_coordinate_index_] );
         std::string label;
         if ( site_label_index_ != loop_items_size_ )
-            label = words[site_label_index_];
+            label = words[site_label_index_].str();
         std::string element_string;
         if ( site_type_symbol_index_ != loop_items_size_ )
-            element_string = words[site_type_symbol_index_];
+            element_string = words[site_type_symbol_index_].str();
         if ( site_label_index_ == loop_items_size_ )
             label = element_string;
         if ( site_type_symbol_index_ == loop_items_size_ )
@@ -194,14 +204,14 @@ public:
             throw std::runtime_error( "read_cif(): _atom_site_aniso_U_23 missing from _atom_site_aniso loop_." );
     }
 
-    void interpret( const std::vector< std::string > & words, CrystalStructure & crystal_structure ) const
+    void interpret( const std::vector< CifToken > & words, CrystalStructure & crystal_structure ) const
     {
         if ( words.size() != loop_items_size_ )
         {
             std::cout << "loop_items_size_ = " << loop_items_size_ << std::endl;
             for ( size_t i( 0 ); i != words.size(); ++i )
             {
-                std::cout << words[i] << std::endl;
+                std::cout << words[i].str() << std::endl;
             }
             throw std::runtime_error( "read_cif(): atom aniso line must have same number of items as specified in loop." );
         }
@@ -214,14 +224,14 @@ public:
         SymmetricMatrix3D U_cif( U11, U22, U33, U12, U13, U23 );
         // We store Ucif here (should be Ucart) because we do not have the lattice yet. We do the transformation later.
         AnisotropicDisplacementParameters adps = AnisotropicDisplacementParameters( U_cif );
-        size_t i = crystal_structure.find_label( words[label_index_] );
+        size_t i = crystal_structure.find_label( words[label_index_].str() );
         if ( i == crystal_structure.natoms() )
-            std::cout << "read_cif(): warning: atom " + words[label_index_] + " is in aniso list but not in the list of atoms." << std::endl;
+            std::cout << "read_cif(): warning: atom " + words[label_index_].str() + " is in aniso list but not in the list of atoms." << std::endl;
         else
         {
             Atom new_atom = crystal_structure.atom( i );
             if ( new_atom.ADPs_type() == Atom::ANISOTROPIC )
-                std::cout << "read_cif(): warning: atom " + words[label_index_] + " is in aniso list but already has ADPs." << std::endl;
+                std::cout << "read_cif(): warning: atom " + words[label_index_].str() + " is in aniso list but already has ADPs." << std::endl;
             new_atom.set_anisotropic_displacement_parameters( adps );
             crystal_structure.set_atom( i, new_atom );
         }
@@ -241,7 +251,27 @@ private:
 
 // ********************************************************************************
 
-void deal_with_atom_loop( TextFileReader & text_file_reader, const std::vector< std::string > & loop_items, CrystalStructure & crystal_structure )
+// Reads the values of one row of a loop_, a row may span several lines and several rows may share a line.
+// Stops at the first token that is not a value, so the last row can be incomplete. Returns false if there are no more rows.
+bool get_next_loop_row( CifTokeniser & cif_tokeniser, const size_t nitems, std::vector< CifToken > & row )
+{
+    row.clear();
+    CifToken token;
+    while ( ( row.size() != nitems ) && cif_tokeniser.next( token ) )
+    {
+        if ( token.type_ != CifToken::VALUE )
+        {
+            cif_tokeniser.push_back_last_token();
+            break;
+        }
+        row.push_back( token );
+    }
+    return ! row.empty();
+}
+
+// ********************************************************************************
+
+void deal_with_atom_loop( CifTokeniser & cif_tokeniser, const std::vector< std::string > & loop_items, CrystalStructure & crystal_structure )
 {
 // We need:
 //_atom_site_label
@@ -251,24 +281,15 @@ void deal_with_atom_loop( TextFileReader & text_file_reader, const std::vector<
 //_atom_site_fract_z
 
     AtomLineInterpreter atom_line_interpreter( loop_items );
-    std::vector< std::string > words;
-    do // Read the atoms.
-    {
-        if ( ! text_file_reader.get_next_line( words ) )
-            return;
-        if ( ( words[0][0] == '_' ) || ( words[0] == "loop_" ) )
-        {
-            text_file_reader.push_back_last_line();
-            return;
-        }
-        // When we are here, we have an atom line.
+    std::vector< CifToken > words;
+    words.reserve( loop_items.size() );
+    while ( get_next_loop_row( cif_tokeniser, loop_items.size(), words ) ) // Read the atoms.
         atom_line_interpreter.interpret( words, crystal_structure );
-    } while ( true );
 }
 
 // ********************************************************************************
 
-void deal_with_symmetry_loop( TextFileReader & text_file_reader, const std::vector< std::string > & loop_items, CrystalStructure & crystal_structure )
+void deal_with_symmetry_loop( CifTokeniser & cif_tokeniser, const std::vector< std::string > & loop_items, CrystalStructure & crystal_structure )
 {
 //loop_
 //_symmetry_equiv_pos_site_id
@@ -276,8 +297,6 @@ void deal_with_symmetry_loop( TextFileReader & text_file_reader, const std::vect
 // Example: -y+x,-y,1/3+z
 //1 x,y,z
 
-    bool skip_whitespace_only_lines = text_file_reader.skip_whitespace_only_lines();
-    text_file_reader.set_skip_whitespace_only_lines( true );
     size_t symmetry_equiv_pos_as_xyz_index = loop_items.size();
     for ( size_t i( 0 ); i != loop_items.size(); ++i )
     {
@@ -287,33 +306,21 @@ void deal_with_symmetry_loop( TextFileReader & text_file_reader, const std::vect
     if ( symmetry_equiv_pos_as_xyz_index == loop_items.size() )
         throw std::runtime_error( "read_cif(): _symmetry_equiv_pos_as_xyz or _space_group_symop_operation_xyz must be present." );
     std::vector< SymmetryOperator > symmetry_operators;
-    std::vector< std::string > words;
-    bool finished( false );
-    do // Read the symmetry operators.
+    std::vector< CifToken > words;
+    while ( get_next_loop_row( cif_tokeniser, loop_items.size(), words ) ) // Read the symmetry operators.
     {
-        if ( ! text_file_reader.get_next_line( words ) )
-            finished = true;
-        else if ( ( words[0][0] == '_' ) || ( words[0] == "loop_" ) )
-        {
-            text_file_reader.push_back_last_line();
-            finished = true;
-        }
-        else // When we are here, we have a symmetry line.
-        {
-            if ( words.size() != loop_items.size() )
-                throw std::runtime_error( "read_cif(): symmetry line must have same number of items as specified in loop." );
-            SymmetryOperator symmetry_operator( words[symmetry_equiv_pos_as_xyz_index] );
-            symmetry_operators.push_back( symmetry_operator );
-        }
-    } while ( ! finished );
-    text_file_reader.set_skip_whitespace_only_lines( skip_whitespace_only_lines );
+        if ( words.size() != loop_items.size() )
+            throw std::runtime_error( "read_cif(): symmetry line must have same number of items as specified in loop." );
+        SymmetryOperator symmetry_operator( words[symmetry_equiv_pos_as_xyz_index].str() );
+        symmetry_operators.push_back( symmetry_operator );
+    }
     SpaceGroup space_group( symmetry_operators, "P21/c" );
     crystal_structure.set_space_group( space_group );
 }
 
 // ********************************************************************************
 
-void deal_with_aniso_loop( TextFileReader & text_file_reader, const std::vector< std::string > & loop_items, CrystalStructure & crystal_structure )
+void deal_with_aniso_loop( CifTokeniser & cif_tokeniser, const std::vector< std::string > & loop_items, CrystalStructure & crystal_structure )
 {
 //    loop_
 //    _atom_site_aniso_label
@@ -326,76 +333,58 @@ void deal_with_aniso_loop( TextFileReader & text_file_reader, const std::vector<
 //    Cl1 0.1071(7) 0.1580(10) 0.0482(5) -0.0068(7) 0.0000(5) -0.0108(5)
 
     AnisoLineInterpreter aniso_line_interpreter( loop_items );
-    std::vector< std::string > words;
-    do // Read the ADPs.
-    {
-        if ( ! text_file_reader.get_next_line( words ) )
-            return;
-        if ( ( words[0][0] == '_' ) || ( words[0] == "loop_" ) )
-        {
-            text_file_reader.push_back_last_line();
-            return;
-        }
-        // When we are here, we have an aniso line.
+    std::vector< CifToken > words;
+    words.reserve( loop_items.size() );
+    while ( get_next_loop_row( cif_tokeniser, loop_items.size(), words ) ) // Read the ADPs.
         aniso_line_interpreter.interpret( words, crystal_structure );
-    } while ( true );
 }
 
 // ********************************************************************************
 
-void get_loop_items( TextFileReader & text_file_reader, std::vector< std::string > & loop_items )
+void get_loop_items( CifTokeniser & cif_tokeniser, std::vector< std::string > & loop_items )
 {
-    std::vector< std::string > words;
-    bool OK( true );
-    do // Read the loop item keywords.
+    CifToken token;
+    while ( cif_tokeniser.next( token ) ) // Read the loop item keywords.
     {
-        if ( ! text_file_reader.get_next_line( words ) )
-            throw std::runtime_error( "read_cif(): loop empty." );
-        if ( words[0][0] == '_' )
-        {
-            if ( words.size() != 1 )
-                throw std::runtime_error( "read_cif(): loop_ item cannot have value." );
-            loop_items.push_back( words[0] );
-        }
-        else
+        if ( token.type_ != CifToken::TAG )
         {
-            text_file_reader.push_back_last_line();
-            return;
+            cif_tokeniser.push_back_last_token();
+            break;
         }
-    } while ( OK );
+        loop_items.push_back( token.str() );
+    }
+    if ( loop_items.empty() )
+        throw std::runtime_error( "read_cif(): no keyword after loop keyword." );
 }
 
 // ********************************************************************************
 
-void deal_with_loop( TextFileReader & text_file_reader, CrystalStructure & crystal_structure, bool & symmetry_matrices_found )
+void deal_with_loop( CifTokeniser & cif_tokeniser, CrystalStructure & crystal_structure, bool & symmetry_matrices_found )
 {
-    std::vector< std::string > words;
-    if ( ! text_file_reader.get_next_line( words ) )
-        throw std::runtime_error( "read_cif(): loop empty." );
-    if ( words[0].length() < 5 )
-        throw std::runtime_error( "read_cif(): unrecognised loop keyword." );
-    if ( words[0][0] != '_' )
-        throw std::runtime_error( "read_cif(): no keyword after loop keyword." );
-    text_file_reader.push_back_last_line();
     std::vector< std::string > loop_items;
-    get_loop_items( text_file_reader, loop_items );
-    if ( words[0].substr( 0, 16 ) == "_atom_site_aniso" )
+    get_loop_items( cif_tokeniser, loop_items );
+    if ( loop_items[0].length() < 5 )
+        throw std::runtime_error( "read_cif(): unrecognised loop keyword." );
+    if ( loop_items[0].substr( 0, 16 ) == "_atom_site_aniso" )
     {
-        deal_with_aniso_loop( text_file_reader, loop_items, crystal_structure );
+        deal_with_aniso_loop( cif_tokeniser, loop_items, crystal_structure );
         return;
     }
-    if ( words[0].substr( 0, 5 ) == "_atom" )
+    if ( loop_items[0].substr( 0, 5 ) == "_atom" )
     {
-        deal_with_atom_loop( text_file_reader, loop_items, crystal_structure );
+        deal_with_atom_loop( cif_tokeniser, loop_items, crystal_structure );
         return;
     }
-    if ( ( words[0].substr( 0, 9 ) == "_symmetry" ) || ( words[0].substr( 0, 18 ) == "_space_group_symop" ) )
+    if ( ( loop_items[0].substr( 0, 9 ) == "_symmetry" ) || ( loop_items[0].substr( 0, 18 ) == "_space_group_symop" ) )
     {
-        deal_with_symmetry_loop( text_file_reader, loop_items, crystal_structure );
+        deal_with_symmetry_loop( cif_tokeniser, loop_items, crystal_structure );
         symmetry_matrices_found = true;
         return;
     }
     // For the moment we ignore everything else.
+    std::vector< CifToken > words;
+    while ( get_next_loop_row( cif_tokeniser, loop_items.size(), words ) )
+        ;
 }
 
 // ********************************************************************************
@@ -437,15 +426,21 @@ void deal_with_loop( TextFileReader & text_file_reader, CrystalStructure & cryst
 
 // A very simple cif reader, can essentially only read cifs from MD trajectories
 // from Materials Studio.
-void read_cif( const FileName & file_name, CrystalStructure & crystal_structure )
+// The text is tokenised in place, only the values that are actually used are copied.
+bool read_cif_data_block( CifTokeniser & cif_tokeniser, CrystalStructure & crystal_structure )
 {
+    CifToken token;
+    if ( ! cif_tokeniser.next( token ) )
+        return false;
     crystal_structure = CrystalStructure();
-    TextFileReader text_file_reader( file_name );
-    text_file_reader.set_skip_empty_lines( true ); // This is crucial.
-    std::vector< std::string > comment_identifiers;
-    comment_identifiers.push_back( "#" );
-    text_file_reader.set_comment_identifiers( comment_identifiers );
+    // The aniso loop looks up every atom by its label.
+    crystal_structure.set_use_label_index( true );
     std::string name;
+    // According to the cif standard, data_ and loop_ are case-insensitive, the tokeniser takes care of that.
+    if ( token.type_ == CifToken::DATA_BLOCK )
+        name = std::string( token.begin_ + 5, token.end_ );
+    else
+        cif_tokeniser.push_back_last_token();
     std::string space_group_str;
     bool found_a( false );
     bool found_b( false );
@@ -460,67 +455,60 @@ void read_cif( const FileName & file_name, CrystalStructure & crystal_structure
     Angle beta;
     Angle gamma;
     bool symmetry_matrices_found( false );
-    std::vector< std::string > words;
-    while ( text_file_reader.get_next_line( words ) )
+    CifToken value;
+    while ( cif_tokeniser.next( token ) )
     {
-        // According to the cif standard, data_ and loop_ are case-insensitive.
-        if ( ( words[0].length() > 4 ) && ( to_lower( words[0].substr( 0, 5 ) ) == "data_" ) )
+        if ( token.type_ == CifToken::DATA_BLOCK ) // The start of the next data block.
+        {
+            cif_tokeniser.push_back_last_token();
+            break;
+        }
+        if ( token.type_ == CifToken::LOOP )
         {
-            if ( words.size() != 1 )
-                throw std::runtime_error( "read_cif(): data_ keyword cannot have a value." );
-            name = words[0].substr( 5, std::string::npos );
+            deal_with_loop( cif_tokeniser, crystal_structure, symmetry_matrices_found );
             continue;
         }
-        if ( to_lower( words[0] == "loop_" ) )
+        // Save frames and stray values are ignored, as are tags that are not followed by a value.
+        if ( token.type_ != CifToken::TAG )
+            continue;
+        if ( ! cif_tokeniser.next( value ) )
+            break;
+        if ( value.type_ != CifToken::VALUE )
         {
-            if ( words.size() != 1 )
-                throw std::runtime_error( "read_cif(): loop_ keyword cannot have a value." );
-            deal_with_loop( text_file_reader, crystal_structure, symmetry_matrices_found );
+            cif_tokeniser.push_back_last_token();
             continue;
         }
-        if ( words.size() == 2 )
+        if ( token.equals( "_symmetry_space_group_name_H-M" ) )
+            space_group_str = value.str();
+        else if ( token.equals( "_cell_length_a" ) )
         {
-            if ( words[0] == "_symmetry_space_group_name_H-M" )
-            {
-                space_group_str = words[1];
-                continue;
-            }
-            if ( words[0] == "_cell_length_a" )
-            {
-                a = string2double( words[1] );
-                found_a = true;
-                continue;
-            }
-            if ( words[0] == "_cell_length_b" )
-            {
-                b = string2double( words[1] );
-                found_b = true;
-                continue;
-            }
-            if ( words[0] == "_cell_length_c" )
-            {
-                c = string2double( words[1] );
-                found_c = true;
-                continue;
-            }
-            if ( words[0] == "_cell_angle_alpha" )
-            {
-                alpha = Angle::from_degrees( string2double( words[1] ) );
-                found_alpha = true;
-                continue;
-            }
-            if ( words[0] == "_cell_angle_beta" )
-            {
-                beta = Angle::from_degrees( string2double( words[1] ) );
-                found_beta = true;
-                continue;
-            }
-            if ( words[0] == "_cell_angle_gamma" )
-            {
-                gamma = Angle::from_degrees( string2double( words[1] ) );
-                found_gamma = true;
-                continue;
-            }
+            a = string2double( value );
+            found_a = true;
+        }
+        else if ( token.equals( "_cell_length_b" ) )
+        {
+            b = string2double( value );
+            found_b = true;
+        }
+        else if ( token.equals( "_cell_length_c" ) )
+        {
+            c = string2double( value );
+            found_c = true;
+        }
+        else if ( token.equals( "_cell_angle_alpha" ) )
+        {
+            alpha = Angle::from_degrees( string2double( value ) );
+            found_alpha = true;
+        }
+        else if ( token.equals( "_cell_angle_beta" ) )
+        {
+            beta = Angle::from_degrees( string2double( value ) );
+            found_beta = true;
+        }
+        else if ( token.equals( "_cell_angle_gamma" ) )
+        {
+            gamma = Angle::from_degrees( string2double( value ) );
+            found_gamma = true;
         }
     }
     if ( ! ( found_a && found_b && found_c && found_alpha && found_beta && found_gamma ) )
@@ -548,6 +536,19 @@ void read_cif( const FileName & file_name, CrystalStructure & crystal_structure
         space_group.set_name( space_group_str );
         crystal_structure.set_space_group( space_group );
     }
+    return true;
+}
+
+// ********************************************************************************
+
+// The file is memory mapped, so it is never copied as a whole.
+void read_cif( const FileName & file_name, CrystalStructure & crystal_structure )
+{
+    crystal_structure = CrystalStructure();
+    MemoryMappedFile memory_mapped_file( file_name );
+    CifTokeniser cif_tokeniser( memory_mapped_file.data(), memory_mapped_file.data() + memory_mapped_file.size() );
+    // As before, a file without any tokens gives an empty crystal structure.
+    read_cif_data_block( cif_tokeniser, crystal_structure );
 }
 
 // ********************************************************************************
@@ -28,12 +28,19 @@ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ********************************************* */
 
+class CifTokeniser;
 class CrystalStructure;
 class FileName;
 
 // Can only read extremely simple cifs such as those written out by Mercury, GRACE or the MD in Materials Studio.
+// Only the first data block is read, use CifArchive for files that contain more than one crystal structure.
+// An empty file (or one with only comments) gives an empty CrystalStructure.
 void read_cif( const FileName & file_name, CrystalStructure & crystal_structure );
 
+// Reads one data block: its data_ header (tokens before the first data_ header are taken to belong to the first block)
+// up to, but not including, the next data_ header. Returns false, and leaves crystal_structure unchanged, if there are no more tokens.
+bool read_cif_data_block( CifTokeniser & cif_tokeniser, CrystalStructure & crystal_structure );
+
 // Entirely text based: removes all lines with five fields or more of which the first field starts with "H" or "D",
 // the second field is "H" or "D" and the third, fourth and fifth field are floating point numbers.
 void remove_hydrogen_atoms( const FileName & input_file_name, const FileName & output_file_name );
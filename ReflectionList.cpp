@@ -44,6 +44,19 @@ ReflectionList::ReflectionList()
 
 // ********************************************************************************
 
+ReflectionList::ReflectionList( const std::vector< MillerIndices > & miller_indices, const std::vector< double > & F_squared, const std::vector< double > & d_spacings, const std::vector< size_t > & multiplicities ):
+miller_indices_(miller_indices),
+F_squared_(F_squared),
+d_spacings_(d_spacings),
+multiplicity_(multiplicities)
+{
+    if ( ( F_squared_.size() != miller_indices_.size() ) || ( d_spacings_.size() != miller_indices_.size() ) || ( multiplicity_.size() != miller_indices_.size() ) )
+        throw std::runtime_error( "ReflectionList::ReflectionList(): Error: sizes of lists are not the same." );
+    sort_by_d_spacing();
+}
+
+// ********************************************************************************
+
 void ReflectionList::push_back( const MillerIndices & miller_indices, const double F_squared, const double d_spacing, const size_t multiplicity )
 {
     miller_indices_.push_back( miller_indices );
@@ -44,6 +44,9 @@ public:
 
     ReflectionList();
 
+    // push_back() sorts the list every time, this sorts it only once, which is much faster for a large number of reflections.
+    ReflectionList( const std::vector< MillerIndices > & miller_indices, const std::vector< double > & F_squared, const std::vector< double > & d_spacings, const std::vector< size_t > & multiplicities );
+
     void push_back( const MillerIndices & miller_indices, const double F_squared, const double d_spacing, const size_t multiplicity );
 
     void reserve( const size_t nvalues );
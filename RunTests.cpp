@@ -36,10 +36,14 @@ void run_tests()
     try
     {
         test_angle( test_suite );
+        test_BatchRMSCD( test_suite );
         test_Chebyshev_background( test_suite );
         test_chemical_formula( test_suite );
+        test_CifArchive( test_suite );
+        test_CifTokeniser( test_suite );
         test_Complex( test_suite );
         test_Constraints( test_suite );
+        test_ConnectivityTable( test_suite );
         test_ConvexPolygon( test_suite );
         test_correlation_matrix( test_suite );
         test_crystal_lattice( test_suite );
@@ -52,8 +56,13 @@ void run_tests()
         test_MatrixFraction3D( test_suite );
         test_maths( test_suite );
         test_ModelBuilding( test_suite );
+        test_NeighbourSearch( test_suite );
         test_OrientationalOrderParameters( test_suite );
+        test_PeakProfileTable( test_suite );
+        test_PhaseSumKernel( test_suite );
         test_PowderPattern( test_suite );
+        test_PowderPatternArchive( test_suite );
+        test_PowderPatternCalculator( test_suite );
         test_quaternion( test_suite );
         test_ReadCell( test_suite );
         test_sort( test_suite );
@@ -61,10 +70,14 @@ void run_tests()
         test_SphericalHarmonics( test_suite );
         test_StringFunctions( test_suite );
         test_StringConversions( test_suite );
+        test_StructureFactorCalculator( test_suite );
         test_SudokuSolver( test_suite );
         test_TextFileReader_2( test_suite );
+        test_TextFileWriter( test_suite );
+        test_ThreadPool( test_suite );
         test_TLS_ADPs( test_suite );
         test_utilities( test_suite );
+        test_VoidsFinder( test_suite );
         test_3D_calculations( test_suite );
     }
     catch ( std::exception& e )
@@ -31,10 +31,14 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 class TestSuite;
 
 void test_angle( TestSuite & test_suite );
+void test_BatchRMSCD( TestSuite & test_suite );
 void test_Chebyshev_background( TestSuite & test_suite );
 void test_chemical_formula( TestSuite & test_suite );
+void test_CifArchive( TestSuite & test_suite );
+void test_CifTokeniser( TestSuite & test_suite );
 void test_Complex( TestSuite & test_suite );
 void test_Constraints( TestSuite & test_suite );
+void test_ConnectivityTable( TestSuite & test_suite );
 void test_ConvexPolygon( TestSuite & test_suite );
 void test_correlation_matrix( TestSuite & test_suite );
 void test_crystal_lattice( TestSuite & test_suite );
@@ -47,8 +51,13 @@ void test_matrix3D( TestSuite & test_suite );
 void test_MatrixFraction3D( TestSuite & test_suite );
 void test_maths( TestSuite & test_suite );
 void test_ModelBuilding( TestSuite & test_suite );
+void test_NeighbourSearch( TestSuite & test_suite );
 void test_OrientationalOrderParameters( TestSuite & test_suite );
+void test_PeakProfileTable( TestSuite & test_suite );
+void test_PhaseSumKernel( TestSuite & test_suite );
 void test_PowderPattern( TestSuite & test_suite );
+void test_PowderPatternArchive( TestSuite & test_suite );
+void test_PowderPatternCalculator( TestSuite & test_suite );
 void test_quaternion( TestSuite & test_suite );
 void test_ReadCell( TestSuite & test_suite );
 void test_sort( TestSuite & test_suite );
@@ -56,10 +65,14 @@ void test_space_group( TestSuite & test_suite );
 void test_SphericalHarmonics( TestSuite & test_suite );
 void test_StringConversions( TestSuite & test_suite );
 void test_StringFunctions( TestSuite & test_suite );
+void test_StructureFactorCalculator( TestSuite & test_suite );
 void test_SudokuSolver( TestSuite & test_suite );
 void test_TextFileReader_2( TestSuite & test_suite );
+void test_TextFileWriter( TestSuite & test_suite );
+void test_ThreadPool( TestSuite & test_suite );
 void test_TLS_ADPs( TestSuite & test_suite );
 void test_utilities( TestSuite & test_suite );
+void test_VoidsFinder( TestSuite & test_suite );
 void test_3D_calculations( TestSuite & test_suite );
 
 void run_tests();
@@ -26,128 +26,167 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ********************************************* */
 
 #include "SimilarityAnalysis.h"
+#include "CifArchive.h"
 
 #include "CorrelationMatrix.h"
 #include "CrystalStructure.h"
 #include "FileList.h"
 #include "PowderPattern.h"
 #include "PowderPatternCalculator.h"
+#include "PowderPatternCalculatorCache.h"
+#include "PreparedPowderPattern.h"
 #include "ReadCif.h"
+#include "ThreadPool.h"
 #include "Utilities.h"
 
+#include <algorithm>
+#include <functional>
 #include <iostream>
 #include <vector>
 
+namespace
+{
+
 // ********************************************************************************
 
-CorrelationMatrix calculate_correlation_matrix( const FileList & file_list )
+// Reads the crystal structures and calculates and prepares their powder patterns, the structures are divided over the threads.
+// read_crystal_structure( i, crystal_structure ) must be thread-safe.
+// The cache is not thread-safe, so each block of consecutive structures has its own cache.
+// Polymorphs or MD frames that share a unit cell and space group are usually consecutive.
+// The cache reuses reflection lists for unit cells that are equal within a tolerance, so the patterns depend on which
+// structures share a cache: the blocks have a fixed size, so that the result does not depend on the number of threads.
+std::vector< PreparedPowderPattern > calculate_prepared_powder_patterns( const size_t nstructures,
+                                                                         const std::function< void( const size_t, CrystalStructure & ) > & read_crystal_structure,
+                                                                         const bool set_F_squared_to_1,
+                                                                         const Angle l,
+                                                                         ThreadPool & thread_pool )
 {
-    std::vector< PowderPattern > powder_patterns;
-    powder_patterns.reserve( file_list.size() );
     Angle two_theta_start( 3.0, Angle::DEGREES );
     Angle two_theta_end(  35.0, Angle::DEGREES );
     Angle two_theta_step( 0.01, Angle::DEGREES );
     double FWHM( 0.1 );
-    for ( size_t i( 0 ); i != file_list.size(); ++i )
+    std::vector< PreparedPowderPattern > result( nstructures );
+    const size_t block_size( 32 );
+    size_t nblocks = ( nstructures + block_size - 1 ) / block_size;
+    std::cout << "Now calculating " << nstructures << " powder patterns with " << thread_pool.nthreads() << " threads" << std::endl;
+    thread_pool.run( nblocks, [&]( const size_t iBlock )
     {
-        CrystalStructure crystal_structure;
-        std::cout << "Now reading cif... " + file_list.value( i ).full_name() << std::endl;
-        read_cif( file_list.value( i ), crystal_structure );
-        crystal_structure.apply_space_group_symmetry();
-        std::cout << "Now calculating powder pattern... " + size_t2string( i, 4, '0' ) << std::endl;
-        PowderPatternCalculator powder_pattern_calculator( crystal_structure );
-        powder_pattern_calculator.set_two_theta_start( two_theta_start );
-        powder_pattern_calculator.set_two_theta_end( two_theta_end );
-        powder_pattern_calculator.set_two_theta_step( two_theta_step );
-        powder_pattern_calculator.set_FWHM( FWHM );
-        PowderPattern powder_pattern;
-        powder_pattern_calculator.calculate( powder_pattern );
-        powder_patterns.push_back( powder_pattern );
-    }
-    CorrelationMatrix result( powder_patterns.size() );
-    // To speed things up, for each powder pattern pre-calculate the weighted cross-correlation function
-    std::vector< double > sqrt_weighted_cross_correlations;
-    sqrt_weighted_cross_correlations.reserve( powder_patterns.size() );
-    // When experimental patterns are involved, the default value is 3.0.
-    Angle l = Angle( 1.0, Angle::DEGREES );
-    std::cout << "Now starting the precalculations" << std::endl;
-    for ( size_t i( 0 ); i != powder_patterns.size(); ++i )
-        sqrt_weighted_cross_correlations.push_back( sqrt( weighted_cross_correlation( powder_patterns[i], powder_patterns[i], l ) ) );
-    std::cout << "Precalculations done" << std::endl;
-    size_t iTotal( 0 );
-    for ( size_t i( 0 ); i != powder_patterns.size(); ++i )
-    {
-        for ( size_t j( i+1 ); j != powder_patterns.size(); ++j )
+        PowderPatternCalculatorCache cache;
+        size_t begin = iBlock * block_size;
+        size_t end = std::min( begin + block_size, nstructures );
+        for ( size_t i( begin ); i != end; ++i )
         {
-            double value = weighted_cross_correlation( powder_patterns[i], powder_patterns[j], l ) / ( sqrt_weighted_cross_correlations[i] * sqrt_weighted_cross_correlations[j] );
-            result.set_value( i, j, value );
-            ++iTotal;
-            if ( (iTotal % 100) == 0 )
-                std::cout << size_t2string( iTotal ) + " comparisons done" << std::endl;
+            CrystalStructure crystal_structure;
+            read_crystal_structure( i, crystal_structure );
+            // Space-group symmetry is applied analytically by the PowderPatternCalculator, no need to expand the crystal structure.
+            PowderPatternCalculator powder_pattern_calculator( crystal_structure );
+            powder_pattern_calculator.set_two_theta_start( two_theta_start );
+            powder_pattern_calculator.set_two_theta_end( two_theta_end );
+            powder_pattern_calculator.set_two_theta_step( two_theta_step );
+            powder_pattern_calculator.set_FWHM( FWHM );
+            powder_pattern_calculator.set_cache( cache );
+            PowderPattern powder_pattern;
+            if ( set_F_squared_to_1 )
+            {
+                powder_pattern_calculator.calculate_reflection_list(); // F^2 is set to 1.0 by default.
+                ReflectionList reflection_list = powder_pattern_calculator.reflection_list();
+                powder_pattern_calculator.calculate( reflection_list, powder_pattern );
+            }
+            else
+                powder_pattern_calculator.calculate( powder_pattern );
+            // Preparing includes the weighted cross-correlation of the pattern with itself, each comparison is then a single dot product.
+            result[i] = PreparedPowderPattern( powder_pattern, l );
         }
-    }
+    } );
     return result;
 }
-    
+
 // ********************************************************************************
 
-// Structure factors are set to 1.0, so only compares unit cells.
-CorrelationMatrix calculate_correlation_matrix_1( const FileList & file_list )
+// The upper triangle is divided into square tiles of tile_size x tile_size comparisons, so that the prepared patterns
+// of a tile stay in the processor cache while they are compared with each other.
+// The tiles are handed out to whichever thread is free, each element of the matrix is written by exactly one tile.
+CorrelationMatrix calculate_correlation_matrix( const std::vector< PreparedPowderPattern > & prepared_powder_patterns, ThreadPool & thread_pool )
 {
-    std::vector< PowderPattern > powder_patterns;
-    powder_patterns.reserve( file_list.size() );
-    Angle two_theta_start( 3.0, Angle::DEGREES );
-    Angle two_theta_end(  35.0, Angle::DEGREES );
-    Angle two_theta_step( 0.01, Angle::DEGREES );
-    double FWHM( 0.1 );
-    for ( size_t i( 0 ); i != file_list.size(); ++i )
+    const size_t tile_size( 16 );
+    CorrelationMatrix result( prepared_powder_patterns.size() );
+    size_t ntiles_1D = ( prepared_powder_patterns.size() + tile_size - 1 ) / tile_size;
+    std::vector< size_t > tile_rows;
+    std::vector< size_t > tile_columns;
+    for ( size_t i( 0 ); i != ntiles_1D; ++i )
     {
-        CrystalStructure crystal_structure;
-        std::cout << "Now reading cif... " + file_list.value( i ).full_name() << std::endl;
-        read_cif( file_list.value( i ), crystal_structure );
-
-// @@ The following should not be necessary here
-        crystal_structure.apply_space_group_symmetry();
-
-        std::cout << "Now calculating powder pattern... " + size_t2string( i, 4, '0' ) << std::endl;
-        PowderPatternCalculator powder_pattern_calculator( crystal_structure );
-        powder_pattern_calculator.set_two_theta_start( two_theta_start );
-        powder_pattern_calculator.set_two_theta_end( two_theta_end );
-        powder_pattern_calculator.set_two_theta_step( two_theta_step );
-        powder_pattern_calculator.set_FWHM( FWHM );
-        PowderPattern powder_pattern;
-        powder_pattern_calculator.calculate_reflection_list(); // F^2 is set to 1.0 by default.
-        ReflectionList reflection_list = powder_pattern_calculator.reflection_list();
-        powder_pattern_calculator.calculate( reflection_list, powder_pattern );
-        powder_patterns.push_back( powder_pattern );
+        for ( size_t j( i ); j != ntiles_1D; ++j )
+        {
+            tile_rows.push_back( i );
+            tile_columns.push_back( j );
+        }
     }
-    CorrelationMatrix result( powder_patterns.size() );
-    // To speed things up, for each powder pattern pre-calculate the weighted cross-correlation function
-    std::vector< double > sqrt_weighted_cross_correlations;
-    sqrt_weighted_cross_correlations.reserve( powder_patterns.size() );
-    // When experimental patterns are involved, the default value is 3.0.
-    Angle l = Angle( 1.5, Angle::DEGREES );
-    std::cout << "Now starting the precalculations" << std::endl;
-    for ( size_t i( 0 ); i != powder_patterns.size(); ++i )
-        sqrt_weighted_cross_correlations.push_back( sqrt( weighted_cross_correlation( powder_patterns[i], powder_patterns[i], l ) ) );
-    std::cout << "Precalculations done" << std::endl;
-    size_t iTotal( 0 );
-    for ( size_t i( 0 ); i != powder_patterns.size(); ++i )
+    std::cout << "Now calculating " << ( prepared_powder_patterns.size() * ( prepared_powder_patterns.size() - 1 ) ) / 2 << " comparisons" << std::endl;
+    thread_pool.run( tile_rows.size(), [&]( const size_t iTile )
     {
-        for ( size_t j( i+1 ); j != powder_patterns.size(); ++j )
+        size_t row_begin = tile_rows[iTile] * tile_size;
+        size_t row_end = std::min( row_begin + tile_size, prepared_powder_patterns.size() );
+        size_t column_begin = tile_columns[iTile] * tile_size;
+        size_t column_end = std::min( column_begin + tile_size, prepared_powder_patterns.size() );
+        for ( size_t i( row_begin ); i != row_end; ++i )
         {
-            double value = weighted_cross_correlation( powder_patterns[i], powder_patterns[j], l ) / ( sqrt_weighted_cross_correlations[i] * sqrt_weighted_cross_correlations[j] );
-            result.set_value( i, j, value );
-            ++iTotal;
-            if ( (iTotal % 100) == 0 )
-                std::cout << size_t2string( iTotal ) + " comparisons done" << std::endl;
+            for ( size_t j( std::max( column_begin, i + 1 ) ); j < column_end; ++j )
+                result.set_value( i, j, normalised_weighted_cross_correlation( prepared_powder_patterns[i], prepared_powder_patterns[j] ) );
         }
-    }
+    } );
+    std::cout << "Comparisons done" << std::endl;
     return result;
 }
 
 // ********************************************************************************
 
+std::function< void( const size_t, CrystalStructure & ) > cif_reader( const FileList & file_list )
+{
+    return [&file_list]( const size_t i, CrystalStructure & crystal_structure ) { read_cif( file_list.value( i ), crystal_structure ); };
+}
+
+// ********************************************************************************
+
+std::function< void( const size_t, CrystalStructure & ) > cif_reader( const CifArchive & cif_archive )
+{
+    return [&cif_archive]( const size_t i, CrystalStructure & crystal_structure ) { cif_archive.read( i, crystal_structure ); };
+}
+
+} // namespace
+
+// ********************************************************************************
+
+CorrelationMatrix calculate_correlation_matrix( const FileList & file_list, const size_t nthreads )
+{
+    ThreadPool thread_pool( nthreads );
+    // When experimental patterns are involved, the default value is 3.0.
+    Angle l = Angle( 1.0, Angle::DEGREES );
+    return calculate_correlation_matrix( calculate_prepared_powder_patterns( file_list.size(), cif_reader( file_list ), false, l, thread_pool ), thread_pool );
+}
+
+// ********************************************************************************
+
+CorrelationMatrix calculate_correlation_matrix( const CifArchive & cif_archive, const size_t nthreads )
+{
+    ThreadPool thread_pool( nthreads );
+    // When experimental patterns are involved, the default value is 3.0.
+    Angle l = Angle( 1.0, Angle::DEGREES );
+    return calculate_correlation_matrix( calculate_prepared_powder_patterns( cif_archive.size(), cif_reader( cif_archive ), false, l, thread_pool ), thread_pool );
+}
+    
+// ********************************************************************************
+
+// Structure factors are set to 1.0, so only compares unit cells.
+CorrelationMatrix calculate_correlation_matrix_1( const FileList & file_list, const size_t nthreads )
+{
+    ThreadPool thread_pool( nthreads );
+    // When experimental patterns are involved, the default value is 3.0.
+    Angle l = Angle( 1.5, Angle::DEGREES );
+    return calculate_correlation_matrix( calculate_prepared_powder_patterns( file_list.size(), cif_reader( file_list ), true, l, thread_pool ), thread_pool );
+}
+
+// ********************************************************************************
+
 FileList select_diverse_structures( const FileList & file_list, const double similarity_limit )
 {
     if ( file_list.size() < 2 )
@@ -28,16 +28,24 @@ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ********************************************* */
 
+class CifArchive;
 class CorrelationMatrix;
 class FileList;
 
+#include <cstddef> // For definition of size_t
+
 // Uses powder patterns and Rene de Gelder's similarity measure, expects file_list to contain .cif files.
 // Uses simulated powder diffraction patterns from 3.0 to 35.0 degrees 2theta.
 // Uses l = 1.0 degrees 2theta.
-CorrelationMatrix calculate_correlation_matrix( const FileList & file_list );
+// Both the powder patterns and the comparisons are divided over nthreads threads, 0 means the number of cores.
+// The result does not depend on the number of threads.
+CorrelationMatrix calculate_correlation_matrix( const FileList & file_list, const size_t nthreads = 0 );
+
+// As above, for all data blocks of one .cif file. CifArchive::build_index() must have been called.
+CorrelationMatrix calculate_correlation_matrix( const CifArchive & cif_archive, const size_t nthreads = 0 );
 
 // Structure factors are set to 1.0, so only compares unit cells.
-CorrelationMatrix calculate_correlation_matrix_1( const FileList & file_list );
+CorrelationMatrix calculate_correlation_matrix_1( const FileList & file_list, const size_t nthreads = 0 );
 
 FileList select_diverse_structures( const FileList & file_list, const double similarity_limit );
 
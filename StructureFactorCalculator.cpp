@@ -0,0 +1,263 @@
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include "StructureFactorCalculator.h"
+#include "BasicMathsFunctions.h"
+#include "CrystallographicCalculations.h"
+#include "CrystalStructure.h"
+#include "ReflectionList.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <stdexcept>
+#include <utility>
+
+// ********************************************************************************
+
+StructureFactorCalculator::StructureFactorCalculator( const CrystalStructure & crystal_structure, const bool use_space_group_symmetry )
+{
+    if ( use_space_group_symmetry )
+    {
+        if ( crystal_structure.space_group_symmetry_has_been_applied() )
+            throw std::runtime_error( "StructureFactorCalculator::StructureFactorCalculator(): Error: space-group symmetry has already been applied." );
+        for ( size_t i( 0 ); i != crystal_structure.space_group().nsymmetry_operators(); ++i )
+            symmetry_operators_.push_back( crystal_structure.space_group().symmetry_operator( i ) );
+    }
+    // First pass: assign every atom to a scattering type.
+    // Isotropic scattering types are identified by element + Uiso, anisotropic ones by element only.
+    // The map stores ( element id, Uiso ) -> scattering type, Uiso is set to -1.0 for anisotropic atoms.
+    std::map< std::pair< size_t, double >, size_t > scattering_type_map;
+    std::map< size_t, size_t > element_map; // Element id -> index into elements_
+    std::vector< size_t > atom_scattering_types;
+    std::vector< size_t > natoms_per_scattering_type;
+    atom_scattering_types.reserve( crystal_structure.natoms() );
+    for ( size_t i( 0 ); i != crystal_structure.natoms(); ++i )
+    {
+        const Atom & atom = crystal_structure.atom( i );
+        std::map< size_t, size_t >::const_iterator element_it = element_map.find( atom.element().id() );
+        size_t element_index;
+        if ( element_it == element_map.end() )
+        {
+            element_index = elements_.size();
+            element_map[ atom.element().id() ] = element_index;
+            elements_.push_back( atom.element() );
+        }
+        else
+            element_index = element_it->second;
+        bool anisotropic = ( atom.ADPs_type() == Atom::ANISOTROPIC );
+        double Uiso( -1.0 );
+        if ( atom.ADPs_type() == Atom::ISOTROPIC )
+            Uiso = atom.Uiso();
+        else if ( atom.ADPs_type() == Atom::NONE )
+        {
+            // This is what Mercury does according to the manual.
+            if ( atom.element().atomic_number() == 1 )
+                Uiso = 0.06;
+            else
+                Uiso = 0.05;
+        }
+        std::pair< size_t, double > key( atom.element().id(), Uiso );
+        std::map< std::pair< size_t, double >, size_t >::const_iterator it = scattering_type_map.find( key );
+        size_t scattering_type;
+        if ( it == scattering_type_map.end() )
+        {
+            scattering_type = scattering_types_.size();
+            scattering_type_map[ key ] = scattering_type;
+            ScatteringType new_scattering_type;
+            new_scattering_type.element_index_ = element_index;
+            new_scattering_type.anisotropic_ = anisotropic;
+            new_scattering_type.B_ = anisotropic ? 0.0 : 8.0 * square( CONSTANT_PI ) * Uiso;
+            new_scattering_type.begin_ = 0;
+            new_scattering_type.end_ = 0;
+            scattering_types_.push_back( new_scattering_type );
+            natoms_per_scattering_type.push_back( 0 );
+        }
+        else
+            scattering_type = it->second;
+        atom_scattering_types.push_back( scattering_type );
+        ++natoms_per_scattering_type[ scattering_type ];
+    }
+    // Second pass: make the atoms of each scattering type contiguous.
+    size_t begin( 0 );
+    for ( size_t i( 0 ); i != scattering_types_.size(); ++i )
+    {
+        scattering_types_[i].begin_ = begin;
+        scattering_types_[i].end_ = begin;
+        begin += natoms_per_scattering_type[i];
+    }
+    size_t natoms = crystal_structure.natoms();
+    x_.resize( natoms );
+    y_.resize( natoms );
+    z_.resize( natoms );
+    occupancies_.resize( natoms );
+    beta_.resize( 6 * natoms, 0.0 );
+    CrystalLattice crystal_lattice = crystal_structure.crystal_lattice();
+    std::vector< std::vector< size_t > > symmetry_images;
+    if ( use_space_group_symmetry )
+        symmetry_images = crystal_structure.distinct_symmetry_images();
+    for ( size_t i( 0 ); i != natoms; ++i )
+    {
+        const Atom & atom = crystal_structure.atom( i );
+        size_t j = scattering_types_[ atom_scattering_types[i] ].end_;
+        ++scattering_types_[ atom_scattering_types[i] ].end_;
+        x_[j] = atom.position().x();
+        y_[j] = atom.position().y();
+        z_[j] = atom.position().z();
+        occupancies_[j] = atom.occupancy();
+        if ( use_space_group_symmetry )
+        {
+            // An atom on a special position is mapped onto itself by the operators of its site symmetry,
+            // summing over all symmetry operators would count it that many times.
+            // The criterion is the same as in CrystalStructure::apply_space_group_symmetry().
+            occupancies_[j] *= static_cast<double>( symmetry_images[i].size() ) / symmetry_operators_.size();
+        }
+        if ( atom.ADPs_type() == Atom::ANISOTROPIC )
+        {
+            SymmetricMatrix3D U_star = atom.anisotropic_displacement_parameters().U_star( crystal_lattice );
+            double factor = 2.0 * square( CONSTANT_PI );
+            beta_[6*j  ] = factor * U_star.value( 0, 0 );
+            beta_[6*j+1] = factor * U_star.value( 1, 1 );
+            beta_[6*j+2] = factor * U_star.value( 2, 2 );
+            beta_[6*j+3] = factor * U_star.value( 0, 1 );
+            beta_[6*j+4] = factor * U_star.value( 0, 2 );
+            beta_[6*j+5] = factor * U_star.value( 1, 2 );
+        }
+    }
+}
+
+// ********************************************************************************
+
+Complex StructureFactorCalculator::structure_factor( const MillerIndices & miller_indices, const double sine_theta_over_lambda ) const
+{
+    Workspace workspace( *this );
+    return structure_factor( miller_indices, sine_theta_over_lambda, workspace );
+}
+
+// ********************************************************************************
+
+void StructureFactorCalculator::calculate_F_squared( ReflectionList & reflection_list ) const
+{
+    Workspace workspace( *this );
+    for ( size_t i( 0 ); i != reflection_list.size(); ++i )
+    {
+        double sine_theta_over_lambda = 1.0 / ( 2.0 * reflection_list.d_spacing( i ) );
+        Complex F = structure_factor( reflection_list.miller_indices( i ), sine_theta_over_lambda, workspace );
+        reflection_list.set_F_squared( i, square( F.real() ) + square( F.imaginary() ) );
+    }
+}
+
+// ********************************************************************************
+
+void StructureFactorCalculator::calculate_F_squared( ReflectionList & reflection_list, ThreadPool & thread_pool ) const
+{
+    // Many more blocks than threads, because the cost per reflection varies with the number of anisotropic atoms,
+    // but large enough that the Workspace allocation is negligible.
+    const size_t block_size( 64 );
+    size_t nblocks = ( reflection_list.size() + block_size - 1 ) / block_size;
+    // Each reflection is written by exactly one task, and set_F_squared() does not change the order of the reflections.
+    thread_pool.run( nblocks, [&]( const size_t iBlock )
+    {
+        Workspace workspace( *this );
+        size_t end = std::min( ( iBlock + 1 ) * block_size, reflection_list.size() );
+        for ( size_t i( iBlock * block_size ); i != end; ++i )
+        {
+            double sine_theta_over_lambda = 1.0 / ( 2.0 * reflection_list.d_spacing( i ) );
+            Complex F = structure_factor( reflection_list.miller_indices( i ), sine_theta_over_lambda, workspace );
+            reflection_list.set_F_squared( i, square( F.real() ) + square( F.imaginary() ) );
+        }
+    } );
+}
+
+// ********************************************************************************
+
+Complex StructureFactorCalculator::structure_factor( const MillerIndices & miller_indices, const double sine_theta_over_lambda, Workspace & workspace ) const
+{
+    // f0 once per element, f0 * T once per scattering type (for anisotropic scattering types just f0).
+    double s2 = square( sine_theta_over_lambda );
+    for ( size_t i( 0 ); i != elements_.size(); ++i )
+        workspace.f0_[i] = elements_[i].scattering_factor( sine_theta_over_lambda );
+    for ( size_t i( 0 ); i != scattering_types_.size(); ++i )
+    {
+        workspace.fT_[i] = workspace.f0_[ scattering_types_[i].element_index_ ];
+        if ( ! scattering_types_[i].anisotropic_ )
+            workspace.fT_[i] *= exp( -scattering_types_[i].B_ * s2 );
+    }
+    if ( symmetry_operators_.empty() )
+        return phase_sum( miller_indices, workspace );
+    // F(h) = sum_j f_j T_j(h) exp( 2 pi i h ( R x_j + t ) ) = sum_R exp( 2 pi i h t ) * [ sum_j f_j T_j(hR) exp( 2 pi i (hR) x_j ) ]
+    double cosine_term( 0.0 );
+    double sine_term( 0.0 );
+    for ( size_t i( 0 ); i != symmetry_operators_.size(); ++i )
+    {
+        Complex partial_F = phase_sum( miller_indices * symmetry_operators_[i].rotation(), workspace );
+        double phase = 2.0 * CONSTANT_PI * ( miller_indices * symmetry_operators_[i].translation() );
+        double cosine = cos( phase );
+        double sine = sin( phase );
+        cosine_term += partial_F.real() * cosine - partial_F.imaginary() * sine;
+        sine_term   += partial_F.imaginary() * cosine + partial_F.real() * sine;
+    }
+    return Complex( cosine_term, sine_term );
+}
+
+// ********************************************************************************
+
+Complex StructureFactorCalculator::phase_sum( const MillerIndices & miller_indices, Workspace & workspace ) const
+{
+    int h = miller_indices.h();
+    int k = miller_indices.k();
+    int l = miller_indices.l();
+    double cosine_term( 0.0 );
+    double sine_term( 0.0 );
+    for ( size_t i( 0 ); i != scattering_types_.size(); ++i )
+    {
+        const ScatteringType & scattering_type = scattering_types_[i];
+        size_t begin = scattering_type.begin_;
+        size_t n = scattering_type.end_ - scattering_type.begin_;
+        double partial_cosine_term( 0.0 );
+        double partial_sine_term( 0.0 );
+        if ( scattering_type.anisotropic_ )
+        {
+            // The Debije-Waller factors differ per atom, so they are folded into the weights.
+            for ( size_t j( begin ); j != scattering_type.end_; ++j )
+            {
+                const double * beta = &beta_[6*j];
+                workspace.weights_[j-begin] = occupancies_[j] * exp( -( beta[0]*h*h + beta[1]*k*k + beta[2]*l*l + 2.0 * ( beta[3]*h*k + beta[4]*h*l + beta[5]*k*l ) ) );
+            }
+            phase_sum_kernel_.phase_sum( h, k, l, &x_[begin], &y_[begin], &z_[begin], &workspace.weights_[0], n, partial_cosine_term, partial_sine_term );
+        }
+        else
+            phase_sum_kernel_.phase_sum( h, k, l, &x_[begin], &y_[begin], &z_[begin], &occupancies_[begin], n, partial_cosine_term, partial_sine_term );
+        cosine_term += workspace.fT_[i] * partial_cosine_term;
+        sine_term += workspace.fT_[i] * partial_sine_term;
+    }
+    return Complex( cosine_term, sine_term );
+}
+
+// ********************************************************************************
+
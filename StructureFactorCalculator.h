@@ -0,0 +1,134 @@
+#ifndef STRUCTUREFACTORCALCULATOR_H
+#define STRUCTUREFACTORCALCULATOR_H
+
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+class CrystalStructure;
+class ReflectionList;
+class ThreadPool;
+
+#include "Complex.h"
+#include "Element.h"
+#include "MillerIndices.h"
+#include "PhaseSumKernel.h"
+#include "SymmetryOperator.h"
+
+#include <vector>
+
+/*
+  Calculates structure factors from a packed copy of the atoms of a crystal structure.
+
+  The table is built once, in the constructor: fractional coordinates and occupancies are stored
+  as separate contiguous arrays and the atoms are sorted into scattering types.
+  All atoms of one scattering type share the same element and, if isotropic, the same Debije-Waller factor,
+  so f0 is calculated once per element per reflection and f0 * T once per scattering type per reflection.
+  Atoms with anisotropic ADPs are grouped by element only, their Debije-Waller factors are calculated per atom
+  from 2 pi^2 U*, which is also precalculated.
+  The sums over the atoms of one scattering type are done by a PhaseSumKernel, which is vectorised.
+
+  Optionally, the atoms are treated as the asymmetric unit and the space-group symmetry is applied analytically,
+  which reduces the number of atoms by the order of the space group.
+
+  Atoms without ADPs get Uiso = 0.06 for hydrogen and Uiso = 0.05 otherwise, which is what Mercury does.
+
+  Because all data are copied, later changes to the crystal structure are not picked up.
+*/
+class StructureFactorCalculator
+{
+public:
+
+    // If use_space_group_symmetry is false, the atoms are used as they are, so space-group symmetry must have been applied.
+    // If use_space_group_symmetry is true, the atoms are treated as the asymmetric unit and the symmetry operators
+    // of the space group are applied analytically to the Miller indices, so the crystal structure does not need to be expanded.
+    // Atoms on special positions are detected in the constructor and their contributions are divided by the order of their site symmetry.
+    // It is then an error to have applied space-group symmetry to the crystal structure.
+    explicit StructureFactorCalculator( const CrystalStructure & crystal_structure, const bool use_space_group_symmetry = false );
+
+    size_t natoms() const { return x_.size(); }
+    size_t nelements() const { return elements_.size(); }
+    size_t nscattering_types() const { return scattering_types_.size(); }
+
+    // The default is the fastest kernel that the processor supports.
+    PhaseSumKernel phase_sum_kernel() const { return phase_sum_kernel_; }
+    void set_phase_sum_kernel( const PhaseSumKernel & phase_sum_kernel ) { phase_sum_kernel_ = phase_sum_kernel; }
+
+    Complex structure_factor( const MillerIndices & miller_indices, const double sine_theta_over_lambda ) const;
+
+    // Calculates F^2 for all reflections, the d-spacings must have been set.
+    void calculate_F_squared( ReflectionList & reflection_list ) const;
+
+    // Same, but the reflections are divided into blocks that are calculated in parallel.
+    // Every reflection is calculated exactly as in the single-threaded version, so the results are identical.
+    void calculate_F_squared( ReflectionList & reflection_list, ThreadPool & thread_pool ) const;
+
+private:
+
+    struct ScatteringType
+    {
+        size_t element_index_; // Index into elements_
+        bool anisotropic_;
+        double B_; // 8 pi^2 Uiso, only used if isotropic
+        size_t begin_; // First atom in the atom arrays
+        size_t end_;   // One past the last atom in the atom arrays
+    };
+
+    std::vector< Element > elements_;
+    std::vector< ScatteringType > scattering_types_;
+    std::vector< double > x_;
+    std::vector< double > y_;
+    std::vector< double > z_;
+    std::vector< double > occupancies_;
+    // 2 pi^2 U*, six values per atom in the order 11, 22, 33, 12, 13, 23; zero for isotropic atoms.
+    std::vector< double > beta_;
+
+    // Empty unless the space-group symmetry is applied analytically.
+    std::vector< SymmetryOperator > symmetry_operators_;
+
+    PhaseSumKernel phase_sum_kernel_;
+
+    // To avoid reallocations for every reflection.
+    struct Workspace
+    {
+        explicit Workspace( const StructureFactorCalculator & structure_factor_calculator ):
+        f0_( structure_factor_calculator.nelements() ),
+        fT_( structure_factor_calculator.nscattering_types() ),
+        weights_( structure_factor_calculator.natoms() )
+        {}
+        std::vector< double > f0_;      // One per element
+        std::vector< double > fT_;      // One per scattering type, f0 * T if isotropic, f0 if anisotropic
+        std::vector< double > weights_; // Occupancy * T for the atoms of one anisotropic scattering type
+    };
+
+    Complex structure_factor( const MillerIndices & miller_indices, const double sine_theta_over_lambda, Workspace & workspace ) const;
+
+    // Sum over all atoms, without symmetry operators, workspace.fT_ must have been set.
+    Complex phase_sum( const MillerIndices & miller_indices, Workspace & workspace ) const;
+};
+
+#endif // STRUCTUREFACTORCALCULATOR_H
+
@@ -0,0 +1,99 @@
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include "SystematicAbsences.h"
+#include "BasicMathsFunctions.h"
+#include "MillerIndices.h"
+#include "SpaceGroup.h"
+
+#include <cmath>
+
+// ********************************************************************************
+
+SystematicAbsences::SystematicAbsences()
+{
+}
+
+// ********************************************************************************
+
+SystematicAbsences::SystematicAbsences( const SpaceGroup & space_group )
+{
+    // Note that we skip the first symmetry operator, which is guaranteed to be the identity.
+    for ( size_t i( 1 ); i != space_group.nsymmetry_operators(); ++i )
+    {
+        SymmetryOperator symmetry_operator = space_group.symmetry_operator( i );
+        Condition condition;
+        bool has_translation( false );
+        for ( size_t j( 0 ); j != 3; ++j )
+        {
+            condition.translation_[j] = symmetry_operator.translation().value( j );
+            if ( ! nearly_integer( condition.translation_[j] ) )
+                has_translation = true;
+            for ( size_t k( 0 ); k != 3; ++k )
+                condition.rotation_[3*j+k] = round_to_int( symmetry_operator.rotation().value( j, k ) );
+        }
+        if ( ! has_translation )
+            continue;
+        bool is_duplicate( false );
+        for ( size_t j( 0 ); ( ! is_duplicate ) && ( j != conditions_.size() ); ++j )
+        {
+            is_duplicate = true;
+            for ( size_t k( 0 ); is_duplicate && ( k != 9 ); ++k )
+                is_duplicate = ( conditions_[j].rotation_[k] == condition.rotation_[k] );
+            for ( size_t k( 0 ); is_duplicate && ( k != 3 ); ++k )
+                is_duplicate = nearly_integer( conditions_[j].translation_[k] - condition.translation_[k] );
+        }
+        if ( ! is_duplicate )
+            conditions_.push_back( condition );
+    }
+}
+
+// ********************************************************************************
+
+bool SystematicAbsences::is_systematic_absence( const MillerIndices & miller_indices ) const
+{
+    int h = miller_indices.h();
+    int k = miller_indices.k();
+    int l = miller_indices.l();
+    for ( size_t i( 0 ); i != conditions_.size(); ++i )
+    {
+        const int * R = conditions_[i].rotation_;
+        // H R, with H a row vector.
+        if ( ( h * R[0] + k * R[3] + l * R[6] == h ) &&
+             ( h * R[1] + k * R[4] + l * R[7] == k ) &&
+             ( h * R[2] + k * R[5] + l * R[8] == l ) )
+        {
+            const double * t = conditions_[i].translation_;
+            if ( ! nearly_integer( h * t[0] + k * t[1] + l * t[2], 0.05 ) )
+                return true;
+        }
+    }
+    return false;
+}
+
+// ********************************************************************************
+
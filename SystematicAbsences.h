@@ -0,0 +1,70 @@
+#ifndef SYSTEMATICABSENCES_H
+#define SYSTEMATICABSENCES_H
+
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+class MillerIndices;
+class SpaceGroup;
+
+#include <cstddef> // For definition of size_t
+#include <vector>
+
+/*
+  The systematic absences of a space group, precalculated so that testing a reflection is cheap.
+
+  A reflection H is systematically absent if there is a symmetry operator { R | t } with H R = H and H t not an integer.
+  Only symmetry operators with a non-zero translation can give rise to a systematic absence, so only those are stored,
+  with their rotation matrices converted to integers. Operators that give rise to the same condition
+  (same rotation, same translation modulo lattice translations) are stored only once.
+*/
+class SystematicAbsences
+{
+public:
+
+    // Default constructor: no systematic absences, as in P1.
+    SystematicAbsences();
+
+    explicit SystematicAbsences( const SpaceGroup & space_group );
+
+    size_t nconditions() const { return conditions_.size(); }
+
+    bool is_systematic_absence( const MillerIndices & miller_indices ) const;
+
+private:
+
+    struct Condition
+    {
+        int rotation_[9]; // Row by row
+        double translation_[3];
+    };
+
+    std::vector< Condition > conditions_;
+};
+
+#endif // SYSTEMATICABSENCES_H
+
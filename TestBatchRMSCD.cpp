@@ -0,0 +1,147 @@
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include "BatchRMSCD.h"
+#include "CrystalStructure.h"
+#include "FileList.h"
+#include "FileName.h"
+#include "Utilities.h"
+
+#include "TestSuite.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+void test_BatchRMSCD( TestSuite & test_suite )
+{
+    std::cout << "Now running tests for BatchRMSCD." << std::endl;
+    // The structures are built in memory, the reader looks them up by file name instead of reading a file.
+    std::map< std::string, CrystalStructure > crystal_structures;
+    {
+    CrystalStructure crystal_structure;
+    crystal_structure.set_crystal_lattice( CrystalLattice( 10.0, 10.0, 10.0, Angle::angle_90_degrees(), Angle::angle_90_degrees(), Angle::angle_90_degrees() ) );
+    crystal_structure.add_atom( Atom( Element( "C" ), Vector3D( 0.1, 0.2, 0.3 ), "C1" ) );
+    crystal_structure.add_atom( Atom( Element( "N" ), Vector3D( 0.4, 0.5, 0.6 ), "N1" ) );
+    crystal_structures[ "A.cif" ] = crystal_structure;
+    crystal_structure.set_atom( 0, Atom( Element( "C" ), Vector3D( 0.11, 0.2, 0.3 ), "C1" ) );
+    crystal_structures[ "B.cif" ] = crystal_structure;
+    crystal_structure.add_atom( Atom( Element( "O" ), Vector3D( 0.7, 0.8, 0.9 ), "O1" ) );
+    crystal_structures[ "C.cif" ] = crystal_structure;
+    }
+    std::function< void( const FileName &, CrystalStructure & ) > crystal_structure_reader = [&]( const FileName & file_name, CrystalStructure & crystal_structure )
+    {
+        std::map< std::string, CrystalStructure >::const_iterator it = crystal_structures.find( file_name.full_name() );
+        if ( it == crystal_structures.end() )
+            throw std::runtime_error( "no \"such\" file" );
+        crystal_structure = it->second;
+    };
+    std::vector< FileName > file_names;
+    file_names.push_back( FileName( "A.cif" ) );
+    file_names.push_back( FileName( "B.cif" ) );
+    file_names.push_back( FileName( "C.cif" ) );
+    file_names.push_back( FileName( "bad,1.cif" ) );
+    file_names.push_back( FileName( "A.cif" ) ); // Read only once.
+    const FileList file_list( file_names );
+    const double RMSCD_AB = root_mean_square_Cartesian_displacement( crystal_structures[ "A.cif" ], crystal_structures[ "B.cif" ], false );
+    test_suite.test_equality_double( RMSCD_AB, std::sqrt( 0.5 * 0.1 * 0.1 ), "BatchRMSCD RMSCD" );
+    // All-vs-all, the results must be in the order of the pairs and must not depend on the number of threads.
+    std::vector< RMSCDResult > results_1;
+    for ( size_t nthreads( 1 ); nthreads != 5; ++nthreads )
+    {
+        BatchRMSCD batch_RMSCD( file_list );
+        batch_RMSCD.set_crystal_structure_reader( crystal_structure_reader );
+        batch_RMSCD.set_nthreads( nthreads );
+        test_suite.test_equality( batch_RMSCD.npairs(), 10, "BatchRMSCD::npairs() all-vs-all" );
+        std::vector< RMSCDResult > results = batch_RMSCD.calculate();
+        test_suite.test_equality( results.size(), 10, "BatchRMSCD all-vs-all size " + size_t2string( nthreads ) );
+        if ( results.size() != 10 )
+            continue;
+        if ( nthreads == 1 )
+        {
+            results_1 = results;
+            const size_t is[] = { 0, 0, 0, 0, 1, 1, 1, 2, 2, 3 };
+            const size_t js[] = { 1, 2, 3, 4, 2, 3, 4, 3, 4, 4 };
+            for ( size_t k( 0 ); k != 10; ++k )
+            {
+                test_suite.test_equality( results[k].i_, is[k], "BatchRMSCD all-vs-all i " + size_t2string( k ) );
+                test_suite.test_equality( results[k].j_, js[k], "BatchRMSCD all-vs-all j " + size_t2string( k ) );
+            }
+            test_suite.test_equality_double( results[0].RMSCD_, RMSCD_AB, "BatchRMSCD all-vs-all A-B" );
+            test_suite.test_equality( results[0].error_message_, std::string( "" ), "BatchRMSCD all-vs-all A-B error" );
+            test_suite.test_equality_double( results[3].RMSCD_, 0.0, "BatchRMSCD all-vs-all A-A" );
+            test_suite.test_equality( results[1].error_message_.empty(), false, "BatchRMSCD all-vs-all different numbers of atoms" );
+            test_suite.test_equality( results[2].error_message_, std::string( "bad,1.cif: no \"such\" file" ), "BatchRMSCD all-vs-all unreadable file" );
+            continue;
+        }
+        size_t nerrors( 0 );
+        for ( size_t k( 0 ); k != 10; ++k )
+        {
+            if ( ( results[k].i_ != results_1[k].i_ ) || ( results[k].j_ != results_1[k].j_ ) || ( results[k].RMSCD_ != results_1[k].RMSCD_ ) || ( results[k].error_message_ != results_1[k].error_message_ ) )
+                ++nerrors;
+        }
+        test_suite.test_equality( nerrors, 0, "BatchRMSCD all-vs-all nthreads " + size_t2string( nthreads ) );
+    }
+    // Pairs, written to a .csv file: fields with commas and quotes are quoted.
+    {
+    std::vector< FileName > file_names_2;
+    file_names_2.push_back( FileName( "B.cif" ) );
+    file_names_2.push_back( FileName( "A.cif" ) );
+    file_names_2.push_back( FileName( "A.cif" ) );
+    file_names_2.push_back( FileName( "A.cif" ) );
+    file_names_2.push_back( FileName( "B.cif" ) );
+    BatchRMSCD batch_RMSCD( file_list, FileList( file_names_2 ) );
+    batch_RMSCD.set_crystal_structure_reader( crystal_structure_reader );
+    batch_RMSCD.set_nthreads( 3 );
+    test_suite.test_equality( batch_RMSCD.npairs(), 5, "BatchRMSCD::npairs() pairs" );
+    const FileName output_file_name( test_suite.temporary_file_name( "TestBatchRMSCD.csv" ) );
+    batch_RMSCD.calculate( output_file_name );
+    std::vector< std::string > lines;
+    {
+    std::ifstream input_file( output_file_name.full_name().c_str() );
+    std::string line;
+    while ( std::getline( input_file, line ) )
+        lines.push_back( line );
+    }
+    std::remove( output_file_name.full_name().c_str() );
+    test_suite.test_equality( lines.size(), 6, "BatchRMSCD .csv number of lines" );
+    if ( lines.size() == 6 )
+    {
+        test_suite.test_equality( lines[0], std::string( "file_1,file_2,RMSCD,seconds,error" ), "BatchRMSCD .csv header" );
+        test_suite.test_equality( lines[1].substr( 0, 20 ), std::string( "A.cif,B.cif," ) + double2string( RMSCD_AB, 5 ) + ",", "BatchRMSCD .csv A-B" );
+        test_suite.test_equality( lines[4], std::string( "\"bad,1.cif\",A.cif,0.00000,0.000000,\"bad,1.cif: no \"\"such\"\" file\"" ), "BatchRMSCD .csv unreadable file" );
+        test_suite.test_equality( lines[5].substr( 0, 20 ), std::string( "A.cif,B.cif," ) + double2string( RMSCD_AB, 5 ) + ",", "BatchRMSCD .csv last pair" );
+    }
+    }
+}
+
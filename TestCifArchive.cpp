@@ -0,0 +1,138 @@
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include "CifArchive.h"
+#include "CrystalStructure.h"
+#include "FileName.h"
+#include "ReadCif.h"
+#include "Utilities.h"
+
+#include "TestSuite.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+
+void write_file( const FileName & file_name, const std::string & text )
+{
+    std::ofstream output_file( file_name.full_name().c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+    output_file << text;
+}
+
+// ********************************************************************************
+
+// A minimal data block without its data_ header.
+std::string structure_text( const std::string & a, const std::string & atoms )
+{
+    return "_cell_length_a " + a + " _cell_length_b 6 _cell_length_c 7\n"
+           "_cell_angle_alpha 90 _cell_angle_beta 90 _cell_angle_gamma 90\n"
+           "loop_ _symmetry_equiv_pos_as_xyz x,y,z\n"
+           "loop_ _atom_site_label _atom_site_fract_x _atom_site_fract_y _atom_site_fract_z\n" + atoms;
+}
+
+} // namespace
+
+void test_CifArchive( TestSuite & test_suite )
+{
+    std::cout << "Now running tests for CifArchive." << std::endl;
+    const FileName file_name( test_suite.temporary_file_name( "TestCifArchive.cif" ) );
+    {
+    // Text before the first data_ header is a data block without a name.
+    const std::string second_block = "data_second\n" + structure_text( "8", "O1 0.1 0.2 0.3\n" );
+    write_file( file_name, "# Written by TestCifArchive\n" + structure_text( "4", "C1 0.1 0.2 0.3\n" ) +
+                           "data_first\n" + structure_text( "5", "C1 0.1 0.2 0.3 N1 0.4 0.5 0.6\n" ) + second_block );
+    CifArchive cif_archive( file_name );
+    test_suite.test_equality( cif_archive.has_index(), false, "CifArchive::has_index() 01" );
+    try
+    {
+        cif_archive.size();
+        test_suite.log_error( "CifArchive::size() without index" );
+    }
+    catch ( std::exception & e ) {}
+    // Sequential.
+    CrystalStructure crystal_structure;
+    const size_t natoms[] = { 1, 2, 1 };
+    for ( size_t i( 0 ); i != 3; ++i )
+    {
+        test_suite.test_equality( cif_archive.next( crystal_structure ), true, "CifArchive::next() " + size_t2string( i ) );
+        test_suite.test_equality( crystal_structure.natoms(), natoms[i], "CifArchive::next() natoms " + size_t2string( i ) );
+    }
+    test_suite.test_equality( crystal_structure.name(), std::string( "second" ), "CifArchive::next() name" );
+    test_suite.test_equality( cif_archive.next( crystal_structure ), false, "CifArchive::next() end" );
+    cif_archive.rewind();
+    test_suite.test_equality( cif_archive.next( crystal_structure ), true, "CifArchive::rewind() 01" );
+    test_suite.test_equality_double( crystal_structure.crystal_lattice().a(), 4.0, "CifArchive::rewind() 02" );
+    // Random access.
+    cif_archive.build_index();
+    test_suite.test_equality( cif_archive.has_index(), true, "CifArchive::has_index() 02" );
+    test_suite.test_equality( cif_archive.size(), 3, "CifArchive::size()" );
+    test_suite.test_equality( cif_archive.name( 0 ), std::string( "" ), "CifArchive::name() 0" );
+    test_suite.test_equality( cif_archive.name( 1 ), std::string( "first" ), "CifArchive::name() 1" );
+    test_suite.test_equality( cif_archive.name( 2 ), std::string( "second" ), "CifArchive::name() 2" );
+    test_suite.test_equality( cif_archive.text( 2 ), second_block, "CifArchive::text() 2" );
+    test_suite.test_equality( cif_archive.text( 1 ).substr( 0, 11 ), std::string( "data_first\n" ), "CifArchive::text() 1" );
+    cif_archive.read( 1, crystal_structure );
+    test_suite.test_equality( crystal_structure.name(), std::string( "first" ), "CifArchive::read() 01" );
+    test_suite.test_equality( crystal_structure.natoms(), 2, "CifArchive::read() 02" );
+    test_suite.test_equality_double( crystal_structure.crystal_lattice().a(), 5.0, "CifArchive::read() 03" );
+    try
+    {
+        cif_archive.read( 3, crystal_structure );
+        test_suite.log_error( "CifArchive::read() out of bounds" );
+    }
+    catch ( std::exception & e ) {}
+    // read_cif() only reads the first data block.
+    read_cif( file_name, crystal_structure );
+    test_suite.test_equality_double( crystal_structure.crystal_lattice().a(), 4.0, "read_cif() first data block" );
+    }
+    {
+    // Comments before the first data_ header do not form a data block.
+    write_file( file_name, "# Comment\n\n# Another comment\ndata_only\n" + structure_text( "5", "C1 0.1 0.2 0.3\n" ) );
+    CifArchive cif_archive( file_name );
+    cif_archive.build_index();
+    test_suite.test_equality( cif_archive.size(), 1, "CifArchive comments only 01" );
+    test_suite.test_equality( cif_archive.name( 0 ), std::string( "only" ), "CifArchive comments only 02" );
+    }
+    {
+    write_file( file_name, "" );
+    CifArchive cif_archive( file_name );
+    cif_archive.build_index();
+    test_suite.test_equality( cif_archive.size(), 0, "CifArchive empty file 01" );
+    CrystalStructure crystal_structure;
+    test_suite.test_equality( cif_archive.next( crystal_structure ), false, "CifArchive empty file 02" );
+    // An empty file gives an empty crystal structure.
+    read_cif( file_name, crystal_structure );
+    test_suite.test_equality( crystal_structure.natoms(), 0, "read_cif() empty file" );
+    }
+    std::remove( file_name.full_name().c_str() );
+}
+
@@ -0,0 +1,139 @@
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include "CifTokeniser.h"
+#include "CrystalStructure.h"
+#include "ReadCif.h"
+#include "Utilities.h"
+
+#include "TestSuite.h"
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+void test_CifTokeniser( TestSuite & test_suite )
+{
+    std::cout << "Now running tests for CifTokeniser." << std::endl;
+    {
+    const char * text = "# comment\r\nDATA_test1 _cell_length_a 7.1234(5) # comment\n"
+                        "_name 'O'Neill' \"two words\"\n"
+                        "_text\n;\n line 1\n line 2\n;\nLoop_ _x . '?' ? save_frame";
+    CifTokeniser cif_tokeniser( text, text + std::strlen( text ) );
+    std::vector< CifToken > tokens;
+    CifToken token;
+    while ( cif_tokeniser.next( token ) )
+        tokens.push_back( token );
+    test_suite.test_equality( tokens.size(), 14, "CifTokeniser 01" );
+    test_suite.test_equality( static_cast< int >( tokens[0].type_ ), static_cast< int >( CifToken::DATA_BLOCK ), "CifTokeniser 02" );
+    test_suite.test_equality( tokens[0].str(), std::string( "DATA_test1" ), "CifTokeniser 03" );
+    test_suite.test_equality( tokens[0].line_number_, 2, "CifTokeniser 04" );
+    test_suite.test_equality( static_cast< int >( tokens[1].type_ ), static_cast< int >( CifToken::TAG ), "CifTokeniser 05" );
+    test_suite.test_equality( tokens[1].equals( "_cell_length_a" ), true, "CifTokeniser 06" );
+    test_suite.test_equality_double( string2double( tokens[2].begin_, tokens[2].end_ ), 7.1234, "CifTokeniser 07" );
+    test_suite.test_equality( tokens[4].str(), std::string( "O'Neill" ), "CifTokeniser 08" );
+    test_suite.test_equality( tokens[5].str(), std::string( "two words" ), "CifTokeniser 09" );
+    test_suite.test_equality( tokens[7].str(), std::string( "\n line 1\n line 2" ), "CifTokeniser 10" );
+    test_suite.test_equality( tokens[7].is_quoted_, true, "CifTokeniser 11" );
+    test_suite.test_equality( static_cast< int >( tokens[8].type_ ), static_cast< int >( CifToken::LOOP ), "CifTokeniser 12" );
+    test_suite.test_equality( tokens[8].line_number_, 9, "CifTokeniser 13" );
+    test_suite.test_equality( tokens[10].is_placeholder(), true, "CifTokeniser 14" );
+    test_suite.test_equality( tokens[11].is_placeholder(), false, "CifTokeniser 15" );
+    cif_tokeniser.push_back_last_token();
+    test_suite.test_equality( cif_tokeniser.next( token ), true, "CifTokeniser 16" );
+    test_suite.test_equality( static_cast< int >( token.type_ ), static_cast< int >( CifToken::SAVE_FRAME ), "CifTokeniser 17" );
+    test_suite.test_equality( cif_tokeniser.next( token ), false, "CifTokeniser 18" );
+    }
+    {
+    const char * text = "_x 'not terminated\n";
+    CifTokeniser cif_tokeniser( text, text + std::strlen( text ) );
+    CifToken token;
+    cif_tokeniser.next( token );
+    try
+    {
+        cif_tokeniser.next( token );
+        test_suite.log_error( "CifTokeniser 19" );
+    }
+    catch ( std::exception & e ) {}
+    }
+    {
+    // Only letters are case insensitive, '_' is not '?'.
+    const char * text = "data?x loop? save?1 Data_y";
+    CifTokeniser cif_tokeniser( text, text + std::strlen( text ) );
+    CifToken token;
+    cif_tokeniser.next( token );
+    test_suite.test_equality( static_cast< int >( token.type_ ), static_cast< int >( CifToken::VALUE ), "CifTokeniser 20" );
+    test_suite.test_equality( token.str(), std::string( "data?x" ), "CifTokeniser 21" );
+    cif_tokeniser.next( token );
+    test_suite.test_equality( static_cast< int >( token.type_ ), static_cast< int >( CifToken::VALUE ), "CifTokeniser 22" );
+    cif_tokeniser.next( token );
+    test_suite.test_equality( static_cast< int >( token.type_ ), static_cast< int >( CifToken::VALUE ), "CifTokeniser 23" );
+    cif_tokeniser.next( token );
+    test_suite.test_equality( static_cast< int >( token.type_ ), static_cast< int >( CifToken::DATA_BLOCK ), "CifTokeniser 24" );
+    }
+    {
+    const char * numbers[] = { "1.234(5)", "-0.0068(7)", "+.5", "5.", "1.5e-1", "-2.5E+2(3)", "0.000123456789012345678901", "1234567890123456789012345" };
+    const double values[] = { 1.234, -0.0068, 0.5, 5.0, 0.15, -250.0, 0.000123456789012345678901, 1234567890123456789012345.0 };
+    for ( size_t i( 0 ); i != 8; ++i )
+        test_suite.test_equality( string2double( numbers[i], numbers[i] + std::strlen( numbers[i] ) ), values[i], "string2double() " + size_t2string( i ) );
+    const char * invalid_numbers[] = { ".", "?", "1.2.3", "1.2(3", "1.2(3)4", "e5", "1e" };
+    for ( size_t i( 0 ); i != 7; ++i )
+    {
+        try
+        {
+            string2double( invalid_numbers[i], invalid_numbers[i] + std::strlen( invalid_numbers[i] ) );
+            test_suite.log_error( std::string( "string2double() " ) + invalid_numbers[i] );
+        }
+        catch ( std::exception & e ) {}
+    }
+    }
+    {
+    const char * text = "data_first\n_cell_length_a 5 _cell_length_b 6 _cell_length_c 7\n"
+                        "_cell_angle_alpha 90 _cell_angle_beta 90 _cell_angle_gamma 90\n"
+                        "loop_ _symmetry_equiv_pos_as_xyz x,y,z\n"
+                        "loop_ _atom_site_label _atom_site_fract_x _atom_site_fract_y _atom_site_fract_z\n"
+                        "C1 0.1 0.2 0.3 N1 0.4 0.5 0.6\n"
+                        "data_second\n_cell_length_a 8 _cell_length_b 9 _cell_length_c 10\n"
+                        "_cell_angle_alpha 90 _cell_angle_beta 90 _cell_angle_gamma 90\n"
+                        "loop_ _space_group_symop_operation_xyz x,y,z -x,-y,-z\n"
+                        "loop_ _atom_site_label _atom_site_fract_x _atom_site_fract_y _atom_site_fract_z\n"
+                        "O1 0.1 0.2 0.3\n";
+    CifTokeniser cif_tokeniser( text, text + std::strlen( text ) );
+    CrystalStructure crystal_structure;
+    test_suite.test_equality( read_cif_data_block( cif_tokeniser, crystal_structure ), true, "read_cif_data_block() 01" );
+    test_suite.test_equality( crystal_structure.name(), std::string( "first" ), "read_cif_data_block() 02" );
+    test_suite.test_equality( crystal_structure.natoms(), 2, "read_cif_data_block() 03" );
+    test_suite.test_equality( read_cif_data_block( cif_tokeniser, crystal_structure ), true, "read_cif_data_block() 04" );
+    test_suite.test_equality( crystal_structure.name(), std::string( "second" ), "read_cif_data_block() 05" );
+    test_suite.test_equality( crystal_structure.natoms(), 1, "read_cif_data_block() 06" );
+    test_suite.test_equality( crystal_structure.space_group().nsymmetry_operators(), 2, "read_cif_data_block() 07" );
+    test_suite.test_equality_double( crystal_structure.crystal_lattice().a(), 8.0, "read_cif_data_block() 08" );
+    test_suite.test_equality( read_cif_data_block( cif_tokeniser, crystal_structure ), false, "read_cif_data_block() 09" );
+    }
+}
+
@@ -0,0 +1,108 @@
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include "ConnectivityTable.h"
+#include "AnalyseRings.h"
+
+#include "TestSuite.h"
+
+#include <iostream>
+
+void test_ConnectivityTable( TestSuite & test_suite )
+{
+    std::cout << "Now running tests for ConnectivityTable." << std::endl;
+    {
+    // Naphthalene (atoms 0-9) with a two-atom substituent (10, 11) on atom 9, a separate two-atom molecule (12, 13) and a single atom (14).
+    // The atoms of naphthalene are numbered around the outside, atoms 4 and 9 are shared by the two rings.
+    ConnectivityTable connectivity_table( 15 );
+    for ( size_t i( 0 ); i != 10; ++i )
+        connectivity_table.set_value( i, ( i + 1 ) % 10, 1 );
+    connectivity_table.set_value( 4, 9, 2 );
+    connectivity_table.set_value( 11, 10, 1 );
+    connectivity_table.set_value( 9, 10, 1 );
+    connectivity_table.set_value( 12, 13, 1 );
+    // Setting a bond twice and removing a bond that does not exist.
+    connectivity_table.set_value( 13, 12, 1 );
+    connectivity_table.set_value( 13, 14, 0 );
+    test_suite.test_equality( connectivity_table.nbonds(), 14, "ConnectivityTable::nbonds() 1" );
+    test_suite.test_equality( connectivity_table.value( 9, 4 ), 2, "ConnectivityTable::value() 1" );
+    test_suite.test_equality( connectivity_table.value( 4, 9 ), 2, "ConnectivityTable::value() 2" );
+    test_suite.test_equality( connectivity_table.value( 3, 3 ), 1, "ConnectivityTable::value() 3" );
+    test_suite.test_equality( connectivity_table.value( 3, 5 ), 0, "ConnectivityTable::value() 4" );
+    test_suite.test_equality( connectivity_table.nneighbours( 9 ), 4, "ConnectivityTable::nneighbours()" );
+    test_suite.test_equality( connectivity_table.neighbour( 9, 0 ), 0, "ConnectivityTable::neighbour() 1" );
+    test_suite.test_equality( connectivity_table.neighbour( 9, 1 ), 4, "ConnectivityTable::neighbour() 2" );
+    test_suite.test_equality( connectivity_table.neighbour( 9, 2 ), 8, "ConnectivityTable::neighbour() 3" );
+    test_suite.test_equality( connectivity_table.neighbour( 9, 3 ), 10, "ConnectivityTable::neighbour() 4" );
+    test_suite.test_equality( connectivity_table.bond_type( 9, 1 ), 2, "ConnectivityTable::bond_type()" );
+    try
+    {
+        connectivity_table.value( 2, 15 );
+        test_suite.log_error( "ConnectivityTable::value() should have thrown." );
+    }
+    catch ( std::exception & e ) {}
+    std::vector< std::vector< size_t > > molecules = split( connectivity_table );
+    test_suite.test_equality( molecules.size(), 3, "split() number of molecules" );
+    if ( molecules.size() == 3 )
+    {
+    test_suite.test_equality( molecules[0].size(), 12, "split() molecule 1" );
+    test_suite.test_equality( molecules[0].back(), 11, "split() molecule 1 sorted" );
+    test_suite.test_equality( molecules[1].size(), 2, "split() molecule 2" );
+    test_suite.test_equality( molecules[1][0], 12, "split() molecule 2 first atom" );
+    test_suite.test_equality( molecules[2].size(), 1, "split() molecule 3" );
+    }
+    std::vector< std::vector< size_t > > rings = find_rings( connectivity_table, 7 );
+    test_suite.test_equality( rings.size(), 2, "find_rings() 1" );
+    if ( rings.size() == 2 )
+    {
+    test_suite.test_equality( rings[0].size(), 6, "find_rings() ring 1" );
+    test_suite.test_equality( rings[0][0], 0, "find_rings() ring 1 first atom" );
+    test_suite.test_equality( rings[0][1], 1, "find_rings() ring 1 second atom" );
+    test_suite.test_equality( rings[1].size(), 6, "find_rings() ring 2" );
+    test_suite.test_equality( rings[1][0], 4, "find_rings() ring 2 first atom" );
+    }
+    test_suite.test_equality( find_rings( connectivity_table, 10 ).size(), 3, "find_rings() 2" );
+    std::vector< bool > is_cyclic = atoms_in_rings( connectivity_table );
+    size_t ncyclic_atoms( 0 );
+    for ( size_t i( 0 ); i != 10; ++i )
+    {
+        if ( is_cyclic[i] )
+            ++ncyclic_atoms;
+    }
+    test_suite.test_equality( ncyclic_atoms, 10, "atoms_in_rings() 1" );
+    for ( size_t i( 10 ); i != 15; ++i )
+    {
+        if ( is_cyclic[i] )
+            test_suite.log_error( "atoms_in_rings() 2" );
+    }
+    // Removing a bond.
+    connectivity_table.set_value( 4, 9, 0 );
+    test_suite.test_equality( connectivity_table.nbonds(), 13, "ConnectivityTable::nbonds() 2" );
+    test_suite.test_equality( find_rings( connectivity_table, 10 ).size(), 1, "find_rings() 3" );
+    }
+}
+
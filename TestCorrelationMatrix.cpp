@@ -27,7 +27,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "CorrelationMatrix.h"
 #include "TestSuite.h"
+#include "Utilities.h"
 
+#include <cmath>
 #include <iostream>
 
 void test_correlation_matrix( TestSuite & test_suite )
@@ -129,5 +131,75 @@ void test_correlation_matrix( TestSuite & test_suite )
     catch ( std::exception & e ) {}
 }
 
+{
+    // Reduced precision: float has a relative error of 6.0E-8, half of 4.9E-4.
+    CorrelationMatrix matrix_float( 4, CorrelationMatrix::FLOAT );
+    CorrelationMatrix matrix_half( 4, CorrelationMatrix::HALF );
+    double values[6] = { 0.123456789, 0.999, -0.5, 1.0E-6, 44.0, 0.0 };
+    size_t k( 0 );
+    for ( size_t i( 1 ); i != 4; ++i )
+    {
+        for ( size_t j( 0 ); j != i; ++j )
+        {
+            matrix_float.set_value( j, i, values[k] );
+            matrix_half.set_value( i, j, values[k] );
+            ++k;
+        }
+    }
+    k = 0;
+    for ( size_t i( 1 ); i != 4; ++i )
+    {
+        for ( size_t j( 0 ); j != i; ++j )
+        {
+            test_suite.test_equality_double( matrix_float.value( i, j ), values[k], "CorrelationMatrix FLOAT " + size_t2string( k ), 1.0E-7 * std::abs( values[k] ) + 1.0E-12 );
+            test_suite.test_equality_double( matrix_half.value( j, i ), values[k], "CorrelationMatrix HALF " + size_t2string( k ), 4.9E-4 * std::abs( values[k] ) + 1.0E-7 );
+            ++k;
+        }
+    }
+    test_suite.test_equality( matrix_half.value( 3, 2 ), 0.0, "CorrelationMatrix HALF 0.0" );
+    test_suite.test_equality( matrix_half.value( 1, 3 ), 44.0, "CorrelationMatrix HALF 44.0" );
+    test_suite.test_equality( matrix_half.largest_value(), 44.0, "CorrelationMatrix::largest_value() HALF" );
+    test_suite.test_equality( matrix_half.smallest_value(), -0.5, "CorrelationMatrix::smallest_value() HALF" );
+    // The copy is independent of the original.
+    CorrelationMatrix copy( matrix_half );
+    copy.set_value( 3, 1, 0.25 );
+    test_suite.test_equality( copy.precision(), CorrelationMatrix::HALF, "CorrelationMatrix copy precision" );
+    test_suite.test_equality( copy.value( 3, 1 ), 0.25, "CorrelationMatrix copy 01" );
+    test_suite.test_equality( matrix_half.value( 3, 1 ), 44.0, "CorrelationMatrix copy 02" );
+    copy = matrix_float;
+    test_suite.test_equality( copy.value( 1, 0 ), matrix_float.value( 1, 0 ), "CorrelationMatrix::operator=()" );
+}
+{
+    // clusters() reads the values row by row, the result must be the same as scanning each cluster's first entry against all later entries.
+    const size_t dimension( 23 );
+    CorrelationMatrix correlation_matrix( dimension );
+    for ( size_t i( 0 ); i != dimension; ++i )
+    {
+        for ( size_t j( i + 1 ); j != dimension; ++j )
+            correlation_matrix.set_value( i, j, fmod( ( i + 3 ) * ( j + 7 ) * 0.6180339887, 1.0 ) );
+    }
+    const double threshold( 0.8 );
+    std::vector< std::vector< size_t > > reference;
+    std::vector< bool > done( dimension, false );
+    for ( size_t i( 0 ); i != dimension; ++i )
+    {
+        if ( done[i] )
+            continue;
+        std::vector< size_t > one_cluster( 1, i );
+        done[i] = true;
+        for ( size_t j( i + 1 ); j != dimension; ++j )
+        {
+            if ( ( ! done[j] ) && ( correlation_matrix.value( i, j ) > threshold ) )
+            {
+                one_cluster.push_back( j );
+                done[j] = true;
+            }
+        }
+        reference.push_back( one_cluster );
+    }
+    std::vector< std::vector< size_t > > clusters = correlation_matrix.clusters( threshold );
+    test_suite.test_equality( clusters.size(), reference.size(), "CorrelationMatrix::clusters() 01" );
+    test_suite.test_equality( clusters == reference, true, "CorrelationMatrix::clusters() 02" );
 }
 
+}
@@ -29,7 +29,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "TestSuite.h"
 
+#include <cmath>
 #include <iostream>
+#include <vector>
 
 void test_crystal_lattice( TestSuite & test_suite )
 {
@@ -75,5 +77,65 @@ void test_crystal_lattice( TestSuite & test_suite )
     CrystalLattice crystal_lattice( 10.2, 10.2, 10.2, Angle::angle_90_degrees(), Angle::angle_90_degrees(), Angle::angle_90_degrees() );
     test_suite.test_equality( crystal_lattice.lattice_system(), CrystalLattice::CUBIC, "deduce_lattice_system() cubic" );
     }
+    {
+    // A very skewed unit cell: the shortest images are many unit cells away along the original axes.
+    CrystalLattice crystal_lattice( 5.0, 5.1, 40.0, Angle::from_degrees( 20.0 ), Angle::from_degrees( 22.0 ), Angle::from_degrees( 10.0 ) );
+    std::vector< Vector3D > lhs;
+    std::vector< Vector3D > rhs;
+    for ( size_t i( 0 ); i != 200; ++i )
+    {
+        lhs.push_back( Vector3D( 3.0 * fmod( i * 0.6180339887, 1.0 ) - 1.0, fmod( i * 0.4142135624, 1.0 ), fmod( i * 0.7320508076, 1.0 ) ) );
+        rhs.push_back( Vector3D( fmod( i * 0.3819660113, 1.0 ), 2.0 * fmod( i * 0.2360679775, 1.0 ), fmod( i * 0.1715728753, 1.0 ) - 2.0 ) );
+    }
+    std::vector< double > distances2;
+    crystal_lattice.shortest_distances2( lhs, rhs, distances2 );
+    bool all_distances_correct( true );
+    for ( size_t i( 0 ); i != lhs.size(); ++i )
+    {
+        // Brute force.
+        double shortest_distance2( 1.0E12 );
+        for ( int u( -12 ); u != 13; ++u )
+        {
+            for ( int v( -12 ); v != 13; ++v )
+            {
+                for ( int w( -12 ); w != 13; ++w )
+                {
+                    double distance2 = crystal_lattice.fractional_to_orthogonal( rhs[i] - lhs[i] + Vector3D( u, v, w ) ).norm2();
+                    if ( distance2 < shortest_distance2 )
+                        shortest_distance2 = distance2;
+                }
+            }
+        }
+        if ( fabs( distances2[i] - shortest_distance2 ) > 1.0E-8 )
+            all_distances_correct = false;
+        double distance;
+        Vector3D difference_vector;
+        crystal_lattice.shortest_distance( lhs[i], rhs[i], distance, difference_vector );
+        if ( fabs( crystal_lattice.fractional_to_orthogonal( difference_vector ).norm2() - shortest_distance2 ) > 1.0E-8 )
+            all_distances_correct = false;
+        Vector3D translation = lhs[i] + difference_vector - rhs[i];
+        if ( ( fabs( translation.x() - round( translation.x() ) ) > 1.0E-8 ) ||
+             ( fabs( translation.y() - round( translation.y() ) ) > 1.0E-8 ) ||
+             ( fabs( translation.z() - round( translation.z() ) ) > 1.0E-8 ) )
+            all_distances_correct = false;
+    }
+    test_suite.test_equality( all_distances_correct, true, "CrystalLattice::shortest_distances2() skewed unit cell" );
+    crystal_lattice.shortest_distances2( lhs[0], rhs, distances2 );
+    test_suite.test_equality_double( distances2[7], crystal_lattice.shortest_distance2( lhs[0], rhs[7] ), "CrystalLattice::shortest_distances2() one to many" );
+    std::vector< Vector3D > orthogonal;
+    crystal_lattice.fractional_to_orthogonal( rhs, orthogonal );
+    std::vector< Vector3D > fractional;
+    crystal_lattice.orthogonal_to_fractional( orthogonal, fractional );
+    test_suite.test_equality_double( ( orthogonal[11] - crystal_lattice.fractional_to_orthogonal( rhs[11] ) ).length(), 0.0, "CrystalLattice::fractional_to_orthogonal() batch" );
+    test_suite.test_equality_double( ( fractional[11] - rhs[11] ).length(), 0.0, "CrystalLattice::orthogonal_to_fractional() batch" );
+    }
+    {
+    // For a tie, the difference vector with all fractional coordinates in [0,1> is returned.
+    CrystalLattice crystal_lattice( 10.0, 10.0, 10.0, Angle::angle_90_degrees(), Angle::angle_90_degrees(), Angle::angle_90_degrees() );
+    double distance;
+    Vector3D difference_vector;
+    crystal_lattice.shortest_distance( Vector3D( 0.0, 0.0, 0.0 ), Vector3D( 0.5, 0.0, 0.0 ), distance, difference_vector );
+    test_suite.test_equality_double( distance, 5.0, "CrystalLattice::shortest_distance() tie 1" );
+    test_suite.test_equality_double( difference_vector.x(), 0.5, "CrystalLattice::shortest_distance() tie 2" );
+    }
 }
-
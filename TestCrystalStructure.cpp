@@ -26,10 +26,43 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ********************************************* */
 
 #include "CrystalStructure.h"
+#include "3DCalculations.h"
+#include "Mapping.h"
+#include "Utilities.h"
 
 #include "TestSuite.h"
 
+#include <algorithm>
 #include <iostream>
+#include <string>
+
+namespace
+{
+
+// The packed columns must agree with the atoms.
+void test_columns( TestSuite & test_suite, const CrystalStructure & crystal_structure, const std::string & message )
+{
+    test_suite.test_equality( crystal_structure.atom_positions().size(), crystal_structure.natoms(), message + " positions size" );
+    test_suite.test_equality( crystal_structure.atom_elements().size(), crystal_structure.natoms(), message + " elements size" );
+    test_suite.test_equality( crystal_structure.atom_occupancies().size(), crystal_structure.natoms(), message + " occupancies size" );
+    for ( size_t i( 0 ); i != std::min( crystal_structure.natoms(), crystal_structure.atom_positions().size() ); ++i )
+    {
+        if ( ! nearly_equal( crystal_structure.atom_positions()[i], crystal_structure.atom( i ).position() ) )
+            test_suite.log_error( message + " position " + size_t2string( i ) );
+    }
+    for ( size_t i( 0 ); i != std::min( crystal_structure.natoms(), crystal_structure.atom_elements().size() ); ++i )
+    {
+        if ( crystal_structure.atom_elements()[i] != crystal_structure.atom( i ).element() )
+            test_suite.log_error( message + " element " + size_t2string( i ) );
+    }
+    for ( size_t i( 0 ); i != std::min( crystal_structure.natoms(), crystal_structure.atom_occupancies().size() ); ++i )
+    {
+        if ( crystal_structure.atom_occupancies()[i] != crystal_structure.atom( i ).occupancy() )
+            test_suite.log_error( message + " occupancy " + size_t2string( i ) );
+    }
+}
+
+} // namespace
 
 void test_crystal_structure( TestSuite & test_suite )
 {
@@ -77,6 +110,181 @@ void test_crystal_structure( TestSuite & test_suite )
     crystal_structure.transform( transformation_matrix );
     test_suite.test_equality_double( crystal_structure.crystal_lattice().orthogonality_defect(), 1.12236, "CrystalStructure::choose_angles_close_to_90() : Error 2.", 0.0001 );
     }
+    {
+    // A water molecule split over the unit-cell boundaries, and a lone chlorine atom.
+    CrystalStructure crystal_structure;
+    crystal_structure.set_crystal_lattice( CrystalLattice( 6.0, 7.0, 8.0, Angle::angle_90_degrees(), Angle::from_degrees( 100.0 ), Angle::angle_90_degrees() ) );
+    crystal_structure.add_atom( Atom( Element( "O" ), Vector3D( 0.99, 0.5, 0.5 ), "O1" ) );
+    crystal_structure.add_atom( Atom( Element( "Cl" ), Vector3D( 0.5, 0.0, 0.0 ), "Cl1" ) );
+    crystal_structure.add_atom( Atom( Element( "H" ), Vector3D( 0.14, 0.5, 0.5 ), "H1" ) );
+    crystal_structure.add_atom( Atom( Element( "H" ), Vector3D( 0.95, 0.62, 0.5 ), "H2" ) );
+    std::vector< std::string > labels_1;
+    std::vector< std::string > labels_2;
+    std::vector< std::string > labels_3;
+    std::vector< double > values;
+    crystal_structure.list_all_bonds( labels_1, labels_2, values );
+    test_suite.test_equality( values.size(), 2, "CrystalStructure::list_all_bonds() number of bonds" );
+    if ( values.size() == 2 )
+    {
+    test_suite.test_equality( labels_1[0] + labels_2[0] + labels_1[1] + labels_2[1], std::string( "O1H1O1H2" ), "CrystalStructure::list_all_bonds() labels" );
+    test_suite.test_equality_double( values[0], crystal_structure.crystal_lattice().shortest_distance( crystal_structure.atom( 0 ).position(), crystal_structure.atom( 2 ).position() ), "CrystalStructure::list_all_bonds() bond length" );
+    }
+    labels_1.clear();
+    labels_2.clear();
+    values.clear();
+    crystal_structure.list_all_angles( labels_1, labels_2, labels_3, values );
+    test_suite.test_equality( values.size(), 1, "CrystalStructure::list_all_angles() number of angles" );
+    if ( values.size() == 1 )
+    {
+    test_suite.test_equality( labels_1[0] + labels_2[0] + labels_3[0], std::string( "H1O1H2" ), "CrystalStructure::list_all_angles() labels" );
+    Vector3D O1 = crystal_structure.crystal_lattice().fractional_to_orthogonal( Vector3D( -0.01, 0.5, 0.5 ) );
+    Vector3D H1 = crystal_structure.crystal_lattice().fractional_to_orthogonal( Vector3D( 0.14, 0.5, 0.5 ) );
+    Vector3D H2 = crystal_structure.crystal_lattice().fractional_to_orthogonal( Vector3D( -0.05, 0.62, 0.5 ) );
+    test_suite.test_equality_double( values[0], angle( H1 - O1, H2 - O1 ).value_in_degrees(), "CrystalStructure::list_all_angles() angle" );
+    }
+    test_suite.test_equality( crystal_structure.nearest_atom( 1 ), 3, "CrystalStructure::nearest_atom() 1" );
+    test_suite.test_equality( crystal_structure.nearest_atom( 2 ), 0, "CrystalStructure::nearest_atom() 2" );
+    crystal_structure.move_atoms_to_form_molecules( false );
+    test_suite.test_equality_double( ( crystal_structure.crystal_lattice().fractional_to_orthogonal( crystal_structure.atom( 2 ).position() - crystal_structure.atom( 0 ).position() ) ).length(), crystal_structure.crystal_lattice().shortest_distance( crystal_structure.atom( 0 ).position(), crystal_structure.atom( 2 ).position() ), "CrystalStructure::move_atoms_to_form_molecules() H1" );
+    test_suite.test_equality_double( ( crystal_structure.crystal_lattice().fractional_to_orthogonal( crystal_structure.atom( 3 ).position() - crystal_structure.atom( 0 ).position() ) ).length(), crystal_structure.crystal_lattice().shortest_distance( crystal_structure.atom( 0 ).position(), crystal_structure.atom( 3 ).position() ), "CrystalStructure::move_atoms_to_form_molecules() H2" );
+    }
+    {
+    // A structure in P2_1/c and a copy of it that has been moved by a symmetry operator, a shift of the origin and lattice translations,
+    // with its atoms in a different order. map() must find the correspondence, including for the hydrogen atoms.
+    std::vector< SymmetryOperator > symmetry_operators;
+    symmetry_operators.push_back( SymmetryOperator( "x,y,z" ) );
+    symmetry_operators.push_back( SymmetryOperator( "-x,y+1/2,-z+1/2" ) );
+    symmetry_operators.push_back( SymmetryOperator( "-x,-y,-z" ) );
+    symmetry_operators.push_back( SymmetryOperator( "x,-y+1/2,z+1/2" ) );
+    CrystalStructure target;
+    target.set_crystal_lattice( CrystalLattice( 12.0, 8.0, 15.0, Angle::angle_90_degrees(), Angle::from_degrees( 105.0 ), Angle::angle_90_degrees() ) );
+    target.set_space_group( SpaceGroup( symmetry_operators ) );
+    target.add_atom( Atom( Element( "C" ), Vector3D( 0.31, 0.22, 0.14 ), "C1" ) );
+    target.add_atom( Atom( Element( "C" ), Vector3D( 0.42, 0.27, 0.19 ), "C2" ) );
+    target.add_atom( Atom( Element( "O" ), Vector3D( 0.47, 0.41, 0.17 ), "O1" ) );
+    target.add_atom( Atom( Element( "N" ), Vector3D( 0.35, 0.61, 0.31 ), "N1" ) );
+    target.add_atom( Atom( Element( "H" ), Vector3D( 0.27, 0.11, 0.16 ), "H1" ) );
+    target.add_atom( Atom( Element( "H" ), Vector3D( 0.46, 0.17, 0.22 ), "H2" ) );
+    // to_be_changed = ( -x, y-1/2, -z+1/2 ) - ( 0.25, 0.5, 0.75 ) + ( 1, 0, -1 ), the inverse of "-x,y+1/2,-z+1/2" followed by the inverse of the shift.
+    CrystalStructure to_be_changed( target );
+    const size_t order[6] = { 5, 2, 0, 4, 3, 1 };
+    for ( size_t i( 0 ); i != 6; ++i )
+    {
+        Atom new_atom( target.atom( order[i] ) );
+        Vector3D position = target.atom( order[i] ).position();
+        new_atom.set_position( Vector3D( -position.x() + 0.75, position.y() - 1.0, -position.z() - 1.25 ) );
+        to_be_changed.set_atom( i, new_atom );
+    }
+    CrystalStructure moved( to_be_changed );
+    Mapping mapping;
+    SymmetryOperator symmetry_operator;
+    std::vector< Vector3D > translations;
+    map( to_be_changed, target, 4, mapping, symmetry_operator, translations, false, false );
+    to_be_changed.apply_map( mapping, symmetry_operator, translations );
+    bool all_atoms_correct( true );
+    for ( size_t i( 0 ); i != 6; ++i )
+    {
+        if ( ( to_be_changed.atom( i ).label() != target.atom( i ).label() ) || ( ! nearly_equal( to_be_changed.atom( i ).position(), target.atom( i ).position() ) ) )
+            all_atoms_correct = false;
+    }
+    test_suite.test_equality( all_atoms_correct, true, "map()" );
+    test_suite.test_equality_double( RMSCD_with_matching( target, moved, 4, false, true ), 0.0, "RMSCD_with_matching()" );
+    }
+    {
+    // An atom on an inversion centre in P2_1/c is mapped onto the same image by the 2_1 axis and by the c-glide.
+    std::vector< SymmetryOperator > symmetry_operators;
+    symmetry_operators.push_back( SymmetryOperator( "x,y,z" ) );
+    symmetry_operators.push_back( SymmetryOperator( "-x,y+1/2,-z+1/2" ) );
+    symmetry_operators.push_back( SymmetryOperator( "-x,-y,-z" ) );
+    symmetry_operators.push_back( SymmetryOperator( "x,-y+1/2,z+1/2" ) );
+    CrystalStructure crystal_structure;
+    crystal_structure.set_crystal_lattice( CrystalLattice( 12.0, 8.0, 15.0, Angle::angle_90_degrees(), Angle::from_degrees( 105.0 ), Angle::angle_90_degrees() ) );
+    crystal_structure.set_space_group( SpaceGroup( symmetry_operators ) );
+    crystal_structure.add_atom( Atom( Element( "C" ), Vector3D( 0.31, 0.22, 0.14 ), "C1" ) );
+    crystal_structure.add_atom( Atom( Element( "Fe" ), Vector3D( 0.0, 0.0, 1.0 ), "Fe1" ) );
+    std::vector< std::vector< size_t > > images = crystal_structure.distinct_symmetry_images();
+    test_suite.test_equality( images[0].size(), 4, "CrystalStructure::distinct_symmetry_images() general position" );
+    test_suite.test_equality( images[1].size(), 2, "CrystalStructure::distinct_symmetry_images() special position" );
+    crystal_structure.apply_space_group_symmetry();
+    test_suite.test_equality( crystal_structure.natoms(), 6, "CrystalStructure::apply_space_group_symmetry() 1" );
+    test_suite.test_equality( crystal_structure.atom( 3 ).label(), std::string( "Fe1_1" ), "CrystalStructure::apply_space_group_symmetry() label" );
+    // A second call is ignored.
+    crystal_structure.apply_space_group_symmetry();
+    test_suite.test_equality( crystal_structure.natoms(), 6, "CrystalStructure::apply_space_group_symmetry() 2" );
+    }
+    {
+    std::vector< SymmetryOperator > symmetry_operators;
+    symmetry_operators.push_back( SymmetryOperator( "x,y,z" ) );
+    symmetry_operators.push_back( SymmetryOperator( "-x,-y,-z" ) );
+    CrystalStructure crystal_structure;
+    crystal_structure.set_crystal_lattice( CrystalLattice( 10.0, 11.0, 12.0, Angle::angle_90_degrees(), Angle::angle_90_degrees(), Angle::angle_90_degrees() ) );
+    crystal_structure.set_space_group( SpaceGroup( symmetry_operators ) );
+    crystal_structure.add_atom( Atom( Element( "C" ), Vector3D( 0.11, 0.12, 0.13 ), "C1" ) );
+    crystal_structure.add_atom( Atom( Element( "O" ), Vector3D( 0.21, 0.22, 0.23 ), "O1" ) );
+    crystal_structure.add_atom( Atom( Element( "C" ), Vector3D( 0.31, 0.32, 0.33 ), "C1" ) );
+    crystal_structure.add_atom( Atom( Element( "H" ), Vector3D( 0.41, 0.42, 0.43 ), "H1" ) );
+    crystal_structure.set_use_label_index( true );
+    test_suite.test_equality( crystal_structure.find_label( "C1" ), 0, "CrystalStructure label index 01" );
+    Atom new_atom( crystal_structure.atom( 0 ) );
+    new_atom.set_label( "C9" );
+    crystal_structure.set_atom( 0, new_atom );
+    test_suite.test_equality( crystal_structure.find_label( "C1" ), 2, "CrystalStructure label index 02" );
+    test_suite.test_equality( crystal_structure.atom( "C9" ), 0, "CrystalStructure label index 03" );
+    crystal_structure.add_atom( Atom( Element( "N" ), Vector3D( 0.51, 0.52, 0.53 ), "N1" ) );
+    test_suite.test_equality( crystal_structure.atom( "N1" ), 4, "CrystalStructure label index 04" );
+    crystal_structure.apply_space_group_symmetry();
+    test_suite.test_equality( crystal_structure.atom( "N1_1" ), 9, "CrystalStructure label index 05" );
+    crystal_structure.remove_H_and_D();
+    test_suite.test_equality( crystal_structure.find_label( "N1_1" ), 7, "CrystalStructure label index 06" );
+    test_suite.test_equality( crystal_structure.find_label( "H1" ), crystal_structure.natoms(), "CrystalStructure label index 07" );
+    crystal_structure.make_atom_labels_unique();
+    test_suite.test_equality( crystal_structure.find_label( "N3" ), 3, "CrystalStructure label index 08" );
+    test_suite.test_equality( crystal_structure.find_label( "C9" ), crystal_structure.natoms(), "CrystalStructure label index 09" );
+    }
+    {
+    // The columns with positions, elements and occupancies are kept in sync by every function that changes atoms.
+    std::vector< SymmetryOperator > symmetry_operators;
+    symmetry_operators.push_back( SymmetryOperator( "x,y,z" ) );
+    symmetry_operators.push_back( SymmetryOperator( "-x,-y,-z" ) );
+    CrystalStructure crystal_structure;
+    crystal_structure.set_crystal_lattice( CrystalLattice( 10.0, 11.0, 12.0, Angle::angle_90_degrees(), Angle::angle_90_degrees(), Angle::angle_90_degrees() ) );
+    crystal_structure.set_space_group( SpaceGroup( symmetry_operators ) );
+    test_columns( test_suite, crystal_structure, "CrystalStructure columns 01" );
+    crystal_structure.add_atom( Atom( Element( "C" ), Vector3D( 0.11, 0.12, 0.13 ), "C1" ) );
+    std::vector< Atom > atoms;
+    atoms.push_back( Atom( Element( "O" ), Vector3D( 1.21, 0.22, 0.23 ), "O1" ) );
+    atoms.push_back( Atom( Element( "H" ), Vector3D( 0.31, -0.68, 0.33 ), "H1" ) );
+    crystal_structure.add_atoms( atoms );
+    test_columns( test_suite, crystal_structure, "CrystalStructure columns 02" );
+    Atom new_atom( crystal_structure.atom( 0 ) );
+    new_atom.set_element( Element( "N" ) );
+    new_atom.set_position( Vector3D( 0.14, 0.15, 0.16 ) );
+    new_atom.set_occupancy( 0.5 );
+    crystal_structure.set_atom( 0, new_atom );
+    test_columns( test_suite, crystal_structure, "CrystalStructure columns 03" );
+    test_suite.test_equality( crystal_structure.atom_elements()[0] == Element( "N" ), true, "CrystalStructure columns 03 element" );
+    test_suite.test_equality_double( crystal_structure.atom_occupancies()[0], 0.5, "CrystalStructure columns 03 occupancy" );
+    crystal_structure.position_all_atoms_within_unit_cell();
+    test_columns( test_suite, crystal_structure, "CrystalStructure columns 04" );
+    test_suite.test_equality_double( crystal_structure.atom_positions()[1].x(), 0.21, "CrystalStructure columns 04 position" );
+    crystal_structure.apply_space_group_symmetry();
+    test_columns( test_suite, crystal_structure, "CrystalStructure columns 05" );
+    test_suite.test_equality( crystal_structure.natoms(), 6, "CrystalStructure columns 05 natoms" );
+    crystal_structure.move_atoms_to_form_molecules( false );
+    test_columns( test_suite, crystal_structure, "CrystalStructure columns 06" );
+    crystal_structure.remove_H_and_D();
+    test_columns( test_suite, crystal_structure, "CrystalStructure columns 07" );
+    crystal_structure.reduce_to_asymmetric_unit();
+    test_columns( test_suite, crystal_structure, "CrystalStructure columns 08" );
+    test_suite.test_equality( crystal_structure.natoms(), 2, "CrystalStructure columns 08 natoms" );
+    crystal_structure.convert_to_P1();
+    crystal_structure.supercell( 2, 1, 1 );
+    test_columns( test_suite, crystal_structure, "CrystalStructure columns 09" );
+    crystal_structure.collapse_supercell( 2, 1, 1 );
+    test_columns( test_suite, crystal_structure, "CrystalStructure columns 10" );
+    crystal_structure.transform( Matrix3D( 0.0, 1.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, -1.0 ) );
+    test_columns( test_suite, crystal_structure, "CrystalStructure columns 11" );
+    }
 
 }
 
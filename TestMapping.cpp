@@ -30,6 +30,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "TestSuite.h"
 
 #include <iostream>
+#include <vector>
 
 void test_mapping( TestSuite & test_suite )
 {
@@ -63,6 +64,18 @@ void test_mapping( TestSuite & test_suite )
     test_suite.test_equality( dummy[0], 1, "Mapping() 09" );
     test_suite.test_equality( dummy[2], 4, "Mapping() 10" );
     }
+    {
+    // The greedy choice for row 0 (column 0) is not part of the optimal solution.
+    std::vector< std::vector< double > > costs( 3, std::vector< double >( 3 ) );
+    costs[0][0] = 1.0; costs[0][1] = 2.0; costs[0][2] = 9.0;
+    costs[1][0] = 2.0; costs[1][1] = 9.0; costs[1][2] = 9.0;
+    costs[2][0] = 9.0; costs[2][1] = 3.0; costs[2][2] = 4.0;
+    Mapping dummy = minimum_cost_mapping( costs );
+    test_suite.test_equality( dummy[0], 1, "minimum_cost_mapping() 01" );
+    test_suite.test_equality( dummy[1], 0, "minimum_cost_mapping() 02" );
+    test_suite.test_equality( dummy[2], 2, "minimum_cost_mapping() 03" );
+    test_suite.test_equality( minimum_cost_mapping( std::vector< std::vector< double > >() ).size(), 0, "minimum_cost_mapping() 04" );
+    }
 
 }
 
@@ -0,0 +1,112 @@
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include "NeighbourSearch.h"
+#include "3DCalculations.h"
+#include "CrystalLattice.h"
+
+#include "TestSuite.h"
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+void test_NeighbourSearch( TestSuite & test_suite )
+{
+    std::cout << "Now running tests for NeighbourSearch." << std::endl;
+    {
+    // A skewed unit cell, with coordinates outside [0,1> on purpose.
+    // The largest cutoff is larger than the perpendicular widths of the unit cell, so more than one image of a pair lies within the cutoff.
+    CrystalLattice crystal_lattice( 7.3, 8.9, 6.1, Angle::from_degrees( 71.0 ), Angle::from_degrees( 112.0 ), Angle::from_degrees( 64.0 ) );
+    const size_t npoints( 157 );
+    std::vector< Vector3D > positions;
+    for ( size_t i( 0 ); i != npoints; ++i )
+        positions.push_back( Vector3D( 3.0 * fmod( i * 0.6180339887, 1.0 ) - 1.0, 2.0 * fmod( i * 0.4142135624 + 0.1, 1.0 ) - 0.5, fmod( i * 0.7320508076 + 0.3, 1.0 ) ) );
+    double cutoffs[3] = { 0.4, 2.5, 9.0 };
+    for ( size_t c( 0 ); c != 3; ++c )
+    {
+        NeighbourSearch neighbour_search( crystal_lattice, positions, cutoffs[c] );
+        std::vector< NeighbourPair > pairs = neighbour_search.pairs();
+        // Brute force.
+        size_t npairs( 0 );
+        bool all_pairs_correct( true );
+        for ( size_t i( 0 ); i != npoints; ++i )
+        {
+            for ( size_t j( i + 1 ); j != npoints; ++j )
+            {
+                double distance2 = crystal_lattice.shortest_distance2( positions[i], positions[j] );
+                if ( distance2 >= cutoffs[c] * cutoffs[c] )
+                    continue;
+                if ( ( npairs >= pairs.size() ) || ( pairs[npairs].i_ != i ) || ( pairs[npairs].j_ != j ) || ( fabs( pairs[npairs].distance2_ - distance2 ) > 1.0E-8 ) )
+                    all_pairs_correct = false;
+                else if ( fabs( crystal_lattice.fractional_to_orthogonal( pairs[npairs].difference_vector_ ).norm2() - distance2 ) > 1.0E-8 )
+                    all_pairs_correct = false;
+                else
+                {
+                    // The difference vector must connect i to an image of j.
+                    Vector3D translation = positions[i] + pairs[npairs].difference_vector_ - positions[j];
+                    if ( ( fabs( translation.x() - round( translation.x() ) ) > 1.0E-8 ) ||
+                         ( fabs( translation.y() - round( translation.y() ) ) > 1.0E-8 ) ||
+                         ( fabs( translation.z() - round( translation.z() ) ) > 1.0E-8 ) )
+                        all_pairs_correct = false;
+                }
+                ++npairs;
+            }
+        }
+        test_suite.test_equality( pairs.size(), npairs, "NeighbourSearch::pairs() number of pairs" );
+        test_suite.test_equality( all_pairs_correct, true, "NeighbourSearch::pairs() pairs" );
+        Vector3D point( 1.37, -0.21, 0.55 );
+        std::vector< NeighbourPair > neighbours = neighbour_search.neighbours( point );
+        size_t nneighbours( 0 );
+        bool all_neighbours_correct( true );
+        for ( size_t j( 0 ); j != npoints; ++j )
+        {
+            double distance2 = crystal_lattice.shortest_distance2( point, positions[j] );
+            if ( distance2 >= cutoffs[c] * cutoffs[c] )
+                continue;
+            if ( ( nneighbours >= neighbours.size() ) || ( neighbours[nneighbours].j_ != j ) || ( fabs( neighbours[nneighbours].distance2_ - distance2 ) > 1.0E-8 ) )
+                all_neighbours_correct = false;
+            ++nneighbours;
+        }
+        test_suite.test_equality( neighbours.size(), nneighbours, "NeighbourSearch::neighbours() number of neighbours" );
+        test_suite.test_equality( all_neighbours_correct, true, "NeighbourSearch::neighbours() neighbours" );
+    }
+    }
+    {
+    // No points at all.
+    CrystalLattice crystal_lattice( 5.0, 5.0, 5.0, Angle::angle_90_degrees(), Angle::angle_90_degrees(), Angle::angle_90_degrees() );
+    NeighbourSearch neighbour_search( crystal_lattice, std::vector< Vector3D >(), 2.0 );
+    test_suite.test_equality( neighbour_search.pairs().size(), static_cast<size_t>(0), "NeighbourSearch::pairs() no points" );
+    try
+    {
+        NeighbourSearch neighbour_search( crystal_lattice, std::vector< Vector3D >(), 0.0 );
+        test_suite.log_error( "NeighbourSearch::NeighbourSearch() should have thrown." );
+    }
+    catch ( std::exception & e ) {}
+    }
+}
+
@@ -0,0 +1,91 @@
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include "PeakProfileTable.h"
+#include "Angle.h"
+#include "FingerCoxJephcoat.h"
+#include "MathsFunctions.h"
+
+#include "TestSuite.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+void test_PeakProfileTable( TestSuite & test_suite )
+{
+    std::cout << "Now running tests for PeakProfileTable." << std::endl;
+    {
+    PeakProfileTable peak_profile_table;
+    test_suite.test_equality_double( peak_profile_table.value( 0.0 ), 0.0, "PeakProfileTable::PeakProfileTable() empty" );
+    }
+    {
+    // Points that are not on the grid, i.e. peaks that are not centred at a 2theta value of the powder pattern.
+    const double FWHM( 0.1 );
+    PeakProfileTable peak_profile_table( FWHM, 0.01 );
+    double maximum = pseudo_Voigt( 0.0, FWHM );
+    test_suite.test_equality_double( peak_profile_table.value( 0.0 ), maximum, "PeakProfileTable::value() maximum" );
+    double largest_difference( 0.0 );
+    for ( int i( -400 ); i != 401; ++i )
+    {
+        double x = i * 0.001234;
+        double difference = peak_profile_table.value( x ) - pseudo_Voigt( x, FWHM );
+        // Beyond the cut-off the table is 0.0, the difference is then at most 0.1% of the maximum.
+        if ( fabs( x ) > peak_profile_table.half_width() )
+            test_suite.test_equality_double( peak_profile_table.value( x ), 0.0, "PeakProfileTable::value() beyond half width" );
+        else if ( fabs( difference ) > largest_difference )
+            largest_difference = fabs( difference );
+    }
+    test_suite.test_equality_double( largest_difference / maximum, 0.0, "PeakProfileTable::value() interpolation", 1.0E-4 );
+    test_suite.test_equality_double( pseudo_Voigt( peak_profile_table.half_width(), FWHM ) / maximum, 0.0, "PeakProfileTable::half_width()", 1.0E-3 );
+    }
+    {
+    // Finger-Cox-Jephcoat with the pseudo-Voigt from the table against the original, where the pseudo-Voigt is calculated.
+    const double FWHM( 0.08 );
+    PeakProfileTable peak_profile_table( FWHM, 0.01 );
+    FingerCoxJephcoat finger_cox_jephcoat( 0.01, 0.01 );
+    Angle two_theta = Angle::from_degrees( 7.3456 );
+    std::vector< Angle > two_phi_values;
+    for ( size_t i( 0 ); i != 200; ++i )
+        two_phi_values.push_back( Angle::from_degrees( 6.0 + i * 0.01 ) );
+    std::vector< double > reference = finger_cox_jephcoat.asymmetric_peak( two_theta, two_phi_values, FWHM );
+    std::vector< double > values = finger_cox_jephcoat.asymmetric_peak( two_theta, two_phi_values, peak_profile_table );
+    double maximum( 0.0 );
+    for ( size_t i( 0 ); i != reference.size(); ++i )
+        maximum = std::max( maximum, reference[i] );
+    double largest_difference( 0.0 );
+    for ( size_t i( 0 ); i != reference.size(); ++i )
+        largest_difference = std::max( largest_difference, fabs( values[i] - reference[i] ) );
+    test_suite.test_equality_double( largest_difference / maximum, 0.0, "FingerCoxJephcoat::asymmetric_peak() PeakProfileTable", 2.0E-3 );
+    // Outside the window the peak is exactly zero.
+    Angle below_window = finger_cox_jephcoat.two_phi_min( two_theta ) - Angle::from_degrees( peak_profile_table.half_width() + 0.001 );
+    std::vector< double > outside = finger_cox_jephcoat.asymmetric_peak( two_theta, std::vector< Angle >( 1, below_window ), peak_profile_table );
+    test_suite.test_equality_double( outside[0], 0.0, "FingerCoxJephcoat::two_phi_min()" );
+    }
+}
+
@@ -0,0 +1,95 @@
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include "PhaseSumKernel.h"
+#include "Angle.h"
+
+#include "TestSuite.h"
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+void test_PhaseSumKernel( TestSuite & test_suite )
+{
+    std::cout << "Now running tests for PhaseSumKernel." << std::endl;
+    {
+    // 37 atoms, so that the vectorised versions also have to deal with a remainder.
+    // Coordinates outside [0,1> are included on purpose.
+    const size_t natoms( 37 );
+    std::vector< double > x;
+    std::vector< double > y;
+    std::vector< double > z;
+    std::vector< double > w;
+    for ( size_t j( 0 ); j != natoms; ++j )
+    {
+        x.push_back( 3.0 * fmod( j * 0.6180339887, 1.0 ) - 1.0 );
+        y.push_back( 2.0 * fmod( j * 0.4142135624 + 0.1, 1.0 ) - 0.5 );
+        z.push_back( fmod( j * 0.7320508076 + 0.3, 1.0 ) );
+        w.push_back( 0.5 + fmod( j * 0.2360679775, 1.0 ) );
+    }
+    std::vector< PhaseSumKernel::InstructionSet > instruction_sets;
+    instruction_sets.push_back( PhaseSumKernel::SCALAR );
+    instruction_sets.push_back( PhaseSumKernel::AVX2 );
+    instruction_sets.push_back( PhaseSumKernel::AVX512 );
+    for ( size_t j( 0 ); j != instruction_sets.size(); ++j )
+    {
+        if ( ! PhaseSumKernel::is_supported( instruction_sets[j] ) )
+            std::cout << "PhaseSumKernel: instruction set " << instruction_set_to_string( instruction_sets[j] ) << " is not supported and is not tested." << std::endl;
+    }
+    int hkl[4][3] = { { 1, 0, 0 }, { 3, -2, 5 }, { -17, 23, 11 }, { 0, 0, 40 } };
+    for ( size_t i( 0 ); i != 4; ++i )
+    {
+        int h = hkl[i][0];
+        int k = hkl[i][1];
+        int l = hkl[i][2];
+        // The original scalar path: one Angle and one call to sincos() per atom.
+        double reference_cosine_sum( 0.0 );
+        double reference_sine_sum( 0.0 );
+        for ( size_t j( 0 ); j != natoms; ++j )
+        {
+            double sine;
+            double cosine;
+            sincos( Angle::from_radians( 2.0 * CONSTANT_PI * ( h*x[j] + k*y[j] + l*z[j] ) ), sine, cosine );
+            reference_cosine_sum += w[j] * cosine;
+            reference_sine_sum += w[j] * sine;
+        }
+        for ( size_t j( 0 ); j != instruction_sets.size(); ++j )
+        {
+            if ( ! PhaseSumKernel::is_supported( instruction_sets[j] ) )
+                continue;
+            PhaseSumKernel phase_sum_kernel( instruction_sets[j] );
+            double cosine_sum( 0.0 );
+            double sine_sum( 0.0 );
+            phase_sum_kernel.phase_sum( h, k, l, &x[0], &y[0], &z[0], &w[0], natoms, cosine_sum, sine_sum );
+            test_suite.test_equality_double( cosine_sum, reference_cosine_sum, "PhaseSumKernel::phase_sum() cosine " + instruction_set_to_string( instruction_sets[j] ), 1.0E-10 );
+            test_suite.test_equality_double( sine_sum, reference_sine_sum, "PhaseSumKernel::phase_sum() sine " + instruction_set_to_string( instruction_sets[j] ), 1.0E-10 );
+        }
+    }
+    }
+}
+
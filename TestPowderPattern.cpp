@@ -26,12 +26,39 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ********************************************* */
 
 #include "PowderPattern.h"
+#include "MathsFunctions.h"
+#include "PreparedPowderPattern.h"
+#include "Utilities.h"
 
 #include "TestSuite.h"
 
+#include <cmath>
 #include <string>
 #include <iostream>
 
+namespace
+{
+
+// The original double loop of weighted_cross_correlation().
+double reference_weighted_cross_correlation( const PowderPattern & lhs, const PowderPattern & rhs, const Angle l )
+{
+    int m = round_to_int( l / lhs.average_two_theta_step() );
+    if ( m == 0 )
+        m = 1;
+    double result( 0.0 );
+    for ( int i( 0 ); i != static_cast<int>( lhs.size() ); ++i )
+    {
+        for ( int j( -m + 1 ); j != m; ++j )
+        {
+            if ( ( ( i + j ) >= 0 ) && ( ( i + j ) < static_cast<int>( lhs.size() ) ) )
+                result += ( 1.0 - std::abs( j ) / static_cast<double>( m ) ) * lhs.intensity( i ) * rhs.intensity( i + j );
+        }
+    }
+    return result;
+}
+
+} // namespace
+
 void test_PowderPattern( TestSuite & test_suite )
 {
     std::cout << "Now running tests for PowderPattern." << std::endl;
@@ -49,5 +76,48 @@ void test_PowderPattern( TestSuite & test_suite )
     test_suite.test_equality( powder_patterns[0].intensity( 1 ) + powder_patterns[1].intensity( 1 ), 1, "split( PowderPattern ) 06" );
     test_suite.test_equality( powder_patterns[0].intensity( 2 ) + powder_patterns[1].intensity( 2 ), 0, "split( PowderPattern ) 07" );
     }
+    {
+    // Two patterns with a handful of peaks at different positions, including one near each end.
+    PowderPattern powder_pattern_1( Angle::from_degrees( 5.0 ), Angle::from_degrees( 20.0 ), Angle::from_degrees( 0.01 ) );
+    PowderPattern powder_pattern_2( Angle::from_degrees( 5.0 ), Angle::from_degrees( 20.0 ), Angle::from_degrees( 0.01 ) );
+    double peak_positions_1[5] = { 5.05, 7.3, 11.11, 15.0, 19.98 };
+    double peak_positions_2[5] = { 5.2, 7.6, 10.9, 16.33, 19.5 };
+    for ( size_t i( 0 ); i != powder_pattern_1.size(); ++i )
+    {
+        double intensity_1( 1.0 );
+        double intensity_2( 3.0 );
+        for ( size_t j( 0 ); j != 5; ++j )
+        {
+            intensity_1 += ( j + 1 ) * pseudo_Voigt( powder_pattern_1.two_theta( i ).value_in_degrees() - peak_positions_1[j], 0.1 );
+            intensity_2 += ( 5 - j ) * pseudo_Voigt( powder_pattern_2.two_theta( i ).value_in_degrees() - peak_positions_2[j], 0.15 );
+        }
+        powder_pattern_1.set_intensity( i, intensity_1 );
+        powder_pattern_2.set_intensity( i, intensity_2 );
+    }
+    // l = 0.0 gives m = 1, l = 40.0 is wider than the pattern.
+    double l_values[4] = { 0.0, 1.0, 3.0, 40.0 };
+    for ( size_t i( 0 ); i != 4; ++i )
+    {
+        Angle l = Angle::from_degrees( l_values[i] );
+        double reference_12 = reference_weighted_cross_correlation( powder_pattern_1, powder_pattern_2, l );
+        double reference_11 = reference_weighted_cross_correlation( powder_pattern_1, powder_pattern_1, l );
+        double reference_22 = reference_weighted_cross_correlation( powder_pattern_2, powder_pattern_2, l );
+        std::string l_string = double2string( l_values[i] );
+        test_suite.test_equality_double( weighted_cross_correlation( powder_pattern_1, powder_pattern_2, l ) / reference_12, 1.0, "weighted_cross_correlation() l = " + l_string, 1.0E-12 );
+        PreparedPowderPattern prepared_powder_pattern_1( powder_pattern_1, l );
+        PreparedPowderPattern prepared_powder_pattern_2( powder_pattern_2, l );
+        test_suite.test_equality_double( weighted_cross_correlation( prepared_powder_pattern_1, prepared_powder_pattern_2 ) / reference_12, 1.0, "weighted_cross_correlation( PreparedPowderPattern ) l = " + l_string, 1.0E-10 );
+        test_suite.test_equality_double( prepared_powder_pattern_1.self_term() / reference_11, 1.0, "PreparedPowderPattern::self_term() l = " + l_string, 1.0E-10 );
+        test_suite.test_equality_double( normalised_weighted_cross_correlation( prepared_powder_pattern_1, prepared_powder_pattern_2 ),
+                                         reference_12 / sqrt( reference_11 * reference_22 ), "normalised_weighted_cross_correlation( PreparedPowderPattern ) l = " + l_string, 1.0E-10 );
+    }
+    PreparedPowderPattern prepared_powder_pattern_1( powder_pattern_1, Angle::from_degrees( 1.0 ) );
+    PreparedPowderPattern prepared_powder_pattern_2( powder_pattern_2, Angle::from_degrees( 3.0 ) );
+    try
+    {
+        weighted_cross_correlation( prepared_powder_pattern_1, prepared_powder_pattern_2 );
+        test_suite.log_error( "weighted_cross_correlation( PreparedPowderPattern ) should have thrown." );
+    }
+    catch ( std::exception & e ) {}
+    }
 }
-
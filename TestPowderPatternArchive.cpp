@@ -0,0 +1,163 @@
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include "FileName.h"
+#include "PowderPattern.h"
+#include "PowderPatternArchive.h"
+#include "Utilities.h"
+#include "Wavelength.h"
+
+#include "TestSuite.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+void test_PowderPatternArchive( TestSuite & test_suite )
+{
+    std::cout << "Now running tests for PowderPatternArchive." << std::endl;
+    const FileName file_name( test_suite.temporary_file_name( "TestPowderPatternArchive.ppa" ) );
+    // A uniform pattern, a non-uniform pattern that needs an explicit 2theta column (odd number of points, so the FLOAT columns need padding),
+    // a synchrotron pattern and an empty pattern.
+    std::vector< PowderPattern > powder_patterns;
+    {
+    PowderPattern powder_pattern( Angle::from_degrees( 5.0 ), Angle::from_degrees( 6.0 ), Angle::from_degrees( 0.02 ) );
+    for ( size_t i( 0 ); i != powder_pattern.size(); ++i )
+    {
+        powder_pattern.set_intensity( i, 100.0 + 10.0 * i + 0.125 );
+        powder_pattern.set_estimated_standard_deviation( i, 1.5 + i );
+    }
+    powder_patterns.push_back( powder_pattern );
+    }
+    {
+    PowderPattern powder_pattern;
+    const double two_theta_values[] = { 3.0, 3.01, 3.03, 3.06, 3.1 };
+    for ( size_t i( 0 ); i != 5; ++i )
+        powder_pattern.push_back( Angle::from_degrees( two_theta_values[i] ), 1000.0 - 3.0 * i, 30.25 );
+    powder_pattern.set_wavelength( Wavelength( Wavelength::Mo, false, false ) );
+    powder_patterns.push_back( powder_pattern );
+    }
+    {
+    PowderPattern powder_pattern( Angle::from_degrees( 2.0 ), Angle::from_degrees( 2.5 ), Angle::from_degrees( 0.1 ) );
+    powder_pattern.set_wavelength( Wavelength::synchrotron_radiation( 0.79 ) );
+    powder_patterns.push_back( powder_pattern );
+    }
+    powder_patterns.push_back( PowderPattern() );
+    for ( size_t p( 0 ); p != 2; ++p )
+    {
+    const PowderPatternArchive::Precision precision = ( p == 0 ) ? PowderPatternArchive::DOUBLE : PowderPatternArchive::FLOAT;
+    const std::string prefix = std::string( "PowderPatternArchive " ) + ( ( p == 0 ) ? "DOUBLE" : "FLOAT" ) + " ";
+    {
+    PowderPatternArchiveWriter powder_pattern_archive_writer( file_name, precision );
+    for ( size_t i( 0 ); i != powder_patterns.size(); ++i )
+        test_suite.test_equality( powder_pattern_archive_writer.add( powder_patterns[i] ), i, prefix + "add() " + size_t2string( i ) );
+    // Not closed explicitly, the destructor writes the index.
+    }
+    PowderPatternArchive powder_pattern_archive( file_name );
+    test_suite.test_equality( powder_pattern_archive.size(), powder_patterns.size(), prefix + "size()" );
+    test_suite.test_equality( static_cast< int >( powder_pattern_archive.precision() ), static_cast< int >( precision ), prefix + "precision()" );
+    // Both 0.125 steps and small integers are exact in float, so the values must be identical in both precisions.
+    for ( size_t i( 0 ); i != powder_patterns.size(); ++i )
+    {
+        test_suite.test_equality( powder_pattern_archive.npoints( i ), powder_patterns[i].size(), prefix + "npoints() " + size_t2string( i ) );
+        PowderPattern powder_pattern = powder_pattern_archive.powder_pattern( i );
+        test_suite.test_equality( powder_pattern.size(), powder_patterns[i].size(), prefix + "size " + size_t2string( i ) );
+        if ( powder_pattern.size() != powder_patterns[i].size() )
+            continue;
+        size_t nerrors( 0 );
+        for ( size_t j( 0 ); j != powder_pattern.size(); ++j )
+        {
+            if ( ! nearly_equal( powder_pattern.two_theta( j ), powder_patterns[i].two_theta( j ) ) )
+                ++nerrors;
+            if ( powder_pattern.intensity( j ) != powder_patterns[i].intensity( j ) )
+                ++nerrors;
+            if ( powder_pattern.estimated_standard_deviation( j ) != powder_patterns[i].estimated_standard_deviation( j ) )
+                ++nerrors;
+        }
+        test_suite.test_equality( nerrors, 0, prefix + "values " + size_t2string( i ) );
+        test_suite.test_equality( static_cast< int >( powder_pattern.wavelength().radiation_source() ), static_cast< int >( powder_patterns[i].wavelength().radiation_source() ), prefix + "radiation source " + size_t2string( i ) );
+        test_suite.test_equality( powder_pattern.wavelength().is_monochromated(), powder_patterns[i].wavelength().is_monochromated(), prefix + "is_monochromated() " + size_t2string( i ) );
+    }
+    test_suite.test_equality_double( powder_pattern_archive.powder_pattern( 2 ).wavelength().wavelength(), 0.79, prefix + "synchrotron wavelength" );
+    // The non-uniform 2theta values must come back exactly, the uniform ones are recalculated from start and step.
+    test_suite.test_equality( powder_pattern_archive.powder_pattern( 1 ).two_theta( 3 ).value_in_degrees(), powder_patterns[1].two_theta( 3 ).value_in_degrees(), prefix + "explicit 2theta" );
+    try
+    {
+        powder_pattern_archive.powder_pattern( powder_patterns.size() );
+        test_suite.log_error( prefix + "index out of bounds" );
+    }
+    catch ( std::exception & e ) {}
+    }
+    // The FLOAT file is smaller: 32 bytes header + 4 * 64 bytes pattern headers + 4 * 8 bytes index,
+    // 51 * 8 bytes for the uniform pattern, 5 * 8 + 5 * 8 bytes for the non-uniform pattern (padded) and 6 * 8 bytes for the synchrotron pattern.
+    {
+    std::ifstream input_file( file_name.full_name().c_str(), std::ios::in | std::ios::binary );
+    std::vector< char > contents( ( std::istreambuf_iterator< char >( input_file ) ), std::istreambuf_iterator< char >() );
+    test_suite.test_equality( contents.size(), 32 + 4 * 64 + 4 * 8 + 51 * 8 + 5 * 8 + 5 * 8 + 6 * 8, "PowderPatternArchive file size" );
+    input_file.close();
+    // A truncated file, the index is incomplete.
+    {
+    std::ofstream output_file( file_name.full_name().c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+    output_file.write( &contents[0], contents.size() - 4 );
+    }
+    try
+    {
+        PowderPatternArchive powder_pattern_archive( file_name );
+        test_suite.log_error( "PowderPatternArchive truncated file" );
+    }
+    catch ( std::exception & e ) {}
+    // A bad magic number.
+    contents[0] = 'X';
+    {
+    std::ofstream output_file( file_name.full_name().c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+    output_file.write( &contents[0], contents.size() );
+    }
+    try
+    {
+        PowderPatternArchive powder_pattern_archive( file_name );
+        test_suite.log_error( "PowderPatternArchive bad magic number" );
+    }
+    catch ( std::exception & e ) {}
+    }
+    // PowderPattern::save_binary() and PowderPattern::read(), which chooses the reader from the extension.
+    {
+    powder_patterns[1].save_binary( file_name );
+    PowderPattern powder_pattern;
+    powder_pattern.read( file_name );
+    test_suite.test_equality( powder_pattern.size(), powder_patterns[1].size(), "PowderPattern::read() .ppa 01" );
+    test_suite.test_equality( powder_pattern.intensity( 4 ), powder_patterns[1].intensity( 4 ), "PowderPattern::read() .ppa 02" );
+    PowderPattern powder_pattern_2;
+    powder_pattern_2.read_binary( file_name, 0 );
+    test_suite.test_equality( powder_pattern_2.estimated_standard_deviation( 2 ), 30.25, "PowderPattern::read_binary()" );
+    }
+    std::remove( file_name.full_name().c_str() );
+}
+
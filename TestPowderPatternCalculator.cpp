@@ -0,0 +1,272 @@
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include "PowderPatternCalculator.h"
+#include "CrystallographicCalculations.h"
+#include "CrystalStructure.h"
+#include "PointGroup.h"
+#include "PowderPattern.h"
+#include "PowderPatternCalculatorCache.h"
+#include "ReflectionList.h"
+#include "Utilities.h"
+
+#include "TestSuite.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <set>
+
+namespace
+{
+
+// The original brute-force algorithm of PowderPatternCalculator::calculate_reflection_list( false ):
+// all (hkl) in a box, one std::set of equivalent reflections per (hkl).
+ReflectionList reference_reflection_list( const CrystalStructure & crystal_structure, const int hkl_max, const Angle two_theta_end, const Wavelength & wavelength )
+{
+    PointGroup Laue_class = crystal_structure.space_group().Laue_class();
+    std::vector< MillerIndices > miller_indices;
+    std::vector< double > d_spacings;
+    std::vector< size_t > multiplicities;
+    for ( int h( -hkl_max ); h <= hkl_max; ++h )
+    {
+        for ( int k( -hkl_max ); k <= hkl_max; ++k )
+        {
+            for ( int l( -hkl_max ); l <= hkl_max; ++l )
+            {
+                MillerIndices current_reflection( h, k, l );
+                if ( current_reflection.is_000() )
+                    continue;
+                bool is_systematic_absence( false );
+                for ( size_t i( 1 ); i != crystal_structure.space_group().nsymmetry_operators(); ++i )
+                {
+                    if ( current_reflection * crystal_structure.space_group().symmetry_operator( i ).rotation() == current_reflection )
+                    {
+                        if ( ! nearly_integer( current_reflection * crystal_structure.space_group().symmetry_operator( i ).translation(), 0.05 ) )
+                            is_systematic_absence = true;
+                    }
+                }
+                if ( is_systematic_absence )
+                    continue;
+                std::set< MillerIndices > equivalent_reflections;
+                for ( size_t i( 0 ); i != Laue_class.nsymmetry_operators(); ++i )
+                    equivalent_reflections.insert( current_reflection * Laue_class.symmetry_operator( i ) );
+                if ( ! ( current_reflection == *equivalent_reflections.begin() ) )
+                    continue;
+                double d = 1.0 / reciprocal_lattice_point( current_reflection, crystal_structure.crystal_lattice() ).length();
+                if ( wavelength.wavelength_1() > 2.0 * d )
+                    continue;
+                Angle two_theta = 2.0 * arcsine( wavelength.wavelength_1() / ( 2.0 * d ) );
+                if ( two_theta < ( two_theta_end + Angle::from_degrees( 0.1 ) ) )
+                {
+                    miller_indices.push_back( current_reflection );
+                    d_spacings.push_back( d );
+                    multiplicities.push_back( equivalent_reflections.size() );
+                }
+            }
+        }
+    }
+    return ReflectionList( miller_indices, std::vector< double >( miller_indices.size(), 1.0 ), d_spacings, multiplicities );
+}
+
+// ********************************************************************************
+
+// The symmetry operators are given as one string separated by semicolons.
+SpaceGroup space_group_from_representatives( const std::string & representative_symmetry_operators, const std::string & centring )
+{
+    std::vector< SymmetryOperator > symmetry_operators;
+    std::string remainder = representative_symmetry_operators;
+    size_t iPos;
+    do
+    {
+        iPos = remainder.find( ';' );
+        symmetry_operators.push_back( SymmetryOperator( remainder.substr( 0, iPos ) ) );
+        if ( iPos != std::string::npos )
+            remainder = remainder.substr( iPos + 1 );
+    }
+    while ( iPos != std::string::npos );
+    return SpaceGroup( symmetry_operators, true, Vector3D(), Centring( centring ) );
+}
+
+} // namespace
+
+void test_PowderPatternCalculator( TestSuite & test_suite )
+{
+    std::cout << "Now running tests for PowderPatternCalculator." << std::endl;
+    {
+    // Reflection list against the brute-force algorithm, for all crystal systems, with centring, screw axes and glide planes.
+    std::vector< CrystalLattice > crystal_lattices;
+    std::vector< SpaceGroup > space_groups;
+    std::vector< size_t > nsymmetry_operators;
+    SpaceGroup space_group;
+    crystal_lattices.push_back( CrystalLattice( 5.3, 6.1, 7.7, Angle::from_degrees( 81.0 ), Angle::from_degrees( 97.0 ), Angle::from_degrees( 103.0 ) ) );
+    space_groups.push_back( space_group );
+    nsymmetry_operators.push_back( 1 );
+    space_group.add_inversion_at_origin();
+    crystal_lattices.push_back( crystal_lattices.back() );
+    space_groups.push_back( space_group );
+    nsymmetry_operators.push_back( 2 );
+    crystal_lattices.push_back( CrystalLattice( 7.3, 6.1, 9.7, Angle::angle_90_degrees(), Angle::from_degrees( 101.0 ), Angle::angle_90_degrees() ) );
+    space_groups.push_back( SpaceGroup::P21c() );
+    nsymmetry_operators.push_back( 4 );
+    crystal_lattices.push_back( CrystalLattice( 12.3, 6.1, 9.7, Angle::angle_90_degrees(), Angle::from_degrees( 104.0 ), Angle::angle_90_degrees() ) );
+    space_groups.push_back( SpaceGroup::C2c() );
+    nsymmetry_operators.push_back( 8 );
+    crystal_lattices.push_back( CrystalLattice( 7.3, 8.9, 11.7, Angle::angle_90_degrees(), Angle::angle_90_degrees(), Angle::angle_90_degrees() ) );
+    space_groups.push_back( space_group_from_representatives( "x,y,z;-x+1/2,-y,z+1/2;-x,y+1/2,-z+1/2;x+1/2,-y+1/2,-z", "P" ) ); // Pbca
+    nsymmetry_operators.push_back( 8 );
+    crystal_lattices.push_back( CrystalLattice( 9.1, 9.1, 6.3, Angle::angle_90_degrees(), Angle::angle_90_degrees(), Angle::angle_90_degrees() ) );
+    space_groups.push_back( space_group_from_representatives( "x,y,z;-x+1/2,-y+1/2,z;-y+1/2,x,z+1/2;y,-x+1/2,z+1/2", "P" ) ); // P42/n
+    nsymmetry_operators.push_back( 8 );
+    crystal_lattices.push_back( CrystalLattice( 9.1, 9.1, 6.3, Angle::angle_90_degrees(), Angle::angle_90_degrees(), Angle::from_degrees( 120.0 ) ) );
+    space_groups.push_back( space_group_from_representatives( "x,y,z;-y,x-y,z;-x+y,-x,z;-x,-y,z+1/2;y,-x+y,z+1/2;x-y,x,z+1/2", "P" ) ); // P63/m
+    nsymmetry_operators.push_back( 12 );
+    crystal_lattices.push_back( CrystalLattice( 9.1, 9.1, 16.3, Angle::angle_90_degrees(), Angle::angle_90_degrees(), Angle::from_degrees( 120.0 ) ) );
+    space_groups.push_back( space_group_from_representatives( "x,y,z;-y,x-y,z;-x+y,-x,z", "R" ) ); // R-3
+    nsymmetry_operators.push_back( 18 );
+    crystal_lattices.push_back( CrystalLattice( 8.7, 8.7, 8.7, Angle::angle_90_degrees(), Angle::angle_90_degrees(), Angle::angle_90_degrees() ) );
+    space_groups.push_back( space_group_from_representatives( "x,y,z;-x+1/2,-y,z+1/2;-x,y+1/2,-z+1/2;x+1/2,-y+1/2,-z;"
+                                                                   "z,x,y;z+1/2,-x+1/2,-y;-z+1/2,-x,y+1/2;-z,x+1/2,-y+1/2;"
+                                                                   "y,z,x;-y,z+1/2,-x+1/2;y+1/2,-z+1/2,-x;-y+1/2,-z,x+1/2", "I" ) ); // Ia-3
+    nsymmetry_operators.push_back( 48 );
+    for ( size_t i( 0 ); i != space_groups.size(); ++i )
+    {
+        test_suite.test_equality( space_groups[i].nsymmetry_operators(), nsymmetry_operators[i], "PowderPatternCalculator::calculate_reflection_list() nsymmetry_operators " + size_t2string( i ) );
+        CrystalStructure crystal_structure;
+        crystal_structure.set_crystal_lattice( crystal_lattices[i] );
+        crystal_structure.set_space_group( space_groups[i] );
+        PowderPatternCalculator powder_pattern_calculator( crystal_structure );
+        powder_pattern_calculator.set_two_theta_end( Angle::from_degrees( 35.0 ) );
+        powder_pattern_calculator.calculate_reflection_list();
+        ReflectionList reflection_list = powder_pattern_calculator.reflection_list();
+        ReflectionList reference = reference_reflection_list( crystal_structure, 12, powder_pattern_calculator.two_theta_end(), powder_pattern_calculator.wavelength() );
+        test_suite.test_equality( reflection_list.size(), reference.size(), "PowderPatternCalculator::calculate_reflection_list() nreflections " + size_t2string( i ) );
+        size_t ndifferences( 0 );
+        for ( size_t j( 0 ); ( j != reflection_list.size() ) && ( j != reference.size() ); ++j )
+        {
+            if ( ( reflection_list.miller_indices( j ) != reference.miller_indices( j ) ) ||
+                 ( reflection_list.multiplicity( j ) != reference.multiplicity( j ) ) ||
+                 ( reflection_list.d_spacing( j ) != reference.d_spacing( j ) ) )
+                ++ndifferences;
+        }
+        test_suite.test_equality( ndifferences, 0, "PowderPatternCalculator::calculate_reflection_list() " + size_t2string( i ) );
+    }
+    }
+    {
+    // Multithreading: F^2 must be identical, the powder patterns nearly identical and reproducible for a given number of threads.
+    CrystalStructure crystal_structure;
+    crystal_structure.set_crystal_lattice( CrystalLattice( 12.3, 6.1, 9.7, Angle::angle_90_degrees(), Angle::from_degrees( 104.0 ), Angle::angle_90_degrees() ) );
+    crystal_structure.set_space_group( SpaceGroup::C2c() );
+    crystal_structure.add_atom( Atom( Element( "C" ), Vector3D( 0.11, 0.23, 0.07 ), "C1" ) );
+    crystal_structure.add_atom( Atom( Element( "S" ), Vector3D( 0.31, 0.67, 0.41 ), "S1" ) );
+    crystal_structure.add_atom( Atom( Element( "O" ), Vector3D( 0.15, 0.55, 0.35 ), "O1" ) );
+    PowderPatternCalculator powder_pattern_calculator( crystal_structure );
+    powder_pattern_calculator.set_two_theta_end( Angle::from_degrees( 40.0 ) );
+    powder_pattern_calculator.set_finger_cox_jephcoat( FingerCoxJephcoat( 0.01, 0.01 ) );
+    PowderPattern powder_pattern_1;
+    powder_pattern_calculator.calculate( powder_pattern_1 );
+    ReflectionList reflection_list_1 = powder_pattern_calculator.reflection_list();
+    powder_pattern_calculator.set_nthreads( 3 );
+    PowderPattern powder_pattern_2;
+    powder_pattern_calculator.calculate( powder_pattern_2 );
+    ReflectionList reflection_list_2 = powder_pattern_calculator.reflection_list();
+    PowderPattern powder_pattern_3;
+    powder_pattern_calculator.calculate( powder_pattern_3 );
+    test_suite.test_equality( reflection_list_2.size(), reflection_list_1.size(), "PowderPatternCalculator multithreaded nreflections" );
+    size_t ndifferences( 0 );
+    for ( size_t i( 0 ); i != reflection_list_1.size(); ++i )
+    {
+        if ( reflection_list_1.F_squared( i ) != reflection_list_2.F_squared( i ) )
+            ++ndifferences;
+    }
+    test_suite.test_equality( ndifferences, 0, "PowderPatternCalculator multithreaded F^2" );
+    test_suite.test_equality( powder_pattern_2.size(), powder_pattern_1.size(), "PowderPatternCalculator multithreaded npoints" );
+    double largest_difference( 0.0 );
+    ndifferences = 0;
+    for ( size_t i( 0 ); i != powder_pattern_1.size(); ++i )
+    {
+        largest_difference = std::max( largest_difference, std::abs( powder_pattern_2.intensity( i ) - powder_pattern_1.intensity( i ) ) );
+        if ( powder_pattern_3.intensity( i ) != powder_pattern_2.intensity( i ) )
+            ++ndifferences;
+    }
+    test_suite.test_equality_double( largest_difference, 0.0, "PowderPatternCalculator multithreaded intensities", 1.0E-8 );
+    test_suite.test_equality( ndifferences, 0, "PowderPatternCalculator multithreaded reproducible" );
+    }
+    {
+    // Cache: a second crystal structure with the same space group and the same unit cell to within the tolerance
+    // reuses the reflection list and the peak shape and gives the same powder pattern as without the cache.
+    CrystalStructure crystal_structure_1;
+    crystal_structure_1.set_crystal_lattice( CrystalLattice( 12.3, 6.1, 9.7, Angle::angle_90_degrees(), Angle::from_degrees( 104.0 ), Angle::angle_90_degrees() ) );
+    crystal_structure_1.set_space_group( SpaceGroup::C2c() );
+    crystal_structure_1.add_atom( Atom( Element( "C" ), Vector3D( 0.11, 0.23, 0.07 ), "C1" ) );
+    crystal_structure_1.add_atom( Atom( Element( "S" ), Vector3D( 0.31, 0.67, 0.41 ), "S1" ) );
+    CrystalStructure crystal_structure_2( crystal_structure_1 );
+    crystal_structure_2.set_crystal_lattice( CrystalLattice( 12.3005, 6.1, 9.7, Angle::angle_90_degrees(), Angle::from_degrees( 104.0 ), Angle::angle_90_degrees() ) );
+    crystal_structure_2.add_atom( Atom( Element( "O" ), Vector3D( 0.15, 0.55, 0.35 ), "O1" ) );
+    PowderPatternCalculatorCache cache;
+    PowderPattern powder_pattern_1;
+    {
+    PowderPatternCalculator powder_pattern_calculator( crystal_structure_1 );
+    powder_pattern_calculator.set_cache( cache );
+    powder_pattern_calculator.calculate( powder_pattern_1 );
+    }
+    test_suite.test_equality( cache.nhits(), 0, "PowderPatternCalculatorCache::nhits() 1" );
+    test_suite.test_equality( cache.nmisses(), 2, "PowderPatternCalculatorCache::nmisses() 1" );
+    PowderPatternCalculator powder_pattern_calculator_cached( crystal_structure_2 );
+    powder_pattern_calculator_cached.set_cache( cache );
+    PowderPattern powder_pattern_cached;
+    powder_pattern_calculator_cached.calculate( powder_pattern_cached );
+    test_suite.test_equality( cache.nhits(), 2, "PowderPatternCalculatorCache::nhits() 2" );
+    test_suite.test_equality( cache.nreflection_lists(), 1, "PowderPatternCalculatorCache::nreflection_lists()" );
+    PowderPatternCalculator powder_pattern_calculator( crystal_structure_2 );
+    PowderPattern powder_pattern;
+    powder_pattern_calculator.calculate( powder_pattern );
+    ReflectionList reflection_list = powder_pattern_calculator.reflection_list();
+    ReflectionList reflection_list_cached = powder_pattern_calculator_cached.reflection_list();
+    test_suite.test_equality( reflection_list_cached.size(), reflection_list.size(), "PowderPatternCalculatorCache nreflections" );
+    size_t ndifferences( 0 );
+    for ( size_t i( 0 ); ( i != reflection_list.size() ) && ( i != reflection_list_cached.size() ); ++i )
+    {
+        if ( ( reflection_list_cached.miller_indices( i ) != reflection_list.miller_indices( i ) ) ||
+             ( reflection_list_cached.d_spacing( i ) != reflection_list.d_spacing( i ) ) ||
+             ( reflection_list_cached.F_squared( i ) != reflection_list.F_squared( i ) ) )
+            ++ndifferences;
+    }
+    for ( size_t i( 0 ); i != powder_pattern.size(); ++i )
+    {
+        if ( powder_pattern_cached.intensity( i ) != powder_pattern.intensity( i ) )
+            ++ndifferences;
+    }
+    test_suite.test_equality( ndifferences, 0, "PowderPatternCalculatorCache reflection list and powder pattern" );
+    // A different space group must not be found.
+    crystal_structure_2.set_space_group( SpaceGroup::P21c() );
+    PowderPatternCalculator powder_pattern_calculator_2( crystal_structure_2 );
+    powder_pattern_calculator_2.set_cache( cache );
+    powder_pattern_calculator_2.calculate_reflection_list();
+    test_suite.test_equality( cache.nreflection_lists(), 2, "PowderPatternCalculatorCache different space group" );
+    }
+}
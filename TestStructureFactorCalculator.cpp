@@ -0,0 +1,162 @@
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include "StructureFactorCalculator.h"
+#include "3DCalculations.h"
+#include "CrystallographicCalculations.h"
+#include "CrystalStructure.h"
+#include "ReflectionList.h"
+
+#include "TestSuite.h"
+
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+
+// The original atom-by-atom loop of PowderPatternCalculator::calculate_structure_factors(),
+// but with h U* h evaluated in floating point.
+double reference_F_squared( const CrystalStructure & crystal_structure, const MillerIndices & miller_indices, const double sine_theta_over_lambda )
+{
+    double cosine_term( 0.0 );
+    double sine_term( 0.0 );
+    for ( size_t j( 0 ); j != crystal_structure.natoms(); ++j )
+    {
+        Atom atom = crystal_structure.atom( j );
+        double f0 = atom.element().scattering_factor( sine_theta_over_lambda ) * atom.occupancy();
+        double T( 1.0 );
+        if ( atom.ADPs_type() == Atom::ANISOTROPIC )
+        {
+            Vector3D H( miller_indices.h(), miller_indices.k(), miller_indices.l() );
+            T = exp( -2.0 * square( CONSTANT_PI ) * ( H * ( atom.anisotropic_displacement_parameters().U_star( crystal_structure.crystal_lattice() ) * H ) ) );
+        }
+        else if ( atom.ADPs_type() == Atom::ISOTROPIC )
+            T = exp( -8.0 * square( CONSTANT_PI ) * atom.Uiso() * square( sine_theta_over_lambda ) );
+        else if ( atom.element().atomic_number() == 1 )
+            T = exp( -8.0 * square( CONSTANT_PI ) * 0.06 * square( sine_theta_over_lambda ) );
+        else
+            T = exp( -8.0 * square( CONSTANT_PI ) * 0.05 * square( sine_theta_over_lambda ) );
+        Angle argument = Angle::from_radians( 2.0 * CONSTANT_PI * ( miller_indices.h() * atom.position().x() + miller_indices.k() * atom.position().y() + miller_indices.l() * atom.position().z() ) );
+        double sine;
+        double cosine;
+        sincos( argument, sine, cosine );
+        sine_term += T * f0 * sine;
+        cosine_term += T * f0 * cosine;
+    }
+    return square( cosine_term ) + square( sine_term );
+}
+
+} // namespace
+
+void test_StructureFactorCalculator( TestSuite & test_suite )
+{
+    std::cout << "Now running tests for StructureFactorCalculator." << std::endl;
+    {
+    CrystalStructure crystal_structure;
+    crystal_structure.set_crystal_lattice( CrystalLattice( 7.1, 9.3, 11.7, Angle::angle_90_degrees(), Angle::from_degrees( 103.2 ), Angle::angle_90_degrees() ) );
+    crystal_structure.add_atom( Atom( Element( "C" ), Vector3D( 0.1, 0.2, 0.3 ), "C1" ) );
+    Atom atom( Element( "C" ), Vector3D( 0.7, 0.15, 0.91 ), "C2" );
+    atom.set_Uiso( 0.03 );
+    crystal_structure.add_atom( atom );
+    atom = Atom( Element( "C" ), Vector3D( -0.3, 1.45, 0.01 ), "C3" );
+    atom.set_Uiso( 0.03 );
+    atom.set_occupancy( 0.5 );
+    crystal_structure.add_atom( atom );
+    crystal_structure.add_atom( Atom( Element( "H" ), Vector3D( 0.12, 0.27, 0.33 ), "H1" ) );
+    atom = Atom( Element( "O" ), Vector3D( 0.45, 0.55, 0.65 ), "O1" );
+    atom.set_anisotropic_displacement_parameters( AnisotropicDisplacementParameters( SymmetricMatrix3D( 0.031, 0.022, 0.043, 0.004, -0.002, 0.007 ) ) );
+    crystal_structure.add_atom( atom );
+    atom = Atom( Element( "Cl" ), Vector3D( 0.95, 0.05, 0.5 ), "Cl1" );
+    atom.set_Uiso( 0.041 );
+    crystal_structure.add_atom( atom );
+    StructureFactorCalculator structure_factor_calculator( crystal_structure );
+    test_suite.test_equality( structure_factor_calculator.natoms(), 6, "StructureFactorCalculator::natoms()" );
+    test_suite.test_equality( structure_factor_calculator.nelements(), 4, "StructureFactorCalculator::nelements()" );
+    test_suite.test_equality( structure_factor_calculator.nscattering_types(), 5, "StructureFactorCalculator::nscattering_types()" );
+    std::vector< MillerIndices > miller_indices;
+    miller_indices.push_back( MillerIndices(  1,  0,  0 ) );
+    miller_indices.push_back( MillerIndices(  1, -2,  3 ) );
+    miller_indices.push_back( MillerIndices( -4,  5,  7 ) );
+    miller_indices.push_back( MillerIndices(  0,  0, 12 ) );
+    ReflectionList reflection_list;
+    for ( size_t i( 0 ); i != miller_indices.size(); ++i )
+        reflection_list.push_back( miller_indices[i], 1.0, 1.0 / reciprocal_lattice_point( miller_indices[i], crystal_structure.crystal_lattice() ).length(), 2 );
+    structure_factor_calculator.calculate_F_squared( reflection_list );
+    for ( size_t i( 0 ); i != reflection_list.size(); ++i )
+    {
+        double reference = reference_F_squared( crystal_structure, reflection_list.miller_indices( i ), 1.0 / ( 2.0 * reflection_list.d_spacing( i ) ) );
+        test_suite.test_equality_double( reflection_list.F_squared( i ), reference, "StructureFactorCalculator::calculate_F_squared() " + reflection_list.miller_indices( i ).to_string(), 1.0E-10 );
+    }
+    }
+    {
+    // Asymmetric unit with an atom on the inversion centre, space-group symmetry applied analytically.
+    CrystalStructure crystal_structure;
+    crystal_structure.set_crystal_lattice( CrystalLattice( 5.3, 6.1, 7.7, Angle::from_degrees( 81.0 ), Angle::from_degrees( 97.0 ), Angle::from_degrees( 103.0 ) ) );
+    SpaceGroup space_group;
+    space_group.add_inversion_at_origin();
+    crystal_structure.set_space_group( space_group );
+    crystal_structure.add_atom( Atom( Element( "Fe" ), Vector3D( 0.0, 0.0, 0.0 ), "Fe1" ) );
+    crystal_structure.add_atom( Atom( Element( "N" ), Vector3D( 0.21, 0.13, 0.05 ), "N1" ) );
+    Atom atom( Element( "O" ), Vector3D( 0.45, 0.55, 0.65 ), "O1" );
+    atom.set_anisotropic_displacement_parameters( AnisotropicDisplacementParameters( SymmetricMatrix3D( 0.031, 0.022, 0.043, 0.004, -0.002, 0.007 ) ) );
+    crystal_structure.add_atom( atom );
+    StructureFactorCalculator asymmetric_unit_calculator( crystal_structure, true );
+    crystal_structure.apply_space_group_symmetry();
+    test_suite.test_equality( crystal_structure.natoms(), 5, "StructureFactorCalculator asymmetric unit P-1 natoms" );
+    StructureFactorCalculator unit_cell_calculator( crystal_structure );
+    for ( int h( -3 ); h != 4; ++h )
+    {
+        MillerIndices miller_indices( h, 2 - h, 2 * h + 1 );
+        double sine_theta_over_lambda = reciprocal_lattice_point( miller_indices, crystal_structure.crystal_lattice() ).length() / 2.0;
+        test_suite.test_equality_Complex( asymmetric_unit_calculator.structure_factor( miller_indices, sine_theta_over_lambda ), unit_cell_calculator.structure_factor( miller_indices, sine_theta_over_lambda ), "StructureFactorCalculator asymmetric unit P-1 " + miller_indices.to_string(), 1.0E-8 );
+    }
+    }
+    {
+    // C2/c, general positions only: centring vectors, screw axes and glide planes.
+    // The phase shifts of the translations are exact in the asymmetric-unit route, the full phases use the fast sincos() approximation.
+    CrystalStructure crystal_structure;
+    crystal_structure.set_crystal_lattice( CrystalLattice( 12.3, 6.1, 9.7, Angle::angle_90_degrees(), Angle::from_degrees( 104.0 ), Angle::angle_90_degrees() ) );
+    crystal_structure.set_space_group( SpaceGroup::C2c() );
+    crystal_structure.add_atom( Atom( Element( "C" ), Vector3D( 0.11, 0.23, 0.07 ), "C1" ) );
+    crystal_structure.add_atom( Atom( Element( "S" ), Vector3D( 0.31, 0.67, 0.41 ), "S1" ) );
+    Atom atom( Element( "O" ), Vector3D( 0.15, 0.55, 0.35 ), "O1" );
+    atom.set_anisotropic_displacement_parameters( AnisotropicDisplacementParameters( SymmetricMatrix3D( 0.031, 0.022, 0.043, 0.004, -0.002, 0.007 ) ) );
+    crystal_structure.add_atom( atom );
+    StructureFactorCalculator asymmetric_unit_calculator( crystal_structure, true );
+    crystal_structure.apply_space_group_symmetry();
+    test_suite.test_equality( crystal_structure.natoms(), 24, "StructureFactorCalculator asymmetric unit C2/c natoms" );
+    StructureFactorCalculator unit_cell_calculator( crystal_structure );
+    double F000 = unit_cell_calculator.structure_factor( MillerIndices( 0, 0, 0 ), 0.0 ).real();
+    for ( int h( -3 ); h != 4; ++h )
+    {
+        MillerIndices miller_indices( 2 * h, 1 - h, h + 2 );
+        double sine_theta_over_lambda = reciprocal_lattice_point( miller_indices, crystal_structure.crystal_lattice() ).length() / 2.0;
+        test_suite.test_equality_Complex( asymmetric_unit_calculator.structure_factor( miller_indices, sine_theta_over_lambda ), unit_cell_calculator.structure_factor( miller_indices, sine_theta_over_lambda ), "StructureFactorCalculator asymmetric unit C2/c " + miller_indices.to_string(), 0.005 * F000 );
+    }
+    }
+}
@@ -27,6 +27,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "TestSuite.h"
 
+#include <cstdlib>
 #include <iostream>
 
 void TestSuite::report() const
@@ -35,3 +36,19 @@ void TestSuite::report() const
         std::cout << *it << std::endl;
 }
 
+// ********************************************************************************
+
+std::string TestSuite::temporary_file_name( const std::string & file_name ) const
+{
+    const char * variables[] = { "TMPDIR", "TEMP", "TMP" };
+    for ( size_t i( 0 ); i != 3; ++i )
+    {
+        const char * directory = std::getenv( variables[i] );
+        if ( ( directory != 0 ) && ( *directory != '\0' ) )
+            return std::string( directory ) + "/" + file_name;
+    }
+    return "/tmp/" + file_name;
+}
+
+// ********************************************************************************
+
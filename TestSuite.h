@@ -76,6 +76,10 @@ public:
 
     void report() const;
 
+    // For tests that must write a file: file_name in the directory for temporary files ($TMPDIR, %TEMP% or /tmp).
+    // The test must remove the file itself.
+    std::string temporary_file_name( const std::string & file_name ) const;
+
 private:
     std::vector< std::string > error_messages_;
 };
@@ -0,0 +1,154 @@
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include "FileName.h"
+#include "TextFileWriter.h"
+#include "Utilities.h"
+
+#include "TestSuite.h"
+
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+void test_TextFileWriter( TestSuite & test_suite )
+{
+    std::cout << "Now running tests for TextFileWriter." << std::endl;
+    const FileName file_name( test_suite.temporary_file_name( "TestTextFileWriter.txt" ) );
+    std::vector< double > values;
+    values.push_back( 0.0 );
+    values.push_back( -0.0 );
+    values.push_back( 1.0 );
+    values.push_back( -1.0 );
+    values.push_back( 0.1 );
+    values.push_back( 1.0 / 3.0 );
+    values.push_back( -2.0 / 3.0 );
+    values.push_back( 123456.5 );
+    values.push_back( 1234567.0 );
+    values.push_back( 0.000012345678 );
+    values.push_back( 0.5E-5 ); // Rounds to 0.00001 with 5 decimals.
+    values.push_back( 1.0E300 ); // More than 64 characters in fixed notation.
+    values.push_back( -1.0E-300 );
+    values.push_back( std::numeric_limits< double >::max() );
+    values.push_back( std::numeric_limits< double >::min() );
+    values.push_back( std::numeric_limits< double >::denorm_min() );
+    values.push_back( 2.5E-310 ); // Denormal.
+    values.push_back( std::numeric_limits< double >::infinity() );
+    values.push_back( -std::numeric_limits< double >::infinity() );
+    values.push_back( std::numeric_limits< double >::quiet_NaN() );
+    for ( size_t i( 0 ); i != 1000; ++i ) // Pseudo-random numbers over many orders of magnitude.
+        values.push_back( ( ( i % 2 ) ? -1.0 : 1.0 ) * std::pow( 10.0, ( static_cast< double >( ( i * 7919 ) % 1000 ) / 50.0 ) - 10.0 ) * ( 1.0 + ( ( i * 104729 ) % 997 ) / 997.0 ) );
+    const int int_values[] = { 0, 1, -1, 42, -123456789, INT_MAX, INT_MIN };
+    const size_t size_t_values[] = { 0, 1, 10, 1234567890, std::numeric_limits< size_t >::max() };
+    {
+    TextFileWriter text_file_writer( file_name );
+    for ( size_t i( 0 ); i != values.size(); ++i )
+    {
+        text_file_writer.write( values[i] );
+        text_file_writer.write_line();
+        text_file_writer.write( values[i], 5 );
+        text_file_writer.write_line();
+        // As in CrystalStructure::save_cif().
+        text_file_writer.write( ( values[i] >= 0.0 ) ? "  " : " " );
+        text_file_writer.write( values[i], 5 );
+        text_file_writer.write_line();
+        text_file_writer.write_round_trip( values[i] );
+        text_file_writer.write_line();
+    }
+    for ( size_t i( 0 ); i != 7; ++i )
+    {
+        text_file_writer.write( int_values[i] );
+        text_file_writer.write( '\n' );
+    }
+    for ( size_t i( 0 ); i != 5; ++i )
+    {
+        text_file_writer.write( size_t_values[i] );
+        text_file_writer.write( "\n" );
+    }
+    text_file_writer.close();
+    try
+    {
+        text_file_writer.write( 1 );
+        test_suite.log_error( "TextFileWriter write after close()" );
+    }
+    catch ( std::exception & e ) {}
+    }
+    std::vector< std::string > lines;
+    {
+    std::ifstream input_file( file_name.full_name().c_str() );
+    std::string line;
+    while ( std::getline( input_file, line ) )
+        lines.push_back( line );
+    }
+    std::remove( file_name.full_name().c_str() );
+    test_suite.test_equality( lines.size(), 4 * values.size() + 7 + 5, "TextFileWriter number of lines" );
+    if ( lines.size() != 4 * values.size() + 7 + 5 )
+        return;
+    size_t nerrors_1( 0 );
+    size_t nerrors_2( 0 );
+    size_t nerrors_3( 0 );
+    size_t nerrors_4( 0 );
+    for ( size_t i( 0 ); i != values.size(); ++i )
+    {
+        if ( lines[ 4 * i ] != double2string( values[i] ) )
+            ++nerrors_1;
+        if ( lines[ 4 * i + 1 ] != double2string( values[i], 5 ) )
+            ++nerrors_2;
+        if ( lines[ 4 * i + 2 ] != " " + double2string_pad_plus( values[i], 5 ) )
+            ++nerrors_3;
+        const std::string & round_trip = lines[ 4 * i + 3 ];
+        if ( std::isfinite( values[i] ) )
+        {
+            double value = string2double( round_trip.data(), round_trip.data() + round_trip.size() );
+            if ( ( value != values[i] ) || ( std::signbit( value ) != std::signbit( values[i] ) ) || ( round_trip.size() > 24 ) )
+                ++nerrors_4;
+        }
+        else
+        {
+            double value = std::strtod( round_trip.c_str(), 0 );
+            if ( std::isnan( values[i] ) ? ( ! std::isnan( value ) ) : ( value != values[i] ) )
+                ++nerrors_4;
+        }
+    }
+    test_suite.test_equality( nerrors_1, 0, "TextFileWriter::write( double )" );
+    test_suite.test_equality( nerrors_2, 0, "TextFileWriter::write( double, ndecimals )" );
+    test_suite.test_equality( nerrors_3, 0, "TextFileWriter::write( double, ndecimals ) with plus padding" );
+    test_suite.test_equality( nerrors_4, 0, "TextFileWriter::write_round_trip()" );
+    for ( size_t i( 0 ); i != 7; ++i )
+        test_suite.test_equality( lines[ 4 * values.size() + i ], int2string( int_values[i] ), "TextFileWriter::write( int ) " + size_t2string( i ) );
+    for ( size_t i( 0 ); i != 5; ++i )
+        test_suite.test_equality( lines[ 4 * values.size() + 7 + i ], size_t2string( size_t_values[i] ), "TextFileWriter::write( size_t ) " + size_t2string( i ) );
+    // The shortest representation is used.
+    test_suite.test_equality( lines[ 4 * 4 + 3 ], std::string( "0.1" ), "TextFileWriter::write_round_trip() 0.1" );
+}
+
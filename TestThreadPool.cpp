@@ -0,0 +1,90 @@
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include "ThreadPool.h"
+#include "Utilities.h"
+
+#include "TestSuite.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+void test_ThreadPool( TestSuite & test_suite )
+{
+    std::cout << "Now running tests for ThreadPool." << std::endl;
+    {
+    ThreadPool thread_pool( 4 );
+    test_suite.test_equality( thread_pool.nthreads(), 4, "ThreadPool::nthreads()" );
+    // The same pool is used several times, with more tasks than threads, fewer tasks than threads and no tasks.
+    size_t ntasks_values[4] = { 1000, 3, 1, 0 };
+    for ( size_t i( 0 ); i != 4; ++i )
+    {
+        std::vector< size_t > values( ntasks_values[i], 0 );
+        thread_pool.run( ntasks_values[i], [&]( const size_t iTask ) { values[iTask] = iTask * iTask + 1; } );
+        size_t nerrors( 0 );
+        for ( size_t j( 0 ); j != values.size(); ++j )
+        {
+            if ( values[j] != j * j + 1 )
+                ++nerrors;
+        }
+        test_suite.test_equality( nerrors, 0, "ThreadPool::run() " + size_t2string( ntasks_values[i] ) + " tasks" );
+    }
+    }
+    {
+    ThreadPool thread_pool( 1 );
+    test_suite.test_equality( thread_pool.nthreads(), 1, "ThreadPool::nthreads() 1" );
+    // With one thread, the tasks are run in order.
+    std::vector< size_t > order;
+    thread_pool.run( 10, [&]( const size_t iTask ) { order.push_back( iTask ); } );
+    bool in_order( order.size() == 10 );
+    for ( size_t i( 0 ); in_order && ( i != order.size() ); ++i )
+        in_order = ( order[i] == i );
+    test_suite.test_equality( in_order, true, "ThreadPool::run() 1 thread" );
+    }
+    {
+    // The exception of a task is passed on, the pool can be used afterwards.
+    ThreadPool thread_pool( 3 );
+    bool exception_thrown( false );
+    try
+    {
+        thread_pool.run( 100, [&]( const size_t iTask ) { if ( iTask == 57 ) throw std::runtime_error( "57" ); } );
+    }
+    catch ( std::exception & e )
+    {
+        exception_thrown = ( std::string( e.what() ) == "57" );
+    }
+    test_suite.test_equality( exception_thrown, true, "ThreadPool::run() exception" );
+    std::vector< size_t > values( 100, 0 );
+    thread_pool.run( 100, [&]( const size_t iTask ) { values[iTask] = 1; } );
+    size_t sum( 0 );
+    for ( size_t i( 0 ); i != values.size(); ++i )
+        sum += values[i];
+    test_suite.test_equality( sum, 100, "ThreadPool::run() after exception" );
+    }
+}
+
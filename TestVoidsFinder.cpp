@@ -26,6 +26,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ********************************************* */
 
 #include "VoidsFinder.h"
+#include "CrystalStructure.h"
 
 #include "TestSuite.h"
 
@@ -33,12 +34,79 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 void test_VoidsFinder( TestSuite & test_suite )
 {
-   // std::cout << "Now running tests for VoidsFinder." << std::endl;
-
+    std::cout << "Now running tests for VoidsFinder." << std::endl;
     {
-   // VoidsFinder dummy();
-   // test_suite.test_equality( dummy, , "VoidsFinder()" );
+    // A single carbon atom in a large cubic unit cell: the void is everything outside the Van der Waals sphere, for any probe radius,
+    // and it is connected in all three directions.
+    CrystalStructure crystal_structure;
+    crystal_structure.set_crystal_lattice( CrystalLattice( 10.0, 10.0, 10.0, Angle::angle_90_degrees(), Angle::angle_90_degrees(), Angle::angle_90_degrees() ) );
+    crystal_structure.add_atom( Atom( Element( "C" ), Vector3D( 0.0, 0.0, 0.0 ), "C1" ) );
+    double expected_volume = 1000.0 - ( 4.0 / 3.0 ) * CONSTANT_PI * 1.7 * 1.7 * 1.7;
+    VoidsReport voids_report = find_voids_on_grid( crystal_structure, 0.0 );
+    test_suite.test_equality_double( voids_report.total_void_volume_, expected_volume, "find_voids_on_grid() 1", 2.0 );
+    test_suite.test_equality( voids_report.void_volumes_.size(), 1, "find_voids_on_grid() 1 number of voids" );
+    test_suite.test_equality( voids_report.void_dimensionalities_[0], 3, "find_voids_on_grid() 1 dimensionality" );
+    test_suite.test_equality_double( find_voids( crystal_structure, 1.2 ), expected_volume, "find_voids()", 2.0 );
+    VolumeEstimate volume_estimate_1 = integrate_void_volume( crystal_structure, 1.0E-4, 0, 1 );
+    VolumeEstimate volume_estimate_2 = integrate_void_volume( crystal_structure, 1.0E-4, 0, 3 );
+    test_suite.test_equality_double( volume_estimate_1.volume_, expected_volume, "integrate_void_volume()", 5.0 * volume_estimate_1.standard_error_ );
+    test_suite.test_equality( volume_estimate_1.standard_error_ < 0.1, true, "integrate_void_volume() tolerance" );
+    test_suite.test_equality( volume_estimate_1.volume_ == volume_estimate_2.volume_, true, "integrate_void_volume() thread count" );
+    }
+    {
+    // Xenon atoms on a simple cubic lattice that overlap along the edges and the faces of the unit cell, leaving an isolated pocket around the centre.
+    CrystalStructure crystal_structure;
+    crystal_structure.set_crystal_lattice( CrystalLattice( 2.8, 2.8, 2.8, Angle::angle_90_degrees(), Angle::angle_90_degrees(), Angle::angle_90_degrees() ) );
+    crystal_structure.add_atom( Atom( Element( "Xe" ), Vector3D( 0.0, 0.0, 0.0 ), "Xe1" ) );
+    VoidsReport voids_report = find_voids_on_grid( crystal_structure, 0.0, 0.05 );
+    test_suite.test_equality( voids_report.void_volumes_.size(), 1, "find_voids_on_grid() 2 number of voids" );
+    test_suite.test_equality( voids_report.void_dimensionalities_[0], 0, "find_voids_on_grid() 2 dimensionality" );
+    }
+    {
+    // Rods of carbon atoms along c, square channels between them.
+    CrystalStructure crystal_structure;
+    crystal_structure.set_crystal_lattice( CrystalLattice( 2.8, 2.8, 1.0, Angle::angle_90_degrees(), Angle::angle_90_degrees(), Angle::angle_90_degrees() ) );
+    crystal_structure.add_atom( Atom( Element( "C" ), Vector3D( 0.0, 0.0, 0.0 ), "C1" ) );
+    VoidsReport voids_report = find_voids_on_grid( crystal_structure, 0.0, 0.05 );
+    test_suite.test_equality( voids_report.void_volumes_.size(), 1, "find_voids_on_grid() 3 number of voids" );
+    test_suite.test_equality( voids_report.void_dimensionalities_[0], 1, "find_voids_on_grid() 3 dimensionality" );
+    }
+    {
+    // Layers of carbon atoms in the ab plane, the holes in the layers are too small for the probe.
+    // The result must not depend on the number of threads.
+    CrystalStructure crystal_structure;
+    crystal_structure.set_crystal_lattice( CrystalLattice( 3.0, 3.0, 10.0, Angle::angle_90_degrees(), Angle::angle_90_degrees(), Angle::angle_90_degrees() ) );
+    crystal_structure.add_atom( Atom( Element( "C" ), Vector3D( 0.0, 0.0, 0.0 ), "C1" ) );
+    VoidsReport voids_report_1 = find_voids_on_grid( crystal_structure, 1.2, 0.15, 1 );
+    VoidsReport voids_report_2 = find_voids_on_grid( crystal_structure, 1.2, 0.15, 3 );
+    test_suite.test_equality( voids_report_1.void_volumes_.size(), 1, "find_voids_on_grid() 4 number of voids" );
+    test_suite.test_equality( voids_report_1.void_dimensionalities_[0], 2, "find_voids_on_grid() 4 dimensionality" );
+    test_suite.test_equality( voids_report_1.total_void_volume_ == voids_report_2.total_void_volume_, true, "find_voids_on_grid() thread count" );
+    try
+    {
+        find_voids_on_grid( crystal_structure, 1.2, 0.0 );
+        test_suite.log_error( "find_voids_on_grid() should have thrown." );
+    }
+    catch ( std::exception & e ) {}
+    }
+    {
+    // Carbon atoms on a simple cubic lattice with a spacing of 3.68 A, in a supercell of two cubes along a. There is a pocket at the centre of each cube
+    // that can accommodate the centre of the probe. The pockets are joined through the faces of the cubes by necks of radius 2.60 A - 1.70 A = 0.90 A,
+    // which is narrower than the probe, but the probe spheres from neighbouring pockets overlap in the necks.
+    // Each pocket is therefore a separate, isolated void.
+    CrystalStructure crystal_structure;
+    crystal_structure.set_crystal_lattice( CrystalLattice( 7.36, 3.68, 3.68, Angle::angle_90_degrees(), Angle::angle_90_degrees(), Angle::angle_90_degrees() ) );
+    crystal_structure.add_atom( Atom( Element( "C" ), Vector3D( 0.0, 0.0, 0.0 ), "C1" ) );
+    crystal_structure.add_atom( Atom( Element( "C" ), Vector3D( 0.5, 0.0, 0.0 ), "C2" ) );
+    VoidsReport voids_report = find_voids_on_grid( crystal_structure, 1.0, 0.05 );
+    test_suite.test_equality( voids_report.void_volumes_.size(), 2, "find_voids_on_grid() 5 number of voids" );
+    if ( voids_report.void_volumes_.size() == 2 )
+    {
+        test_suite.test_equality( voids_report.void_dimensionalities_[0], 0, "find_voids_on_grid() 5 dimensionality 1" );
+        test_suite.test_equality( voids_report.void_dimensionalities_[1], 0, "find_voids_on_grid() 5 dimensionality 2" );
+        test_suite.test_equality_double( voids_report.void_volumes_[0], voids_report.void_volumes_[1], "find_voids_on_grid() 5 volumes", 0.5 );
+        test_suite.test_equality_double( voids_report.void_volumes_[0] + voids_report.void_volumes_[1], voids_report.total_void_volume_, "find_voids_on_grid() 5 total volume" );
+    }
     }
-
 }
 
@@ -28,36 +28,210 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "TextFileWriter.h"
 #include "FileName.h"
 
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
 #include <stdexcept>
+#include <vector>
+
+namespace
+{
+
+// Large enough to make the number of system calls negligible, small enough to stay in the processor cache.
+const size_t buffer_capacity( 64 * 1024 );
+
+// ********************************************************************************
+
+// Writes the digits backwards, ending just before end, returns the number of digits.
+size_t unsigned_to_chars( unsigned long long value, char * end )
+{
+    char * current = end;
+    do
+    {
+        *(--current) = static_cast< char >( '0' + ( value % 10 ) );
+        value /= 10;
+    } while ( value != 0 );
+    return end - current;
+}
+
+} // namespace
 
 // ********************************************************************************
 
-TextFileWriter::TextFileWriter( const FileName & file_name )
+TextFileWriter::TextFileWriter( const FileName & file_name ):
+file_name_(file_name.full_name()),
+is_open_(true)
 {
-    output_file_.open( file_name.full_name().c_str() );
+    // Our own buffer replaces that of the stream, so that the text is not copied twice.
+    output_file_.rdbuf()->pubsetbuf( 0, 0 );
+    output_file_.open( file_name_.c_str() );
     if ( ! output_file_ )
-       throw std::runtime_error( std::string( "Could not open file " ) + file_name.full_name() );
+       throw std::runtime_error( std::string( "Could not open file " ) + file_name_ );
+    buffer_.reserve( buffer_capacity );
+}
+
+// ********************************************************************************
+
+TextFileWriter::~TextFileWriter()
+{
+    if ( ! is_open_ )
+        return;
+    try
+    {
+        close();
+    }
+    catch ( std::exception & e )
+    {
+        std::cout << "TextFileWriter::~TextFileWriter(): Error: " << e.what() << std::endl;
+    }
 }
 
 // ********************************************************************************
 
 void TextFileWriter::write_line( const std::string & line )
 {
-    output_file_ << line << std::endl;
+    append( line.data(), line.size() );
+    append( "\n", 1 );
 }
 
 // ********************************************************************************
 
 void TextFileWriter::write_line()
 {
-    output_file_ << std::endl;
+    append( "\n", 1 );
 }
 
 // ********************************************************************************
 
 void TextFileWriter::write( const std::string & text )
 {
-    output_file_ << text;
+    append( text.data(), text.size() );
+}
+
+// ********************************************************************************
+
+void TextFileWriter::write( const char * text )
+{
+    append( text, std::strlen( text ) );
+}
+
+// ********************************************************************************
+
+void TextFileWriter::write( const char c )
+{
+    append( &c, 1 );
+}
+
+// ********************************************************************************
+
+void TextFileWriter::write( const int value )
+{
+    char digits[24];
+    size_t length = unsigned_to_chars( ( value < 0 ) ? -static_cast< long long >( value ) : value, digits + 24 );
+    if ( value < 0 )
+        digits[ 24 - ++length ] = '-';
+    append( digits + 24 - length, length );
+}
+
+// ********************************************************************************
+
+void TextFileWriter::write( const size_t value )
+{
+    char digits[24];
+    size_t length = unsigned_to_chars( value, digits + 24 );
+    append( digits + 24 - length, length );
+}
+
+// ********************************************************************************
+
+void TextFileWriter::write( const double value )
+{
+    append_double( "%.*g", 6, value );
+}
+
+// ********************************************************************************
+
+void TextFileWriter::write( const double value, const size_t ndecimals )
+{
+    append_double( "%.*f", static_cast< int >( ndecimals ), value );
+}
+
+// ********************************************************************************
+
+void TextFileWriter::write_round_trip( const double value )
+{
+    char digits[32];
+    int length( 0 );
+    for ( int precision( 15 ); precision != 18; ++precision )
+    {
+        length = std::snprintf( digits, sizeof( digits ), "%.*g", precision, value );
+        if ( std::strtod( digits, 0 ) == value )
+            break;
+    }
+    append( digits, length );
+}
+
+// ********************************************************************************
+
+void TextFileWriter::flush()
+{
+    if ( ! is_open_ )
+        throw std::runtime_error( "TextFileWriter::flush(): Error: file " + file_name_ + " has already been closed." );
+    write_buffer();
+}
+
+// ********************************************************************************
+
+void TextFileWriter::close()
+{
+    if ( ! is_open_ )
+        throw std::runtime_error( "TextFileWriter::close(): Error: file " + file_name_ + " has already been closed." );
+    // Closed before writing, so that if writing fails the destructor does not try again and report the same error twice.
+    is_open_ = false;
+    write_buffer();
+    output_file_.close();
+}
+
+// ********************************************************************************
+
+void TextFileWriter::write_buffer()
+{
+    output_file_.write( buffer_.data(), buffer_.size() );
+    output_file_.flush();
+    buffer_.clear();
+    if ( ! output_file_ )
+        throw std::runtime_error( "TextFileWriter::flush(): Error: could not write to file " + file_name_ + "." );
+}
+
+// ********************************************************************************
+
+void TextFileWriter::append( const char * text, const size_t length )
+{
+    if ( ! is_open_ )
+        throw std::runtime_error( "TextFileWriter::write(): Error: file " + file_name_ + " has already been closed." );
+    buffer_.append( text, length );
+    if ( buffer_.size() >= buffer_capacity )
+        flush();
+}
+
+// ********************************************************************************
+
+void TextFileWriter::append_double( const char * format, const int precision, const double value )
+{
+    char digits[64];
+    int length = std::snprintf( digits, sizeof( digits ), format, precision, value );
+    if ( length < 0 )
+        throw std::runtime_error( "TextFileWriter::append_double(): Error: could not format number." );
+    if ( static_cast< size_t >( length ) < sizeof( digits ) )
+    {
+        append( digits, length );
+        return;
+    }
+    // Only very large numbers in fixed notation.
+    std::vector< char > large_digits( length + 1 );
+    std::snprintf( &large_digits[0], large_digits.size(), format, precision, value );
+    append( &large_digits[0], length );
 }
 
 // ********************************************************************************
@@ -30,9 +30,18 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 class FileName;
 
+#include <cstddef> // For definition of size_t
 #include <fstream>
 #include <string>
 
+/*
+  Writes a text file through a large buffer, so that the operating system is called once per buffer rather than once per line.
+  Nothing is flushed before the buffer is full, flush() or close() is called or the writer is destroyed.
+  Write errors throw, except in the destructor, which cannot throw; call close() to catch them.
+
+  The numbers are formatted directly into the buffer, without temporary strings. write( value ) and write( value, ndecimals )
+  give exactly the same text as double2string( value ) and double2string( value, ndecimals ), so existing output does not change.
+*/
 class TextFileWriter
 {
 public:
@@ -41,7 +50,7 @@ public:
 
     explicit TextFileWriter( const FileName & file_name );
 
-    ~TextFileWriter() { output_file_.close(); }
+    ~TextFileWriter();
 
     // Adds newline at end of line.
     void write_line( const std::string & line );
@@ -52,8 +61,39 @@ public:
     // No newline is added.
     void write( const std::string & text );
 
+    // Avoids a temporary std::string for string literals.
+    void write( const char * text );
+
+    void write( const char c );
+
+    void write( const int value );
+
+    void write( const size_t value );
+
+    // Same as double2string( value ), i.e. six significant digits.
+    void write( const double value );
+
+    // Same as double2string( value, ndecimals ), i.e. fixed notation.
+    void write( const double value, const size_t ndecimals );
+
+    // The shortest of 15, 16 or 17 significant digits that reads back as exactly the same double.
+    void write_round_trip( const double value );
+
+    // Writes the buffer to the file.
+    void flush();
+
+    // Flushes and closes the file, nothing can be written afterwards.
+    void close();
+
 private:
     std::ofstream output_file_;
+    std::string file_name_;
+    std::string buffer_;
+    bool is_open_;
+
+    void write_buffer();
+    void append( const char * text, const size_t length );
+    void append_double( const char * format, const int precision, const double value );
 };
 
 #endif // TEXTFILEWRITER_H
@@ -0,0 +1,154 @@
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include "ThreadPool.h"
+
+// ********************************************************************************
+
+ThreadPool::ThreadPool( const size_t nthreads ):
+task_(0),
+ntasks_(0),
+next_task_(0),
+nfinished_tasks_(0),
+generation_(0),
+stop_(false)
+{
+    size_t nthreads_2 = nthreads;
+    if ( nthreads_2 == 0 )
+        nthreads_2 = std::thread::hardware_concurrency();
+    // hardware_concurrency() returns 0 if the number of cores cannot be determined.
+    if ( nthreads_2 == 0 )
+        nthreads_2 = 1;
+    threads_.reserve( nthreads_2 - 1 );
+    for ( size_t i( 1 ); i != nthreads_2; ++i )
+        threads_.push_back( std::thread( &ThreadPool::worker, this ) );
+}
+
+// ********************************************************************************
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard< std::mutex > lock( mutex_ );
+        stop_ = true;
+    }
+    work_available_.notify_all();
+    for ( size_t i( 0 ); i != threads_.size(); ++i )
+        threads_[i].join();
+}
+
+// ********************************************************************************
+
+void ThreadPool::run( const size_t ntasks, const std::function< void( const size_t ) > & task )
+{
+    if ( ntasks == 0 )
+        return;
+    if ( threads_.empty() )
+    {
+        for ( size_t i( 0 ); i != ntasks; ++i )
+            task( i );
+        return;
+    }
+    {
+        std::lock_guard< std::mutex > lock( mutex_ );
+        task_ = &task;
+        ntasks_ = ntasks;
+        next_task_ = 0;
+        nfinished_tasks_ = 0;
+        exception_ = std::exception_ptr();
+        ++generation_;
+    }
+    work_available_.notify_all();
+    execute_tasks();
+    std::exception_ptr exception;
+    {
+        std::unique_lock< std::mutex > lock( mutex_ );
+        while ( nfinished_tasks_ != ntasks_ )
+            work_done_.wait( lock );
+        task_ = 0;
+        exception = exception_;
+        exception_ = std::exception_ptr();
+    }
+    if ( exception )
+        std::rethrow_exception( exception );
+}
+
+// ********************************************************************************
+
+void ThreadPool::worker()
+{
+    size_t last_generation( 0 );
+    for ( ;; )
+    {
+        {
+            std::unique_lock< std::mutex > lock( mutex_ );
+            while ( ( ! stop_ ) && ( generation_ == last_generation ) )
+                work_available_.wait( lock );
+            if ( stop_ )
+                return;
+            last_generation = generation_;
+        }
+        execute_tasks();
+    }
+}
+
+// ********************************************************************************
+
+void ThreadPool::execute_tasks()
+{
+    for ( ;; )
+    {
+        const std::function< void( const size_t ) > * task;
+        size_t i;
+        {
+            std::lock_guard< std::mutex > lock( mutex_ );
+            // A worker that wakes up late may find that the work has already been finished.
+            if ( ( task_ == 0 ) || ( next_task_ == ntasks_ ) )
+                return;
+            task = task_;
+            i = next_task_;
+            ++next_task_;
+        }
+        try
+        {
+            (*task)( i );
+        }
+        catch ( ... )
+        {
+            std::lock_guard< std::mutex > lock( mutex_ );
+            if ( ! exception_ )
+                exception_ = std::current_exception();
+        }
+        std::lock_guard< std::mutex > lock( mutex_ );
+        ++nfinished_tasks_;
+        if ( nfinished_tasks_ == ntasks_ )
+            work_done_.notify_all();
+    }
+}
+
+// ********************************************************************************
+
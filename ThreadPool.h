@@ -0,0 +1,88 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+/* *********************************************
+Copyright (c) 2013-2025, Cornelis Jan (Jacco) van de Streek
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of my employers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CORNELIS JAN VAN DE STREEK BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+********************************************* */
+
+#include <condition_variable>
+#include <cstddef> // For definition of size_t
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+  A fixed number of threads that run numbered tasks.
+
+  run( ntasks, task ) calls task( i ) for i = 0, ..., ntasks-1 and returns when all tasks have finished.
+  The calling thread takes part in the work, so a pool of n threads starts n-1 extra threads.
+  With one thread no extra threads are started at all and the tasks are run in order in the calling thread.
+
+  Tasks are handed out to whichever thread is free, so which thread runs which task is not fixed.
+  For results that do not depend on the timing, a task should only depend on its index and should only write
+  to data that belong to that index, e.g. one partial sum per task that is reduced afterwards in order of the index.
+
+  If a task throws, the remaining tasks are still run and the first exception is rethrown by run().
+*/
+class ThreadPool
+{
+public:
+
+    // nthreads = 0 means the number of cores.
+    explicit ThreadPool( const size_t nthreads = 0 );
+
+    ~ThreadPool();
+
+    size_t nthreads() const { return threads_.size() + 1; }
+
+    // Not thread-safe: only one thread should call run() at any one time.
+    void run( const size_t ntasks, const std::function< void( const size_t ) > & task );
+
+private:
+    std::vector< std::thread > threads_;
+    std::mutex mutex_;
+    std::condition_variable work_available_;
+    std::condition_variable work_done_;
+    const std::function< void( const size_t ) > * task_; // 0 if there is no work
+    size_t ntasks_;
+    size_t next_task_;
+    size_t nfinished_tasks_;
+    size_t generation_; // Increased by one for each call to run(), so the workers can tell new work from old
+    bool stop_;
+    std::exception_ptr exception_;
+
+    void worker();
+    void execute_tasks();
+
+    // Not copyable.
+    ThreadPool( const ThreadPool & );
+    ThreadPool & operator=( const ThreadPool & );
+};
+
+#endif // THREADPOOL_H
+
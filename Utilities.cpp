@@ -30,6 +30,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "StringFunctions.h"
 
 #include <cmath>
+#include <cstdlib>
 #include <sstream>
 #include <stdexcept>
 
@@ -168,6 +169,107 @@ double string2double( std::string input )
 
 // ********************************************************************************
 
+// Up to 19 significant digits are collected into an integer and scaled by an exact power of ten.
+// For the common case of at most 15 digits and a decimal exponent of at most 22 that is one correctly
+// rounded multiplication or division, anything else is handed to strtod().
+double string2double( const char * begin, const char * end )
+{
+    static const double powers_of_ten[] = { 1.0e0,  1.0e1,  1.0e2,  1.0e3,  1.0e4,  1.0e5,  1.0e6,  1.0e7,
+                                            1.0e8,  1.0e9,  1.0e10, 1.0e11, 1.0e12, 1.0e13, 1.0e14, 1.0e15,
+                                            1.0e16, 1.0e17, 1.0e18, 1.0e19, 1.0e20, 1.0e21, 1.0e22 };
+    const char * current = begin;
+    bool is_negative( false );
+    if ( ( current != end ) && ( ( *current == '+' ) || ( *current == '-' ) ) )
+    {
+        is_negative = ( *current == '-' );
+        ++current;
+    }
+    unsigned long long mantissa( 0 );
+    size_t nsignificant_digits( 0 );
+    size_t ndigits( 0 );
+    int exponent( 0 );
+    bool after_period( false );
+    for ( ; current != end; ++current )
+    {
+        if ( ( *current >= '0' ) && ( *current <= '9' ) )
+        {
+            ++ndigits;
+            if ( ( mantissa == 0 ) && ( *current == '0' ) )
+            {
+                if ( after_period )
+                    --exponent;
+                continue;
+            }
+            if ( nsignificant_digits < 19 )
+            {
+                mantissa = 10 * mantissa + ( *current - '0' );
+                ++nsignificant_digits;
+                if ( after_period )
+                    --exponent;
+            }
+            else
+            {
+                ++nsignificant_digits;
+                if ( ! after_period )
+                    ++exponent;
+            }
+        }
+        else if ( ( *current == '.' ) && ( ! after_period ) )
+            after_period = true;
+        else
+            break;
+    }
+    if ( ndigits == 0 )
+        throw std::runtime_error( "string2double(): error: no digits found : >" + std::string( begin, end ) + "<" );
+    if ( ( current != end ) && ( ( *current == 'E' ) || ( *current == 'e' ) ) )
+    {
+        ++current;
+        bool exponent_is_negative( false );
+        if ( ( current != end ) && ( ( *current == '+' ) || ( *current == '-' ) ) )
+        {
+            exponent_is_negative = ( *current == '-' );
+            ++current;
+        }
+        if ( ( current == end ) || ( *current < '0' ) || ( *current > '9' ) )
+            throw std::runtime_error( "string2double(): error: no digits after exponent : >" + std::string( begin, end ) + "<" );
+        int explicit_exponent( 0 );
+        for ( ; ( current != end ) && ( *current >= '0' ) && ( *current <= '9' ); ++current )
+        {
+            if ( explicit_exponent < 10000 )
+                explicit_exponent = 10 * explicit_exponent + ( *current - '0' );
+        }
+        exponent += exponent_is_negative ? -explicit_exponent : explicit_exponent;
+    }
+    const char * end_of_number = current;
+    if ( ( current != end ) && ( *current == '(' ) )
+    {
+        ++current;
+        while ( ( current != end ) && ( *current >= '0' ) && ( *current <= '9' ) )
+            ++current;
+        if ( ( current == end ) || ( *current != ')' ) )
+            throw std::runtime_error( "string2double(): error: parentheses not closed properly :  >" + std::string( begin, end ) + "<" );
+        ++current;
+    }
+    if ( current != end )
+        throw std::runtime_error( "string2double(): error: invalid character found : >" + std::string( begin, end ) + "<" );
+    double result;
+    if ( mantissa == 0 )
+        result = 0.0;
+    else if ( ( nsignificant_digits <= 15 ) && ( exponent >= -22 ) && ( exponent <= 22 ) )
+    {
+        result = static_cast< double >( mantissa );
+        if ( exponent < 0 )
+            result /= powers_of_ten[ -exponent ];
+        else
+            result *= powers_of_ten[ exponent ];
+    }
+    else
+        result = std::strtod( std::string( begin + ( ( *begin == '+' ) || ( *begin == '-' ) ? 1 : 0 ), end_of_number ).c_str(), 0 );
+    return is_negative ? -result : result;
+}
+
+// ********************************************************************************
+
 int string2integer( const std::string & input )
 {
     return round_to_int( string2double_2( input, false ) );
@@ -101,6 +101,10 @@ double string2double_2( const std::string & input, const bool float_allowed );
 // Recognises scientific notation with "E" or "e" such as -.234e-45.
 double string2double( std::string input );
 
+// As above, including the "1.234(5)" form, but reads the characters [begin, end) in place without allocating memory.
+// The result is correctly rounded, which string2double() does not guarantee.
+double string2double( const char * begin, const char * end );
+
 int string2integer( const std::string & input );
 
 size_t string2size_t( const std::string & input );
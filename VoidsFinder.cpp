@@ -29,165 +29,563 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "3DCalculations.h"
 #include "CrystalStructure.h"
 #include "BasicMathsFunctions.h"
-#include "RandomNumberGenerator.h"
+#include "ThreadPool.h"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <stdexcept>
 
 namespace {
 
-bool intersects_atoms( const std::vector< Vector3D > & positions_Cartesian, const Vector3D & position_Cartesian, const std::vector< double > & distances2 )
+inline int wrap_index( const int i, const int n )
 {
-    for ( size_t i( 0 ); i != positions_Cartesian.size(); ++i )
+    int result = i % n;
+    if ( result < 0 )
+        result += n;
+    return result;
+}
+
+// ********************************************************************************
+
+// The unit cell divided into n_[0] x n_[1] x n_[2] voxels, voxel (i,j,k) is centred at fractional coordinates ( (i+0.5)/n_[0], (j+0.5)/n_[1], (k+0.5)/n_[2] ).
+class VoxelGrid
+{
+public:
+
+    VoxelGrid( const CrystalLattice & crystal_lattice, const double grid_spacing ):
+    fractional_to_orthogonal_matrix_( crystal_lattice.fractional_to_orthogonal_matrix() )
+    {
+        double lengths[3] = { crystal_lattice.a(), crystal_lattice.b(), crystal_lattice.c() };
+        // Two points that are r apart differ by at most a* r in their fractional x coordinate.
+        reciprocal_lengths_[0] = crystal_lattice.a_star();
+        reciprocal_lengths_[1] = crystal_lattice.b_star();
+        reciprocal_lengths_[2] = crystal_lattice.c_star();
+        for ( size_t d( 0 ); d != 3; ++d )
+        {
+            n_[d] = std::max( 1, static_cast<int>( ceil( lengths[d] / grid_spacing ) ) );
+            Vector3D step;
+            step.set_value( d, 1.0 / n_[d] );
+            steps_[d] = fractional_to_orthogonal_matrix_ * step;
+        }
+    }
+
+    size_t size() const { return static_cast<size_t>( n_[0] ) * n_[1] * n_[2]; }
+    int n( const size_t d ) const { return n_[d]; }
+    size_t index( const int i, const int j, const int k ) const { return ( static_cast<size_t>( i ) * n_[1] + j ) * n_[2] + k; }
+    Vector3D centre( const int i, const int j, const int k ) const { return Vector3D( ( i + 0.5 ) / n_[0], ( j + 0.5 ) / n_[1], ( k + 0.5 ) / n_[2] ); }
+    Matrix3D fractional_to_orthogonal_matrix() const { return fractional_to_orthogonal_matrix_; }
+
+    // Half the length of the longest body diagonal of a voxel, every point in a voxel lies within this distance of its centre.
+    double half_diagonal() const
+    {
+        double result( 0.0 );
+        for ( int i( -1 ); i != 3; i += 2 )
+        {
+            for ( int j( -1 ); j != 3; j += 2 )
+                result = std::max( result, ( static_cast<double>( i ) * steps_[0] + static_cast<double>( j ) * steps_[1] + steps_[2] ).norm2() );
+        }
+        return 0.5 * sqrt( result );
+    }
+
+    // point must be in fractional coordinates in [0,1>.
+    size_t voxel( const Vector3D & point, int & i, int & j, int & k ) const
+    {
+        i = std::min( static_cast<int>( point.x() * n_[0] ), n_[0] - 1 );
+        j = std::min( static_cast<int>( point.y() * n_[1] ), n_[1] - 1 );
+        k = std::min( static_cast<int>( point.z() * n_[2] ), n_[2] - 1 );
+        return index( i, j, k );
+    }
+
+    // Calls visitor( index, distance2, difference ) for every voxel with first index in [begin, end> whose centre lies within radius of sphere_centre,
+    // difference is the Cartesian vector from (the image of) sphere_centre to the centre of the voxel.
+    // sphere_centre is in fractional coordinates, all periodic images are included, so a voxel may be visited more than once.
+    template< class Visitor >
+    void visit_sphere( const Vector3D & sphere_centre, const double radius, const int begin, const int end, Visitor & visitor ) const
+    {
+        int lower[3];
+        int upper[3];
+        for ( size_t d( 0 ); d != 3; ++d )
+            index_range( sphere_centre, radius, d, lower[d], upper[d] );
+        const double radius2 = square( radius );
+        // Cartesian position of voxel (0,0,0) relative to the centre.
+        const Vector3D origin = fractional_to_orthogonal_matrix_ * ( centre( 0, 0, 0 ) - sphere_centre );
+        for ( int i( lower[0] ); i <= upper[0]; ++i )
+        {
+            const int iw = wrap_index( i, n_[0] );
+            if ( ( iw < begin ) || ( iw >= end ) )
+                continue;
+            for ( int j( lower[1] ); j <= upper[1]; ++j )
+            {
+                const int jw = wrap_index( j, n_[1] );
+                const Vector3D row = origin + static_cast<double>( i ) * steps_[0] + static_cast<double>( j ) * steps_[1];
+                for ( int k( lower[2] ); k <= upper[2]; ++k )
+                {
+                    const Vector3D difference = row + static_cast<double>( k ) * steps_[2];
+                    const double distance2 = difference.norm2();
+                    if ( distance2 < radius2 )
+                        visitor( index( iw, jw, wrap_index( k, n_[2] ) ), distance2, difference );
+                }
+            }
+        }
+    }
+
+    // The range [lower, upper] of (unwrapped) indices along lattice vector d of the voxels whose centres can lie within radius of sphere_centre.
+    void index_range( const Vector3D & sphere_centre, const double radius, const size_t d, int & lower, int & upper ) const
+    {
+        // The centre in units of voxels, relative to the centres of the voxels.
+        double c = sphere_centre.value( d ) * n_[d] - 0.5;
+        double extent = reciprocal_lengths_[d] * radius * n_[d];
+        lower = static_cast<int>( ceil( c - extent ) );
+        upper = static_cast<int>( floor( c + extent ) );
+    }
+
+private:
+    Matrix3D fractional_to_orthogonal_matrix_;
+    double reciprocal_lengths_[3];
+    int n_[3];
+    Vector3D steps_[3]; // Cartesian vector from one voxel to the next along each lattice vector.
+};
+
+// ********************************************************************************
+
+// Keeps the smallest signed distance to a Van der Waals surface.
+struct UpdateDistanceField
+{
+    UpdateDistanceField( std::vector< float > & distance_field, const double Van_der_Waals_radius ): distance_field_(distance_field), Van_der_Waals_radius_(Van_der_Waals_radius) {}
+
+    void operator()( const size_t index, const double distance2, const Vector3D & )
+    {
+        float distance = static_cast<float>( sqrt( distance2 ) - Van_der_Waals_radius_ );
+        if ( distance < distance_field_[index] )
+            distance_field_[index] = distance;
+    }
+
+    std::vector< float > & distance_field_;
+    double Van_der_Waals_radius_;
+};
+
+// ********************************************************************************
+
+// Adds the voxels in a probe sphere to the void of the accessible voxel at its centre. The accessible voxels themselves are left alone.
+// A voxel that can be reached from more than one void is given the lowest label, so the result does not depend on the order of the spheres.
+struct AddToVoid
+{
+    AddToVoid( std::vector< int > & labels, const std::vector< char > & is_accessible, const int label ): labels_(labels), is_accessible_(is_accessible), label_(label) {}
+
+    void operator()( const size_t index, const double, const Vector3D & )
+    {
+        if ( is_accessible_[index] )
+            return;
+        if ( ( labels_[index] < 0 ) || ( label_ < labels_[index] ) )
+            labels_[index] = label_;
+    }
+
+    std::vector< int > & labels_;
+    const std::vector< char > & is_accessible_;
+    int label_;
+};
+
+// ********************************************************************************
+
+// Spheres are applied in slabs of voxels along a, so that every voxel is written by one task only.
+// The spheres are sorted into the slabs first, so each task only visits the spheres that intersect its slab, in their original order.
+template< class Visitor >
+void visit_spheres( const VoxelGrid & voxel_grid, const std::vector< Vector3D > & centres, const std::vector< double > & radii, std::vector< Visitor > & visitors, ThreadPool & thread_pool )
+{
+    const int n = voxel_grid.n( 0 );
+    const size_t ntasks = std::min( static_cast<size_t>( n ), 4 * thread_pool.nthreads() );
+    std::vector< size_t > task_of_slice( n );
+    for ( size_t task( 0 ); task != ntasks; ++task )
+    {
+        for ( size_t i( ( task * n ) / ntasks ); i != ( ( task + 1 ) * n ) / ntasks; ++i )
+            task_of_slice[i] = task;
+    }
+    std::vector< std::vector< size_t > > spheres( ntasks );
+    for ( size_t i( 0 ); i != centres.size(); ++i )
+    {
+        int lower;
+        int upper;
+        voxel_grid.index_range( centres[i], radii[i], 0, lower, upper );
+        upper = std::min( upper, lower + n - 1 );
+        for ( int j( lower ); j <= upper; ++j )
+        {
+            std::vector< size_t > & task_spheres = spheres[ task_of_slice[ wrap_index( j, n ) ] ];
+            if ( task_spheres.empty() || ( task_spheres.back() != i ) )
+                task_spheres.push_back( i );
+        }
+    }
+    thread_pool.run( ntasks, [&]( const size_t task )
+    {
+        const int begin = static_cast<int>( ( task * n ) / ntasks );
+        const int end = static_cast<int>( ( ( task + 1 ) * n ) / ntasks );
+        for ( size_t i( 0 ); i != spheres[task].size(); ++i )
+        {
+            Visitor visitor( visitors[ spheres[task][i] ] );
+            voxel_grid.visit_sphere( centres[ spheres[task][i] ], radii[ spheres[task][i] ], begin, end, visitor );
+        }
+    } );
+}
+
+// ********************************************************************************
+
+struct OccupancyCandidate
+{
+    Vector3D position_; // Cartesian, relative to the centre of the voxel.
+    double radius2_;
+};
+
+// ********************************************************************************
+
+// Sorts the atoms into the voxels of a coarse grid. A voxel that lies completely inside an atom is flagged as such,
+// otherwise the voxel stores the images of all atoms that overlap with it.
+struct AddToOccupancyGrid
+{
+    AddToOccupancyGrid( std::vector< char > & is_covered, std::vector< std::vector< OccupancyCandidate > > & candidates, const double Van_der_Waals_radius, const double half_diagonal ):
+    is_covered_(is_covered), candidates_(candidates), Van_der_Waals_radius_(Van_der_Waals_radius), half_diagonal_(half_diagonal) {}
+
+    void operator()( const size_t index, const double distance2, const Vector3D & difference )
+    {
+        if ( is_covered_[index] )
+            return;
+        if ( sqrt( distance2 ) + half_diagonal_ <= Van_der_Waals_radius_ )
+        {
+            is_covered_[index] = 1;
+            std::vector< OccupancyCandidate >().swap( candidates_[index] );
+            return;
+        }
+        OccupancyCandidate candidate;
+        candidate.position_ = -difference;
+        candidate.radius2_ = square( Van_der_Waals_radius_ );
+        candidates_[index].push_back( candidate );
+    }
+
+    std::vector< char > & is_covered_;
+    std::vector< std::vector< OccupancyCandidate > > & candidates_;
+    double Van_der_Waals_radius_;
+    double half_diagonal_;
+};
+
+// ********************************************************************************
+
+// Element i of the Halton sequence in base b, the radical inverse of i.
+double radical_inverse( size_t i, const size_t b )
+{
+    double result( 0.0 );
+    double fraction( 1.0 / b );
+    while ( i != 0 )
     {
-        if ( ( positions_Cartesian[i] - position_Cartesian ).norm2() < distances2[i] )
-            return true;
+        result += ( i % b ) * fraction;
+        i /= b;
+        fraction /= b;
     }
-    return false;
+    return result;
+}
+
+// ********************************************************************************
+
+double fractional_part( const double x )
+{
+    double result = x - floor( x );
+    if ( result >= 1.0 )
+        result = 0.0;
+    return result;
 }
 
-double calculate_volume( const CrystalStructure & crystal_structure, const std::vector< Vector3D > & void_spheres, const double probe_radius )
+// ********************************************************************************
+
+// Number of linearly independent vectors among the periods of a void (0, 1, 2 or 3).
+size_t dimensionality( const std::vector< std::vector< int > > & periods )
 {
-    std::cout << "Now calculating the volume." << std::endl;
-    if ( void_spheres.empty() )
-        return 0.0;
-    RandomNumberGenerator_double random_number_generator;
-    const size_t nprobes( ( crystal_structure.crystal_lattice().volume() * 1000.0 ) / crystal_structure.space_group().nsymmetry_operators() ); // 1000 sampling points per A^3
-    size_t ninside_voids( 0 );
-    double probe_radius2 = square( probe_radius );
-    std::vector< double > distances2;
-    distances2.reserve( void_spheres.size() );
-    for ( size_t i( 0 ); i != void_spheres.size(); ++i )
-        distances2.push_back( probe_radius2 );
-    for ( size_t i( 0 ); i != nprobes; ++i )
-    {
-        Vector3D random_vector_fractional( random_number_generator.next_number(), random_number_generator.next_number(), random_number_generator.next_number() );
-        Vector3D random_vector_Cartesian = crystal_structure.crystal_lattice().fractional_to_orthogonal( random_vector_fractional );
-        if ( intersects_atoms( void_spheres, random_vector_Cartesian, distances2 ) )
-            ++ninside_voids;
-    }
-    return ( static_cast<double>( ninside_voids ) / static_cast<double>( nprobes ) ) * crystal_structure.crystal_lattice().volume();
+    std::vector< Vector3D > basis;
+    for ( size_t i( 0 ); i != periods.size(); ++i )
+    {
+        Vector3D period( periods[i][0], periods[i][1], periods[i][2] );
+        if ( basis.empty() )
+            basis.push_back( period );
+        else if ( basis.size() == 1 )
+        {
+            if ( ! cross_product( basis[0], period ).nearly_zero() )
+                basis.push_back( period );
+        }
+        else if ( std::abs( cross_product( basis[0], basis[1] ) * period ) > 0.5 )
+            return 3;
+    }
+    return basis.size();
 }
 
 } // namespace
 
 // ********************************************************************************
 
+VoidsReport find_voids_on_grid( const CrystalStructure & crystal_structure, const double probe_radius, const double grid_spacing, const size_t nthreads )
+{
+    if ( probe_radius < 0.0 )
+        throw std::runtime_error( "find_voids_on_grid(): Error: probe radius must not be negative." );
+    if ( grid_spacing <= 0.0 )
+        throw std::runtime_error( "find_voids_on_grid(): Error: grid spacing must be positive." );
+    CrystalStructure crystal_structure_2( crystal_structure );
+    if ( ! crystal_structure_2.space_group_symmetry_has_been_applied() )
+        crystal_structure_2.apply_space_group_symmetry( false );
+    const CrystalLattice crystal_lattice = crystal_structure_2.crystal_lattice();
+    VoxelGrid voxel_grid( crystal_lattice, grid_spacing );
+    ThreadPool thread_pool( nthreads );
+    // Signed distance from each voxel to the nearest Van der Waals surface, only calculated up to probe_radius.
+    // Single precision is plenty for distances that are compared against the probe radius on a grid of a tenth of an Angstrom.
+    std::vector< float > distance_field( voxel_grid.size(), static_cast<float>( probe_radius ) );
+    {
+        std::vector< Vector3D > centres;
+        std::vector< double > radii;
+        std::vector< UpdateDistanceField > visitors;
+        for ( size_t i( 0 ); i != crystal_structure_2.natoms(); ++i )
+        {
+            double Van_der_Waals_radius = crystal_structure_2.atom_elements()[i].Van_der_Waals_radius();
+            centres.push_back( crystal_structure_2.atom_positions()[i] );
+            radii.push_back( Van_der_Waals_radius + probe_radius );
+            visitors.push_back( UpdateDistanceField( distance_field, Van_der_Waals_radius ) );
+        }
+        visit_spheres( voxel_grid, centres, radii, visitors, thread_pool );
+    }
+    // The centre of a probe fits wherever the distance field has not been lowered.
+    std::vector< char > is_accessible( voxel_grid.size(), 0 );
+    for ( size_t i( 0 ); i != voxel_grid.size(); ++i )
+        is_accessible[i] = ( distance_field[i] >= static_cast<float>( probe_radius ) ) ? 1 : 0;
+    // Connected regions of accessible voxels: the probe can only move from one void to another if its centre can.
+    // Each voxel also stores the lattice translation of the copy that was reached,
+    // reaching a voxel that has already been assigned to the same void with a different translation means that the void is periodic.
+    VoidsReport result;
+    const int unassigned( -1 );
+    std::vector< int > labels( voxel_grid.size(), unassigned );
+    std::vector< signed char > translations( 3 * voxel_grid.size(), 0 ); // The search never strays more than a few unit cells from the seed.
+    std::vector< size_t > queue;
+    for ( size_t seed( 0 ); seed != voxel_grid.size(); ++seed )
+    {
+        if ( ( ! is_accessible[seed] ) || ( labels[seed] != unassigned ) )
+            continue;
+        const int label = static_cast<int>( result.void_dimensionalities_.size() );
+        std::vector< std::vector< int > > periods;
+        queue.clear();
+        queue.push_back( seed );
+        labels[seed] = label;
+        for ( size_t q( 0 ); q != queue.size(); ++q )
+        {
+            const size_t current = queue[q];
+            int ijk[3];
+            ijk[2] = static_cast<int>( current % voxel_grid.n( 2 ) );
+            ijk[1] = static_cast<int>( ( current / voxel_grid.n( 2 ) ) % voxel_grid.n( 1 ) );
+            ijk[0] = static_cast<int>( current / ( static_cast<size_t>( voxel_grid.n( 1 ) ) * voxel_grid.n( 2 ) ) );
+            for ( size_t d( 0 ); d != 3; ++d )
+            {
+                for ( int step( -1 ); step != 3; step += 2 )
+                {
+                    int neighbour_ijk[3] = { ijk[0], ijk[1], ijk[2] };
+                    neighbour_ijk[d] += step;
+                    int translation[3] = { translations[ 3 * current ], translations[ 3 * current + 1 ], translations[ 3 * current + 2 ] };
+                    if ( neighbour_ijk[d] < 0 )
+                    {
+                        neighbour_ijk[d] += voxel_grid.n( d );
+                        translation[d] -= 1;
+                    }
+                    else if ( neighbour_ijk[d] == voxel_grid.n( d ) )
+                    {
+                        neighbour_ijk[d] = 0;
+                        translation[d] += 1;
+                    }
+                    const size_t neighbour = voxel_grid.index( neighbour_ijk[0], neighbour_ijk[1], neighbour_ijk[2] );
+                    if ( ! is_accessible[neighbour] )
+                        continue;
+                    if ( labels[neighbour] == unassigned )
+                    {
+                        labels[neighbour] = label;
+                        for ( size_t e( 0 ); e != 3; ++e )
+                            translations[ 3 * neighbour + e ] = static_cast<signed char>( translation[e] );
+                        queue.push_back( neighbour );
+                    }
+                    else if ( ( translations[ 3 * neighbour ] != translation[0] ) ||
+                              ( translations[ 3 * neighbour + 1 ] != translation[1] ) ||
+                              ( translations[ 3 * neighbour + 2 ] != translation[2] ) )
+                    {
+                        for ( size_t e( 0 ); e != 3; ++e )
+                            translation[e] -= translations[ 3 * neighbour + e ];
+                        std::vector< int > period( translation, translation + 3 );
+                        if ( std::find( periods.begin(), periods.end(), period ) == periods.end() )
+                            periods.push_back( period );
+                    }
+                }
+            }
+        }
+        result.void_dimensionalities_.push_back( dimensionality( periods ) );
+    }
+    // Add the probe spheres on the surface of each region that can accommodate the centre of a probe to that region.
+    // The voxels inside a region are within probe_radius of its surface, so they need not be visited.
+    if ( probe_radius > 0.0 )
+    {
+        std::vector< Vector3D > centres;
+        std::vector< AddToVoid > visitors;
+        for ( int i( 0 ); i != voxel_grid.n( 0 ); ++i )
+        {
+            for ( int j( 0 ); j != voxel_grid.n( 1 ); ++j )
+            {
+                for ( int k( 0 ); k != voxel_grid.n( 2 ); ++k )
+                {
+                    const size_t index = voxel_grid.index( i, j, k );
+                    if ( ! is_accessible[index] )
+                        continue;
+                    if ( is_accessible[ voxel_grid.index( wrap_index( i - 1, voxel_grid.n( 0 ) ), j, k ) ] &&
+                         is_accessible[ voxel_grid.index( wrap_index( i + 1, voxel_grid.n( 0 ) ), j, k ) ] &&
+                         is_accessible[ voxel_grid.index( i, wrap_index( j - 1, voxel_grid.n( 1 ) ), k ) ] &&
+                         is_accessible[ voxel_grid.index( i, wrap_index( j + 1, voxel_grid.n( 1 ) ), k ) ] &&
+                         is_accessible[ voxel_grid.index( i, j, wrap_index( k - 1, voxel_grid.n( 2 ) ) ) ] &&
+                         is_accessible[ voxel_grid.index( i, j, wrap_index( k + 1, voxel_grid.n( 2 ) ) ) ] )
+                        continue;
+                    centres.push_back( voxel_grid.centre( i, j, k ) );
+                    visitors.push_back( AddToVoid( labels, is_accessible, labels[index] ) );
+                }
+            }
+        }
+        std::vector< double > radii( centres.size(), probe_radius );
+        visit_spheres( voxel_grid, centres, radii, visitors, thread_pool );
+    }
+    const double voxel_volume = crystal_lattice.volume() / voxel_grid.size();
+    std::vector< size_t > nvoxels( result.void_dimensionalities_.size(), 0 );
+    size_t total_nvoxels( 0 );
+    for ( size_t i( 0 ); i != voxel_grid.size(); ++i )
+    {
+        if ( labels[i] == unassigned )
+            continue;
+        ++nvoxels[ labels[i] ];
+        ++total_nvoxels;
+    }
+    for ( size_t i( 0 ); i != nvoxels.size(); ++i )
+        result.void_volumes_.push_back( nvoxels[i] * voxel_volume );
+    result.total_void_volume_ = total_nvoxels * voxel_volume;
+    return result;
+}
+
+// ********************************************************************************
+
 double find_voids( const CrystalStructure & crystal_structure, const double probe_radius )
 {
     if ( crystal_structure.natoms() == 0 )
         return crystal_structure.crystal_lattice().volume();
+    return find_voids_on_grid( crystal_structure, probe_radius ).total_void_volume_;
+}
+
+// ********************************************************************************
+
+VolumeEstimate integrate_void_volume( const CrystalStructure & crystal_structure, const double relative_tolerance, const size_t maximum_npoints, const size_t nthreads )
+{
+    VolumeEstimate result;
+    result.volume_ = crystal_structure.crystal_lattice().volume();
+    result.standard_error_ = 0.0;
+    result.npoints_ = 0;
+    if ( crystal_structure.natoms() == 0 )
+        return result;
     CrystalStructure crystal_structure_2( crystal_structure );
-    crystal_structure_2.pack_crystal( probe_radius );
-    double grid_spacing( 0.15 );
-    double probe_reduction = probe_radius * 0.05;
-    double probe_radius_intermediate = probe_radius - probe_reduction;
-    std::vector< Vector3D > void_spheres_intermediate;
-    // For each atom, precalculate square( VdW radius + probe_radius )
-    std::vector< Vector3D > atom_positions_Cartesian;
-    atom_positions_Cartesian.reserve( crystal_structure_2.natoms() );
-    std::vector< double > distances2;
-    distances2.reserve( crystal_structure_2.natoms() );
-    for ( size_t i( 0 ); i != crystal_structure_2.natoms(); ++i )
-    {
-        atom_positions_Cartesian.push_back( crystal_structure_2.crystal_lattice().fractional_to_orthogonal( crystal_structure_2.atom( i ).position() ) );
-        distances2.push_back( square( crystal_structure_2.atom( i ).element().Van_der_Waals_radius() + probe_radius_intermediate ) );
-    }
-    // Our CrystalLattice class uses the a-along-x convention
-    // We need the enclosing box / bounding box
-    Vector3D min_min_min;
-    Vector3D max_max_max;
-    crystal_structure_2.crystal_lattice().enclosing_box( min_min_min, max_max_max );
-    for ( int ix = round_to_int( min_min_min.x() / grid_spacing ) - 1; ix != round_to_int( max_max_max.x() / grid_spacing ) + 1; ++ix )
-    {
-        for ( int iy = round_to_int( min_min_min.y() / grid_spacing ) - 1; iy != round_to_int( max_max_max.y() / grid_spacing ) + 1; ++iy )
+    if ( ! crystal_structure_2.space_group_symmetry_has_been_applied() )
+        crystal_structure_2.apply_space_group_symmetry( false );
+    const CrystalLattice crystal_lattice = crystal_structure_2.crystal_lattice();
+    ThreadPool thread_pool( nthreads );
+    // Voxels of about half an Angstrom: most voxels are either completely inside an atom or are crossed by only a few atoms.
+    const VoxelGrid voxel_grid( crystal_lattice, 0.5 );
+    const double half_diagonal = voxel_grid.half_diagonal();
+    std::vector< char > is_covered( voxel_grid.size(), 0 );
+    std::vector< std::vector< OccupancyCandidate > > candidates( voxel_grid.size() );
+    {
+        std::vector< Vector3D > centres;
+        std::vector< double > radii;
+        std::vector< AddToOccupancyGrid > visitors;
+        for ( size_t i( 0 ); i != crystal_structure_2.natoms(); ++i )
         {
-            for ( int iz = round_to_int( min_min_min.z() / grid_spacing ) - 1; iz != round_to_int( max_max_max.z() / grid_spacing ) + 1; ++iz )
+            double Van_der_Waals_radius = crystal_structure_2.atom_elements()[i].Van_der_Waals_radius();
+            centres.push_back( crystal_structure_2.atom_positions()[i] );
+            radii.push_back( Van_der_Waals_radius + half_diagonal );
+            visitors.push_back( AddToOccupancyGrid( is_covered, candidates, Van_der_Waals_radius, half_diagonal ) );
+        }
+        visit_spheres( voxel_grid, centres, radii, visitors, thread_pool );
+    }
+    const Matrix3D fractional_to_orthogonal_matrix = voxel_grid.fractional_to_orthogonal_matrix();
+    // The points are the Halton sequence in bases 2, 3 and 5, shifted by a different fixed vector for each of nreplicas replicas (randomised quasi-Monte Carlo).
+    // The spread of the estimates from the replicas gives the error estimate.
+    // The work is divided into a fixed number of tasks that each count the points outside the atoms in their own range,
+    // so the result does not depend on the number of threads.
+    const size_t nreplicas( 8 );
+    const size_t nchunks( 16 ); // Per replica per round.
+    const size_t npoints_maximum = ( maximum_npoints == 0 ) ? static_cast<size_t>( result.volume_ * 1000.0 ) : maximum_npoints; // Default is 1000 sampling points per A^3
+    std::vector< Vector3D > shifts;
+    for ( size_t r( 0 ); r != nreplicas; ++r )
+        shifts.push_back( Vector3D( fractional_part( ( r + 1 ) * 0.4142135623730950 ), fractional_part( ( r + 1 ) * 0.7320508075688772 ), fractional_part( ( r + 1 ) * 0.2360679774997897 ) ) );
+    std::vector< size_t > noutside( nreplicas, 0 );
+    size_t npoints_per_replica( 0 ); // Points per replica so far.
+    size_t nnew_points_per_replica( 4096 );
+    size_t nrounds( 0 );
+    while ( true )
+    {
+        std::vector< size_t > noutside_per_task( nreplicas * nchunks, 0 );
+        const size_t first_point = npoints_per_replica + 1; // Element 0 of the Halton sequence is the origin for all bases.
+        thread_pool.run( nreplicas * nchunks, [&]( const size_t task )
+        {
+            const size_t r = task / nchunks;
+            const size_t chunk = task % nchunks;
+            const size_t begin = first_point + ( chunk * nnew_points_per_replica ) / nchunks;
+            const size_t end = first_point + ( ( chunk + 1 ) * nnew_points_per_replica ) / nchunks;
+            size_t noutside_task( 0 );
+            for ( size_t i( begin ); i != end; ++i )
             {
-                Vector3D position_Cartesian( ix * grid_spacing, iy * grid_spacing, iz * grid_spacing );
-                // Check that the probe point lies within the unit cell
-                Vector3D fractional_position = crystal_structure_2.crystal_lattice().orthogonal_to_fractional( position_Cartesian );
-                if ( ( fractional_position.x() < 0.0 ) || ( fractional_position.x() > 1.0 ) ||
-                     ( fractional_position.y() < 0.0 ) || ( fractional_position.y() > 1.0 ) ||
-                     ( fractional_position.z() < 0.0 ) || ( fractional_position.z() > 1.0 ) )
+                Vector3D point( fractional_part( radical_inverse( i, 2 ) + shifts[r].x() ),
+                                fractional_part( radical_inverse( i, 3 ) + shifts[r].y() ),
+                                fractional_part( radical_inverse( i, 5 ) + shifts[r].z() ) );
+                int iv;
+                int jv;
+                int kv;
+                const size_t index = voxel_grid.voxel( point, iv, jv, kv );
+                if ( is_covered[index] )
                     continue;
-                if ( ! intersects_atoms( atom_positions_Cartesian, position_Cartesian, distances2 ) )
-                    void_spheres_intermediate.push_back( position_Cartesian );
+                const Vector3D position = fractional_to_orthogonal_matrix * ( point - voxel_grid.centre( iv, jv, kv ) );
+                bool is_inside( false );
+                for ( size_t j( 0 ); j != candidates[index].size(); ++j )
+                {
+                    if ( ( position - candidates[index][j].position_ ).norm2() < candidates[index][j].radius2_ )
+                    {
+                        is_inside = true;
+                        break;
+                    }
+                }
+                if ( ! is_inside )
+                    ++noutside_task;
             }
-        }
+            noutside_per_task[task] = noutside_task;
+        } );
+        for ( size_t task( 0 ); task != nreplicas * nchunks; ++task )
+            noutside[ task / nchunks ] += noutside_per_task[task];
+        npoints_per_replica += nnew_points_per_replica;
+        ++nrounds;
+        double mean( 0.0 );
+        for ( size_t r( 0 ); r != nreplicas; ++r )
+            mean += static_cast<double>( noutside[r] ) / npoints_per_replica;
+        mean /= nreplicas;
+        double variance( 0.0 );
+        for ( size_t r( 0 ); r != nreplicas; ++r )
+            variance += square( static_cast<double>( noutside[r] ) / npoints_per_replica - mean );
+        variance /= ( nreplicas - 1 );
+        result.volume_ = mean * crystal_lattice.volume();
+        result.standard_error_ = sqrt( variance / nreplicas ) * crystal_lattice.volume();
+        result.npoints_ = nreplicas * npoints_per_replica;
+        if ( ( nrounds > 1 ) && ( result.standard_error_ <= relative_tolerance * crystal_lattice.volume() ) )
+            break;
+        if ( result.npoints_ + nreplicas * 2 * nnew_points_per_replica > npoints_maximum )
+            break;
+        // Doubling the number of points per round keeps the number of error estimates logarithmic in the number of points.
+        nnew_points_per_replica = npoints_per_replica;
     }
-    std::cout << "Number of intermediate spheres = " << void_spheres_intermediate.size() << std::endl;
-    // Above was with smaller radius (-0.05). Now for every point try again, this time with the real radius, but on nine different points (vertices + centre of a cube).
-    std::vector< Vector3D > void_spheres_final;
-    // For each atom, precalculate square( VdW radius + probe_radius )
-    distances2.clear();
-    for ( size_t i( 0 ); i != crystal_structure_2.natoms(); ++i )
-        distances2.push_back( square( crystal_structure_2.atom( i ).element().Van_der_Waals_radius() + probe_radius ) );
-    double delta = probe_reduction / sqrt(3.0); // 0.028868 Cartesian coordinates
-    for ( size_t i( 0 ); i != void_spheres_intermediate.size(); ++i )
-    {
-        Vector3D position_Cartesian( void_spheres_intermediate[i] );
-        if ( ! intersects_atoms( atom_positions_Cartesian, position_Cartesian, distances2 ) )
-            void_spheres_final.push_back( position_Cartesian );
-        position_Cartesian = Vector3D( void_spheres_intermediate[i] + Vector3D( -delta, -delta, -delta ) );
-        if ( ! intersects_atoms( atom_positions_Cartesian, position_Cartesian, distances2 ) )
-            void_spheres_final.push_back( position_Cartesian );
-        position_Cartesian = Vector3D( void_spheres_intermediate[i] + Vector3D( -delta, -delta, +delta ) );
-        if ( ! intersects_atoms( atom_positions_Cartesian, position_Cartesian, distances2 ) )
-            void_spheres_final.push_back( position_Cartesian );
-        position_Cartesian = Vector3D( void_spheres_intermediate[i] + Vector3D( -delta, +delta, -delta ) );
-        if ( ! intersects_atoms( atom_positions_Cartesian, position_Cartesian, distances2 ) )
-            void_spheres_final.push_back( position_Cartesian );
-        position_Cartesian = Vector3D( void_spheres_intermediate[i] + Vector3D( -delta, +delta, +delta ) );
-        if ( ! intersects_atoms( atom_positions_Cartesian, position_Cartesian, distances2 ) )
-            void_spheres_final.push_back( position_Cartesian );
-        position_Cartesian = Vector3D( void_spheres_intermediate[i] + Vector3D( +delta, -delta, -delta ) );
-        if ( ! intersects_atoms( atom_positions_Cartesian, position_Cartesian, distances2 ) )
-            void_spheres_final.push_back( position_Cartesian );
-        position_Cartesian = Vector3D( void_spheres_intermediate[i] + Vector3D( +delta, -delta, +delta ) );
-        if ( ! intersects_atoms( atom_positions_Cartesian, position_Cartesian, distances2 ) )
-            void_spheres_final.push_back( position_Cartesian );
-        position_Cartesian = Vector3D( void_spheres_intermediate[i] + Vector3D( +delta, +delta, -delta ) );
-        if ( ! intersects_atoms( atom_positions_Cartesian, position_Cartesian, distances2 ) )
-            void_spheres_final.push_back( position_Cartesian );
-        position_Cartesian = Vector3D( void_spheres_intermediate[i] + Vector3D( +delta, +delta, +delta ) );
-        if ( ! intersects_atoms( atom_positions_Cartesian, position_Cartesian, distances2 ) )
-            void_spheres_final.push_back( position_Cartesian );
-    }
-    std::cout << "Number of final spheres = " << void_spheres_final.size() << std::endl;
-    // Calculate the combined volume of the voids
-    return calculate_volume( crystal_structure_2, void_spheres_final, probe_radius );
+    return result;
 }
 
 // ********************************************************************************
 
 double void_volume( const CrystalStructure & crystal_structure )
 {
-    if ( crystal_structure.natoms() == 0 )
-        return crystal_structure.crystal_lattice().volume();
-    CrystalStructure crystal_structure_2( crystal_structure );
-    crystal_structure_2.pack_crystal( 0.0 );
-    RandomNumberGenerator_double random_number_generator;
-    const size_t nprobes( ( crystal_structure_2.crystal_lattice().volume() * 1000.0 ) / crystal_structure_2.space_group().nsymmetry_operators() ); // 1000 sampling points per A^3
-    // For each atom, precalculate square( VdW radius )
-    std::vector< Vector3D > atom_positions_Cartesian;
-    atom_positions_Cartesian.reserve( crystal_structure_2.natoms() );
-    std::vector< double > distances2;
-    distances2.reserve( crystal_structure_2.natoms() );
-    for ( size_t i( 0 ); i != crystal_structure_2.natoms(); ++i )
-    {
-        distances2.push_back( square( crystal_structure_2.atom( i ).element().Van_der_Waals_radius() ) );
-        atom_positions_Cartesian.push_back( crystal_structure_2.crystal_lattice().fractional_to_orthogonal( crystal_structure_2.atom( i ).position() ) );
-    }
-    size_t ninside_voids( 0 );
-    for ( size_t ix( 0 ); ix != nprobes; ++ix )
-    {
-        Vector3D random_vector_fractional( random_number_generator.next_number(), random_number_generator.next_number(), random_number_generator.next_number() );
-        Vector3D random_vector_Cartesian = crystal_structure_2.crystal_lattice().fractional_to_orthogonal( random_vector_fractional );
-        if ( ! intersects_atoms( atom_positions_Cartesian, random_vector_Cartesian, distances2 ) )
-                ++ninside_voids;
-    }
-    return ( static_cast<double>( ninside_voids ) / static_cast<double>( nprobes ) ) * crystal_structure_2.crystal_lattice().volume();
+    return integrate_void_volume( crystal_structure ).volume_;
 }
 
 // ********************************************************************************
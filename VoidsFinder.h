@@ -30,12 +30,58 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 class CrystalStructure;
 
-// Returns the void volume
-// Uses the old algorithm, based on first finding the set of spheres that determine the voids followed by
-// determining the volume of the set of spheres.
+#include <cstddef> // For definition of size_t
+#include <vector>
+
+struct VoidsReport
+{
+    double total_void_volume_;
+    // One entry per void.
+    std::vector< double > void_volumes_;
+    // 0 for an isolated pocket, 1 for a channel, 2 for a layer, 3 for a three-dimensional network of voids.
+    std::vector< size_t > void_dimensionalities_;
+};
+
+// The void is the volume that can be reached by a spherical probe of radius probe_radius that does not overlap with
+// the Van der Waals spheres of the atoms, i.e. the union of all probe spheres that fit in the crystal structure.
+//
+// The unit cell is divided into voxels of at most grid_spacing A along each lattice vector and the distance from each voxel
+// to the nearest Van der Waals surface is calculated by letting each atom update the voxels in a sphere around it.
+// Voxels further than probe_radius from the Van der Waals surface can accommodate the centre of a probe. The voids are the connected regions
+// of these voxels, taking periodicity into account: a void that connects to its own periodic image is a channel, layer or network.
+// Two pockets joined by a neck that is narrower than the probe are therefore two voids, even if their probe spheres overlap in the neck.
+// The volume of each void is that of the union of the probe spheres centred on the voxels on its surface; voxels that can be reached
+// from more than one void are counted once, for the void that was found first.
+// The voxels are sorted into slabs along a, each slab only visits the spheres that intersect it. The cost is proportional to the number of atoms
+// times the number of voxels in a sphere of the Van der Waals radius plus probe_radius, plus the number of voxels on the surface of the voids
+// times the number of voxels in a sphere of probe_radius (about 2000 at the defaults), plus the number of voxels.
+// The work is divided over nthreads threads (0 means all cores) and the results do not depend on the number of threads.
+// The error in the volumes is a few percent at the default grid spacing.
+// Space-group symmetry is applied if that has not already been done.
+VoidsReport find_voids_on_grid( const CrystalStructure & crystal_structure, const double probe_radius = 1.2, const double grid_spacing = 0.15, const size_t nthreads = 0 );
+
+// Returns the void volume, calculated with find_voids_on_grid().
 double find_voids( const CrystalStructure & crystal_structure, const double probe_radius = 1.2 );
 
-// Probe size is 0.0, this is useful for calculating e.g. the packing coefficient.
+struct VolumeEstimate
+{
+    double volume_;
+    double standard_error_;
+    size_t npoints_;
+};
+
+// The volume of the unit cell that is not inside the Van der Waals sphere of any atom (probe size 0.0),
+// this is useful for calculating e.g. the packing coefficient.
+//
+// The volume is integrated by randomised quasi-Monte Carlo: several copies of the Halton sequence, each shifted by a different fixed vector,
+// are tested against the atoms, which are sorted into a coarse grid of voxels beforehand so each point is tested against only a few atoms.
+// The spread of the copies gives the standard error. The number of points is doubled until the standard error is below
+// relative_tolerance times the unit-cell volume or until maximum_npoints would be exceeded (0 means 1000 points per A^3).
+// The points are the same for any number of threads (0 means all cores), and so is the result.
+// Space-group symmetry is applied if that has not already been done.
+VolumeEstimate integrate_void_volume( const CrystalStructure & crystal_structure, const double relative_tolerance = 1.0E-4, const size_t maximum_npoints = 0, const size_t nthreads = 0 );
+
+// Returns the void volume, calculated with integrate_void_volume().
 double void_volume( const CrystalStructure & crystal_structure );
 
 #endif // VOIDSFINDER_H